@@ -0,0 +1,298 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <algorithm>
+#include <iterator>
+
+#include <boost/bind.hpp>
+
+#include "oro_exceptions.h"
+#include "tracer.h"
+#include "response_view.h"
+#include "batch.h"
+
+using namespace std;
+using namespace boost;
+
+namespace oro {
+
+namespace {
+
+/* The handlers: each one checks the response of a call as the matching
+ * method of the Ontology does (cf ResponseView::check()), and stores its
+ * result.
+ */
+
+void checkWrite(const string& what, const ServerResponse& res) {
+    if (res.status == ServerResponse::failed)
+        throw OntologyServerException("Server threw a " + res.exception_msg + " while " + what + ". Server message was " + res.error_msg);
+}
+
+void toConcepts(const string& errorPrefix, set<Concept>* result, const ServerResponse& res) {
+    ResponseView::check(res, errorPrefix);
+
+    //nothing returned is fine.
+    if (const set<string>* rawResult = get<set<string> >(&res.result))
+        copy(rawResult->begin(), rawResult->end(), inserter(*result, result->begin()));
+}
+
+void toSet(const string& errorPrefix, set<string>* result, const ServerResponse& res) {
+    ResponseView::check(res, errorPrefix);
+
+    if (const set<string>* result_p = get<set<string> >(&res.result))
+        *result = *result_p;
+}
+
+void toMap(const string& what, map<string, string>* result, const ServerResponse& res) {
+    if (res.status != ServerResponse::ok)
+        throw OntologyServerException("Server threw a " + res.exception_msg + " while " + what + ". Server message was " + res.error_msg);
+
+    if (const map<string, string>* result_p = get<map<string, string> >(&res.result))
+        *result = *result_p;
+}
+
+void toBool(bool* result, const ServerResponse& res) {
+    if (res.status != ServerResponse::ok)
+        throw OntologyServerException("Server" + res.exception_msg + " while checking consistency. Server message was " + res.error_msg);
+
+    const bool* result_p = get<bool>(&res.result);
+    *result = (result_p != NULL && *result_p);
+}
+
+set<string> stringify(const set<Statement>& statements) {
+    set<string> result;
+    for (set<Statement>::const_iterator it = statements.begin() ; it != statements.end() ; ++it)
+        result.insert(it->to_string());
+    return result;
+}
+
+}
+
+string BatchCall::error() const {
+    if (!_state->error) return "";
+
+    try {
+        std::rethrow_exception(_state->error);
+    } catch (std::exception& e) {
+        return e.what();
+    } catch (...) {
+        return "Unknown error";
+    }
+}
+
+void BatchCall::check() const {
+    if (!_state->done) throw OntologyException("The batch of this call has not been executed yet.");
+    if (_state->error) std::rethrow_exception(_state->error);
+}
+
+void Batch::record(const string& method,
+                   const vector<server_param_types>& args,
+                   const boost::shared_ptr<BatchCall::State>& state,
+                   const Handler& handler) {
+    _queries.push_back(query_type(method, args));
+    _states.push_back(state);
+    _handlers.push_back(handler);
+}
+
+BatchResult<set<Concept> > Batch::find(const string& resource, const set<string>& partial_statements, const set<string>& restrictions) {
+    BatchResult<set<Concept> > result;
+
+    vector<server_param_types> args;
+    args.push_back(resource);
+    args.push_back(partial_statements);
+    if (!restrictions.empty()) args.push_back(restrictions);
+
+    record("find", args, result._state, boost::bind(toConcepts, string("\"find\" operation was not successful"), &result.value(), _1));
+    return result;
+}
+
+BatchResult<set<Concept> > Batch::find(const string& resource, const string& partial_statement) {
+    set<string> tmp;
+    tmp.insert(partial_statement);
+    return find(resource, tmp);
+}
+
+BatchResult<set<Concept> > Batch::findForAgent(const string& agent, const string& resource, const set<string>& partial_statements, const set<string>& restrictions) {
+    BatchResult<set<Concept> > result;
+
+    vector<server_param_types> args;
+    args.push_back(agent);
+    args.push_back(resource);
+    args.push_back(partial_statements);
+    if (!restrictions.empty()) args.push_back(restrictions);
+
+    record("findForAgent", args, result._state, boost::bind(toConcepts, string("\"findForAgent\" operation was not successful"), &result.value(), _1));
+    return result;
+}
+
+BatchResult<set<string> > Batch::query(const string& var_name, const string& query) {
+    BatchResult<set<string> > result;
+
+    vector<server_param_types> args;
+    args.push_back(var_name);
+    args.push_back(query);
+
+    record("query", args, result._state, boost::bind(toSet, "Query <" + query + "> was not successful", &result.value(), _1));
+    return result;
+}
+
+BatchResult<set<string> > Batch::getInfos(const string& resource) {
+    BatchResult<set<string> > result;
+
+    vector<server_param_types> args(1, resource);
+
+    record("getInfos", args, result._state, boost::bind(toSet, "Couldn't retrieve infos on " + resource, &result.value(), _1));
+    return result;
+}
+
+BatchResult<set<string> > Batch::getInfosForAgent(const string& agent, const string& resource) {
+    BatchResult<set<string> > result;
+
+    vector<server_param_types> args;
+    args.push_back(agent);
+    args.push_back(resource);
+
+    record("getInfosForAgent", args, result._state, boost::bind(toSet, "Couldn't retrieve infos on " + resource, &result.value(), _1));
+    return result;
+}
+
+BatchResult<map<string, string> > Batch::lookup(const string& id) {
+    BatchResult<map<string, string> > result;
+
+    vector<server_param_types> args(1, id);
+
+    record("lookup", args, result._state, boost::bind(toMap, "looking up " + id, &result.value(), _1));
+    return result;
+}
+
+BatchResult<bool> Batch::checkConsistency() {
+    BatchResult<bool> result;
+
+    record("checkConsistency", vector<server_param_types>(), result._state, boost::bind(toBool, &result.value(), _1));
+    return result;
+}
+
+BatchResult<map<string, string> > Batch::stats() {
+    BatchResult<map<string, string> > result;
+
+    record("stats", vector<server_param_types>(), result._state, boost::bind(toMap, string("fetching stats"), &result.value(), _1));
+    return result;
+}
+
+BatchCall Batch::add(const Statement& statement) {
+    set<Statement> tmp;
+    tmp.insert(statement);
+    return add(tmp);
+}
+
+BatchCall Batch::add(const set<Statement>& statements) {
+    BatchCall result(new BatchCall::State());
+
+    vector<server_param_types> args(1, stringify(statements));
+
+    record("add", args, result._state, boost::bind(checkWrite, string("adding statements"), _1));
+    return result;
+}
+
+BatchCall Batch::update(const set<Statement>& statements) {
+    BatchCall result(new BatchCall::State());
+
+    vector<server_param_types> args(1, stringify(statements));
+
+    record("update", args, result._state, boost::bind(checkWrite, string("updating statements"), _1));
+    return result;
+}
+
+BatchCall Batch::clear(const set<string>& statements) {
+    BatchCall result(new BatchCall::State());
+
+    vector<server_param_types> args(1, statements);
+
+    record("clear", args, result._state, boost::bind(checkWrite, string("clearing statements from the ontology"), _1));
+    return result;
+}
+
+BatchCall Batch::addForAgent(const string& agent, const set<Statement>& statements) {
+    BatchCall result(new BatchCall::State());
+
+    vector<server_param_types> args;
+    args.push_back(agent);
+    args.push_back(stringify(statements));
+
+    record("addForAgent", args, result._state, boost::bind(checkWrite, "adding statements for agent " + agent, _1));
+    return result;
+}
+
+BatchCall Batch::updateForAgent(const string& agent, const set<Statement>& statements) {
+    BatchCall result(new BatchCall::State());
+
+    vector<server_param_types> args;
+    args.push_back(agent);
+    args.push_back(stringify(statements));
+
+    record("updateForAgent", args, result._state, boost::bind(checkWrite, "updating statements for agent " + agent, _1));
+    return result;
+}
+
+BatchCall Batch::clearForAgent(const string& agent, const set<string>& statements) {
+    BatchCall result(new BatchCall::State());
+
+    vector<server_param_types> args;
+    args.push_back(agent);
+    args.push_back(statements);
+
+    record("clearForAgent", args, result._state, boost::bind(checkWrite, "clearing statements in " + agent + "'s model", _1));
+    return result;
+}
+
+void Batch::execute() {
+    TraceSpan span("ontology", "Batch::execute");
+
+    vector<query_type> queries;
+    vector<boost::shared_ptr<BatchCall::State> > states;
+    vector<Handler> handlers;
+
+    // The batch is ready for new calls, even if a handler throws.
+    queries.swap(_queries);
+    states.swap(_states);
+    handlers.swap(_handlers);
+
+    if (queries.empty()) return;
+
+    vector<ServerResponse> responses;
+    _connector.executeBatch(queries, responses);
+
+    for (size_t i = 0 ; i < states.size() ; ++i) {
+        try {
+            if (i >= responses.size())
+                throw ConnectorException("No response from the server to this request.");
+
+            const ServerResponse& res = responses[i];
+
+            if (res.status == ServerResponse::failed && res.exception_msg == CONNECTOR_EXCEPTION)
+                throw ConnectorException(res.error_msg);
+
+            handlers[i](res);
+        } catch (...) {
+            states[i]->error = std::current_exception();
+        }
+
+        states[i]->done = true;
+    }
+}
+
+}
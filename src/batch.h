@@ -0,0 +1,209 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/** \file
+ * This header defines the Batch class, which sends many independent calls
+ * to the ontology server at once, and the BatchResult of each call.
+ */
+
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include <set>
+#include <map>
+#include <vector>
+#include <string>
+#include <exception>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "oro.h"
+
+namespace oro {
+
+/**
+ * The outcome of a call recorded in a Batch, without value (for the
+ * writes). Valid once the batch is executed.
+ */
+class BatchCall {
+public:
+
+    /**
+     * Returns true once the batch has been executed.
+     */
+    bool done() const {return _state->done;}
+
+    /**
+     * Returns true if the call succeeded.
+     */
+    bool ok() const {return _state->done && !_state->error;}
+
+    /**
+     * Returns the message of the exception of the call, or an empty string
+     * if it succeeded.
+     */
+    std::string error() const;
+
+    /**
+     * Throws the exception of the call, as the matching method of the
+     * Ontology would have (OntologyServerException,
+     * ResourceNotFoundOntologyException...), if it failed. Throws an
+     * OntologyException if the batch has not been executed yet.
+     */
+    void check() const;
+
+protected:
+    friend class Batch;
+
+    struct State {
+        State() : done(false) {}
+        virtual ~State() {}
+
+        bool done;
+        std::exception_ptr error;
+    };
+
+    explicit BatchCall(State* state) : _state(state) {}
+
+    boost::shared_ptr<State> _state;
+};
+
+/**
+ * The outcome of a call recorded in a Batch, with its value.
+ */
+template<typename T>
+class BatchResult : public BatchCall {
+public:
+
+    /**
+     * Returns the result of the call, or throws its exception (cf check()).
+     */
+    const T& get() const {
+        check();
+        return static_cast<const ValueState*>(_state.get())->value;
+    }
+
+protected:
+    friend class Batch;
+
+    struct ValueState : public State {
+        T value;
+    };
+
+    BatchResult() : BatchCall(new ValueState()) {}
+
+    T& value() {return static_cast<ValueState*>(_state.get())->value;}
+};
+
+/**
+ * Records independent calls to the ontology, and sends them all at once
+ * when execute() is called. Obtained from Ontology::batch().
+ *
+ * With the SocketConnector, the requests are written back-to-back in a
+ * single write, and the responses are read as they arrive: the batch costs
+ * about one round-trip to the server instead of one per call. Other
+ * connectors execute the calls one after the other.
+ *
+ * Each call returns a handle to its own result. A failed call does not
+ * prevent the other ones from completing: its handle holds the exception
+ * the corresponding Ontology method would have thrown.
+ *
+ * \code
+ * Batch batch = oro->batch();
+ *
+ * BatchResult<set<string> > infos = batch.getInfos("myself");
+ * BatchResult<set<Concept> > seen = batch.find("x", "myself sees ?x");
+ * BatchCall added = batch.add(Statement("myself isIn kitchen"));
+ *
+ * batch.execute();
+ *
+ * if (infos.ok()) ...
+ * set<Concept> objects = seen.get(); // throws if the find failed
+ * \endcode
+ *
+ * The calls are sent in the order they were recorded, and the server
+ * processes them in that order. Writes are always acknowledged, and bypass
+ * bufferize() and the automatic batching.
+ *
+ * A Batch is meant to be used by one thread. It can be reused once
+ * executed.
+ */
+class Batch {
+public:
+
+    explicit Batch(IConnector& connector) : _connector(connector) {}
+
+    /* Reads */
+
+    BatchResult<std::set<Concept> > find(const std::string& resource, const std::set<std::string>& partial_statements, const std::set<std::string>& restrictions = std::set<std::string>());
+    BatchResult<std::set<Concept> > find(const std::string& resource, const std::string& partial_statement);
+    BatchResult<std::set<Concept> > findForAgent(const std::string& agent, const std::string& resource, const std::set<std::string>& partial_statements, const std::set<std::string>& restrictions = std::set<std::string>());
+    BatchResult<std::set<std::string> > query(const std::string& var_name, const std::string& query);
+    BatchResult<std::set<std::string> > getInfos(const std::string& resource);
+    BatchResult<std::set<std::string> > getInfosForAgent(const std::string& agent, const std::string& resource);
+
+    /**
+     * Looks up a label or an id: returns the matching ids, with their type
+     * ("instance", "class", "object_property"...).
+     */
+    BatchResult<std::map<std::string, std::string> > lookup(const std::string& id);
+
+    BatchResult<bool> checkConsistency();
+    BatchResult<std::map<std::string, std::string> > stats();
+
+    /* Writes */
+
+    BatchCall add(const Statement& statement);
+    BatchCall add(const std::set<Statement>& statements);
+    BatchCall update(const std::set<Statement>& statements);
+    BatchCall clear(const std::set<std::string>& statements);
+    BatchCall addForAgent(const std::string& agent, const std::set<Statement>& statements);
+    BatchCall updateForAgent(const std::string& agent, const std::set<Statement>& statements);
+    BatchCall clearForAgent(const std::string& agent, const std::set<std::string>& statements);
+
+    /**
+     * Returns the number of calls recorded since the last execute().
+     */
+    size_t size() const {return _queries.size();}
+
+    /**
+     * Sends the recorded calls and fills their results. Errors are stored
+     * in the results, not thrown.
+     */
+    void execute();
+
+private:
+
+    /* Converts the response of a call into its result, or throws. */
+    typedef boost::function<void(const ServerResponse&)> Handler;
+
+    void record(const std::string& method,
+                const std::vector<server_param_types>& args,
+                const boost::shared_ptr<BatchCall::State>& state,
+                const Handler& handler);
+
+    IConnector& _connector;
+
+    std::vector<query_type> _queries;
+    std::vector<boost::shared_ptr<BatchCall::State> > _states;
+    std::vector<Handler> _handlers;
+};
+
+}
+
+#endif /* BATCH_H_ */
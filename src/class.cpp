@@ -27,7 +27,7 @@ Class::~Class(){}
 
 void Class::onNewInstance(OroEventObserver& callback, bool repeatable) const {
 	set<string> pattern;
-	pattern.insert(_name);
+	pattern.insert(_name.str());
 	
 	Ontology::getInstance()->registerEvent(
 					callback,
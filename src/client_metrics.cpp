@@ -0,0 +1,266 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <algorithm>
+#include <iomanip>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#include "leaked.h"
+#include "client_metrics.h"
+
+using namespace std;
+
+namespace oro {
+
+void MethodStats::merge(const MethodStats& other) {
+    calls += other.calls;
+    errors += other.errors;
+    bytesSent += other.bytesSent;
+    bytesReceived += other.bytesReceived;
+    serializeTime += other.serializeTime;
+    queueTime += other.queueTime;
+    waitTime += other.waitTime;
+    parseTime += other.parseTime;
+    latency.merge(other.latency);
+}
+
+void ClientStats::merge(const ClientStats& other) {
+    for (map<string, MethodStats>::const_iterator it = other.methods.begin() ; it != other.methods.end() ; ++it)
+        methods[it->first].merge(it->second);
+
+    events += other.events;
+    eventBytes += other.eventBytes;
+    eventParseTime += other.eventParseTime;
+    bufferedStatements += other.bufferedStatements;
+    cancelledStatements += other.cancelledStatements;
+    duplicatedStatements += other.duplicatedStatements;
+    sentBatches += other.sentBatches;
+    sentStatements += other.sentStatements;
+    arenaReleases += other.arenaReleases;
+    arenaAllocations += other.arenaAllocations;
+    arenaBytes += other.arenaBytes;
+    arenaUpstreamAllocations += other.arenaUpstreamAllocations;
+    arenaPeakBytes = max(arenaPeakBytes, other.arenaPeakBytes);
+}
+
+// Mean of a cumulated time, in microseconds.
+static double meanUs(boost::uint64_t total, boost::uint64_t count) {
+    return count ? total / 1e3 / count : 0.0;
+}
+
+ostream& operator<<(ostream& os, const ClientStats& stats) {
+
+    ios::fmtflags flags = os.flags();
+    streamsize precision = os.precision();
+
+    os << left << setw(24) << "request" << right
+       << setw(9) << "calls" << setw(7) << "errors"
+       << setw(12) << "sent(B)" << setw(12) << "recv(B)"
+       << setw(10) << "p50(us)" << setw(10) << "p99(us)" << setw(10) << "max(us)"
+       << setw(11) << "serialize" << setw(9) << "queue" << setw(10) << "wait" << setw(9) << "parse" << endl;
+
+    os << fixed << setprecision(1);
+
+    for (map<string, MethodStats>::const_iterator it = stats.methods.begin() ; it != stats.methods.end() ; ++it) {
+        const MethodStats& m = it->second;
+
+        os << left << setw(24) << it->first << right
+           << setw(9) << m.calls << setw(7) << m.errors
+           << setw(12) << m.bytesSent << setw(12) << m.bytesReceived
+           << setw(10) << m.latency.percentile(50) / 1e3
+           << setw(10) << m.latency.percentile(99) / 1e3
+           << setw(10) << m.latency.max() / 1e3
+           << setw(11) << meanUs(m.serializeTime, m.calls)
+           << setw(9) << meanUs(m.queueTime, m.calls)
+           << setw(10) << meanUs(m.waitTime, m.calls)
+           << setw(9) << meanUs(m.parseTime, m.calls) << endl;
+    }
+
+    os << "(phases: mean time per call, in us)" << endl;
+
+    os << "events: " << stats.events << " received, " << stats.eventBytes << " bytes, "
+       << meanUs(stats.eventParseTime, stats.events) << "us mean parse time" << endl;
+
+    os << "buffering: " << stats.bufferedStatements << " statements buffered, "
+       << stats.cancelledStatements << " cancelled, " << stats.duplicatedStatements << " duplicated, "
+       << stats.sentStatements << " sent in " << stats.sentBatches << " batches" << endl;
+
+    os << "arenas: " << stats.arenaReleases << " requests, " << stats.arenaAllocations << " allocations, "
+       << stats.arenaBytes << " bytes (peak " << stats.arenaPeakBytes << "), "
+       << stats.arenaUpstreamAllocations << " upstream allocations" << endl;
+
+    os.flags(flags);
+    os.precision(precision);
+
+    return os;
+}
+
+/*******************************************************************************
+*                              Thread shards                                   *
+*******************************************************************************/
+
+namespace {
+
+// The metrics recorded by one thread.
+struct Shard {
+    boost::mutex lock;
+    ClientStats stats;
+};
+
+struct Registry {
+    boost::mutex lock;
+    set<Shard*> shards;
+
+    // Metrics of the threads that have exited.
+    ClientStats retired;
+};
+
+Registry& registry() {
+    return leaked<Registry>();
+}
+
+// Called when a thread exits.
+void retire(Shard* shard) {
+    Registry& reg = registry();
+    boost::lock_guard<boost::mutex> lock(reg.lock);
+
+    reg.retired.merge(shard->stats);
+    reg.shards.erase(shard);
+    delete shard;
+}
+
+Shard& localShard() {
+    static leaked_tls<Shard> shards(retire);
+
+    Shard* shard = shards.get();
+
+    if (shard == NULL) {
+        shard = new Shard();
+        shards.reset(shard);
+
+        Registry& reg = registry();
+        boost::lock_guard<boost::mutex> lock(reg.lock);
+        reg.shards.insert(shard);
+    }
+
+    return *shard;
+}
+
+bool enabledByEnvironment() {
+    const char* value = getenv("ORO_METRICS");
+    return value != NULL && strcmp(value, "1") == 0;
+}
+
+}
+
+/*******************************************************************************
+*                               ClientMetrics                                  *
+*******************************************************************************/
+
+boost::atomic<bool> ClientMetrics::_enabled(enabledByEnvironment());
+
+void ClientMetrics::enable(bool state) {
+    _enabled.store(state, boost::memory_order_relaxed);
+}
+
+ClientStats ClientMetrics::snapshot() {
+    Registry& reg = registry();
+    boost::lock_guard<boost::mutex> lock(reg.lock);
+
+    ClientStats res;
+    res.merge(reg.retired);
+
+    for (set<Shard*>::const_iterator it = reg.shards.begin() ; it != reg.shards.end() ; ++it) {
+        boost::lock_guard<boost::mutex> shardLock((*it)->lock);
+        res.merge((*it)->stats);
+    }
+
+    return res;
+}
+
+void ClientMetrics::reset() {
+    Registry& reg = registry();
+    boost::lock_guard<boost::mutex> lock(reg.lock);
+
+    reg.retired = ClientStats();
+
+    for (set<Shard*>::const_iterator it = reg.shards.begin() ; it != reg.shards.end() ; ++it) {
+        boost::lock_guard<boost::mutex> shardLock((*it)->lock);
+        (*it)->stats = ClientStats();
+    }
+}
+
+void ClientMetrics::recordRequest(const string& method, const RequestMetrics& request, boost::uint64_t latency) {
+    Shard& shard = localShard();
+    boost::lock_guard<boost::mutex> lock(shard.lock);
+
+    MethodStats& stats = shard.stats.methods[method];
+
+    stats.calls++;
+    if (request.failed) stats.errors++;
+    stats.bytesSent += request.bytesSent;
+    stats.bytesReceived += request.bytesReceived;
+    stats.serializeTime += request.serializeTime;
+    stats.queueTime += request.queueTime;
+    stats.waitTime += request.waitTime;
+    stats.parseTime += request.parseTime;
+    stats.latency.record(latency);
+}
+
+void ClientMetrics::recordEvent(size_t bytes, boost::uint64_t parseTime) {
+    Shard& shard = localShard();
+    boost::lock_guard<boost::mutex> lock(shard.lock);
+
+    shard.stats.events++;
+    shard.stats.eventBytes += bytes;
+    shard.stats.eventParseTime += parseTime;
+}
+
+void ClientMetrics::recordBuffering(size_t buffered, size_t cancelled, size_t duplicated) {
+    Shard& shard = localShard();
+    boost::lock_guard<boost::mutex> lock(shard.lock);
+
+    shard.stats.bufferedStatements += buffered;
+    shard.stats.cancelledStatements += cancelled;
+    shard.stats.duplicatedStatements += duplicated;
+}
+
+void ClientMetrics::recordBatch(size_t statements) {
+    Shard& shard = localShard();
+    boost::lock_guard<boost::mutex> lock(shard.lock);
+
+    shard.stats.sentBatches++;
+    shard.stats.sentStatements += statements;
+}
+
+void ClientMetrics::recordArena(size_t allocations, size_t bytes, size_t upstream) {
+    Shard& shard = localShard();
+    boost::lock_guard<boost::mutex> lock(shard.lock);
+
+    shard.stats.arenaReleases++;
+    shard.stats.arenaAllocations += allocations;
+    shard.stats.arenaBytes += bytes;
+    shard.stats.arenaUpstreamAllocations += upstream;
+    shard.stats.arenaPeakBytes = max(shard.stats.arenaPeakBytes, (boost::uint64_t) bytes);
+}
+
+}
@@ -0,0 +1,200 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/** \file
+ * This header defines ClientMetrics, the registry of the client-side
+ * metrics of liboro (time spent per request, bytes exchanged with the
+ * server, events, buffering), and ClientStats, a snapshot of these metrics.
+ */
+
+#ifndef CLIENT_METRICS_H_
+#define CLIENT_METRICS_H_
+
+#include <string>
+#include <map>
+#include <ostream>
+#include <chrono>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+
+#include "latency_histogram.h"
+
+namespace oro {
+
+/**
+ * The metrics of one type of request ("add", "find", "query"...).
+ *
+ * Times are in nanoseconds. The phases of a request are:
+ *  - serialization of the parameters,
+ *  - queue: wait for the connection to be available for writing,
+ *  - wait: from the sending of the request to the availability of the
+ *    response (network and server time),
+ *  - parse: deserialization of the response.
+ *
+ * Requests sent without waiting for the acknowledgment of the server have
+ * no wait and parse times, and no bytes received.
+ */
+struct MethodStats {
+    MethodStats() : calls(0), errors(0), bytesSent(0), bytesReceived(0),
+                    serializeTime(0), queueTime(0), waitTime(0), parseTime(0) {}
+
+    void merge(const MethodStats& other);
+
+    boost::uint64_t calls;
+    boost::uint64_t errors;
+
+    boost::uint64_t bytesSent;
+    boost::uint64_t bytesReceived;
+
+    // Cumulated times of each phase
+    boost::uint64_t serializeTime;
+    boost::uint64_t queueTime;
+    boost::uint64_t waitTime;
+    boost::uint64_t parseTime;
+
+    // Distribution of the total duration of the requests
+    LatencyHistogram latency;
+};
+
+/**
+ * The metrics of a single request, as recorded by the connector.
+ */
+struct RequestMetrics {
+    RequestMetrics() : failed(false), bytesSent(0), bytesReceived(0),
+                       serializeTime(0), queueTime(0), waitTime(0), parseTime(0) {}
+
+    bool failed;
+    size_t bytesSent;
+    size_t bytesReceived;
+    boost::uint64_t serializeTime;
+    boost::uint64_t queueTime;
+    boost::uint64_t waitTime;
+    boost::uint64_t parseTime;
+};
+
+/**
+ * A snapshot of the client-side metrics, as returned by
+ * Ontology::clientStats().
+ */
+struct ClientStats {
+    ClientStats() : events(0), eventBytes(0), eventParseTime(0),
+                    bufferedStatements(0), cancelledStatements(0), duplicatedStatements(0),
+                    sentBatches(0), sentStatements(0),
+                    arenaReleases(0), arenaAllocations(0), arenaBytes(0),
+                    arenaUpstreamAllocations(0), arenaPeakBytes(0) {}
+
+    void merge(const ClientStats& other);
+
+    /** Metrics of the requests, by request name. */
+    std::map<std::string, MethodStats> methods;
+
+    /** Events received from the server, their size and parsing time. */
+    boost::uint64_t events;
+    boost::uint64_t eventBytes;
+    boost::uint64_t eventParseTime;
+
+    /** Statements written while bufferizing (or auto-batching). */
+    boost::uint64_t bufferedStatements;
+    /** Buffered statements that cancelled a pending opposite action (an add
+     * cancelled by a remove, or conversely), both being dropped. */
+    boost::uint64_t cancelledStatements;
+    /** Buffered statements that were already pending for the same action. */
+    boost::uint64_t duplicatedStatements;
+
+    /** Batches of buffered statements sent to the server, and the number of
+     * statements they held. */
+    boost::uint64_t sentBatches;
+    boost::uint64_t sentStatements;
+
+    /** Request arenas (cf RequestArena): the number of requests that
+     * allocated from them, the allocations and bytes they served, and the
+     * allocations they made themselves (ideally, none once warm). The peak
+     * is the largest request, in bytes. */
+    boost::uint64_t arenaReleases;
+    boost::uint64_t arenaAllocations;
+    boost::uint64_t arenaBytes;
+    boost::uint64_t arenaUpstreamAllocations;
+    boost::uint64_t arenaPeakBytes;
+};
+
+/**
+ * Prints the stats, one line per type of request.
+ */
+std::ostream& operator<<(std::ostream& os, const ClientStats& stats);
+
+/**
+ * The process-wide registry of the client-side metrics.
+ *
+ * Metrics are disabled by default. They are enabled with enable(), or by
+ * setting the ORO_METRICS environment variable to 1. While disabled, the
+ * instrumented code only tests enabled(), a relaxed atomic load.
+ *
+ * Each thread records into its own set of metrics, only merged by
+ * snapshot(): recording never contends with other threads.
+ */
+class ClientMetrics {
+public:
+    static bool enabled() {return _enabled.load(boost::memory_order_relaxed);}
+
+    static void enable(bool state = true);
+
+    /**
+     * Returns the metrics recorded so far, by all the threads.
+     */
+    static ClientStats snapshot();
+
+    static void reset();
+
+    /**
+     * A monotonic timestamp, in nanoseconds, to measure the phases of the
+     * requests.
+     */
+    static boost::uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * Records a complete request, \p latency being its total duration.
+     */
+    static void recordRequest(const std::string& method, const RequestMetrics& request, boost::uint64_t latency);
+
+    static void recordEvent(size_t bytes, boost::uint64_t parseTime);
+
+    /**
+     * Records \p buffered statements added to a buffer, \p cancelled of them
+     * cancelling a pending opposite action, \p duplicated already pending.
+     */
+    static void recordBuffering(size_t buffered, size_t cancelled, size_t duplicated);
+
+    static void recordBatch(size_t statements);
+
+    /**
+     * Records the release of a request arena that served \p allocations
+     * allocations, for \p bytes bytes, and had to allocate \p upstream new
+     * chunks to do so.
+     */
+    static void recordArena(size_t allocations, size_t bytes, size_t upstream);
+
+private:
+    static boost::atomic<bool> _enabled;
+};
+
+}
+
+#endif /* CLIENT_METRICS_H_ */
@@ -27,30 +27,36 @@ namespace oro {
 /*******************************************************************************
 *                       	  Class Concept                                *
 *******************************************************************************/
-Concept::Concept():_id(Ontology::newId()), _label(""), _class(Class("owl:Thing")) {}
+//Default class of the concepts. Interned once.
+static Class owlThing() {
+	static const Class thing("owl:Thing");
+	return thing;
+}
 
-Concept::Concept(const std::string& id):_id(id), _label(""), _class(Class("owl:Thing")) {}
+Concept::Concept():_id(Ontology::newId()), _class(owlThing()) {}
 
-Concept Concept::create(const std::string& label) {
-	Concept concept;
-	concept.setLabel(label);
+Concept::Concept(const std::string& id):_id(id), _class(owlThing()) {}
 
-	return concept;
+Concept::Concept(Symbol id):_id(id), _class(owlThing()) {}
+
+Concept Concept::create(const std::string& label) {
+	return build().label(label).commit();
 }
 
 Concept Concept::create(const std::string& label, const Class& type){
-	Concept concept;
-	concept.setLabel(label);
-	concept.setType(type);
-
-	return concept;
+	return build().label(label).type(type).commit();
 }
 
 Concept Concept::create(const Class& type){
-	Concept concept;
-	concept.setType(type);
+	return build().type(type).commit();
+}
 
-	return concept;
+ConceptBuilder Concept::build() {
+	return ConceptBuilder(Concept());
+}
+
+ConceptBuilder Concept::build(const std::string& id) {
+	return ConceptBuilder(Concept(id));
 }
 
 void Concept::assertThat(const Property& predicate, const string& value){
@@ -121,36 +127,95 @@ void Concept::remove(const Property& predicate, const Concept& value){
 }
 
 const Concept Concept::nothing = Concept();
+
+/*******************************************************************************
+*                       	  Class ConceptBuilder                         *
+*******************************************************************************/
+ConceptBuilder::ConceptBuilder(const Concept& concept) : _concept(concept) {}
+
+ConceptBuilder& ConceptBuilder::label(const std::string& label){
+	_statements.insert(Statement(_concept, Property("rdfs:label"), "\"" + label + "\""));
+	_concept._label = label;
+	return *this;
+}
+
+ConceptBuilder& ConceptBuilder::type(const Class& type){
+	_statements.insert(Statement(_concept, Property("rdf:type"), type.to_string()));
+	_concept._class = type;
+	return *this;
+}
+
+ConceptBuilder& ConceptBuilder::assertThat(const Property& predicate, const string& value){
+	_statements.insert(Statement(_concept, predicate, value));
+	return *this;
+}
+
+ConceptBuilder& ConceptBuilder::assertThat(const Property& predicate, const Concept& value){
+	_statements.insert(Statement(_concept, predicate, value));
+	return *this;
+}
+
+Concept ConceptBuilder::commit(){
+	if (!_statements.empty())
+		Ontology::getInstance()->add(_statements);
+
+	return _concept;
+}
+
+vector<Concept> ConceptBuilder::commit(const vector<ConceptBuilder>& builders){
+	set<Statement> statements;
+	vector<Concept> concepts;
+	concepts.reserve(builders.size());
+
+	for (vector<ConceptBuilder>::const_iterator it = builders.begin() ; it != builders.end() ; ++it) {
+		statements.insert(it->_statements.begin(), it->_statements.end());
+		concepts.push_back(it->_concept);
+	}
+
+	if (!statements.empty())
+		Ontology::getInstance()->add(statements);
+
+	return concepts;
+}
+
+namespace {
+// Creates a concept of the given type, with a label if not empty, in one
+// request, and returns it in 'concept'.
+void commitNew(Concept& concept, const std::string& label, const Class& type) {
+	ConceptBuilder builder(concept);
+	if (!label.empty()) builder.label(label);
+	concept = builder.type(type).commit();
+}
+}
+
 /*******************************************************************************
 *                            	  Class Object					               *
 *******************************************************************************/
 
 Object Object::create() {
 	Object concept;
-	concept.setType(Class("Object"));
+	commitNew(concept, "", Class("Object"));
 
 	return concept;
 }
 
 Object Object::create(const std::string& label) {
 	Object concept;
-	concept.setLabel(label);
-	concept.setType(Class("Object"));
+	commitNew(concept, label, Class("Object"));
 
 	return concept;
 }
 
 Object Object::create(const std::string& label, const Class& type){
 	Object concept;
-	concept.setLabel(label);
-	concept.setType(type);
+	commitNew(concept, label, type);
 
 	return concept;
 }
 
 Object Object::create(const Class& type){
 	Object concept;
-	concept.setType(type);
+	commitNew(concept, "", type);
 
 	return concept;
 }
@@ -161,30 +226,28 @@ Object Object::create(const Class& type){
 
 Agent Agent::create() {
 	Agent concept;
-	concept.setType(Class("Agent"));
+	commitNew(concept, "", Class("Agent"));
 
 	return concept;
 }
 
 Agent Agent::create(const std::string& label) {
 	Agent concept;
-	concept.setLabel(label);
-	concept.setType(Class("Agent"));
+	commitNew(concept, label, Class("Agent"));
 
 	return concept;
 }
 		
 Agent Agent::create(const std::string& label, const Class& type){
 	Agent concept;
-	concept.setLabel(label);
-	concept.setType(type);
+	commitNew(concept, label, type);
 
 	return concept;
 }
 
 Agent Agent::create(const Class& type){
 	Agent concept;
-	concept.setType(type);
+	commitNew(concept, "", type);
 
 	return concept;
 }
@@ -210,30 +273,28 @@ void Agent::currentlyPerforms(const Action& action){
 		
 Action Action::create() {
 	Action concept;
-	concept.setType(Class("Action"));
+	commitNew(concept, "", Class("Action"));
 
 	return concept;
 }
 		
 Action Action::create(const std::string& label) {
 	Action concept;
-	concept.setLabel(label);
-	concept.setType(Class("Action"));
+	commitNew(concept, label, Class("Action"));
 
 	return concept;
 }
 
 Action Action::create(const std::string& label, const Class& type){
 	Action concept;
-	concept.setLabel(label);
-	concept.setType(type);
+	commitNew(concept, label, type);
 
 	return concept;
 }
 
 Action Action::create(const Class& type){
 	Action concept;
-	concept.setType(type);
+	commitNew(concept, "", type);
 
 	return concept;
 }
@@ -0,0 +1,464 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <chrono>
+
+#include <boost/functional/hash.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "oro.h"
+#include "oro_exceptions.h"
+#include "event_dispatcher.h"
+#include "oro_log.h"
+#include "tracer.h"
+#include "leaked.h"
+
+using namespace std;
+
+namespace oro {
+
+namespace {
+
+// The dispatchers do not own their workers' marker.
+void noCleanup(EventDispatcher*) {}
+
+// The dispatcher the calling thread is a worker of, if any.
+leaked_tls<EventDispatcher>& workerOf() {
+    static leaked_tls<EventDispatcher> dispatcher(noCleanup);
+    return dispatcher;
+}
+
+}
+
+EventDispatcher::EventDispatcher(size_t workers, size_t capacity, OverflowPolicy policy) :
+    _capacity(std::max<size_t>(capacity, 1)),
+    _policy(policy),
+    _nbWorkers(std::max<size_t>(workers, 1)),
+    _nextSerial(0),
+    _dropped(0),
+    _slowThreshold_ms(0)
+{
+    start();
+}
+
+EventDispatcher::~EventDispatcher() {
+    boost::unique_lock<boost::shared_mutex> lock(_shardsLock);
+    stop();
+}
+
+void EventDispatcher::configure(size_t workers, size_t capacity, OverflowPolicy policy) {
+
+    if (onWorker())
+        throw OntologyException("The event dispatcher can not be configured from an observer.");
+
+    // Waits for the on-going 'post' to complete. Producers blocked on a full
+    // queue are released by the workers, which are still running.
+    boost::unique_lock<boost::shared_mutex> lock(_shardsLock);
+
+    stop();
+
+    _nbWorkers = std::max<size_t>(workers, 1);
+    _capacity = std::max<size_t>(capacity, 1);
+    _policy = policy;
+
+    start();
+}
+
+void EventDispatcher::start() {
+    for (size_t i = 0 ; i < _nbWorkers ; ++i) {
+        boost::shared_ptr<Shard> shard(new Shard());
+        shard->worker = boost::thread(boost::bind(&EventDispatcher::run, this, shard.get()));
+        _shards.push_back(shard);
+    }
+}
+
+void EventDispatcher::stop() {
+    for (size_t i = 0 ; i < _shards.size() ; ++i) {
+        {
+            boost::lock_guard<boost::mutex> lock(_shards[i]->lock);
+            _shards[i]->stopping = true;
+        }
+        _shards[i]->notEmpty.notify_one();
+    }
+
+    for (size_t i = 0 ; i < _shards.size() ; ++i)
+        _shards[i]->worker.join();
+
+    _shards.clear();
+}
+
+bool EventDispatcher::subscribe(const string& event_id,
+                                OroEventObserver* observer,
+                                bool oneShot,
+                                const EventCoalescing& coalescing) {
+    boost::unique_lock<boost::shared_mutex> lock(_registryLock);
+
+    if (_observers.find(event_id) != _observers.end()) return false;
+
+    Subscription& subscription = _observers[event_id];
+    subscription.observer = observer;
+    subscription.oneShot = oneShot;
+    subscription.coalescing = coalescing;
+    subscription.serial = ++_nextSerial;
+
+    boost::lock_guard<boost::mutex> statsLock(_statsLock);
+    _stats[event_id] = ObserverStats();
+    return true;
+}
+
+bool EventDispatcher::unsubscribe(const string& event_id) {
+    {
+        boost::unique_lock<boost::shared_mutex> lock(_registryLock);
+
+        if (_observers.erase(event_id) == 0) return false;
+
+        boost::lock_guard<boost::mutex> statsLock(_statsLock);
+        retireStats(event_id);
+    }
+
+    // From now on, deliver() does not call the observer anymore: wait for
+    // the call in progress, if any.
+    boost::unique_lock<boost::mutex> lock(_deliveryLock);
+
+    map<string, boost::thread::id>::const_iterator it;
+    while ((it = _delivering.find(event_id)) != _delivering.end() &&
+           it->second != boost::this_thread::get_id())
+        _deliveryDone.wait(lock);
+
+    return true;
+}
+
+bool EventDispatcher::onWorker() const {
+    return workerOf().get() == this;
+}
+
+void EventDispatcher::retireStats(const string& event_id) {
+    map<string, ObserverStats>::iterator it = _stats.find(event_id);
+    if (it == _stats.end()) return;
+
+    const ObserverStats& stats = it->second;
+    _retired.events += stats.events;
+    _retired.calls += stats.calls;
+    _retired.total_us += stats.total_us;
+    if (stats.calls > 0) _retired.last_us = stats.last_us;
+    if (stats.max_us > _retired.max_us) _retired.max_us = stats.max_us;
+
+    _stats.erase(it);
+}
+
+bool EventDispatcher::post(const string& event_id, const server_return_types& raw_event_content) {
+
+    boost::shared_lock<boost::shared_mutex> shardsLock(_shardsLock);
+
+    Shard& shard = *_shards[boost::hash<string>()(event_id) % _shards.size()];
+
+    {
+        boost::unique_lock<boost::mutex> lock(shard.lock);
+
+        if (shard.queue.size() >= _capacity) {
+            switch (_policy) {
+            case BLOCK:
+                while (shard.queue.size() >= _capacity)
+                    shard.notFull.wait(lock);
+                break;
+            case DROP_NEWEST:
+                {
+                    boost::lock_guard<boost::mutex> statsLock(_statsLock);
+                    _dropped++;
+                }
+                return false;
+            case DROP_OLDEST:
+                shard.queue.pop_front();
+                {
+                    boost::lock_guard<boost::mutex> statsLock(_statsLock);
+                    _dropped++;
+                }
+                break;
+            }
+        }
+
+        shard.queue.push_back(PendingEvent());
+        shard.queue.back().event_id = event_id;
+        shard.queue.back().raw_content = raw_event_content;
+    }
+
+    shard.notEmpty.notify_one();
+    return true;
+}
+
+void EventDispatcher::run(Shard* shard) {
+
+    Tracer::nameThread("oro events");
+    workerOf().reset(this);
+
+    while (true) {
+        PendingEvent evt;
+        bool gotEvent = false;
+        bool stopping = false;
+
+        {
+            boost::unique_lock<boost::mutex> lock(shard->lock);
+
+            while (shard->queue.empty() && !shard->stopping) {
+                if (shard->bursts.empty()) {
+                    shard->notEmpty.wait(lock);
+                    continue;
+                }
+
+                // Sleep until the next coalescing window closes.
+                boost::posix_time::ptime deadline = boost::posix_time::pos_infin;
+                for (map<string, Burst>::const_iterator it = shard->bursts.begin() ;
+                     it != shard->bursts.end() ; ++it)
+                    deadline = std::min(deadline, it->second.deadline);
+
+                if (!shard->notEmpty.timed_wait(lock, deadline)) break;
+            }
+
+            if (!shard->queue.empty()) {
+                std::swap(evt, shard->queue.front());
+                shard->queue.pop_front();
+                gotEvent = true;
+            }
+            // Only stop once the queue is drained.
+            else stopping = shard->stopping;
+        }
+
+        if (gotEvent) {
+            shard->notFull.notify_one();
+            dispatch(shard, evt);
+        }
+
+        flushBursts(shard, stopping);
+
+        if (stopping) return;
+    }
+}
+
+void EventDispatcher::dispatch(Shard* shard, const PendingEvent& evt) {
+
+    TraceSpan span("event", "dispatch");
+
+    Subscription subscription;
+    {
+        boost::shared_lock<boost::shared_mutex> lock(_registryLock);
+
+        map<string, Subscription>::const_iterator it = _observers.find(evt.event_id);
+
+        if (it == _observers.end()) {
+            ORO_LOG_ERROR("Got a callback on an event I don't know! ({})", evt.event_id);
+            return;
+        }
+
+        subscription = it->second;
+    }
+
+    {
+        // The event may have been removed in the meantime: its stats are
+        // then already retired.
+        boost::lock_guard<boost::mutex> statsLock(_statsLock);
+        map<string, ObserverStats>::iterator stats = _stats.find(evt.event_id);
+        if (stats != _stats.end()) stats->second.events++;
+    }
+
+    if (subscription.coalescing.window_ms == 0) {
+        event_content_types content;
+        if (!toEventContent(evt.raw_content, content)) {
+            ORO_LOG_WARNING("A set of string or an empty string is expected in the event content! I discard this event");
+            return;
+        }
+
+        deliver(evt.event_id, subscription, content, 1);
+        return;
+    }
+
+    const set<string>* raw_content = boost::get<set<string> >(&evt.raw_content);
+    const string* empty_content = boost::get<string>(&evt.raw_content);
+
+    if (raw_content == NULL && (empty_content == NULL || !empty_content->empty())) {
+        ORO_LOG_WARNING("A set of string or an empty string is expected in the event content! I discard this event");
+        return;
+    }
+
+    map<string, Burst>::iterator it = shard->bursts.find(evt.event_id);
+
+    if (it == shard->bursts.end()) {
+        it = shard->bursts.insert(make_pair(evt.event_id, Burst())).first;
+        it->second.nbEvents = 0;
+        it->second.subscription = subscription;
+        it->second.deadline = boost::posix_time::microsec_clock::universal_time() +
+                              boost::posix_time::milliseconds(subscription.coalescing.window_ms);
+    }
+
+    Burst& burst = it->second;
+
+    if (raw_content != NULL)
+        burst.content.insert(raw_content->begin(), raw_content->end());
+    burst.nbEvents++;
+
+    if (subscription.coalescing.max_events > 0 &&
+        burst.nbEvents >= subscription.coalescing.max_events) {
+
+        set<Concept> content(burst.content.begin(), burst.content.end());
+        Burst done = burst;
+        shard->bursts.erase(it);
+
+        deliver(evt.event_id, done.subscription, content, done.nbEvents);
+    }
+}
+
+void EventDispatcher::flushBursts(Shard* shard, bool all) {
+
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+
+    map<string, Burst>::iterator it = shard->bursts.begin();
+
+    while (it != shard->bursts.end()) {
+        if (all || it->second.deadline <= now) {
+            set<Concept> content(it->second.content.begin(), it->second.content.end());
+            Burst done = it->second;
+            string event_id = it->first;
+            shard->bursts.erase(it++);
+
+            deliver(event_id, done.subscription, content, done.nbEvents);
+        }
+        else ++it;
+    }
+}
+
+void EventDispatcher::deliver(const string& event_id,
+                              const Subscription& subscription,
+                              const event_content_types& content,
+                              unsigned long nbEvents) {
+
+    {
+        boost::unique_lock<boost::shared_mutex> lock(_registryLock);
+
+        //The subscription may have been removed (or replaced) since the
+        //event was queued or coalesced: its observer may be gone.
+        map<string, Subscription>::iterator it = _observers.find(event_id);
+        if (it == _observers.end() || it->second.serial != subscription.serial) return;
+
+        //If the event is a "one shot", remove it from the event list before
+        //calling the observer, so that it is never called twice. Its call is
+        //then recorded in the retired stats.
+        if (subscription.oneShot) {
+            _observers.erase(it);
+
+            boost::lock_guard<boost::mutex> statsLock(_statsLock);
+            retireStats(event_id);
+        }
+
+        boost::lock_guard<boost::mutex> deliveryLock(_deliveryLock);
+        _delivering[event_id] = boost::this_thread::get_id();
+    }
+
+    OroEvent e(event_id, content);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    try {
+        TraceSpan span("event", "observer");
+        (*subscription.observer)(e);
+    } catch (...) {
+        endDelivery(event_id);
+        throw;
+    }
+
+    endDelivery(event_id);
+
+    unsigned long long duration = std::chrono::duration_cast<std::chrono::microseconds>(
+                                        std::chrono::steady_clock::now() - start).count();
+
+    boost::lock_guard<boost::mutex> statsLock(_statsLock);
+
+    map<string, ObserverStats>::iterator it = _stats.find(event_id);
+
+    // A subscription removed in the meantime has its stats retired.
+    if (!subscription.oneShot && it != _stats.end()) {
+        ObserverStats& stats = it->second;
+        stats.calls++;
+        stats.total_us += duration;
+        stats.last_us = duration;
+        if (duration > stats.max_us) stats.max_us = duration;
+    }
+    else {
+        _retired.calls++;
+        _retired.total_us += duration;
+        _retired.last_us = duration;
+        if (duration > _retired.max_us) _retired.max_us = duration;
+    }
+
+    if (_slowThreshold_ms > 0 && duration > _slowThreshold_ms * 1000ULL)
+        ORO_LOG_WARNING("Observer of event {} took {}ms ({} coalesced events)", event_id, duration / 1000, nbEvents);
+}
+
+void EventDispatcher::endDelivery(const string& event_id) {
+    {
+        boost::lock_guard<boost::mutex> lock(_deliveryLock);
+        _delivering.erase(event_id);
+    }
+    _deliveryDone.notify_all();
+}
+
+map<string, ObserverStats> EventDispatcher::observerStats() const {
+    boost::lock_guard<boost::mutex> lock(_statsLock);
+    return _stats;
+}
+
+ObserverStats EventDispatcher::retiredObserverStats() const {
+    boost::lock_guard<boost::mutex> lock(_statsLock);
+    return _retired;
+}
+
+unsigned long EventDispatcher::droppedEvents() const {
+    boost::lock_guard<boost::mutex> lock(_statsLock);
+    return _dropped;
+}
+
+void EventDispatcher::setSlowObserverThreshold(unsigned int ms) {
+    boost::lock_guard<boost::mutex> lock(_statsLock);
+    _slowThreshold_ms = ms;
+}
+
+bool EventDispatcher::toEventContent(const server_return_types& raw_event_content,
+                                     event_content_types& content) {
+
+    if (const set<string>* raw_content = boost::get<set<string> >(&raw_event_content)) {
+        set<Concept> event_content;
+
+        copy(raw_content->begin(),
+             raw_content->end(),
+             inserter(event_content, event_content.begin()));
+
+        content = event_content;
+        return true;
+    }
+
+    if (const string* raw_content = boost::get<string>(&raw_event_content)) {
+        if (raw_content->empty()) {
+            content = set<Concept>();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+}
@@ -0,0 +1,303 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/** \file
+ * This header defines the EventDispatcher class, which delivers the events
+ * received by a connector to their OroEventObserver on a pool of dedicated
+ * worker threads, so that slow observers never stall the connector.
+ */
+
+#ifndef EVENT_DISPATCHER_H_
+#define EVENT_DISPATCHER_H_
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <map>
+#include <set>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "oro_event.h"
+#include "oro_connector.h"
+
+namespace oro {
+
+/** Constants that define what the EventDispatcher does when an event arrives
+ * while the queue it belongs to is full.
+ *
+ * <ul>
+ *  <li>\p BLOCK : the connector thread waits until a worker makes room. No
+ *  event is ever lost, but the connector reads nothing else meanwhile: if an
+ *  observer then makes a request to the ontology, it waits for a response
+ *  that the connector can not read anymore, and the connection deadlocks.
+ *  Only use it with observers that never call the ontology.</li>
+ *  <li>\p DROP_NEWEST : the incoming event is discarded.</li>
+ *  <li>\p DROP_OLDEST : the oldest queued event is discarded to make room for
+ *  the incoming one. This is the default.</li>
+ * </ul>
+ */
+enum OverflowPolicy {BLOCK, DROP_NEWEST, DROP_OLDEST};
+
+/**
+ * Coalescing settings of an event subscription.
+ *
+ * When coalescing is enabled, the events received for the same event id
+ * during a time window are merged into a single OroEvent, whose content is
+ * the union of the content of each event. The window opens with the first
+ * event of a burst; the merged event is delivered when the window closes, or
+ * as soon as \p max_events events have been merged.
+ *
+ * With the default settings, coalescing is disabled: each event received from
+ * the server triggers its own call to the observer.
+ */
+struct EventCoalescing {
+    /** Length of the coalescing window, in milliseconds. 0 disables coalescing. */
+    unsigned int window_ms;
+
+    /** Maximum number of events merged together. 0 means no limit. */
+    size_t max_events;
+
+    EventCoalescing(unsigned int window_ms = 0, size_t max_events = 0) :
+        window_ms(window_ms),
+        max_events(max_events) {}
+};
+
+/**
+ * Timing statistics of the observer attached to one event.
+ */
+struct ObserverStats {
+    /** Number of events received from the server. */
+    unsigned long events;
+
+    /** Number of times the observer has been called. Lower than \p events
+     * when the subscription coalesces events.
+     */
+    unsigned long calls;
+
+    /** Cumulated time spent in the observer, in microseconds. */
+    unsigned long long total_us;
+
+    /** Duration of the slowest call, in microseconds. */
+    unsigned long long max_us;
+
+    /** Duration of the last call, in microseconds. */
+    unsigned long long last_us;
+
+    ObserverStats() : events(0), calls(0), total_us(0), max_us(0), last_us(0) {}
+};
+
+/**
+ * Delivers events to their observers.
+ *
+ * Events are posted by the connector thread (see Ontology::evtCallback) into
+ * one of several bounded queues, and consumed by one worker thread per queue.
+ * The queue is chosen from the event id: events sharing an id always go
+ * through the same queue and are thus delivered in the order they were
+ * received, while events with different ids may be delivered concurrently.
+ *
+ * The registry of observers is itself thread-safe: events can be registered
+ * or removed from any thread while events are being dispatched.
+ */
+class EventDispatcher {
+
+public:
+
+    /**
+     * Creates a new dispatcher and starts its workers.
+     *
+     * \param workers the number of worker threads (and queues). At least one.
+     * \param capacity the maximum number of pending events per queue.
+     * \param policy what to do when a queue is full.
+     */
+    EventDispatcher(size_t workers = 1,
+                    size_t capacity = 1024,
+                    OverflowPolicy policy = DROP_OLDEST);
+
+    /**
+     * Stops the workers once all pending events have been delivered.
+     *
+     * It joins the workers: it must not run from an observer.
+     */
+    ~EventDispatcher();
+
+    /**
+     * Changes the size of the worker pool, the capacity of the queues and the
+     * overflow policy. Pending events are delivered by the current workers
+     * before the new ones are started.
+     *
+     * \throw OntologyException if called from an observer: the workers
+     * could not be joined.
+     */
+    void configure(size_t workers, size_t capacity, OverflowPolicy policy);
+
+    /**
+     * Attaches an observer to an event id. If \p oneShot is true, the
+     * observer is removed after its first call.
+     *
+     * \param coalescing optionally merges bursts of events before calling
+     * the observer. Cf EventCoalescing.
+     * \return false if the event id was already known (the previous observer
+     * is then kept).
+     */
+    bool subscribe(const std::string& event_id,
+                   OroEventObserver* observer,
+                   bool oneShot,
+                   const EventCoalescing& coalescing = EventCoalescing());
+
+    /**
+     * Detaches the observer of an event id.
+     *
+     * Once it returns, the observer is not called anymore, and is not being
+     * called either (unless by the calling thread itself, ie when an
+     * observer unsubscribes itself): it can be deleted. Events of this id
+     * still queued, or being coalesced, are discarded.
+     *
+     * \return false if the event id was unknown.
+     */
+    bool unsubscribe(const std::string& event_id);
+
+    /**
+     * Queues a raw event for delivery. Returns immediately, unless the
+     * queue is full and the overflow policy is BLOCK.
+     *
+     * \return false if the event has been dropped.
+     */
+    bool post(const std::string& event_id,
+              const server_return_types& raw_event_content);
+
+    /**
+     * Returns the timing statistics of the current observers, indexed by
+     * event id.
+     */
+    std::map<std::string, ObserverStats> observerStats() const;
+
+    /**
+     * Returns the statistics of all the observers removed so far
+     * (unsubscribed, or one-shot observers that have been called), merged
+     * together: they are not kept per event id, so that registering many
+     * events over time does not grow the statistics.
+     */
+    ObserverStats retiredObserverStats() const;
+
+    /**
+     * Returns the number of events dropped because a queue was full.
+     */
+    unsigned long droppedEvents() const;
+
+    /**
+     * Observers taking longer than \p ms milliseconds are reported as
+     * warnings in the log (cf oro_log.h). 0 (the default) disables the
+     * reports.
+     */
+    void setSlowObserverThreshold(unsigned int ms);
+
+    /**
+     * Converts the raw content of an event (as received from the server)
+     * into the content of an OroEvent.
+     *
+     * \return false if the raw content is neither a set of strings nor an
+     * empty string.
+     */
+    static bool toEventContent(const server_return_types& raw_event_content,
+                               event_content_types& content);
+
+private:
+
+    struct PendingEvent {
+        std::string event_id;
+        server_return_types raw_content;
+    };
+
+    struct Subscription {
+        OroEventObserver* observer;
+        bool oneShot;
+        EventCoalescing coalescing;
+
+        // Tells a subscription from a later one with the same event id.
+        unsigned long serial;
+    };
+
+    // Events being coalesced for one event id.
+    struct Burst {
+        std::set<std::string> content;
+        unsigned long nbEvents;
+        boost::posix_time::ptime deadline;
+        Subscription subscription;
+    };
+
+    struct Shard {
+        boost::mutex lock;
+        boost::condition_variable notEmpty;
+        boost::condition_variable notFull;
+        std::deque<PendingEvent> queue;
+        bool stopping;
+        boost::thread worker;
+
+        // Only accessed by the worker of the shard.
+        std::map<std::string, Burst> bursts;
+
+        Shard() : stopping(false) {}
+    };
+
+    void start();
+    void stop();
+    void run(Shard* shard);
+    void dispatch(Shard* shard, const PendingEvent& evt);
+    void flushBursts(Shard* shard, bool all);
+    void deliver(const std::string& event_id,
+                 const Subscription& subscription,
+                 const event_content_types& content,
+                 unsigned long nbEvents);
+    void endDelivery(const std::string& event_id);
+
+    // Merges the stats of an event id into _retired. _statsLock must be held.
+    void retireStats(const std::string& event_id);
+
+    // Whether the calling thread is one of the workers of this dispatcher.
+    bool onWorker() const;
+
+    size_t _capacity;
+    OverflowPolicy _policy;
+    size_t _nbWorkers;
+
+    // Held shared while posting, exclusively while (re)configuring.
+    boost::shared_mutex _shardsLock;
+    std::vector<boost::shared_ptr<Shard> > _shards;
+
+    mutable boost::shared_mutex _registryLock;
+    std::map<std::string, Subscription> _observers;
+    unsigned long _nextSerial;
+
+    // The event ids whose observer is being called, and by which worker.
+    // unsubscribe() waits for them.
+    boost::mutex _deliveryLock;
+    boost::condition_variable _deliveryDone;
+    std::map<std::string, boost::thread::id> _delivering;
+
+    mutable boost::mutex _statsLock;
+    std::map<std::string, ObserverStats> _stats;
+    ObserverStats _retired;
+    unsigned long _dropped;
+    unsigned int _slowThreshold_ms;
+};
+
+}
+
+#endif /* EVENT_DISPATCHER_H_ */
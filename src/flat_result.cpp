@@ -0,0 +1,227 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <algorithm>
+#include <stdexcept>
+#include <cassert>
+
+#include "oro_exceptions.h"
+#include "flat_result.h"
+
+using namespace std;
+using namespace boost;
+
+namespace oro {
+
+uint32_t FlatArena::append(const char* data, size_t length) {
+    if (_buffer.size() + length > 0xFFFFFFFFu)
+        throw OntologyException("Result too large: flat containers are limited to 4GB.");
+
+    uint32_t offset = _buffer.size();
+    _buffer.append(data, length);
+    return offset;
+}
+
+/* FlatStringSet */
+
+struct FlatStringSet::EntryLess {
+    const FlatArena& arena;
+
+    EntryLess(const FlatArena& arena) : arena(arena) {}
+
+    bool operator()(const Entry& a, const Entry& b) const {
+        return arena.view(a.offset, a.length) < arena.view(b.offset, b.length);
+    }
+    bool operator()(const Entry& a, string_view b) const {
+        return arena.view(a.offset, a.length) < b;
+    }
+};
+
+FlatStringSet::FlatStringSet(const set<string>& set) : _sorted(true) {
+    size_t bytes = 0;
+    for (std::set<string>::const_iterator it = set.begin() ; it != set.end() ; ++it)
+        bytes += it->length();
+
+    reserve(set.size(), bytes);
+
+    // std::set is already sorted and without duplicates.
+    for (std::set<string>::const_iterator it = set.begin() ; it != set.end() ; ++it) {
+        Entry entry;
+        entry.length = it->length();
+        entry.offset = _arena.append(it->data(), it->length());
+        _entries.push_back(entry);
+    }
+}
+
+void FlatStringSet::insert(const char* data, size_t length) {
+    Entry entry;
+    entry.length = length;
+    entry.offset = _arena.append(data, length);
+    _entries.push_back(entry);
+    _sorted = false;
+}
+
+void FlatStringSet::sort() {
+    if (_sorted) return;
+
+    EntryLess less(_arena);
+    std::sort(_entries.begin(), _entries.end(), less);
+
+    // Duplicates are adjacent once sorted. Their characters stay in the
+    // arena: shrinking it would mean moving all the other ones.
+    vector<Entry>::iterator last = _entries.begin();
+    for (vector<Entry>::iterator it = _entries.begin() ; it != _entries.end() ; ++it) {
+        if (it == _entries.begin() || less(*(last - 1), *it)) *last++ = *it;
+    }
+    _entries.erase(last, _entries.end());
+
+    _sorted = true;
+}
+
+FlatStringSet::const_iterator FlatStringSet::find(string_view str) const {
+    assert(_sorted);
+
+    vector<Entry>::const_iterator it = lower_bound(_entries.begin(), _entries.end(), str, EntryLess(_arena));
+
+    if (it == _entries.end() || _arena.view(it->offset, it->length) != str) return end();
+    return const_iterator(this, it - _entries.begin());
+}
+
+void FlatStringSet::clear() {
+    _arena.clear();
+    _entries.clear();
+    _sorted = true;
+}
+
+void FlatStringSet::swap(FlatStringSet& other) {
+    _arena.swap(other._arena);
+    _entries.swap(other._entries);
+    std::swap(_sorted, other._sorted);
+}
+
+void FlatStringSet::shrink_to_fit() {
+    _arena.shrink_to_fit();
+    _entries.shrink_to_fit();
+}
+
+set<string> FlatStringSet::toSet() const {
+    set<string> result;
+    for (const_iterator it = begin() ; it != end() ; ++it)
+        result.insert(result.end(), it->to_string());
+    return result;
+}
+
+/* FlatStringMap */
+
+struct FlatStringMap::EntryLess {
+    const FlatArena& arena;
+
+    EntryLess(const FlatArena& arena) : arena(arena) {}
+
+    bool operator()(const Entry& a, const Entry& b) const {
+        return arena.view(a.keyOffset, a.keyLength) < arena.view(b.keyOffset, b.keyLength);
+    }
+    bool operator()(const Entry& a, string_view b) const {
+        return arena.view(a.keyOffset, a.keyLength) < b;
+    }
+};
+
+FlatStringMap::FlatStringMap(const map<string, string>& map) : _sorted(true) {
+    size_t bytes = 0;
+    for (std::map<string, string>::const_iterator it = map.begin() ; it != map.end() ; ++it)
+        bytes += it->first.length() + it->second.length();
+
+    reserve(map.size(), bytes);
+
+    for (std::map<string, string>::const_iterator it = map.begin() ; it != map.end() ; ++it) {
+        Entry entry;
+        entry.keyLength = it->first.length();
+        entry.keyOffset = _arena.append(it->first.data(), it->first.length());
+        entry.valueLength = it->second.length();
+        entry.valueOffset = _arena.append(it->second.data(), it->second.length());
+        _entries.push_back(entry);
+    }
+}
+
+void FlatStringMap::insert(string_view key, string_view value) {
+    Entry entry;
+    entry.keyLength = key.size();
+    entry.keyOffset = _arena.append(key.data(), key.size());
+    entry.valueLength = value.size();
+    entry.valueOffset = _arena.append(value.data(), value.size());
+    _entries.push_back(entry);
+    _sorted = false;
+}
+
+void FlatStringMap::sort() {
+    if (_sorted) return;
+
+    EntryLess less(_arena);
+    // Stable, so that the last value of a duplicated key is the last of
+    // its run.
+    std::stable_sort(_entries.begin(), _entries.end(), less);
+
+    vector<Entry>::iterator last = _entries.begin();
+    for (vector<Entry>::iterator it = _entries.begin() ; it != _entries.end() ; ++it) {
+        if (it != _entries.begin() && !less(*(last - 1), *it)) *(last - 1) = *it;
+        else *last++ = *it;
+    }
+    _entries.erase(last, _entries.end());
+
+    _sorted = true;
+}
+
+FlatStringMap::const_iterator FlatStringMap::find(string_view key) const {
+    assert(_sorted);
+
+    vector<Entry>::const_iterator it = lower_bound(_entries.begin(), _entries.end(), key, EntryLess(_arena));
+
+    if (it == _entries.end() || _arena.view(it->keyOffset, it->keyLength) != key) return end();
+    return const_iterator(this, it - _entries.begin());
+}
+
+string_view FlatStringMap::at(string_view key) const {
+    const_iterator it = find(key);
+    if (it == end()) throw out_of_range("FlatStringMap::at: no key " + key.to_string());
+    return it->second;
+}
+
+void FlatStringMap::clear() {
+    _arena.clear();
+    _entries.clear();
+    _sorted = true;
+}
+
+void FlatStringMap::swap(FlatStringMap& other) {
+    _arena.swap(other._arena);
+    _entries.swap(other._entries);
+    std::swap(_sorted, other._sorted);
+}
+
+void FlatStringMap::shrink_to_fit() {
+    _arena.shrink_to_fit();
+    _entries.shrink_to_fit();
+}
+
+map<string, string> FlatStringMap::toMap() const {
+    map<string, string> result;
+    for (const_iterator it = begin() ; it != end() ; ++it)
+        result.insert(result.end(), make_pair(it->first.to_string(), it->second.to_string()));
+    return result;
+}
+
+}
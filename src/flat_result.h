@@ -0,0 +1,309 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/** \file
+ * This header defines FlatStringSet and FlatStringMap, compact alternatives
+ * to the std::set and std::map of strings returned by the server.
+ */
+
+#ifndef FLAT_RESULT_H_
+#define FLAT_RESULT_H_
+
+#include <set>
+#include <map>
+#include <vector>
+#include <string>
+#include <utility>
+
+#include <boost/cstdint.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/utility/string_view.hpp>
+
+namespace oro {
+
+/**
+ * The storage shared by FlatStringSet and FlatStringMap: the characters of
+ * all the strings, back-to-back in one buffer.
+ */
+class FlatArena {
+public:
+
+    /**
+     * Copies a string at the end of the arena and returns its position.
+     *
+     * \throw OntologyException if the arena would exceed 4GB.
+     */
+    boost::uint32_t append(const char* data, size_t length);
+
+    boost::string_view view(boost::uint32_t offset, boost::uint32_t length) const {
+        return boost::string_view(_buffer.data() + offset, length);
+    }
+
+    size_t bytes() const {return _buffer.size();}
+
+    void reserve(size_t bytes) {_buffer.reserve(bytes);}
+    void clear() {_buffer.clear();}
+    void shrink_to_fit() {_buffer.shrink_to_fit();}
+    void swap(FlatArena& other) {_buffer.swap(other._buffer);}
+
+private:
+    std::string _buffer;
+};
+
+/**
+ * A sorted set of strings, stored in a single buffer.
+ *
+ * Where a std::set<std::string> allocates a node (and often a string) per
+ * element, a FlatStringSet holds one buffer for the characters and one
+ * vector of (offset, length) pairs. Elements are returned as string views
+ * into the buffer: they remain valid as long as the set is neither
+ * modified nor destroyed.
+ *
+ * The set is filled with insert(), in any order, then sort() must be called
+ * before any lookup: it orders the elements and removes the duplicates.
+ * Iteration follows the insertion order until then.
+ *
+ * Use toSet() where a std::set<std::string> is expected.
+ */
+class FlatStringSet {
+
+    struct Entry {
+        boost::uint32_t offset;
+        boost::uint32_t length;
+    };
+
+    struct EntryLess;
+
+public:
+
+    class const_iterator : public boost::iterator_facade<const_iterator,
+                                                         boost::string_view,
+                                                         boost::random_access_traversal_tag,
+                                                         boost::string_view> {
+    public:
+        const_iterator() : _set(NULL), _index(0) {}
+
+    private:
+        friend class FlatStringSet;
+        friend class boost::iterator_core_access;
+
+        const_iterator(const FlatStringSet* set, size_t index) : _set(set), _index(index) {}
+
+        boost::string_view dereference() const {return (*_set)[_index];}
+        bool equal(const const_iterator& other) const {return _index == other._index;}
+        void increment() {++_index;}
+        void decrement() {--_index;}
+        void advance(std::ptrdiff_t n) {_index += n;}
+        std::ptrdiff_t distance_to(const const_iterator& other) const {return other._index - _index;}
+
+        const FlatStringSet* _set;
+        size_t _index;
+    };
+
+    typedef const_iterator iterator;
+    typedef boost::string_view value_type;
+
+    FlatStringSet() : _sorted(true) {}
+
+    /**
+     * Copies (and sorts) the elements of a std::set.
+     */
+    explicit FlatStringSet(const std::set<std::string>& set);
+
+    /**
+     * Pre-allocates room for \p elements elements, totalling \p bytes
+     * characters.
+     */
+    void reserve(size_t elements, size_t bytes) {
+        _entries.reserve(elements);
+        _arena.reserve(bytes);
+    }
+
+    /**
+     * Appends an element. The set is not sorted anymore: call sort() once
+     * all the elements are inserted.
+     */
+    void insert(const char* data, size_t length);
+    void insert(boost::string_view str) {insert(str.data(), str.size());}
+
+    /**
+     * Sorts the elements and removes the duplicates.
+     */
+    void sort();
+
+    bool sorted() const {return _sorted;}
+
+    size_t size() const {return _entries.size();}
+    bool empty() const {return _entries.empty();}
+
+    /**
+     * Returns the number of characters of the elements, ie, the size of the
+     * buffer.
+     */
+    size_t bytes() const {return _arena.bytes();}
+
+    boost::string_view operator[](size_t index) const {
+        return _arena.view(_entries[index].offset, _entries[index].length);
+    }
+
+    const_iterator begin() const {return const_iterator(this, 0);}
+    const_iterator end() const {return const_iterator(this, _entries.size());}
+
+    /**
+     * Returns the position of \p str , or end(). The set must be sorted.
+     */
+    const_iterator find(boost::string_view str) const;
+
+    bool contains(boost::string_view str) const {return find(str) != end();}
+    size_t count(boost::string_view str) const {return contains(str) ? 1 : 0;}
+
+    void clear();
+    void swap(FlatStringSet& other);
+
+    /**
+     * Releases the memory reserved beyond the current content.
+     */
+    void shrink_to_fit();
+
+    /**
+     * Returns a copy of the elements as a std::set.
+     */
+    std::set<std::string> toSet() const;
+
+private:
+    FlatArena _arena;
+    std::vector<Entry> _entries;
+    bool _sorted;
+};
+
+/**
+ * A sorted map from strings to strings, stored in a single buffer. Like
+ * FlatStringSet, but each element is a (key, value) pair of string views.
+ *
+ * The map is filled with insert(), then sort() must be called before any
+ * lookup. Like with std::map::operator[], a key inserted several times
+ * keeps its last value.
+ *
+ * Use toMap() where a std::map<std::string, std::string> is expected.
+ */
+class FlatStringMap {
+
+    struct Entry {
+        boost::uint32_t keyOffset;
+        boost::uint32_t keyLength;
+        boost::uint32_t valueOffset;
+        boost::uint32_t valueLength;
+    };
+
+    struct EntryLess;
+
+public:
+
+    typedef std::pair<boost::string_view, boost::string_view> value_type;
+
+    class const_iterator : public boost::iterator_facade<const_iterator,
+                                                         value_type,
+                                                         boost::random_access_traversal_tag,
+                                                         value_type> {
+    public:
+        const_iterator() : _map(NULL), _index(0) {}
+
+    private:
+        friend class FlatStringMap;
+        friend class boost::iterator_core_access;
+
+        const_iterator(const FlatStringMap* map, size_t index) : _map(map), _index(index) {}
+
+        value_type dereference() const {return (*_map)[_index];}
+        bool equal(const const_iterator& other) const {return _index == other._index;}
+        void increment() {++_index;}
+        void decrement() {--_index;}
+        void advance(std::ptrdiff_t n) {_index += n;}
+        std::ptrdiff_t distance_to(const const_iterator& other) const {return other._index - _index;}
+
+        const FlatStringMap* _map;
+        size_t _index;
+    };
+
+    typedef const_iterator iterator;
+
+    FlatStringMap() : _sorted(true) {}
+
+    /**
+     * Copies (and sorts) the elements of a std::map.
+     */
+    explicit FlatStringMap(const std::map<std::string, std::string>& map);
+
+    void reserve(size_t elements, size_t bytes) {
+        _entries.reserve(elements);
+        _arena.reserve(bytes);
+    }
+
+    void insert(boost::string_view key, boost::string_view value);
+
+    /**
+     * Sorts the elements by key and removes the duplicated keys.
+     */
+    void sort();
+
+    bool sorted() const {return _sorted;}
+
+    size_t size() const {return _entries.size();}
+    bool empty() const {return _entries.empty();}
+    size_t bytes() const {return _arena.bytes();}
+
+    value_type operator[](size_t index) const {
+        const Entry& entry = _entries[index];
+        return value_type(_arena.view(entry.keyOffset, entry.keyLength),
+                          _arena.view(entry.valueOffset, entry.valueLength));
+    }
+
+    const_iterator begin() const {return const_iterator(this, 0);}
+    const_iterator end() const {return const_iterator(this, _entries.size());}
+
+    /**
+     * Returns the position of \p key , or end(). The map must be sorted.
+     */
+    const_iterator find(boost::string_view key) const;
+
+    size_t count(boost::string_view key) const {return find(key) != end() ? 1 : 0;}
+
+    /**
+     * Returns the value of \p key .
+     *
+     * \throw std::out_of_range if there is no such key.
+     */
+    boost::string_view at(boost::string_view key) const;
+
+    void clear();
+    void swap(FlatStringMap& other);
+    void shrink_to_fit();
+
+    /**
+     * Returns a copy of the elements as a std::map.
+     */
+    std::map<std::string, std::string> toMap() const;
+
+private:
+    FlatArena _arena;
+    std::vector<Entry> _entries;
+    bool _sorted;
+};
+
+}
+
+#endif /* FLAT_RESULT_H_ */
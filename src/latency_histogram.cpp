@@ -0,0 +1,92 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include "latency_histogram.h"
+
+using namespace std;
+
+namespace oro {
+
+LatencyHistogram::LatencyHistogram() : _counts(NB_BUCKETS, 0) {
+    reset();
+}
+
+size_t LatencyHistogram::index(boost::uint64_t value) {
+    if (value < EXACT) return value;
+
+    // Position of the most significant bit: value is in [2^msb, 2^(msb+1)[,
+    // a range split in SUB_BUCKETS buckets.
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - EXACT_BITS + 1;
+
+    return shift * SUB_BUCKETS + (value >> shift);
+}
+
+boost::uint64_t LatencyHistogram::lowest(size_t index) {
+    if (index < EXACT) return index;
+
+    int shift = index / SUB_BUCKETS - 1;
+    return (boost::uint64_t) (index % SUB_BUCKETS + SUB_BUCKETS) << shift;
+}
+
+void LatencyHistogram::record(boost::uint64_t value) {
+    _counts[index(value)]++;
+    _count++;
+    _sum += value;
+    if (value < _min) _min = value;
+    if (value > _max) _max = value;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0 ; i < NB_BUCKETS ; ++i) _counts[i] += other._counts[i];
+
+    _count += other._count;
+    _sum += other._sum;
+    _min = std::min(_min, other._min);
+    _max = std::max(_max, other._max);
+}
+
+void LatencyHistogram::reset() {
+    fill(_counts.begin(), _counts.end(), 0);
+    _count = 0;
+    _sum = 0;
+    _min = ~(boost::uint64_t) 0;
+    _max = 0;
+}
+
+boost::uint64_t LatencyHistogram::percentile(double percent) const {
+    if (_count == 0) return 0;
+
+    boost::uint64_t rank = (boost::uint64_t) ceil(percent / 100.0 * _count);
+    rank = std::max<boost::uint64_t>(1, std::min(rank, _count));
+
+    boost::uint64_t seen = 0;
+    for (size_t i = 0 ; i < NB_BUCKETS ; ++i) {
+        seen += _counts[i];
+
+        // The highest value of the bucket, within the recorded range.
+        if (seen >= rank)
+            return std::max(_min, std::min(_max, lowest(i + 1) - 1));
+    }
+
+    return _max;
+}
+
+}
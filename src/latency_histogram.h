@@ -0,0 +1,90 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/** \file
+ * This header defines LatencyHistogram, used to record distributions of
+ * latencies (in the benchmark tools, for instance).
+ */
+
+#ifndef LATENCY_HISTOGRAM_H_
+#define LATENCY_HISTOGRAM_H_
+
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+namespace oro {
+
+/**
+ * A histogram of positive integer values (typically, latencies in
+ * nanoseconds) with a bounded relative error.
+ *
+ * Values below 128 are counted exactly. Above, each power of two is split in
+ * 64 buckets: percentiles are exact to within 1/64 (1.6%), whatever the
+ * range of values, for a fixed memory footprint (about 30KB).
+ *
+ * Recording a value is a constant-time operation that does not allocate.
+ * A histogram is not thread-safe: record into one histogram per thread, and
+ * merge() them.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(boost::uint64_t value);
+
+    /**
+     * Adds the values recorded in \p other to this histogram.
+     */
+    void merge(const LatencyHistogram& other);
+
+    void reset();
+
+    boost::uint64_t count() const {return _count;}
+
+    /** Returns the smallest recorded value, 0 if the histogram is empty. */
+    boost::uint64_t min() const {return _count ? _min : 0;}
+
+    boost::uint64_t max() const {return _max;}
+
+    double mean() const {return _count ? _sum / _count : 0.0;}
+
+    /**
+     * Returns the value below which \p percent % of the recorded values
+     * fall (eg, percentile(99.9)), 0 if the histogram is empty.
+     */
+    boost::uint64_t percentile(double percent) const;
+
+private:
+    enum {EXACT_BITS = 7,
+          EXACT = 1 << EXACT_BITS,    // values counted exactly
+          SUB_BUCKETS = EXACT / 2,    // buckets per power of two above
+          NB_BUCKETS = (64 - EXACT_BITS + 1) * SUB_BUCKETS + EXACT};
+
+    static size_t index(boost::uint64_t value);
+    static boost::uint64_t lowest(size_t index);
+
+    std::vector<boost::uint64_t> _counts;
+    boost::uint64_t _count;
+    boost::uint64_t _min;
+    boost::uint64_t _max;
+    double _sum;
+};
+
+}
+
+#endif /* LATENCY_HISTOGRAM_H_ */
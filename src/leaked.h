@@ -0,0 +1,80 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/** \file
+ * This header defines leaked() and leaked_tls, the process-wide and
+ * per-thread objects of the library that are never destroyed.
+ *
+ * The library is used by threads that may outlive main() (the event
+ * dispatcher, the logger, the threads of the application...): they may
+ * still record metrics, log or send requests during the static
+ * destruction. The objects they rely on are thus leaked on purpose, instead
+ * of being destroyed in an unspecified order at exit.
+ */
+
+#ifndef LEAKED_H_
+#define LEAKED_H_
+
+#include <boost/thread/tss.hpp>
+
+namespace oro {
+
+/**
+ * Returns the instance of \p T shared by the process. It is constructed on
+ * first use (thread-safely), and never destroyed.
+ */
+template<typename T>
+T& leaked() {
+    static T* instance = new T();
+    return *instance;
+}
+
+/**
+ * A boost::thread_specific_ptr that is never destroyed, to be declared as a
+ * function-local static:
+ *
+ * \code
+ * static leaked_tls<Shard> shards(retire);
+ * \endcode
+ *
+ * The object of each thread is still cleaned up when the thread exits, by
+ * \p cleanup (or deleted, by default).
+ */
+template<typename T>
+class leaked_tls {
+public:
+
+    leaked_tls() : _ptr(new boost::thread_specific_ptr<T>()) {}
+
+    explicit leaked_tls(void (*cleanup)(T*)) : _ptr(new boost::thread_specific_ptr<T>(cleanup)) {}
+
+    T* get() const {return _ptr->get();}
+
+    void reset(T* value) {_ptr->reset(value);}
+
+private:
+
+    leaked_tls(const leaked_tls&);
+    leaked_tls& operator=(const leaked_tls&);
+
+    // Not deleted: no destructor, hence nothing to run at exit.
+    boost::thread_specific_ptr<T>* _ptr;
+};
+
+}
+
+#endif /* LEAKED_H_ */
@@ -20,12 +20,12 @@
 #include "oro.h"
 #include "oro_event.h"
 #include "oro_exceptions.h"
-
-#ifdef DEBUG
-#define TRACE(arg) (std::cerr << "[LIBORO DEBUG] " << arg << std::endl)
-#else
-#define TRACE(arg) sizeof(std::cerr << arg << std::endl)
-#endif
+#include "oro_log.h"
+#include "prepared_query.h"
+#include "batch.h"
+#include "flat_result.h"
+#include "response_view.h"
+#include "tracer.h"
 
 
 using namespace std;
@@ -33,26 +33,30 @@ using namespace boost;
 
 namespace oro {
 
-Ontology* Ontology::_instance = NULL;
-
-map<string, Ontology::EventObserver> Ontology::_eventObservers;
+boost::atomic<Ontology*> Ontology::_instance(NULL);
+boost::mutex Ontology::_instanceLock;
 
 // Protected constructor
-Ontology::Ontology(IConnector& connector) : _connector(connector) {
+Ontology::Ontology(IConnector& connector) :
+    _connector(connector),
+    _batchId(1),
+    _sentBatches(1),
+    _sending(false),
+    _batchUnwaited(false),
+    _unreportedBatch(0),
+    _autoBatch(false),
+    _maxBatchSize(0),
+    _stopFlusher(false)
+{
 
-    cerr << "liboro v." << ORO_VERSION;
     //Initializes the random generator for later generation of unique id for concepts.
     srand(time(NULL));
 
-    _bufferize = false;
-
     //By default, always wait for acks.
     _waitForAck = true;
 
-    _buf_op_counter = 0;
-
     if (!checkOntologyServer()) {
-        cerr << "\nCannot reach the ontology server! Check it is started and that the middleware link is up.\n";
+        ORO_LOG_ERROR("Cannot reach the ontology server! Check it is started and that the middleware link is up.");
         throw OntologyServerException("Cannot reach the ontology server. Abandon.");
     }
 
@@ -62,23 +66,39 @@ Ontology::Ontology(IConnector& connector) : _connector(connector) {
 }
 
 //Singleton creation
+Ontology::~Ontology(){
+
+    //Sends the auto-batched statements still pending, and stops the flusher.
+    disableAutoBatch();
+
+    boost::lock_guard<boost::mutex> lock(_instanceLock);
+    if (_instance == this) _instance = NULL;
+}
+
 Ontology* Ontology::createWithConnector(IConnector& connector){
 
+    boost::lock_guard<boost::mutex> lock(_instanceLock);
+
     if (_instance == NULL)
         _instance = new Ontology(connector);
 
-    cerr << " - ontology initialized." << endl;
-
     return _instance;
 }
 
 //Singleton access
 Ontology* Ontology::getInstance(){
-    if (_instance != NULL)
-        return _instance;
+    Ontology* instance = _instance;
+    if (instance != NULL)
+        return instance;
     else throw UninitializedOntologyException("the ontology is not properly initialized. Created with Ontology::createWithConnector(IConnector&) before any access attempt.");
 }
 
+ResponseView Ontology::executeChecked(const string& method, const vector<server_param_types>& args, const string& errorPrefix){
+    ResponseView res(_connector.executeUndecoded(method, args));
+    res.check(errorPrefix);
+    return res;
+}
+
 bool Ontology::checkOntologyServer(){
 
     ServerResponse res = _connector.execute("stats");
@@ -87,9 +107,9 @@ bool Ontology::checkOntologyServer(){
 
     try {
         string version = (get<map<string, string> >(res.result))["version"];
-        cerr << " - oro-server v." << version;
+        ORO_LOG_INFO("liboro v.{} - oro-server v.{} - ontology initialized.", ORO_VERSION, version);
     } catch (bad_get e) {
-        cerr << "Internal error: oro-server answered malformed results at initialization!";
+        ORO_LOG_ERROR("Internal error: oro-server answered malformed results at initialization!");
         return false;
     }
 
@@ -98,138 +118,275 @@ bool Ontology::checkOntologyServer(){
 
 void Ontology::evtCallback(const std::string& event_id, const server_return_types& raw_event_content){
 
-    set<Concept> event_content;
+    Ontology* instance = _instance;
+    if (instance == NULL) return;
 
-    try {
-        set<string> raw_content = get<set<string> >(raw_event_content);
+    instance->_dispatcher.post(event_id, raw_event_content);
+}
 
-        copy(	raw_content.begin(),
-             raw_content.end(),
-             inserter(event_content, event_content.begin()));
+Ontology::WriteBuffer* Ontology::activeBuffer(){
+    WriteBuffer* buffer = _localBuffer.get();
+    if (buffer == NULL || buffer->depth == 0) return NULL;
+    return buffer;
+}
 
-    } catch (bad_get e) {
+void Ontology::bufferize(){
+    if (_localBuffer.get() == NULL) _localBuffer.reset(new WriteBuffer());
+    _localBuffer->depth++;
+}
+
+void Ontology::flush(){
+    TraceSpan span("ontology", "Ontology::flush");
+
+    WriteBuffer* local = activeBuffer();
+    if (local == NULL) return;
+
+    if (--local->depth > 0) return; //more that one on-going bufferization operation? decrement the counter and return.
+
+    boost::unique_lock<boost::mutex> lock(_batchLock);
+
+    //Merge the statements of this thread into the shared batch. The
+    //cancellation rules of addToBuffer apply across threads as well.
+    if (_batch.empty())
+        _batchDeadline = boost::posix_time::microsec_clock::universal_time() + _maxBatchDelay;
+    _batch.merge(local->statements);
+
+    //Nothing left to send: our statements cancelled pending ones.
+    if (_batch.empty()) return;
+
+    sendBatches(_batchId, lock);
+}
 
+void Ontology::sendBatches(unsigned long batch, boost::unique_lock<boost::mutex>& lock){
+
+    _batchStatus[batch].waiters++;
+
+    while (_sentBatches <= batch) {
+
+        //Another thread is sending: it will send our statements with the
+        //next batch, or it will let us send them.
+        if (_sending) {
+            _batchSent.wait(lock);
+            continue;
+        }
+
+        _sending = true;
+
+        StatementBuffer toSend;
+        toSend.swap(_batch);
+        unsigned long id = _batchId++;
+        bool unwaited = _batchUnwaited;
+        _batchUnwaited = false;
+
+        lock.unlock();
+
+        //the order we send add and remove doesn't matter since the buffer
+        //never holds both an "add" and a "remove" of the same statement.
+        static const char* queries[] = {"add", "remove", "update"};
+        vector<string> stmts[3];
+        toSend.drain(stmts[0], stmts[1], stmts[2]);
+
+        if (ClientMetrics::enabled())
+            ClientMetrics::recordBatch(stmts[0].size() + stmts[1].size() + stmts[2].size());
+
+        bool failed = false;
+        string failure;
         try {
+            for (int i = 0 ; i < 3 ; ++i) {
+                if (stmts[i].empty()) continue;
+
+                vector<server_param_types> args;
+                args.push_back(server_param_types(std::move(stmts[i])));
 
-            string raw_content = get<string>(raw_event_content);
-            if (raw_content != "") {
-                cerr << "A set of string or an empty string is expected in the event content! I discard this event"
-                     << endl;
-                return;
+                // Only the status matters: the result is not decoded.
+                ServerResponse res = _connector.executeUndecoded(queries[i], args, _waitForAck);
+
+                if (res.status == ServerResponse::failed)
+                    throw OntologyServerException("Server threw a " + res.exception_msg + " while flushing buffered statements (" + queries[i] + "). Server message was " + res.error_msg);
             }
+        }
+        catch (std::runtime_error& e) {
+            failed = true;
+            failure = e.what();
+        }
 
-        } catch (bad_get e) {
-            cerr << "A set of string or an empty string is expected in the event content! I discard this event"
-                 << endl;
-            return;
+        lock.lock();
+
+        _sending = false;
+        _sentBatches = id + 1;
+        if (failed) {
+            map<unsigned long, BatchStatus>::iterator status = _batchStatus.find(id);
+            if (status != _batchStatus.end()) {
+                status->second.failed = true;
+                status->second.failure = failure;
+            }
+
+            //The writers of auto-batched statements learn it on sync().
+            if (unwaited && _unreportedBatch == 0) {
+                _unreportedBatch = id;
+                _unreportedFailure = failure;
+            }
         }
+        _batchSent.notify_all();
     }
 
-    //Create a new event object
-    OroEvent e(event_id, event_content);
+    //Every thread whose statements were part of a failed batch gets the error.
+    map<unsigned long, BatchStatus>::iterator status = _batchStatus.find(batch);
+    bool failed = status->second.failed;
+    string failure = status->second.failure;
 
-    //Call the liboro event subscriber callback;
-    std::map<std::string, EventObserver>::iterator it;
-    it = _eventObservers.find(event_id);
+    if (--status->second.waiters == 0) _batchStatus.erase(status);
 
-    if (it != _eventObservers.end()) {
-        EventObserver& eo = it->second;
-        (*eo.first)(e);
+    if (failed)
+        throw OntologyServerException("Flushing the buffered statements failed: " + failure);
+}
+
+void Ontology::enableAutoBatch(size_t max_statements, unsigned int max_delay_ms){
 
-        //If the event is a "one shot", remove it from the event list
-        if (eo.second)
-            _eventObservers.erase(event_id);
+    {
+        boost::lock_guard<boost::mutex> lock(_batchLock);
+
+        _maxBatchSize = std::max<size_t>(max_statements, 1);
+        _maxBatchDelay = boost::posix_time::milliseconds(max_delay_ms);
+
+        if (!_autoBatch) {
+            _stopFlusher = false;
+            _flusher = boost::thread(boost::bind(&Ontology::autoFlush, this));
+            _autoBatch = true;
+        }
     }
-    else cerr << "[EE] Got a callback on an event I don't know!" << endl;
 
+    //The thresholds may have changed: let the flusher reconsider its deadline.
+    _flushNeeded.notify_one();
 }
 
-void Ontology::bufferize(){
-    _bufferize = true;
-    _buf_op_counter++;
+void Ontology::disableAutoBatch(){
+
+    {
+        boost::lock_guard<boost::mutex> lock(_batchLock);
+
+        if (!_autoBatch) return;
+
+        //From now on, writes are sent directly.
+        _autoBatch = false;
+        _stopFlusher = true;
+    }
+
+    _flushNeeded.notify_one();
+
+    //The flusher sends what remains before leaving.
+    _flusher.join();
 }
 
-void Ontology::flush(){
-    if (!_bufferize) return;
+void Ontology::sync(){
+    TraceSpan span("ontology", "Ontology::sync");
 
-    if (!(_buf_op_counter--)) return; //more that one on-going bufferization operation? decrement the counter and return.
+    boost::unique_lock<boost::mutex> lock(_batchLock);
 
-    //cout << "End of bufferization" << endl;
-    _bufferize = false;
+    //The batch being filled is the last one to wait for, unless it is empty:
+    //then only the batch being sent, if any, matters.
+    unsigned long batch = _batch.empty() ? _batchId - 1 : _batchId;
 
+    string failure;
 
-    /**** ADD ****/
-    set<Statement> stmtToAdd;
-    //copy(_buffer["add"].begin(), _buffer["add"].end(), stmtToAdd.begin());
+    try {
+        if (batch >= _sentBatches)
+            sendBatches(batch, lock);
+    } catch (OntologyServerException& e) {
+        failure = e.what();
+    }
 
-    for(BufStatements::iterator i = _buffer["add"].begin() ; i != _buffer["add"].end() ; ++i) {
-        stmtToAdd.insert(i->second);
+    //An earlier failure of auto-batched statements comes first: nobody has
+    //been told about it yet.
+    if (_unreportedBatch != 0) {
+        failure = "Flushing the buffered statements failed: " + _unreportedFailure;
+        _unreportedBatch = 0;
+        _unreportedFailure.clear();
     }
 
-    if (stmtToAdd.size() > 0) add(stmtToAdd);
-    _buffer["add"].clear();
+    if (!failure.empty())
+        throw OntologyServerException(failure);
+}
+
+bool Ontology::addToBatch(StatementBuffer::Action action, const set<Statement>& statements){
 
-    /**** REMOVE ****/
-    set<Statement> stmtToRemove;
-    //copy(_buffer["remove"].begin(), _buffer["remove"].end(), stmtToRemove.begin());
-    for(BufStatements::iterator i = _buffer["remove"].begin() ; i != _buffer["remove"].end() ; ++i) {
-        stmtToRemove.insert(i->second);
-    }
+    bool wakeUpFlusher;
+
+    {
+        boost::lock_guard<boost::mutex> lock(_batchLock);
+
+        //Disabled since the caller checked: the flusher may be gone already.
+        if (!_autoBatch) return false;
 
-    if (stmtToRemove.size() > 0) remove(stmtToRemove); //the order we call add and remove doesn't matter if the buffer is carefully filled through Ontology::addToBuffer. Else, if the same statement is first removed and then added, the flush operation will only retain the "remove"!
+        bool wasEmpty = _batch.empty();
+        if (wasEmpty)
+            _batchDeadline = boost::posix_time::microsec_clock::universal_time() + _maxBatchDelay;
 
-    _buffer["remove"].clear();
+        for(set<Statement>::const_iterator i = statements.begin() ; i != statements.end() ; ++i)
+            addToBuffer(_batch, action, *i);
 
-    /**** UPDATE ****/
-    set<Statement> stmtToUpdate;
-    //copy(_buffer["update"].begin(), _buffer["update"].end(), stmtToUpdate.begin());
-    for(BufStatements::iterator i = _buffer["update"].begin() ; i != _buffer["update"].end() ; ++i) {
-        stmtToUpdate.insert(i->second);
+        _batchUnwaited = true;
+
+        wakeUpFlusher = wasEmpty || _batch.size() >= _maxBatchSize;
     }
 
-    if (stmtToUpdate.size() > 0) update(stmtToUpdate);
+    if (wakeUpFlusher) _flushNeeded.notify_one();
 
-    _buffer["update"].clear();
+    return true;
 }
 
-void Ontology::addToBuffer(const string action, const Statement& stmt) {
+void Ontology::autoFlush(){
 
-    // If the connector is disconnected, don't bufferize anything anymore
-    // and clear the buffer.
-    if (!_connector.isConnected()) {
-        cerr << "[WW] Server disconnected, discarding buffered facts" << endl;
+    boost::unique_lock<boost::mutex> lock(_batchLock);
 
-        _buffer["add"].clear();
-        _buffer["remove"].clear();
-        _buffer["update"].clear();
-        return;
-    }
+    while (true) {
 
-    //TODO replace vectors by sets or lists. It's stupid to use vectors.
-    if (action == "add") {
+        if (_batch.empty()) {
+            if (_stopFlusher) return;
+            _flushNeeded.wait(lock);
+            continue;
+        }
 
-        //here we remove all the previous requests to "remove" this very statement, since the "add" cancel them.
-        BufStatements::iterator i = _buffer["remove"].find(stmt.to_string());
+        if (!_stopFlusher &&
+            _batch.size() < _maxBatchSize &&
+            boost::posix_time::microsec_clock::universal_time() < _batchDeadline) {
+            _flushNeeded.timed_wait(lock, _batchDeadline);
+            continue;
+        }
 
-        if( i != _buffer["remove"].end()) {
-            _buffer["remove"].erase(i);
-        } else _buffer["add"].insert(pair<string, Statement>(stmt.to_string(), stmt));
+        try {
+            sendBatches(_batchId, lock);
+        } catch (OntologyServerException& e) {
+            //The writers of the batch did not wait for it: the failure is
+            //kept for the next sync() (cf sendBatches).
+            ORO_LOG_ERROR("Automatic flush of the buffered statements failed: {}", e.what());
+        }
     }
+}
 
-    else if (action == "remove") {
+void Ontology::addToBuffer(StatementBuffer& buffer, StatementBuffer::Action action, const Statement& stmt) {
 
-        //here we remove all the previous requests to "add" this very statement, since the "remove" cancel them.
-        BufStatements::iterator i = _buffer["add"].find(stmt.to_string());
+    // If the connector is disconnected, don't bufferize anything anymore
+    // and clear the buffer.
+    if (!_connector.isConnected()) {
+        ORO_LOG_WARNING("Server disconnected, discarding buffered facts");
 
-        if( i != _buffer["add"].end()) {
-            _buffer["add"].erase(i);
-        } else _buffer["remove"].insert(pair<string, Statement>(stmt.to_string(), stmt));
+        buffer.clear();
+        return;
     }
 
-    else if (action == "update") {
-        _buffer["update"].insert(pair<string, Statement>(stmt.to_string(), stmt));
+    if (!ClientMetrics::enabled()) {
+        buffer.insert(action, stmt.triple());
+        return;
     }
 
+    //An insertion that shrinks the buffer cancelled an opposite action,
+    //one that leaves it unchanged was already pending.
+    size_t before = buffer.size();
+    buffer.insert(action, stmt.triple());
+    size_t after = buffer.size();
+
+    ClientMetrics::recordBuffering(1, after < before ? 1 : 0, after == before ? 1 : 0);
 }
 
 void Ontology::add(const Statement& statement){
@@ -239,19 +396,24 @@ void Ontology::add(const Statement& statement){
 }
 
 void Ontology::add(const set<Statement>& statements){
+    TraceSpan span("ontology", "Ontology::add");
 
     set<string> stringified_stmts;
     set<Statement>::const_iterator iterator = statements.begin();
+    WriteBuffer* buffer = activeBuffer();
+
+    if (buffer == NULL && _autoBatch && addToBatch(StatementBuffer::ADD, statements))
+        return;
 
     while( iterator != statements.end() ) {
 
-        if (_bufferize) addToBuffer("add", *iterator);
+        if (buffer) addToBuffer(buffer->statements, StatementBuffer::ADD, *iterator);
         else stringified_stmts.insert(iterator->to_string());
         ++iterator;
     }
 
-    if (!_bufferize) {
-        ServerResponse res = _connector.execute("add", stringified_stmts, _waitForAck);
+    if (!buffer) {
+        ServerResponse res = _connector.executeUndecoded("add", vector<server_param_types>(1, stringified_stmts), _waitForAck);
 
         if (res.status == ServerResponse::failed) throw OntologyServerException("Server threw a " + res.exception_msg + " while adding statements. Server message was " + res.error_msg);
     }
@@ -264,17 +426,23 @@ void Ontology::remove(const Statement& statement){
 }
 
 void Ontology::remove(const set<Statement>& statements){
+    TraceSpan span("ontology", "Ontology::remove");
+
     set<string> stringified_stmts;
     set<Statement>::const_iterator iterator = statements.begin();
+    WriteBuffer* buffer = activeBuffer();
+
+    if (buffer == NULL && _autoBatch && addToBatch(StatementBuffer::REMOVE, statements))
+        return;
 
     while( iterator != statements.end() ) {
-        if (_bufferize) addToBuffer("remove", (Statement)*iterator);
-        stringified_stmts.insert(((Statement)*iterator).to_string());
+        if (buffer) addToBuffer(buffer->statements, StatementBuffer::REMOVE, *iterator);
+        else stringified_stmts.insert(iterator->to_string());
         ++iterator;
     }
 
-    if (!_bufferize) {
-        ServerResponse res = _connector.execute("remove", stringified_stmts, _waitForAck);
+    if (!buffer) {
+        ServerResponse res = _connector.executeUndecoded("remove", vector<server_param_types>(1, stringified_stmts), _waitForAck);
 
         if (res.status == ServerResponse::failed) throw OntologyServerException("Server" + res.exception_msg + " while removing statements. Server message was " + res.error_msg);
     }
@@ -287,17 +455,23 @@ void Ontology::update(const Statement& statement){
 }
 
 void Ontology::update(const set<Statement>& statements){
+    TraceSpan span("ontology", "Ontology::update");
+
     set<string> stringified_stmts;
     set<Statement>::const_iterator iterator = statements.begin();
+    WriteBuffer* buffer = activeBuffer();
+
+    if (buffer == NULL && _autoBatch && addToBatch(StatementBuffer::UPDATE, statements))
+        return;
 
     while( iterator != statements.end() ) {
-        if (_bufferize) addToBuffer("update", (Statement)*iterator);
-        stringified_stmts.insert(((Statement)*iterator).to_string());
+        if (buffer) addToBuffer(buffer->statements, StatementBuffer::UPDATE, *iterator);
+        else stringified_stmts.insert(iterator->to_string());
         ++iterator;
     }
 
-    if (!_bufferize) {
-        ServerResponse res = _connector.execute("update", stringified_stmts, _waitForAck);
+    if (!buffer) {
+        ServerResponse res = _connector.executeUndecoded("update", vector<server_param_types>(1, stringified_stmts), _waitForAck);
 
         if (res.status == ServerResponse::failed) throw OntologyServerException("Server" + res.exception_msg + " while updating statements. Server message was " + res.error_msg);
     }
@@ -310,14 +484,15 @@ void Ontology::addForAgent(const string& agent, const Statement& statement){
 }
 
 void Ontology::addForAgent(const string& agent, const set<Statement>& statements){
+    TraceSpan span("ontology", "Ontology::addForAgent");
 
     vector<server_param_types> parameters;
     set<string> stringified_stmts;
     set<Statement>::const_iterator iterator = statements.begin();
 
-    TRACE("Got 'addForAgent' call with parameters:");
+    ORO_LOG_DEBUG("Got 'addForAgent' call with parameters:");
     while( iterator != statements.end() ) {
-        TRACE("- " << iterator->to_string());
+        ORO_LOG_DEBUG("- {}", iterator->to_string());
         stringified_stmts.insert(iterator->to_string());
         ++iterator;
     }
@@ -325,7 +500,7 @@ void Ontology::addForAgent(const string& agent, const set<Statement>& statements
     parameters.push_back(agent);
     parameters.push_back(stringified_stmts);
 
-    ServerResponse res = _connector.execute("addForAgent", parameters, _waitForAck);
+    ServerResponse res = _connector.executeUndecoded("addForAgent", parameters, _waitForAck);
 
     if (res.status == ServerResponse::failed)
         throw OntologyServerException("Server threw a " + res.exception_msg +
@@ -340,14 +515,15 @@ void Ontology::removeForAgent(const string& agent, const Statement& statement){
 }
 
 void Ontology::removeForAgent(const string& agent, const set<Statement>& statements){
+    TraceSpan span("ontology", "Ontology::removeForAgent");
 
     vector<server_param_types> parameters;
     set<string> stringified_stmts;
     set<Statement>::const_iterator iterator = statements.begin();
 
-    TRACE("Got 'removeForAgent' call with parameters:");
+    ORO_LOG_DEBUG("Got 'removeForAgent' call with parameters:");
     while( iterator != statements.end() ) {
-        TRACE("- " << iterator->to_string());
+        ORO_LOG_DEBUG("- {}", iterator->to_string());
         stringified_stmts.insert(iterator->to_string());
         ++iterator;
     }
@@ -355,7 +531,7 @@ void Ontology::removeForAgent(const string& agent, const set<Statement>& stateme
     parameters.push_back(agent);
     parameters.push_back(stringified_stmts);
 
-    ServerResponse res = _connector.execute("removeForAgent", parameters, _waitForAck);
+    ServerResponse res = _connector.executeUndecoded("removeForAgent", parameters, _waitForAck);
 
     if (res.status == ServerResponse::failed)
         throw OntologyServerException("Server threw a " + res.exception_msg +
@@ -370,14 +546,15 @@ void Ontology::updateForAgent(const string& agent, const Statement& statement){
 }
 
 void Ontology::updateForAgent(const string& agent, const set<Statement>& statements){
+    TraceSpan span("ontology", "Ontology::updateForAgent");
 
     vector<server_param_types> parameters;
     set<string> stringified_stmts;
     set<Statement>::const_iterator iterator = statements.begin();
 
-    TRACE("Got 'updateForAgent' call with parameters:");
+    ORO_LOG_DEBUG("Got 'updateForAgent' call with parameters:");
     while( iterator != statements.end() ) {
-        TRACE("- " << iterator->to_string());
+        ORO_LOG_DEBUG("- {}", iterator->to_string());
         stringified_stmts.insert(iterator->to_string());
         ++iterator;
     }
@@ -385,7 +562,7 @@ void Ontology::updateForAgent(const string& agent, const set<Statement>& stateme
     parameters.push_back(agent);
     parameters.push_back(stringified_stmts);
 
-    ServerResponse res = _connector.execute("updateForAgent", parameters, _waitForAck);
+    ServerResponse res = _connector.executeUndecoded("updateForAgent", parameters, _waitForAck);
 
     if (res.status == ServerResponse::failed)
         throw OntologyServerException("Server threw a " + res.exception_msg +
@@ -394,22 +571,25 @@ void Ontology::updateForAgent(const string& agent, const set<Statement>& stateme
 }
 
 void Ontology::clear(const set<string>& statements){
-    ServerResponse res = _connector.execute("clear", statements, _waitForAck);
+    TraceSpan span("ontology", "Ontology::clear");
+
+    ServerResponse res = _connector.executeUndecoded("clear", vector<server_param_types>(1, statements), _waitForAck);
 
     if (res.status == ServerResponse::failed) throw OntologyServerException("Server" + res.exception_msg + " while clearing statements from the ontology. Server message was " + res.error_msg);
 
 }
 
 void Ontology::clearForAgent(const string& agent, const set<string>& statements){
+    TraceSpan span("ontology", "Ontology::clearForAgent");
 
     vector<server_param_types> parameters;
 
-    TRACE("Got 'clearForAgent' call");
+    ORO_LOG_DEBUG("Got 'clearForAgent' call");
 
     parameters.push_back(agent);
     parameters.push_back(statements);
 
-    ServerResponse res = _connector.execute("clearForAgent", parameters, _waitForAck);
+    ServerResponse res = _connector.executeUndecoded("clearForAgent", parameters, _waitForAck);
 
     if (res.status == ServerResponse::failed)
         throw OntologyServerException("Server threw a " + res.exception_msg +
@@ -418,8 +598,9 @@ void Ontology::clearForAgent(const string& agent, const set<string>& statements)
 }
 
 bool Ontology::checkConsistency(){
+    TraceSpan span("ontology", "Ontology::checkConsistency");
 
-    TRACE("Got 'checkConsistency' call");
+    ORO_LOG_DEBUG("Got 'checkConsistency' call");
 
     ServerResponse res = _connector.execute("checkConsistency");
 
@@ -430,6 +611,8 @@ bool Ontology::checkConsistency(){
 }
 
 void Ontology::save(const string& path){
+    TraceSpan span("ontology", "Ontology::save");
+
     ServerResponse res = _connector.execute("save", path);
 
     if (res.status == ServerResponse::failed) throw OntologyServerException("Server" + res.exception_msg + " while saving the ontology. Server message was " + res.error_msg);
@@ -437,6 +620,8 @@ void Ontology::save(const string& path){
 }
 
 void Ontology::reload(){
+    TraceSpan span("ontology", "Ontology::reload");
+
     ServerResponse res = _connector.execute("reload");
 
     if (res.status == ServerResponse::failed) throw OntologyServerException("Server" + res.exception_msg + " while reloading the ontology. Server message was " + res.error_msg);
@@ -444,6 +629,8 @@ void Ontology::reload(){
 }
 
 map<string, string> Ontology::stats(){
+    TraceSpan span("ontology", "Ontology::stats");
+
     map<string, string> result;
 
     ServerResponse res = _connector.execute("stats");
@@ -459,49 +646,40 @@ map<string, string> Ontology::stats(){
     return result;
 }
 
+ClientStats Ontology::clientStats(){
+    return ClientMetrics::snapshot();
+}
+
+void Ontology::enableClientStats(bool state){
+    ClientMetrics::enable(state);
+}
+
+void Ontology::resetClientStats(){
+    ClientMetrics::reset();
+}
+
 void Ontology::find(const std::string& resource, const std::set<std::string>& partial_statements, const std::set<std::string>& restrictions, std::set<Concept>& result){
+    TraceSpan span("ontology", "Ontology::find");
 
-    set<string> rawResult;
     vector<server_param_types> args;
     args.push_back(resource);
     args.push_back(partial_statements);
     args.push_back(restrictions);
 
-    ServerResponse res = _connector.execute("find", args);
-
-    if (res.status != ServerResponse::ok)
-    {
-        throw OntologyServerException("\"filtred find\" operation was not successful: server threw a " + res.exception_msg + " (" + res.error_msg +")");
-    }
-
-    rawResult = get<set<string> >(res.result);
-
-    copy(rawResult.begin(), rawResult.end(), inserter(result, result.begin()));
-
+    executeChecked("find", args, "\"find\" operation was not successful").visit(collect(inserter(result, result.begin())));
 }
 
 void Ontology::find(const std::string& resource, const std::set<std::string>& partial_statements, std::set<Concept>& result){
+    TraceSpan span("ontology", "Ontology::find");
 
-    set<string> rawResult;
     vector<server_param_types> args;
     args.push_back(resource);
     args.push_back(partial_statements);
 
-    ServerResponse res = _connector.execute("find", args);
-
-    if (res.status != ServerResponse::ok)
-    {
-        throw OntologyServerException("\"Find\" operation was not successful: server threw a " + res.exception_msg + " (" + res.error_msg +")");
-    }
-
-    try {
-        rawResult = get<set<string> >(res.result);
-        copy(rawResult.begin(), rawResult.end(), inserter(result, result.begin()));
-    } catch (bad_get e) {
-        //nothing was returned. That's fine.
-    }
-
+    ResponseView res = executeChecked("find", args, "\"find\" operation was not successful");
 
+    //anything but a list: nothing was returned. That's fine.
+    if (res.kind() == ResponseView::LIST) res.visit(collect(inserter(result, result.begin())));
 }
 
 void Ontology::find(const std::string& resource, const std::string& partial_statement, std::set<Concept>& result){
@@ -512,87 +690,147 @@ void Ontology::find(const std::string& resource, const std::string& partial_stat
 
 }
 
-//TODO: Some code factorization around would be welcome...
-void Ontology::findForAgent(const string& agent, const std::string& resource, const std::set<std::string>& partial_statements, const std::set<std::string>& restrictions, std::set<Concept>& result){
+size_t Ontology::find(const std::string& resource, const std::set<std::string>& partial_statements, const ResultVisitor& visitor){
+    TraceSpan span("ontology", "Ontology::find");
+
+    vector<server_param_types> args;
+    args.push_back(resource);
+    args.push_back(partial_statements);
+
+    return executeChecked("find", args, "\"find\" operation was not successful").visit(visitor);
+}
 
-    TRACE("Got 'findForAgent' call");
+size_t Ontology::find(const std::string& resource, const std::set<std::string>& partial_statements, const std::set<std::string>& restrictions, const ResultVisitor& visitor){
+    TraceSpan span("ontology", "Ontology::find");
 
-    set<string> rawResult;
     vector<server_param_types> args;
-    args.push_back(agent);
     args.push_back(resource);
     args.push_back(partial_statements);
     args.push_back(restrictions);
 
-    ServerResponse res = _connector.execute("findForAgent", args);
-
-    if (res.status != ServerResponse::ok)
-    {
-        throw OntologyServerException("\"filtred findForAgent\" operation was not successful: server threw a " + res.exception_msg + " (" + res.error_msg +")");
-    }
+    return executeChecked("find", args, "\"find\" operation was not successful").visit(visitor);
+}
 
-    rawResult = get<set<string> >(res.result);
+void Ontology::find(const std::string& resource, const std::set<std::string>& partial_statements, FlatStringSet& result){
+    TraceSpan span("ontology", "Ontology::find");
 
-    copy(rawResult.begin(), rawResult.end(), inserter(result, result.begin()));
+    vector<server_param_types> args;
+    args.push_back(resource);
+    args.push_back(partial_statements);
 
+    executeChecked("find", args, "\"find\" operation was not successful").asFlatSet(result);
 }
 
-void Ontology::findForAgent(const string& agent, const std::string& resource, const std::set<std::string>& partial_statements, std::set<Concept>& result){
+void Ontology::findForAgent(const string& agent, const std::string& resource, const std::set<std::string>& partial_statements, const std::set<std::string>& restrictions, std::set<Concept>& result){
+    TraceSpan span("ontology", "Ontology::findForAgent");
 
-    TRACE("Got 'findForAgent' call");
+    ORO_LOG_DEBUG("Got 'findForAgent' call");
 
-    set<string> rawResult;
     vector<server_param_types> args;
     args.push_back(agent);
     args.push_back(resource);
     args.push_back(partial_statements);
+    args.push_back(restrictions);
 
-    ServerResponse res = _connector.execute("findForAgent", args);
+    executeChecked("findForAgent", args, "\"findForAgent\" operation was not successful").visit(collect(inserter(result, result.begin())));
+}
 
-    if (res.status != ServerResponse::ok)
-    {
-        throw OntologyServerException("\"FindForAgent\" operation was not successful: server threw a " + res.exception_msg + " (" + res.error_msg +")");
-    }
+void Ontology::findForAgent(const string& agent, const std::string& resource, const std::set<std::string>& partial_statements, std::set<Concept>& result){
+    TraceSpan span("ontology", "Ontology::findForAgent");
 
-    rawResult = get<set<string> >(res.result);
+    ORO_LOG_DEBUG("Got 'findForAgent' call");
 
-    copy(rawResult.begin(), rawResult.end(), inserter(result, result.begin()));
+    vector<server_param_types> args;
+    args.push_back(agent);
+    args.push_back(resource);
+    args.push_back(partial_statements);
 
+    executeChecked("findForAgent", args, "\"findForAgent\" operation was not successful").visit(collect(inserter(result, result.begin())));
 }
 
 void Ontology::findForAgent(const string& agent, const std::string& resource, const std::string& partial_statement, std::set<Concept>& result){
 
-    TRACE("Got 'findForAgent' call");
+    ORO_LOG_DEBUG("Got 'findForAgent' call");
 
     set<string> tmp;
     tmp.insert(partial_statement);
     findForAgent(agent, resource, tmp, result);
 }
 
+size_t Ontology::findForAgent(const string& agent, const std::string& resource, const std::set<std::string>& partial_statements, const ResultVisitor& visitor){
+    TraceSpan span("ontology", "Ontology::findForAgent");
+
+    vector<server_param_types> args;
+    args.push_back(agent);
+    args.push_back(resource);
+    args.push_back(partial_statements);
+
+    return executeChecked("findForAgent", args, "\"findForAgent\" operation was not successful").visit(visitor);
+}
+
+void Ontology::findForAgent(const string& agent, const std::string& resource, const std::set<std::string>& partial_statements, FlatStringSet& result){
+    TraceSpan span("ontology", "Ontology::findForAgent");
+
+    vector<server_param_types> args;
+    args.push_back(agent);
+    args.push_back(resource);
+    args.push_back(partial_statements);
+
+    executeChecked("findForAgent", args, "\"findForAgent\" operation was not successful").asFlatSet(result);
+}
+
 
 void Ontology::guess(const std::string& resource, const double threshold, const std::vector<std::string>& partial_statements, std::set<std::string>& result){
     throw OntologyException("Not yet implemented!");
 }
 
 void Ontology::query(const string& var_name, const string& query, set<string>& result){
+    TraceSpan span("ontology", "Ontology::query");
+
     vector<server_param_types> args;
     args.push_back(var_name);
     args.push_back(query);
 
-    ServerResponse res = _connector.execute("query", args);
+    ResponseView res = executeChecked("query", args, "Query <" + query + "> was not successful");
 
-    if (res.status != ServerResponse::ok)
-    {
-        if (res.exception_msg.find(SERVER_QUERYPARSE_EXCEPTION) != string::npos)
-            throw InvalidQueryException(query + "\nYour SPARQL query is invalid: " + res.error_msg);
-        throw OntologyServerException("Query was not successful: server threw a " + res.exception_msg + " (" + res.error_msg +").");
-    }
+    result.clear();
+    res.visit(collect(inserter(result, result.end())));
+}
+
+size_t Ontology::query(const string& var_name, const string& query, const ResultVisitor& visitor){
+    TraceSpan span("ontology", "Ontology::query");
+
+    vector<server_param_types> args;
+    args.push_back(var_name);
+    args.push_back(query);
 
-    if (set<string>* result_p = get<set<string> >(&res.result))
-        result = *result_p;
+    return executeChecked("query", args, "Query <" + query + "> was not successful").visit(visitor);
+}
+
+void Ontology::query(const string& var_name, const string& query, FlatStringSet& result){
+    TraceSpan span("ontology", "Ontology::query");
+
+    vector<server_param_types> args;
+    args.push_back(var_name);
+    args.push_back(query);
+
+    executeChecked("query", args, "Query <" + query + "> was not successful").asFlatSet(result);
+}
+
+PreparedQuery Ontology::prepareQuery(const string& var_name, const string& query){
+    return PreparedQuery(_connector, var_name, query);
+}
+
+PreparedFind Ontology::prepareFind(const string& resource, const set<string>& partial_statements, const set<string>& restrictions){
+    return PreparedFind(_connector, resource, partial_statements, restrictions);
+}
+
+Batch Ontology::batch(){
+    return Batch(_connector);
 }
 
 void Ontology::getDirectClasses(const string& resource, set<Concept>& result){
+    TraceSpan span("ontology", "Ontology::getDirectClasses");
 
     map<string, string> rawResult;
 
@@ -621,35 +859,48 @@ void Ontology::getDirectClasses(const string& resource, set<Concept>& result){
 }
 
 void Ontology::getInfos(const string& resource, set<string>& result){
-    ServerResponse res = _connector.execute("getInfos", resource);
-    if (res.status != ServerResponse::ok)
-    {
-        if (res.exception_msg.find(SERVER_NOTFOUND_EXCEPTION) != string::npos)
-            throw ResourceNotFoundOntologyException(resource + " does not exist in the current ontology.");
-        else throw OntologyServerException("Couldn't retrieve infos on " + resource + ": server threw a " + res.exception_msg + " (" + res.error_msg +").");
-    }
-    result = get<set<string> >(res.result);
+    TraceSpan span("ontology", "Ontology::getInfos");
+
+    vector<server_param_types> args(1, resource);
+
+    ResponseView res = executeChecked("getInfos", args, "Couldn't retrieve infos on " + resource);
 
+    result.clear();
+    res.visit(collect(inserter(result, result.end())));
+}
+
+size_t Ontology::getInfos(const string& resource, const ResultVisitor& visitor){
+    TraceSpan span("ontology", "Ontology::getInfos");
+
+    vector<server_param_types> args(1, resource);
+
+    return executeChecked("getInfos", args, "Couldn't retrieve infos on " + resource).visit(visitor);
+}
+
+void Ontology::getInfos(const string& resource, FlatStringSet& result){
+    TraceSpan span("ontology", "Ontology::getInfos");
+
+    vector<server_param_types> args(1, resource);
+
+    executeChecked("getInfos", args, "Couldn't retrieve infos on " + resource).asFlatSet(result);
 }
 
 void Ontology::getInfosForAgent(const string& agent, const string& resource, set<string>& result){
+    TraceSpan span("ontology", "Ontology::getInfosForAgent");
 
     vector<server_param_types> args;
     args.push_back(agent);
     args.push_back(resource);
 
-    ServerResponse res = _connector.execute("getInfosForAgent", args);
-    if (res.status != ServerResponse::ok)
-    {
-        if (res.exception_msg.find(SERVER_NOTFOUND_EXCEPTION) != string::npos)
-            throw ResourceNotFoundOntologyException(resource + " does not exist in the current ontology.");
-        else throw OntologyServerException("Couldn't retrieve infos on " + resource + ": server threw a " + res.exception_msg + " (" + res.error_msg +").");
-    }
-    result = get<set<string> >(res.result);
+    ResponseView res = executeChecked("getInfosForAgent", args, "Couldn't retrieve infos on " + resource);
 
+    result.clear();
+    res.visit(collect(inserter(result, result.end())));
 }
 
 void Ontology::getResourceDetails(const string& resource, string& result){
+    TraceSpan span("ontology", "Ontology::getResourceDetails");
+
     ServerResponse res = _connector.execute("getResourceDetails", resource);
     if (res.status != ServerResponse::ok)
     {
@@ -662,6 +913,7 @@ void Ontology::getResourceDetails(const string& resource, string& result){
 }
 
 map<string, string> Ontology::lookup(const string& id) {
+    TraceSpan span("ontology", "Ontology::lookup");
 
 	map<string, string> result;
 
@@ -683,6 +935,7 @@ map<string, string> Ontology::lookup(const string& id) {
 }
 
 string Ontology::getLabel(const string& id) {
+    TraceSpan span("ontology", "Ontology::getLabel");
 
 	string label;
 
@@ -707,9 +960,10 @@ string Ontology::registerEvent(	OroEventObserver& callback,
                                EventType eventType,
                                EventTriggeringType triggerType,
                                const std::set<std::string>& pattern,
-                               const std::string& variable_to_bind){
+                               const std::string& variable_to_bind,
+                               const EventCoalescing& coalescing){
 
-    return registerEventForAgent(callback, "", eventType, triggerType, pattern, variable_to_bind);
+    return registerEventForAgent(callback, "", eventType, triggerType, pattern, variable_to_bind, coalescing);
 }
 
 string Ontology::registerEventForAgent(	OroEventObserver& callback,
@@ -717,7 +971,9 @@ string Ontology::registerEventForAgent(	OroEventObserver& callback,
                                        EventType eventType,
                                        EventTriggeringType triggerType,
                                        const std::set<std::string>& pattern,
-                                       const std::string& variable_to_bind){
+                                       const std::string& variable_to_bind,
+                                       const EventCoalescing& coalescing){
+    TraceSpan span("ontology", "Ontology::registerEvent");
 
     vector<server_param_types> args;
 
@@ -781,31 +1037,24 @@ string Ontology::registerEventForAgent(	OroEventObserver& callback,
     try {
         event_id = get<string>(res.result);
     } catch (bad_get e) {
-        cerr << "[EE] Serious error while registering an event! Please report it to openrobots@laas.fr. " << e.what() << endl;
+        ORO_LOG_ERROR("Serious error while registering an event! Please report it to openrobots@laas.fr. {}", e.what());
     }
 
 
     //Store the newly registered event in the list of event observers
-    std::map<std::string, EventObserver>::iterator it;
-    it = _eventObservers.find(event_id);
-
-    if (it != _eventObservers.end())
-        cerr << "[II] Event id already known. Re-registering an previous event. Fine." << endl;
-    else {
-        EventObserver e(&callback, oneShot);
-        _eventObservers[event_id] = e;
-
-        cerr << "[II] New event registered with id " << event_id << endl;
-
-    }
+    if (!_dispatcher.subscribe(event_id, &callback, oneShot, coalescing))
+        ORO_LOG_DEBUG("Event id {} already known. Re-registering an previous event. Fine.", event_id);
+    else
+        ORO_LOG_DEBUG("New event registered with id {}", event_id);
 
     return event_id;
 
 }
 
 void Ontology::clearEvents(){
+    TraceSpan span("ontology", "Ontology::clearEvents");
 
-    TRACE("Got 'clearEvents' call");
+    ORO_LOG_DEBUG("Got 'clearEvents' call");
 
     ServerResponse res = _connector.execute("clearEvents");
 
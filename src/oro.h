@@ -182,10 +182,22 @@
 #include <typeinfo>
 
 #include <boost/logic/tribool.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 
 #include "oro_exceptions.h"
 #include "oro_event.h"
 #include "oro_connector.h"
+#include "client_metrics.h"
+#include "event_dispatcher.h"
+#include "statement_buffer.h"
+#include "statement_parser.h"
+#include "symbol_table.h"
 
 /**
  * The main \p liboro namespace.
@@ -193,10 +205,55 @@
 namespace oro {
 
 class Concept;
+class PreparedQuery;
+class PreparedFind;
+class Batch;
+class FlatStringSet;
+class ResponseView;
 class Statement;
+class ConceptBuilder;
+
+/**
+ * A ResultVisitor that writes the elements of a result to an output
+ * iterator, cf collect().
+ */
+template<typename OutputIterator>
+class ResultCollector {
+public:
+    ResultCollector(OutputIterator out, size_t limit) : _out(out), _limit(limit), _count(0) {}
+
+    bool operator()(const std::string& element) {
+        *_out++ = element;
+        return _limit == 0 || ++_count < _limit;
+    }
+
+private:
+    OutputIterator _out;
+    size_t _limit;
+    size_t _count;
+};
+
+/**
+ * Returns a ResultVisitor that writes the elements of a result to \p out ,
+ * and stops after \p limit elements (0 for no limit).
+ *
+ * \code
+ * set<Concept> result;
+ * oro->find("x", partial_stmts, collect(inserter(result, result.begin()), 10));
+ * \endcode
+ */
+template<typename OutputIterator>
+ResultCollector<OutputIterator> collect(OutputIterator out, size_t limit = 0) {
+    return ResultCollector<OutputIterator>(out, limit);
+}
 
 /**
  * This represent the ontology itself. This class offers tools to look for concept, etc.
+ *
+ * The ontology can be shared by several threads, provided the connector is
+ * itself thread-safe (which is the case of the SocketConnector). Bufferization
+ * (cf Ontology::bufferize()) is done per thread: each thread fills its own
+ * buffer without any locking, and the buffers are merged at flush time.
  */
 class Ontology {
 
@@ -216,6 +273,13 @@ public:
     */
     static Ontology* getInstance();
 
+    /**
+     * Sends the auto-batched statements still pending (cf
+     * disableAutoBatch()). getInstance() then throws again, until the next
+     * createWithConnector().
+     */
+    ~Ontology();
+
     /**
       * Change the behaviour of liboro for requests whose responses are not essential.
       *
@@ -532,6 +596,55 @@ public:
 
     void find(const std::string& resource, const std::string& partial_statement, std::set<Concept>& result);
 
+    /* Note that the identifier of each Concept returned is interned (cf
+     * SymbolTable), and stays in memory until the program exits. The
+     * FlatStringSet and ResultVisitor overloads below do not intern: use
+     * them for requests that return ever-new identifiers.
+     */
+
+    /**
+     * Like Ontology::find(const std::string&, const std::set<std::string>&, std::set<Concept>&),
+     * but hands each result over to \p visitor as soon as it is decoded,
+     * instead of building a set. The search stops as soon as the visitor
+     * returns false.
+     *
+     * \code
+     * // prints at most 10 results
+     * oro->find("x", partial_stmts, collect(ostream_iterator<string>(cout, "\n"), 10));
+     * \endcode
+     *
+     * Memory is still O(response): the whole response of the server is
+     * received and held before the first result is visited. Only the set
+     * (one node per result) is saved. The server sends all the results even
+     * if the visitor stops early.
+     *
+     * The results are visited in the order the server sent them, and
+     * duplicates are visited as many times as they were sent: unlike the
+     * set overload, nothing is sorted nor deduplicated.
+     *
+     * @return the number of results visited.
+     */
+    size_t find(const std::string& resource, const std::set<std::string>& partial_statements, const ResultVisitor& visitor);
+
+    size_t find(const std::string& resource, const std::set<std::string>& partial_statements, const std::set<std::string>& restrictions, const ResultVisitor& visitor);
+
+    /**
+     * Like Ontology::find(const std::string&, const std::set<std::string>&, std::set<Concept>&),
+     * but returns the results in a FlatStringSet: all the results share one
+     * buffer, which is much cheaper to decode and to hold than a set of
+     * Concept for large results. Previous content of \p result is
+     * discarded.
+     *
+     * \code
+     * #include "liboro/flat_result.h"
+     *
+     * FlatStringSet result;
+     * oro->find("x", partial_stmts, result);
+     * if (result.contains("oro:Table")) ...
+     * \endcode
+     */
+    void find(const std::string& resource, const std::set<std::string>& partial_statements, FlatStringSet& result);
+
     /**
      * Like Ontology::find(const std::string&, const std::set<std::string>&, const std::set<std::string>&, std::set<Concept>&)
      * but look for statements in a specific agent model.
@@ -550,6 +663,14 @@ public:
      */
     void findForAgent(const std::string& agent, const std::string& resource, const std::string& partial_statement, std::set<Concept>& result);
 
+    /**
+     * Like Ontology::find(const std::string&, const std::set<std::string>&, const ResultVisitor&)
+     * but look for statements in a specific agent model.
+     */
+    size_t findForAgent(const std::string& agent, const std::string& resource, const std::set<std::string>& partial_statements, const ResultVisitor& visitor);
+
+    void findForAgent(const std::string& agent, const std::string& resource, const std::set<std::string>& partial_statements, FlatStringSet& result);
+
 
     /**
      * Tries to approximately identify an individual given a set of known statements about this resource.\n
@@ -617,6 +738,67 @@ public:
     */
     void query(const std::string& var_name, const std::string& query, std::set<std::string>& result);
 
+    /**
+     * Like Ontology::query(const std::string&, const std::string&, std::set<std::string>&),
+     * but hands each result over to \p visitor , until it returns false.
+     * Memory, order and duplicates are as for the visitor overload of
+     * find().
+     *
+     * @return the number of results visited.
+     */
+    size_t query(const std::string& var_name, const std::string& query, const ResultVisitor& visitor);
+
+    /**
+     * Like Ontology::query(const std::string&, const std::string&, std::set<std::string>&),
+     * but returns the results in a FlatStringSet (cf Ontology::find(const std::string&, const std::set<std::string>&, FlatStringSet&)).
+     */
+    void query(const std::string& var_name, const std::string& query, FlatStringSet& result);
+
+    /**
+     * Prepares a SPARQL query with placeholders (like \p ${agent} ), to be
+     * executed many times with different values. The query is serialized
+     * once: each execution only splices the bound values in. Results may
+     * also be cached. See PreparedRequest for the syntax of the
+     * placeholders.
+     *
+     * \code
+     * #include "liboro/prepared_query.h"
+     *
+     * PreparedQuery seen = oro->prepareQuery("x", "SELECT ?x WHERE {${agent} sees ?x}");
+     *
+     * seen.bind("agent", "myself").execute(result);
+     * seen.bind("agent", "bob").execute(result);
+     * \endcode
+     *
+     * Prepared requests require a connector that implements
+     * IConnector::executeSerialized(), like the SocketConnector.
+     *
+     * @throw OntologyException if a placeholder is malformed.
+     */
+    PreparedQuery prepareQuery(const std::string& var_name, const std::string& query);
+
+    /**
+     * Like prepareQuery(), for Ontology::find(): the resource, the partial
+     * statements and the restrictions may contain placeholders.
+     */
+    PreparedFind prepareFind(const std::string& resource, const std::set<std::string>& partial_statements, const std::set<std::string>& restrictions = std::set<std::string>());
+
+    /**
+     * Returns an empty Batch, to send many independent calls (finds,
+     * lookups, writes...) to the server at once, and get each result and
+     * each error separately.
+     *
+     * \code
+     * #include "liboro/batch.h"
+     *
+     * Batch batch = oro->batch();
+     * BatchResult<set<string> > bob = batch.getInfos("bob");
+     * BatchResult<set<string> > alice = batch.getInfos("alice");
+     * batch.execute(); // one round-trip to the server
+     * \endcode
+     */
+    Batch batch();
+
     /**
      * Returns the direct class (or classes) of an instance, ie classes that
      * are not super-classes of any other class of the instance.
@@ -642,6 +824,18 @@ public:
      */
     void getInfos(const std::string& resource, std::set<std::string>& result);
 
+    /**
+     * Like Ontology::getInfos(const std::string&, std::set<std::string>&),
+     * but hands each statement over to \p visitor , until it returns false.
+     * Memory, order and duplicates are as for the visitor overload of
+     * find().
+     *
+     * @return the number of statements visited.
+     */
+    size_t getInfos(const std::string& resource, const ResultVisitor& visitor);
+
+    void getInfos(const std::string& resource, FlatStringSet& result);
+
     /**
      * Like Ontology::getInfos(const std::string&, std::set<Statement>&);
      * but look for statements in a specific agent model.
@@ -681,6 +875,11 @@ public:
      * \param variable_to_bind (optional) for the NEW_INSTANCE event type,
      * define the variable from the partial statements to bind in the event
      * (ie, when an NEW_INSTANCE event is triggered, what object is returned).
+     * \param coalescing (optional) merges the bursts of events triggered
+     * within a time window into a single call to the observer, whose content
+     * is the union of the content of the merged events. Cf \link
+     * EventCoalescing the EventCoalescing documentation \endlink. By default,
+     * each event is delivered on its own.
      * \return An ID that uniquely identify this event. When this event is
      * triggered on the server, the notification mechanism refers to the event
      * by this ID.
@@ -689,7 +888,8 @@ public:
                               EventType type,
                               EventTriggeringType triggerType,
                               const std::set<std::string>& pattern,
-                              const std::string& variable_to_bind = "");
+                              const std::string& variable_to_bind = "",
+                              const EventCoalescing& coalescing = EventCoalescing());
 
     /**
      * Like Ontology::registerEvent()
@@ -700,7 +900,8 @@ public:
                                       EventType type,
                                       EventTriggeringType triggerType,
                                       const std::set<std::string>& pattern,
-                                      const std::string& variable_to_bind = "");
+                                      const std::string& variable_to_bind = "",
+                                      const EventCoalescing& coalescing = EventCoalescing());
 
 	/**
 	 * Removes all events currently registered on the main model.
@@ -739,6 +940,33 @@ public:
      */
     std::map<std::string, std::string> stats();
 
+    /**
+     * Returns the client-side counterpart of stats(): for each type of
+     * request ("add", "find"...), the number of calls, the bytes exchanged
+     * and the latency distribution, with the time spent serializing, waiting
+     * for the connection, waiting for the server and parsing, plus the
+     * events received and the bufferization statistics.
+     *
+     * The metrics are recorded by all the threads of the process, once
+     * enabled by enableClientStats() or by the ORO_METRICS=1 environment
+     * variable. Only the SocketConnector records per-request metrics.
+     *
+     * The result can be printed with operator<<.
+     */
+    ClientStats clientStats();
+
+    /**
+     * Enables (or disables) the recording of the client-side metrics
+     * returned by clientStats(). Disabled metrics cost an atomic load per
+     * request.
+     */
+    void enableClientStats(bool state = true);
+
+    /**
+     * Clears the client-side metrics recorded so far.
+     */
+    void resetClientStats();
+
     /**
      * Generate a new random id which can be used to name new objects. Attention! no check for collision!
      *
@@ -776,18 +1004,98 @@ public:
      * 		return 0;
      * }
      * \endcode
+     *
+     * Bufferization only applies to the calling thread: other threads keep
+     * on sending their requests directly, unless they call bufferize() as
+     * well. Calls to bufferize() and flush() can be nested; the buffer is only
+     * flushed by the outermost flush().
+     *
+     * Statements still in the buffer of a thread when it exits are lost.
+     *
+     * To avoid placing bufferize() and flush() by hand, see enableAutoBatch().
      */
     void bufferize();
 
     /**
       * If buffering is enabled (cf {@link #bufferize()} ), optimize the buffer by concatenating what requests, actually send the requests, and flush the buffer.
+      *
+      * The buffer of the calling thread is first merged into a buffer shared
+      * by all threads, following the same rules as within one buffer (an
+      * "add" cancels a pending "remove" of the same statement and
+      * conversely). If no other thread is currently sending, the calling
+      * thread then sends the combined requests of every thread that flushed in
+      * the meantime; otherwise it waits for its statements to be sent by the
+      * thread in charge.
       */
     void flush();
 
+    /**
+     * Enables the automatic batching of writes.
+     *
+     * Once enabled, add(), remove() and update() (from any thread that is not
+     * explicitly bufferizing) return immediately: the statements are stored
+     * in a shared buffer that a background thread sends as soon as it holds
+     * \p max_statements statements, or as soon as its oldest statement has
+     * been waiting for \p max_delay_ms milliseconds. The same cancellation
+     * rules as for bufferize() apply.
+     *
+     * Requests that read the ontology are not batched, and are thus not
+     * guaranteed to see the statements still waiting in the buffer: call
+     * sync() before them if needed.
+     *
+     * Calling it again while enabled changes the thresholds.
+     *
+     * The ontology returned by createWithConnector() is never destroyed:
+     * call sync() or disableAutoBatch() before exiting, or the statements
+     * still waiting in the buffer are lost. Destroying an Ontology disables
+     * auto-batching, hence sends them.
+     *
+     * \code
+     * oro->enableAutoBatch(500, 20);
+     *
+     * for (int i = 0; i < 10000; i++)
+     *     oro->add(Statement("gorilla eats banana" + boost::lexical_cast<string>(i)));
+     *
+     * oro->sync(); //every statement has now been sent to the server.
+     * \endcode
+     */
+    void enableAutoBatch(size_t max_statements = 1000, unsigned int max_delay_ms = 50);
+
+    /**
+     * Sends the statements still pending, and goes back to sending each
+     * write request as it comes.
+     */
+    void disableAutoBatch();
+
+    /**
+     * Blocks until every statement batched or flushed so far (by any thread)
+     * has been sent to the server, and acknowledged unless
+     * alwaysWaitForAcknowledgment(false) was set.
+     *
+     * Throws OntologyServerException if the last batch it waited for failed,
+     * or if a batch of auto-batched statements (which add() and remove()
+     * do not wait for) failed since the last call to sync(), even if
+     * nothing is left to send.
+     */
+    void sync();
+
+    /**
+     * Returns the dispatcher that delivers the events to their observers.
+     *
+     * It can be used to tune the number of event worker threads and the
+     * overflow policy, or to inspect how long the observers take:
+     *
+     * \code
+     * oro->eventDispatcher().configure(4, 256, DROP_OLDEST);
+     * \endcode
+     */
+    EventDispatcher& eventDispatcher() { return _dispatcher; }
+
     /** This callback is called by the connector when it receive an event.
-     * It converts a raw "server_return_type" in "event_content_type", create
-     * a new OroEvent object, and dispatch it to its subscriber (ie an
-     * OroEventObserver).
+     * It hands the raw event over to the event dispatcher, which converts it
+     * into an OroEvent and calls its subscriber (ie an OroEventObserver) on
+     * one of its worker threads. It thus returns immediately, whatever the
+     * observer does.
      */
     static void evtCallback(const std::string& event_id, const server_return_types& raw_event_content);
 
@@ -802,24 +1110,93 @@ private:
      */
     bool checkOntologyServer();
 
-    void addToBuffer(const std::string, const Statement&);
+    /** Executes a read request without decoding its result, and checks its
+     * status (cf ResponseView::check()).
+     *
+     * \throw OntologyServerException (or ResourceNotFoundOntologyException,
+     * InvalidQueryException) if the request failed, with a message starting
+     * with \p errorPrefix .
+     */
+    ResponseView executeChecked(const std::string& method, const std::vector<server_param_types>& args, const std::string& errorPrefix);
 
-    static Ontology* _instance;
+    struct WriteBuffer {
+        /**hold the number of "on-going" bufferization operation. It allows to flush the buffer only at the end of the "stack".
+         */
+        int depth;
 
-    bool _bufferize;
-    bool _waitForAck;
+        StatementBuffer statements;
 
-    /**hold the number of "on-going" bufferization operation. It allows to flush the buffer only at the end of the "stack".
-         */
-    int _buf_op_counter;
+        WriteBuffer() : depth(0) {}
+    };
+
+    /** Returns the write buffer of the calling thread if it is currently
+     * bufferizing, NULL otherwise.
+     */
+    WriteBuffer* activeBuffer();
 
-    typedef std::map<std::string, Statement> BufStatements;
-    std::map<std::string, BufStatements > _buffer;
+    void addToBuffer(StatementBuffer& buffer, StatementBuffer::Action action, const Statement& stmt);
 
-    //The boolan in the EventObserver typedef indicates if the event is "one
-    //shot" (true) or permanent (false).
-    typedef std::pair<OroEventObserver*, bool> EventObserver;
-    static std::map<std::string, EventObserver> _eventObservers;
+    /** Sends the shared buffer until the statements merged in batch
+     * \p batch have been sent, or waits for another thread to do it.
+     */
+    void sendBatches(unsigned long batch, boost::unique_lock<boost::mutex>& lock);
+
+    /** Adds statements to the shared batch, when auto-batching is enabled.
+     * Returns false, without adding anything, if auto-batching has been
+     * disabled since the caller checked it: the statements must then be
+     * sent directly.
+     */
+    bool addToBatch(StatementBuffer::Action action, const std::set<Statement>& statements);
+
+    /** Main loop of the background flusher. Cf enableAutoBatch().
+     */
+    void autoFlush();
+
+    static boost::atomic<Ontology*> _instance;
+    static boost::mutex _instanceLock;
+
+    boost::atomic<bool> _waitForAck;
+
+    boost::thread_specific_ptr<WriteBuffer> _localBuffer;
+
+    // Statements flushed by all threads, waiting to be sent.
+    boost::mutex _batchLock;
+    boost::condition_variable _batchSent;
+    StatementBuffer _batch;
+    unsigned long _batchId; // id of the batch currently being filled
+    unsigned long _sentBatches; // batches with a lower id have been sent
+    bool _sending;
+
+    // Outcome of the batches threads are waiting for, kept until each of
+    // these threads has checked it.
+    struct BatchStatus {
+        unsigned int waiters;
+        bool failed;
+        std::string failure;
+
+        BatchStatus() : waiters(0), failed(false) {}
+    };
+    std::map<unsigned long, BatchStatus> _batchStatus;
+
+    // Whether the batch being filled holds auto-batched statements, whose
+    // writers do not wait for the batch to be sent.
+    bool _batchUnwaited;
+
+    // The first failure of a batch of auto-batched statements not reported
+    // yet by sync() (0 if none).
+    unsigned long _unreportedBatch;
+    std::string _unreportedFailure;
+
+    // Auto-batching (cf enableAutoBatch()). The settings are protected by _batchLock.
+    boost::atomic<bool> _autoBatch;
+    size_t _maxBatchSize;
+    boost::posix_time::time_duration _maxBatchDelay;
+    boost::posix_time::ptime _batchDeadline;
+    bool _stopFlusher;
+    boost::condition_variable _flushNeeded;
+    boost::thread _flusher;
+
+    EventDispatcher _dispatcher;
 
 };
 
@@ -841,14 +1218,27 @@ public:
      */
     Class(const std::string& name);
 
+    explicit Class(Symbol name) : _name(name) {}
+
     virtual ~Class();
 
-    const std::string& name() const {return _name;}
+    const std::string& name() const {return _name.str();}
+
+    /**
+     * Returns the interned name of the class.
+     */
+    Symbol symbol() const {return _name;}
 
     /**
      * Return a computer-friendly string describing the class.
      */
-    const std::string& to_string() const {return _name;}
+    const std::string& to_string() const {return _name.str();}
+
+    bool operator==(const Class& c) const {return _name == c._name;}
+    bool operator!=(const Class& c) const {return _name != c._name;}
+    bool operator<(const Class& c) const {return _name < c._name;}
+
+    friend std::size_t hash_value(const Class& c) {return hash_value(c._name);}
 
     /**
      * Print, in a computer-friendly way, the class.
@@ -870,7 +1260,7 @@ public:
     void onNewInstance(OroEventObserver& callback, bool repeatable = PERMANENT_EVENT) const;
 
 protected:
-    std::string _name;
+    Symbol _name;
 };
 
 /** This represents a property (or predicate) of the OpenRobots ontology.
@@ -887,18 +1277,31 @@ public:
      */
     Property(const std::string& name);
 
+    explicit Property(Symbol name) : _name(name) {}
+
     virtual ~Property();
 
     /**
      * Return the name of the property
      */
-    const std::string& name() const {return _name;}
+    const std::string& name() const {return _name.str();}
+
+    /**
+     * Returns the interned name of the property.
+     */
+    Symbol symbol() const {return _name;}
 
     /**
      * Return, in a computer-friendly way, the property id. Does currently 
 	 * the same as Property.name().
      */
-    const std::string& to_string() const {return _name;}
+    const std::string& to_string() const {return _name.str();}
+
+    bool operator==(const Property& p) const {return _name == p._name;}
+    bool operator!=(const Property& p) const {return _name != p._name;}
+    bool operator<(const Property& p) const {return _name < p._name;}
+
+    friend std::size_t hash_value(const Property& p) {return hash_value(p._name);}
 
     /**
      * Print, in a computer-friendly way, the property.
@@ -909,7 +1312,7 @@ public:
     }
 
 protected:
-    std::string _name;
+    Symbol _name;
 };
 
 /** This represents a concept (an instance or an individual in OWL terminology)
@@ -930,7 +1333,20 @@ public:
      */
     Concept(const std::string& id);
 
-    inline bool operator<(const Concept& concept) const {return _id < concept.id();}
+    /**
+     * Constructs a object from the interned identifier of a previous concept.
+     */
+    explicit Concept(Symbol id);
+
+    /**
+     * Concepts are ordered alphabetically by identifier. Equality is tested
+     * in constant time.
+     */
+    inline bool operator<(const Concept& concept) const {return _id != concept._id && _id.str() < concept._id.str();}
+    inline bool operator==(const Concept& concept) const {return _id == concept._id;}
+    inline bool operator!=(const Concept& concept) const {return _id != concept._id;}
+
+    friend std::size_t hash_value(const Concept& c) {return hash_value(c._id);}
 
 
     /** Creates a new concept with a label, defaulting its class to "owl:Thing"
@@ -945,6 +1361,27 @@ public:
      */
     static Concept create(const Class& type);
 
+    /**
+     * Starts building a new concept, associated to a random identifier. The
+     * assertions on the concept are gathered by the builder, and sent to the
+     * server in a single request by ConceptBuilder::commit().
+     *
+     * \code
+     * Concept cup = Concept::build()
+     *                   .label("my cup")
+     *                   .type(Class("Cup"))
+     *                   .assertThat(Property("isOn"), table)
+     *                   .commit();
+     * \endcode
+     */
+    static ConceptBuilder build();
+
+    /**
+     * Starts building assertions on the concept \p id.
+     * \see build()
+     */
+    static ConceptBuilder build(const std::string& id);
+
     /**
      * This is a special member of the Concept class representing the semantic of the "nothing" concept. It's the unique, virtual, instance of the class Nothing.
      * \see Class::Nothing
@@ -1058,7 +1495,12 @@ public:
      * Returns the ID of the concept. Beware: two different ID may refer to the same actual concept (OWL doesn't rely on the Unique Name Assumption).
      * \return the ID of the concept.
      */
-    const std::string id() const {return _id;};
+    const std::string& id() const {return _id.str();};
+
+    /**
+     * Returns the interned ID of the concept.
+     */
+    Symbol symbol() const {return _id;}
 
     /**
      * Returns the status (true or false) of some boolean property.
@@ -1116,7 +1558,7 @@ public:
     /**
      * Returns a computer-friendly string describing the concept.
      */
-    std::string to_string() const {return id();}
+    const std::string& to_string() const {return id();}
 
     /**
      * Print, in a computer-friendly way, the concept.
@@ -1128,7 +1570,9 @@ public:
     }
 
 protected:
-    std::string _id;
+    friend class ConceptBuilder;
+
+    Symbol _id;
     std::string _label;
     Class _class;
 
@@ -1238,6 +1682,14 @@ public:
  * \li 1.0e6, which is the same as "1.0e6"^^xsd:double
  * \li true, which is the same as "true"^^xsd:boolean
  * \li false, which is the same as "false"^^xsd:boolean
+ *
+ * Literals containing spaces should be quoted. An unquoted object of
+ * several words is still accepted, as a string: <tt>john says hello
+ * world</tt> is the same as <tt>john says "hello world"</tt>.
+ *
+ * Statements are kept in a canonical form (cf StatementParser): the
+ * statements above that are "the same" compare equal, and are sent
+ * identically to the server.
  */
 class Statement {
 public:
@@ -1248,20 +1700,73 @@ public:
     std::string literal_object;
 
     bool isObjectLiteral;
+    LiteralType literal_type;
 
     /**
      * Constructs a new statement from its literal string representation.
      * For details regarding the syntax, please refer to the Statement class main documentation page.
+     *
+     * \throw InvalidStatementException if the statement can not be parsed.
      */
     Statement(const std::string& stmt);
     Statement(const Concept& subject, const Property& predicate, const Concept& object);
+
+    /**
+     * Constructs a new statement whose object is given as a string. The
+     * object is parsed like the object of Statement(const std::string&): it
+     * may be a resource or a literal. If it can not be parsed, it is taken
+     * verbatim as a string literal.
+     */
     Statement(const Concept& subject, const Property& predicate, const std::string& object);
 
-    inline bool operator==(const Statement& stmt) const {return (stmt.to_string() == to_string());}
-    inline bool operator<(const Statement& stmt) const {return (stmt.to_string() < to_string());}
+    /**
+     * Constructs a new statement from an already canonical literal object.
+     */
+    Statement(const Concept& subject, const Property& predicate, const std::string& literal, LiteralType type);
 
     /**
-     * Returns a computer-friendly string describing the concept.
+     * Statements are compared by their subject, predicate and object
+     * symbols (cf Symbol about the ordering), and by their literal object,
+     * which is not interned, if any. Same order as Triple.
+     */
+    inline bool operator==(const Statement& stmt) const {
+        return subject.symbol() == stmt.subject.symbol() &&
+               predicate.symbol() == stmt.predicate.symbol() &&
+               isObjectLiteral == stmt.isObjectLiteral &&
+               (isObjectLiteral ? literal_object == stmt.literal_object
+                                : object.symbol() == stmt.object.symbol());
+    }
+
+    inline bool operator<(const Statement& stmt) const {
+        if (subject.symbol() != stmt.subject.symbol()) return subject.symbol() < stmt.subject.symbol();
+        if (predicate.symbol() != stmt.predicate.symbol()) return predicate.symbol() < stmt.predicate.symbol();
+        if (isObjectLiteral != stmt.isObjectLiteral) return isObjectLiteral < stmt.isObjectLiteral;
+        if (isObjectLiteral) return literal_object < stmt.literal_object;
+        return object.symbol() < stmt.object.symbol();
+    }
+
+    friend std::size_t hash_value(const Statement& stmt) {
+        std::size_t seed = 0;
+        boost::hash_combine(seed, stmt.subject.symbol().id());
+        boost::hash_combine(seed, stmt.predicate.symbol().id());
+        boost::hash_combine(seed, stmt.isObjectLiteral);
+        if (stmt.isObjectLiteral) boost::hash_combine(seed, stmt.literal_object);
+        else boost::hash_combine(seed, stmt.object.symbol().id());
+        return seed;
+    }
+
+    /**
+     * Returns the compact identity of the statement.
+     */
+    Triple triple() const {
+        if (isObjectLiteral) return Triple(subject.symbol(), predicate.symbol(), literal_object);
+        return Triple(subject.symbol(), predicate.symbol(), object.symbol());
+    }
+
+    /**
+     * Returns a computer-friendly string describing the concept. The string
+     * is built on each call: it is meant to be used when the statement is
+     * sent to the server.
      */
     std::string to_string() const;
 
@@ -1269,13 +1774,74 @@ public:
      * Print, in a computer-friendly way, the statement.
      */
     friend std::ostream& operator<<(std::ostream& stream,const Statement& stmt){
-        stream <<  stmt._originalStmt;
+        stream << stmt.subject << " " << stmt.predicate << " ";
+        if (stmt.isObjectLiteral) stream << stmt.literal_object;
+        else stream << stmt.object;
         return stream;
     }
+};
 
-private:
-    std::string _originalStmt;
+/**
+ * Gathers the assertions on a concept, to send them all at once to the server.
+ * Cf Concept::build().
+ *
+ * Several concepts can be created with a single request as well:
+ * \code
+ * vector<ConceptBuilder> builders;
+ * for (int i = 0 ; i < 10 ; i++)
+ *     builders.push_back(Concept::build().type(Class("Cup")));
+ *
+ * vector<Concept> cups = ConceptBuilder::commit(builders);
+ * \endcode
+ */
+class ConceptBuilder {
+public:
+    explicit ConceptBuilder(const Concept& concept);
+
+    /**
+     * Sets a human-readable label for the concept (cf Concept::setLabel()).
+     */
+    ConceptBuilder& label(const std::string& label);
+
+    /**
+     * Sets the class of the concept (cf Concept::setType()).
+     */
+    ConceptBuilder& type(const Class& type);
+
+    /**
+     * Adds an assertion on the concept (cf Concept::assertThat()).
+     */
+    ConceptBuilder& assertThat(const Property& predicate, const std::string& value);
+    ConceptBuilder& assertThat(const Property& predicate, const Concept& value);
+
+    /**
+     * Returns the concept being built.
+     */
+    const Concept& concept() const {return _concept;}
 
+    /**
+     * Returns the assertions gathered so far.
+     */
+    const std::set<Statement>& statements() const {return _statements;}
+
+    /**
+     * Sends all the assertions to the server, in a single request, and
+     * returns the concept. Like any other addition, the request is subject
+     * to the bufferization or to the auto-batching of the ontology.
+     *
+     * \throw OntologySemanticException if the addition of the statements causes the ontology to become inconsistent.
+     */
+    Concept commit();
+
+    /**
+     * Sends the assertions of several builders in a single request, and
+     * returns the concepts, in the same order.
+     */
+    static std::vector<Concept> commit(const std::vector<ConceptBuilder>& builders);
+
+private:
+    Concept _concept;
+    std::set<Statement> _statements;
 };
 }
 
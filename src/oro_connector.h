@@ -32,6 +32,9 @@
 #include <iostream>
 #include <stdexcept>
 #include <boost/variant.hpp>
+#include <boost/function.hpp>
+
+#include "oro_exceptions.h"
 
 namespace oro {
 
@@ -40,6 +43,7 @@ typedef boost::variant<	bool,
                         double,
                         std::string,
                         std::set<std::string>,
+                        std::vector<std::string>,
                         std::map<std::string, std::string>
                          > server_param_types;
 
@@ -53,6 +57,12 @@ typedef boost::variant< bool,
 
 typedef std::pair<std::string, std::vector<server_param_types> > query_type;
 
+/**
+ * Receives the elements of a result one by one, as they are decoded.
+ * Returning false stops the decoding: the remaining elements are skipped.
+ */
+typedef boost::function<bool(const std::string&)> ResultVisitor;
+
 struct ServerResponse {
     enum Status {
         ok,
@@ -123,13 +133,74 @@ class IConnector {
         virtual ServerResponse execute(const std::string& query,
                                        bool waitForAck = true) = 0;
 
+        /**
+         * Performs a query whose arguments are already serialized in the
+         * text protocol of the ontology server (one argument per line, cf
+         * SocketConnector). This lets PreparedQuery and PreparedFind reuse
+         * their serialization from one call to the other.
+         *
+         * Connectors that do not speak this protocol may omit it: they throw
+         * a ConnectorException.
+         */
+        virtual ServerResponse executeSerialized(
+                            const std::string& /*query*/,
+                            const std::string& /*serialized_args*/,
+                            bool /*waitForAck*/ = true) {
+            throw ConnectorException("This connector does not support pre-serialized requests.");
+        }
+
+        /**
+         * Like execute(), but the connector may leave the result undecoded,
+         * in its raw form (\p raw_result ), for callers that decode it
+         * themselves, element by element (cf SocketConnector::visitCollection),
+         * lazily (cf ResponseView), or not at all (writes, that only check
+         * the status). Connectors that always decode their results may omit
+         * it.
+         */
+        virtual ServerResponse executeUndecoded(
+                            const std::string& query,
+                            const std::vector<server_param_types>& args,
+                            bool waitForAck = true) {
+            return execute(query, args, waitForAck);
+        }
+
+        /**
+         * Performs several queries and returns their responses, in the same
+         * order. Each response carries its own status: a failure, even of
+         * the connection, is reported in the response (with a
+         * CONNECTOR_EXCEPTION exception_msg for the latter) rather than
+         * thrown.
+         *
+         * The default implementation executes the queries one after the
+         * other. Connectors that can pipeline requests (like the
+         * SocketConnector) send them all at once, then wait for the
+         * responses.
+         */
+        virtual void executeBatch(const std::vector<query_type>& queries,
+                                  std::vector<ServerResponse>& responses) {
+            responses.clear();
+            responses.reserve(queries.size());
+
+            for (size_t i = 0 ; i < queries.size() ; ++i) {
+                try {
+                    responses.push_back(execute(queries[i].first, queries[i].second));
+                } catch (ConnectorException& e) {
+                    ServerResponse res;
+                    res.status = ServerResponse::failed;
+                    res.exception_msg = CONNECTOR_EXCEPTION;
+                    res.error_msg = e.what();
+                    responses.push_back(res);
+                }
+            }
+        }
+
         /**
          * Sets the callback the connector will call when it receive an event
          * from the server. If the connector doesn't handle events, the
          * implementation of this method may be omitted.
          */
         virtual void setEventCallback(
-                void (*evtCallback)(const std::string& event_id,
+                void (* /*evtCallback*/)(const std::string& event_id,
                                     const server_return_types& raw_event_content)
                 ) {};
 
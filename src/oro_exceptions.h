@@ -145,6 +145,7 @@ class InvalidStatementException : public OntologyException {
     public:
         InvalidStatementException() : OntologyException("A statement must contain precisely 3 tokens (the subject, the predicate and the object)") { }
         InvalidStatementException(const char* msg) : OntologyException(msg) { }
+        InvalidStatementException(const std::string& msg) : OntologyException(msg.c_str()) { }
 };
 
 }
@@ -0,0 +1,250 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <chrono>
+
+#include <boost/bind.hpp>
+#include <boost/lockfree/queue.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/once.hpp>
+
+#include "leaked.h"
+#include "oro_log.h"
+
+// Number of messages the queue can hold before dropping new ones.
+#define ORO_LOG_QUEUE_SIZE 1024
+
+using namespace std;
+
+namespace oro {
+
+void LogRecord::format(string& out) const {
+    char number[32];
+    size_t arg = 0;
+
+    for (const char* c = formatString ; *c != '\0' ; ++c) {
+
+        if (c[0] != '{' || c[1] != '}' || arg == nbArgs) {
+            out += *c;
+            continue;
+        }
+
+        switch (types[arg]) {
+        case SIGNED:
+            snprintf(number, sizeof(number), "%lld", values[arg].i);
+            out += number;
+            break;
+        case UNSIGNED:
+            snprintf(number, sizeof(number), "%llu", values[arg].u);
+            out += number;
+            break;
+        case DOUBLE:
+            snprintf(number, sizeof(number), "%g", values[arg].d);
+            out += number;
+            break;
+        case STRING:
+            out.append(payload + values[arg].string.offset, values[arg].string.length);
+            break;
+        }
+
+        ++arg;
+        ++c;
+    }
+}
+
+namespace {
+
+const char* prefixes[] = {"[DD] ", "[II] ", "[WW] ", "[EE] "};
+
+void formatLine(const LogRecord& record, string& out) {
+    out += prefixes[record.level];
+
+    // Debug messages are timestamped, like the former TRACE macro.
+    if (record.level == LOG_DEBUG) {
+        time_t seconds = record.time / 1000000000ULL;
+        struct tm tm;
+        localtime_r(&seconds, &tm);
+
+        char timestamp[32];
+        snprintf(timestamp, sizeof(timestamp), "%02d:%02d:%02d.%03d ",
+                 tm.tm_hour, tm.tm_min, tm.tm_sec, (int) (record.time / 1000000ULL % 1000));
+        out += timestamp;
+    }
+
+    record.format(out);
+    out += '\n';
+}
+
+struct Logger {
+    Logger() : queue(ORO_LOG_QUEUE_SIZE), pushed(0), written(0), dropped(0),
+               sleeping(false), stopped(false) {}
+
+    /* The background thread: formats and writes the messages, in batches.
+     */
+    void run() {
+        string out;
+        LogRecord record;
+
+        while (true) {
+            out.clear();
+            size_t nbRecords = 0;
+
+            while (nbRecords < 256 && queue.pop(record)) {
+                formatLine(record, out);
+                ++nbRecords;
+            }
+
+            if (nbRecords > 0) {
+                fwrite(out.data(), 1, out.length(), stderr);
+                fflush(stderr);
+                written += nbRecords;
+                continue;
+            }
+
+            if (stopped) return;
+
+            // Producers do not lock: a wake-up may be missed, hence the
+            // timeout.
+            boost::unique_lock<boost::mutex> lock(sleepLock);
+            sleeping = true;
+            if (queue.empty())
+                wakeUp.timed_wait(lock, boost::posix_time::milliseconds(50));
+            sleeping = false;
+        }
+    }
+
+    void start() {
+        thread = boost::thread(boost::bind(&Logger::run, this));
+    }
+
+    boost::lockfree::queue<LogRecord> queue;
+
+    boost::atomic<size_t> pushed;
+    boost::atomic<size_t> written;
+    boost::atomic<size_t> dropped;
+
+    boost::atomic<bool> sleeping;
+    boost::atomic<bool> stopped;
+
+    boost::mutex sleepLock;
+    boost::condition_variable wakeUp;
+
+    boost::thread thread;
+};
+
+Logger& logger() {
+    return leaked<Logger>();
+}
+
+boost::once_flag loggerStarted = BOOST_ONCE_INIT;
+
+void startLogger() {
+    logger().start();
+}
+
+/* Writes the pending messages at exit. Messages logged afterwards are
+ * written synchronously.
+ */
+struct LogAtExit {
+    ~LogAtExit() {
+        Logger& log = logger();
+
+        log.stopped = true;
+        if (!log.thread.joinable()) return;
+
+        log.wakeUp.notify_one();
+        log.thread.join();
+    }
+};
+
+LogAtExit logAtExit;
+
+// Debug builds (cmake -DDEBUG=ON) display the debug messages by default.
+#ifdef DEBUG
+const LogLevel DEFAULT_LEVEL = LOG_DEBUG;
+#else
+const LogLevel DEFAULT_LEVEL = LOG_INFO;
+#endif
+
+LogLevel levelFromEnvironment() {
+    const char* value = getenv("ORO_LOG");
+    if (value == NULL) return DEFAULT_LEVEL;
+
+    string level(value);
+    if (level == "debug") return LOG_DEBUG;
+    if (level == "info") return LOG_INFO;
+    if (level == "warning") return LOG_WARNING;
+    if (level == "error") return LOG_ERROR;
+    if (level == "off") return LOG_OFF;
+    return DEFAULT_LEVEL;
+}
+
+}
+
+boost::atomic<int> Log::_level(levelFromEnvironment());
+
+void Log::setLevel(LogLevel level) {
+    _level.store(level, boost::memory_order_relaxed);
+}
+
+boost::uint64_t Log::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void Log::push(const LogRecord& record) {
+    Logger& log = logger();
+
+    if (log.stopped) {
+        string out;
+        formatLine(record, out);
+        fwrite(out.data(), 1, out.length(), stderr);
+        return;
+    }
+
+    boost::call_once(loggerStarted, startLogger);
+
+    if (!log.queue.bounded_push(record)) {
+        log.dropped++;
+        return;
+    }
+
+    log.pushed++;
+
+    if (log.sleeping) log.wakeUp.notify_one();
+}
+
+void Log::flush() {
+    Logger& log = logger();
+    size_t target = log.pushed.load();
+
+    while (log.written.load() < target && !log.stopped) {
+        log.wakeUp.notify_one();
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+}
+
+size_t Log::dropped() {
+    return logger().dropped.load();
+}
+
+}
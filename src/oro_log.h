@@ -0,0 +1,197 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/** \file
+ * This header defines the logging facility of liboro: the ORO_LOG_* macros,
+ * and the Log class behind them.
+ */
+
+#ifndef ORO_LOG_H_
+#define ORO_LOG_H_
+
+#include <string>
+#include <cstring>
+#include <algorithm>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/utility/string_view.hpp>
+
+// Maximum number of arguments of a log message.
+#define ORO_LOG_MAX_ARGS 6
+// Room for the string arguments of a message. Longer strings are truncated,
+// and end with "...".
+#define ORO_LOG_PAYLOAD 192
+
+namespace oro {
+
+enum LogLevel {LOG_DEBUG = 0, LOG_INFO, LOG_WARNING, LOG_ERROR, LOG_OFF};
+
+/**
+ * A log message, before formatting: the format string and a binary copy of
+ * its arguments.
+ */
+struct LogRecord {
+    enum ArgType {SIGNED, UNSIGNED, DOUBLE, STRING};
+
+    void add(long long value) {
+        if (nbArgs == ORO_LOG_MAX_ARGS) return;
+        types[nbArgs] = SIGNED;
+        values[nbArgs++].i = value;
+    }
+
+    void add(unsigned long long value) {
+        if (nbArgs == ORO_LOG_MAX_ARGS) return;
+        types[nbArgs] = UNSIGNED;
+        values[nbArgs++].u = value;
+    }
+
+    void add(double value) {
+        if (nbArgs == ORO_LOG_MAX_ARGS) return;
+        types[nbArgs] = DOUBLE;
+        values[nbArgs++].d = value;
+    }
+
+    void add(boost::string_view value) {
+        if (nbArgs == ORO_LOG_MAX_ARGS) return;
+
+        size_t room = ORO_LOG_PAYLOAD - payloadSize;
+        size_t length = value.length();
+
+        //Truncated strings end with "...", so that they are not mistaken for
+        //the actual value.
+        if (length > room) {
+            length = room < 3 ? 0 : room - 3;
+            memcpy(payload + payloadSize, value.data(), length);
+            memcpy(payload + payloadSize + length, "...", room - length);
+            length = room;
+        }
+        else memcpy(payload + payloadSize, value.data(), length);
+
+        types[nbArgs] = STRING;
+        values[nbArgs].string.offset = payloadSize;
+        values[nbArgs++].string.length = length;
+        payloadSize += length;
+    }
+
+    void add(int value) {add((long long) value);}
+    void add(long value) {add((long long) value);}
+    void add(unsigned int value) {add((unsigned long long) value);}
+    void add(unsigned long value) {add((unsigned long long) value);}
+    void add(float value) {add((double) value);}
+    void add(bool value) {add(boost::string_view(value ? "true" : "false"));}
+    void add(const char* value) {add(boost::string_view(value));}
+    void add(const std::string& value) {add(boost::string_view(value));}
+
+    /**
+     * Appends the message to \p out, with its arguments in place of the
+     * "{}" of the format.
+     */
+    void format(std::string& out) const;
+
+    boost::uint64_t time;   // in ns since the epoch
+    const char* formatString;
+    unsigned char level;
+    unsigned char nbArgs;
+    unsigned char types[ORO_LOG_MAX_ARGS];
+    unsigned short payloadSize;
+
+    union {
+        long long i;
+        unsigned long long u;
+        double d;
+        struct {unsigned short offset; unsigned short length;} string;
+    } values[ORO_LOG_MAX_ARGS];
+
+    char payload[ORO_LOG_PAYLOAD];
+};
+
+/**
+ * An asynchronous logger.
+ *
+ * Logging a message only copies its format string and its arguments into a
+ * fixed-size record, pushed onto a lock-free queue. A background thread
+ * formats the records and writes them to the standard error, in batches.
+ * If the queue is full, the message is dropped (and counted) rather than
+ * blocking the caller.
+ *
+ * Messages below the level given by the ORO_LOG environment variable
+ * ("debug", "info" -- the default, or "debug" if liboro was built with the
+ * DEBUG option --, "warning", "error" or "off") are
+ * discarded at the cost of a relaxed atomic load. Messages below
+ * ORO_LOG_MIN_LEVEL (a LogLevel, 0 by default) are not even compiled in.
+ *
+ * The format string must be a string literal: it is only read by the
+ * background thread. Every "{}" is replaced by the next argument.
+ */
+class Log {
+public:
+    static bool enabled(LogLevel level) {return level >= _level.load(boost::memory_order_relaxed);}
+
+    static LogLevel level() {return (LogLevel) _level.load(boost::memory_order_relaxed);}
+    static void setLevel(LogLevel level);
+
+    template<typename... Args>
+    static void write(LogLevel level, const char* format, const Args&... args) {
+        LogRecord record;
+        record.time = now();
+        record.formatString = format;
+        record.level = level;
+        record.nbArgs = 0;
+        record.payloadSize = 0;
+
+        int expand[] = {0, (record.add(args), 0)...};
+        (void) expand;
+
+        push(record);
+    }
+
+    /**
+     * Blocks until the messages logged so far are written.
+     */
+    static void flush();
+
+    /**
+     * Number of messages dropped because the queue was full.
+     */
+    static size_t dropped();
+
+private:
+    static boost::uint64_t now();
+    static void push(const LogRecord& record);
+
+    static boost::atomic<int> _level;
+};
+
+}
+
+#ifndef ORO_LOG_MIN_LEVEL
+#define ORO_LOG_MIN_LEVEL 0
+#endif
+
+#define ORO_LOG(level, ...) \
+    do { \
+        if ((level) >= ORO_LOG_MIN_LEVEL && oro::Log::enabled(level)) \
+            oro::Log::write(level, __VA_ARGS__); \
+    } while (0)
+
+#define ORO_LOG_DEBUG(...) ORO_LOG(oro::LOG_DEBUG, __VA_ARGS__)
+#define ORO_LOG_INFO(...) ORO_LOG(oro::LOG_INFO, __VA_ARGS__)
+#define ORO_LOG_WARNING(...) ORO_LOG(oro::LOG_WARNING, __VA_ARGS__)
+#define ORO_LOG_ERROR(...) ORO_LOG(oro::LOG_ERROR, __VA_ARGS__)
+
+#endif /* ORO_LOG_H_ */
@@ -0,0 +1,358 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <cstdlib>
+#include <algorithm>
+#include <iterator>
+
+#include <boost/lexical_cast.hpp>
+
+#include "oro_exceptions.h"
+#include "tracer.h"
+#include "socket_connector.h"
+#include "response_view.h"
+#include "prepared_query.h"
+
+using namespace std;
+using namespace boost;
+
+namespace oro {
+
+namespace {
+
+const char* typeNames[] = {"id", "literal", "int", "double", "bool"};
+
+/* Same escaping as SocketConnector::protectValue, without the surrounding
+ * quotes: it can be applied piece by piece.
+ */
+void escapeQuotes(const string& value, string& out) {
+    for (size_t i = 0 ; i < value.length() ; ++i) {
+        if (value[i] == '"') out += '\\';
+        out += value[i];
+    }
+}
+
+bool isNumber(const string& value, bool integer) {
+    if (value.empty()) return false;
+
+    char* end;
+    if (integer) strtol(value.c_str(), &end, 10);
+    else strtod(value.c_str(), &end);
+
+    return *end == '\0';
+}
+
+}
+
+const char* PreparedRequest::typeName(PlaceholderType type) {
+    return typeNames[type];
+}
+
+PreparedRequest::PreparedRequest(IConnector& connector, const string& method) :
+    _connector(connector),
+    _method(method),
+    _fragments(1),
+    _cacheCapacity(0),
+    _cacheHits(0),
+    _cacheMisses(0) {}
+
+void PreparedRequest::appendFixed(const string& text, bool quoted) {
+    if (quoted) escapeQuotes(text, _fragments.back());
+    else _fragments.back() += text;
+}
+
+void PreparedRequest::appendTemplate(const string& text, bool quoted) {
+
+    size_t pos = 0;
+
+    while (true) {
+        size_t start = text.find("${", pos);
+
+        if (start == string::npos) {
+            appendFixed(text.substr(pos), quoted);
+            return;
+        }
+
+        appendFixed(text.substr(pos, start - pos), quoted);
+
+        size_t end = text.find('}', start);
+        if (end == string::npos)
+            throw OntologyException("Unterminated placeholder in \"" + text + "\"");
+
+        string name = text.substr(start + 2, end - start - 2);
+        string type;
+
+        size_t colon = name.find(':');
+        if (colon != string::npos) {
+            type = name.substr(colon + 1);
+            name = name.substr(0, colon);
+        }
+
+        if (name.empty())
+            throw OntologyException("Placeholder without name in \"" + text + "\"");
+
+        PlaceholderType placeholderType = ID;
+        if (!type.empty()) {
+            const char** found = std::find(typeNames, typeNames + 5, type);
+            if (found == typeNames + 5)
+                throw OntologyException("Unknown type \"" + type + "\" for placeholder " + name + " (expected id, literal, int, double or bool)");
+            placeholderType = (PlaceholderType) (found - typeNames);
+        }
+
+        size_t index = 0;
+        while (index < _placeholders.size() && _placeholders[index].name != name) ++index;
+
+        if (index == _placeholders.size()) {
+            Placeholder placeholder;
+            placeholder.name = name;
+            placeholder.type = placeholderType;
+            placeholder.bound = false;
+            _placeholders.push_back(placeholder);
+        }
+        else if (!type.empty() && _placeholders[index].type != placeholderType)
+            throw OntologyException("Placeholder " + name + " is used with different types");
+
+        Slot slot;
+        slot.placeholder = index;
+        slot.quoted = quoted;
+        _slots.push_back(slot);
+        _fragments.push_back("");
+
+        pos = end + 1;
+    }
+}
+
+PreparedRequest::Placeholder& PreparedRequest::find(const string& name) {
+    for (size_t i = 0 ; i < _placeholders.size() ; ++i)
+        if (_placeholders[i].name == name) return _placeholders[i];
+
+    throw OntologyException("No placeholder named " + name);
+}
+
+PreparedRequest& PreparedRequest::bind(const string& name, const string& value) {
+    Placeholder& placeholder = find(name);
+
+    bool valid = true;
+
+    switch (placeholder.type) {
+    case ID:
+        valid = !value.empty() && value.find_first_of(" \t\n\"'") == string::npos;
+        placeholder.value = value;
+        break;
+    case LITERAL:
+        placeholder.value = "\"";
+        for (size_t i = 0 ; i < value.length() ; ++i) {
+            if (value[i] == '"' || value[i] == '\\') placeholder.value += '\\';
+            placeholder.value += value[i];
+        }
+        placeholder.value += '"';
+        break;
+    case INT:
+    case DOUBLE:
+        valid = isNumber(value, placeholder.type == INT);
+        placeholder.value = value;
+        break;
+    case BOOL:
+        valid = (value == "true" || value == "false");
+        placeholder.value = value;
+        break;
+    }
+
+    if (!valid) {
+        placeholder.bound = false;
+        throw OntologyException("\"" + value + "\" is not a valid " + typeNames[placeholder.type] + " for placeholder " + name);
+    }
+
+    placeholder.bound = true;
+    return *this;
+}
+
+PreparedRequest& PreparedRequest::bind(const string& name, const char* value) {
+    return bind(name, string(value));
+}
+
+PreparedRequest& PreparedRequest::bind(const string& name, int value) {
+    PlaceholderType type = find(name).type;
+    if (type != INT && type != DOUBLE)
+        throw OntologyException("Placeholder " + name + " expects a " + typeNames[type] + ", not an int");
+
+    return bind(name, lexical_cast<string>(value));
+}
+
+PreparedRequest& PreparedRequest::bind(const string& name, double value) {
+    PlaceholderType type = find(name).type;
+    if (type != DOUBLE)
+        throw OntologyException("Placeholder " + name + " expects a " + typeNames[type] + ", not a double");
+
+    return bind(name, lexical_cast<string>(value));
+}
+
+PreparedRequest& PreparedRequest::bind(const string& name, bool value) {
+    PlaceholderType type = find(name).type;
+    if (type != BOOL)
+        throw OntologyException("Placeholder " + name + " expects a " + typeNames[type] + ", not a bool");
+
+    return bind(name, string(value ? "true" : "false"));
+}
+
+void PreparedRequest::clearBindings() {
+    for (size_t i = 0 ; i < _placeholders.size() ; ++i)
+        _placeholders[i].bound = false;
+}
+
+vector<string> PreparedRequest::placeholders() const {
+    vector<string> names;
+    for (size_t i = 0 ; i < _placeholders.size() ; ++i)
+        names.push_back(_placeholders[i].name);
+    return names;
+}
+
+void PreparedRequest::enableCache(size_t capacity) {
+    _cacheCapacity = capacity;
+
+    while (_cache.size() > _cacheCapacity) {
+        _cache.erase(_cacheOrder.front());
+        _cacheOrder.pop_front();
+    }
+}
+
+void PreparedRequest::disableCache() {
+    enableCache(0);
+}
+
+void PreparedRequest::clearCache() {
+    _cache.clear();
+    _cacheOrder.clear();
+}
+
+void PreparedRequest::run(set<string>& result) {
+
+    vector<string> values;
+    values.reserve(_placeholders.size());
+
+    for (size_t i = 0 ; i < _placeholders.size() ; ++i) {
+        if (!_placeholders[i].bound)
+            throw OntologyException("Placeholder " + _placeholders[i].name + " is not bound");
+        values.push_back(_placeholders[i].value);
+    }
+
+    if (_cacheCapacity > 0) {
+        map<vector<string>, set<string> >::const_iterator cached = _cache.find(values);
+        if (cached != _cache.end()) {
+            ++_cacheHits;
+            result = cached->second;
+            return;
+        }
+        ++_cacheMisses;
+    }
+
+    string args = _fragments[0];
+    for (size_t i = 0 ; i < _slots.size() ; ++i) {
+        const string& value = values[_slots[i].placeholder];
+
+        if (_slots[i].quoted) escapeQuotes(value, args);
+        else args += value;
+
+        args += _fragments[i + 1];
+    }
+
+    ServerResponse res = _connector.executeSerialized(_method, args);
+
+    if (res.status != ServerResponse::ok) fail(res);
+
+    if (set<string>* result_p = get<set<string> >(&res.result))
+        result = *result_p;
+    else
+        result.clear(); //nothing was returned. That's fine.
+
+    if (_cacheCapacity > 0) {
+        if (_cache.size() == _cacheCapacity) {
+            _cache.erase(_cacheOrder.front());
+            _cacheOrder.pop_front();
+        }
+
+        _cache[values] = result;
+        _cacheOrder.push_back(values);
+    }
+}
+
+PreparedQuery::PreparedQuery(IConnector& connector, const string& var_name, const string& query) :
+    PreparedRequest(connector, "query"),
+    _query(query)
+{
+    // cf ParametersSerializationHolder: plain strings are quoted, not escaped.
+    appendFixed("\"" + var_name + "\"" + MSG_SEPARATOR + "\"", false);
+    appendTemplate(query, false);
+    appendFixed(string("\"") + MSG_SEPARATOR, false);
+}
+
+void PreparedQuery::execute(set<string>& result) {
+    TraceSpan span("ontology", "PreparedQuery::execute");
+    run(result);
+}
+
+void PreparedQuery::fail(const ServerResponse& res) const {
+    ResponseView::check(res, "Query <" + _query + "> was not successful");
+}
+
+PreparedFind::PreparedFind(IConnector& connector,
+                           const string& resource,
+                           const set<string>& partial_statements,
+                           const set<string>& restrictions) :
+    PreparedRequest(connector, "find")
+{
+    appendFixed("\"", false);
+    appendTemplate(resource, false);
+    appendFixed(string("\"") + MSG_SEPARATOR + "[", false);
+
+    for (set<string>::const_iterator it = partial_statements.begin() ; it != partial_statements.end() ; ++it) {
+        if (it != partial_statements.begin()) appendFixed(",", false);
+        appendFixed("\"", false);
+        appendTemplate(*it, true);
+        appendFixed("\"", false);
+    }
+
+    appendFixed(string("]") + MSG_SEPARATOR, false);
+
+    if (!restrictions.empty()) {
+        appendFixed("[", false);
+
+        for (set<string>::const_iterator it = restrictions.begin() ; it != restrictions.end() ; ++it) {
+            if (it != restrictions.begin()) appendFixed(",", false);
+            appendFixed("\"", false);
+            appendTemplate(*it, true);
+            appendFixed("\"", false);
+        }
+
+        appendFixed(string("]") + MSG_SEPARATOR, false);
+    }
+}
+
+void PreparedFind::execute(set<Concept>& result) {
+    TraceSpan span("ontology", "PreparedFind::execute");
+
+    set<string> rawResult;
+    run(rawResult);
+
+    copy(rawResult.begin(), rawResult.end(), inserter(result, result.begin()));
+}
+
+void PreparedFind::fail(const ServerResponse& res) const {
+    ResponseView::check(res, "\"find\" operation was not successful");
+}
+
+}
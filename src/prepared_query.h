@@ -0,0 +1,236 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/** \file
+ * This header defines PreparedQuery and PreparedFind, templates of SPARQL
+ * queries and of \p find requests whose serialization is reused from one
+ * call to the other.
+ */
+
+#ifndef PREPARED_QUERY_H_
+#define PREPARED_QUERY_H_
+
+#include <set>
+#include <map>
+#include <deque>
+#include <vector>
+#include <string>
+
+#include "oro.h"
+
+namespace oro {
+
+/**
+ * The common part of PreparedQuery and PreparedFind: the placeholders, their
+ * bindings, the pre-serialized request and the result cache.
+ *
+ * Placeholders are written \p ${name:type} in the templates, where \p type
+ * is one of:
+ * <ul>
+ *  <li>\p id (the default, \p ${name} is the same as \p ${name:id}): a
+ *  resource identifier, like \p myself or \p oro:Table . It can not contain
+ *  spaces nor quotes,</li>
+ *  <li>\p literal : a string, spliced in quotes (and with its quotes and
+ *  backslashes escaped),</li>
+ *  <li>\p int , \p double and \p bool : the corresponding literals.</li>
+ * </ul>
+ * A placeholder may appear several times: all its occurrences take the same
+ * value.
+ *
+ * The template is serialized once, when it is prepared, into fragments of
+ * the request that are already escaped. Executing the request only escapes
+ * the bound values and splices them between the fragments.
+ *
+ * The results can be cached, per tuple of bound values (cf enableCache()).
+ * The cache does not know when the knowledge base changes: it is meant for
+ * knowledge that does not, or for callers that clear it when it may have.
+ *
+ * Like the Ontology, a prepared request may be executed by several threads,
+ * but must be bound and executed by one thread at a time.
+ */
+class PreparedRequest {
+public:
+
+    enum PlaceholderType {ID, LITERAL, INT, DOUBLE, BOOL};
+
+    /**
+     * Returns the name of a type in the templates: "id", "literal"...
+     */
+    static const char* typeName(PlaceholderType type);
+
+    /**
+     * Binds a value to all the occurrences of the placeholder \p name .
+     *
+     * \throw OntologyException if there is no such placeholder, or if the
+     * value does not match the type of the placeholder.
+     */
+    PreparedRequest& bind(const std::string& name, const std::string& value);
+    PreparedRequest& bind(const std::string& name, const char* value);
+    PreparedRequest& bind(const std::string& name, int value);
+    PreparedRequest& bind(const std::string& name, double value);
+    PreparedRequest& bind(const std::string& name, bool value);
+
+    /**
+     * Unbinds all the placeholders.
+     */
+    void clearBindings();
+
+    /**
+     * Returns the names of the placeholders, in order of first appearance.
+     */
+    std::vector<std::string> placeholders() const;
+
+    /**
+     * Caches the results of the last \p capacity distinct tuples of bound
+     * values. The oldest entries are evicted first.
+     */
+    void enableCache(size_t capacity = 256);
+    void disableCache();
+    void clearCache();
+
+    size_t cacheHits() const {return _cacheHits;}
+    size_t cacheMisses() const {return _cacheMisses;}
+
+protected:
+
+    PreparedRequest(IConnector& connector, const std::string& method);
+
+    /* Appends 'text' to the serialized request. If 'quoted', the text
+     * belongs to a quoted item of a list, and its quotes are escaped.
+     */
+    void appendFixed(const std::string& text, bool quoted);
+
+    /* Same as above, for a text that may contain placeholders. */
+    void appendTemplate(const std::string& text, bool quoted);
+
+    virtual ~PreparedRequest() {}
+
+    /* Executes the request with the current bindings, or returns the cached
+     * result. Throws an OntologyException if a placeholder is not bound.
+     */
+    void run(std::set<std::string>& result);
+
+    /* Throws the exception matching a failed response. */
+    virtual void fail(const ServerResponse& res) const = 0;
+
+    IConnector& _connector;
+    std::string _method;
+
+private:
+
+    struct Placeholder {
+        std::string name;
+        PlaceholderType type;
+        bool bound;
+        std::string value; // as spliced in the request, before escaping
+    };
+
+    // An occurrence of a placeholder, between two fragments.
+    struct Slot {
+        size_t placeholder;
+        bool quoted;
+    };
+
+    Placeholder& find(const std::string& name);
+
+    std::vector<Placeholder> _placeholders;
+
+    // _fragments.size() == _slots.size() + 1
+    std::vector<std::string> _fragments;
+    std::vector<Slot> _slots;
+
+    size_t _cacheCapacity;
+    std::map<std::vector<std::string>, std::set<std::string> > _cache;
+    std::deque<std::vector<std::string> > _cacheOrder;
+    size_t _cacheHits;
+    size_t _cacheMisses;
+};
+
+/**
+ * A SPARQL query with placeholders, cf Ontology::prepareQuery().
+ *
+ * \code
+ * PreparedQuery seen = oro->prepareQuery("x", "SELECT ?x WHERE {${agent} sees ?x}");
+ *
+ * set<string> result;
+ * seen.bind("agent", "myself").execute(result);
+ * \endcode
+ */
+class PreparedQuery : public PreparedRequest {
+public:
+
+    PreparedQuery(IConnector& connector, const std::string& var_name, const std::string& query);
+
+    PreparedQuery& bind(const std::string& name, const std::string& value) {PreparedRequest::bind(name, value); return *this;}
+    PreparedQuery& bind(const std::string& name, const char* value) {PreparedRequest::bind(name, value); return *this;}
+    PreparedQuery& bind(const std::string& name, int value) {PreparedRequest::bind(name, value); return *this;}
+    PreparedQuery& bind(const std::string& name, double value) {PreparedRequest::bind(name, value); return *this;}
+    PreparedQuery& bind(const std::string& name, bool value) {PreparedRequest::bind(name, value); return *this;}
+
+    /**
+     * Like Ontology::query(), with the current bindings.
+     */
+    void execute(std::set<std::string>& result);
+
+protected:
+    void fail(const ServerResponse& res) const;
+
+private:
+    std::string _query;
+};
+
+/**
+ * A \p find request whose partial statements and filters have placeholders,
+ * cf Ontology::prepareFind().
+ *
+ * \code
+ * set<string> partial_stmts;
+ * partial_stmts.insert("${agent} sees ?x");
+ * partial_stmts.insert("?x rdf:type ${class}");
+ *
+ * PreparedFind seen = oro->prepareFind("x", partial_stmts);
+ *
+ * set<Concept> result;
+ * seen.bind("agent", "myself").bind("class", "Table").execute(result);
+ * \endcode
+ */
+class PreparedFind : public PreparedRequest {
+public:
+
+    PreparedFind(IConnector& connector,
+                 const std::string& resource,
+                 const std::set<std::string>& partial_statements,
+                 const std::set<std::string>& restrictions = std::set<std::string>());
+
+    PreparedFind& bind(const std::string& name, const std::string& value) {PreparedRequest::bind(name, value); return *this;}
+    PreparedFind& bind(const std::string& name, const char* value) {PreparedRequest::bind(name, value); return *this;}
+    PreparedFind& bind(const std::string& name, int value) {PreparedRequest::bind(name, value); return *this;}
+    PreparedFind& bind(const std::string& name, double value) {PreparedRequest::bind(name, value); return *this;}
+    PreparedFind& bind(const std::string& name, bool value) {PreparedRequest::bind(name, value); return *this;}
+
+    /**
+     * Like Ontology::find(), with the current bindings.
+     */
+    void execute(std::set<Concept>& result);
+
+protected:
+    void fail(const ServerResponse& res) const;
+};
+
+}
+
+#endif /* PREPARED_QUERY_H_ */
@@ -0,0 +1,440 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/** \file
+ * This header defines a small DSL to write \p find requests and SPARQL
+ * queries with C++ expressions instead of strings:
+ *
+ * \code
+ * #include "liboro/oro_library.h"
+ * #include "liboro/query_dsl.h"
+ *
+ * using namespace oro;
+ *
+ * ORO_DSL_VAR(x);
+ * ORO_DSL_PARAM(agent, PreparedRequest::ID);
+ *
+ * // Built and prepared once...
+ * static PreparedFind seenRobots = dsl::find(x, dsl::triple(agent, Properties::sees, x)
+ *                                             & dsl::isA(x, Classes::Robot))
+ *                                        .prepare(*oro);
+ *
+ * // ...executed at each cycle: only 'agent' is substituted.
+ * set<Concept> result;
+ * seenRobots.bind("agent", "myself").execute(result);
+ * \endcode
+ *
+ * The variables and the parameters are types: the selected variable must
+ * appear in the pattern, classes can not be used as predicates, and
+ * requests with parameters can only be executed once prepared. These
+ * mistakes are compile errors.
+ *
+ * This header only depends on \p liboro headers, and needs no linking
+ * besides \p liboro itself.
+ */
+
+#ifndef QUERY_DSL_H_
+#define QUERY_DSL_H_
+
+#include <set>
+#include <string>
+#include <vector>
+#include <type_traits>
+
+#include <boost/lexical_cast.hpp>
+
+#include "oro.h"
+#include "prepared_query.h"
+
+namespace oro {
+namespace dsl {
+
+/**
+ * A variable of a pattern, like \p ?x . Declared with ORO_DSL_VAR.
+ */
+template<typename Tag> struct Var {};
+
+/**
+ * A parameter, bound when the request is executed. Declared with
+ * ORO_DSL_PARAM. It becomes a placeholder of the PreparedFind or
+ * PreparedQuery.
+ */
+template<typename Tag> struct Param {};
+
+/**
+ * A string literal, like \p "Bob" .
+ */
+struct Literal {
+    explicit Literal(const std::string& value) : value(value) {}
+    std::string value;
+};
+
+inline Literal literal(const std::string& value) {return Literal(value);}
+
+/* Compile-time lists of tags, to track the variables and the parameters
+ * used by a pattern.
+ */
+template<typename... Tags> struct TagList {};
+
+template<typename Tag, typename List> struct Contains;
+
+template<typename Tag>
+struct Contains<Tag, TagList<> > : std::false_type {};
+
+template<typename Tag, typename Head, typename... Tail>
+struct Contains<Tag, TagList<Head, Tail...> > :
+    std::integral_constant<bool, std::is_same<Tag, Head>::value || Contains<Tag, TagList<Tail...> >::value> {};
+
+template<typename... Lists> struct Concat;
+
+template<>
+struct Concat<> {typedef TagList<> type;};
+
+template<typename... Tags>
+struct Concat<TagList<Tags...> > {typedef TagList<Tags...> type;};
+
+template<typename... As, typename... Bs, typename... Rest>
+struct Concat<TagList<As...>, TagList<Bs...>, Rest...> {
+    typedef typename Concat<TagList<As..., Bs...>, Rest...>::type type;
+};
+
+/**
+ * One position of a triple, as written in the request.
+ */
+struct Term {
+    enum Kind {VARIABLE, PARAMETER, RESOURCE, VALUE} kind;
+    std::string text;
+
+    Term(Kind kind, const std::string& text) : kind(kind), text(text) {}
+
+    /* find() takes the resources as they are; SPARQL needs a namespace,
+     * oro: by default.
+     */
+    void write(std::string& out, bool sparql) const {
+        switch (kind) {
+        case VARIABLE:
+            out += '?';
+            out += text;
+            break;
+        case PARAMETER:
+            out += "${";
+            out += text;
+            out += '}';
+            break;
+        case RESOURCE:
+            if (sparql && text.find(':') == std::string::npos) out += "oro:";
+            out += text;
+            break;
+        case VALUE:
+            out += text;
+            break;
+        }
+    }
+};
+
+/* How each kind of C++ value becomes a Term, with the variables and the
+ * parameters it brings.
+ */
+template<typename T, typename Enable = void>
+struct TermOf {
+    static_assert(sizeof(T) == 0, "this type can not be used in a triple: use a variable, a parameter, a Concept, a Class, a Property, a string, a number or dsl::literal()");
+};
+
+template<typename Tag>
+struct TermOf<Var<Tag> > {
+    typedef TagList<Tag> vars;
+    typedef TagList<> params;
+    static Term make(const Var<Tag>&) {return Term(Term::VARIABLE, Tag::name());}
+};
+
+template<typename Tag>
+struct TermOf<Param<Tag> > {
+    typedef TagList<> vars;
+    typedef TagList<Tag> params;
+    static Term make(const Param<Tag>&) {return Term(Term::PARAMETER, Tag::placeholder());}
+};
+
+template<typename T>
+struct TermOf<T, typename std::enable_if<std::is_same<T, Concept>::value ||
+                                         std::is_base_of<Concept, T>::value>::type> {
+    typedef TagList<> vars;
+    typedef TagList<> params;
+    static Term make(const Concept& c) {return Term(Term::RESOURCE, c.id());}
+};
+
+template<>
+struct TermOf<Class> {
+    typedef TagList<> vars;
+    typedef TagList<> params;
+    static Term make(const Class& c) {return Term(Term::RESOURCE, c.name());}
+};
+
+template<>
+struct TermOf<Property> {
+    typedef TagList<> vars;
+    typedef TagList<> params;
+    static Term make(const Property& p) {return Term(Term::RESOURCE, p.name());}
+};
+
+template<>
+struct TermOf<std::string> {
+    typedef TagList<> vars;
+    typedef TagList<> params;
+    static Term make(const std::string& s) {return Term(Term::RESOURCE, s);}
+};
+
+template<>
+struct TermOf<Literal> {
+    typedef TagList<> vars;
+    typedef TagList<> params;
+    static Term make(const Literal& l) {
+        std::string quoted("\"");
+        for (size_t i = 0 ; i < l.value.length() ; ++i) {
+            if (l.value[i] == '"' || l.value[i] == '\\') quoted += '\\';
+            quoted += l.value[i];
+        }
+        return Term(Term::VALUE, quoted + "\"");
+    }
+};
+
+template<typename T>
+struct TermOf<T, typename std::enable_if<std::is_arithmetic<T>::value>::type> {
+    typedef TagList<> vars;
+    typedef TagList<> params;
+    static Term make(T value) {
+        if (std::is_same<T, bool>::value) return Term(Term::VALUE, value ? "true" : "false");
+        return Term(Term::VALUE, boost::lexical_cast<std::string>(value));
+    }
+};
+
+// String literals and char arrays are resources.
+template<typename T>
+struct Decay {typedef typename std::decay<T>::type type;};
+
+template<>
+struct Decay<const char*> {typedef std::string type;};
+
+template<>
+struct Decay<char*> {typedef std::string type;};
+
+template<typename T>
+struct TermType {typedef typename Decay<typename std::decay<T>::type>::type type;};
+
+/**
+ * A conjunction of triples, built with triple(), isA() and \p & .
+ */
+template<typename Vars, typename Params>
+class Pattern {
+public:
+    typedef Vars vars;
+    typedef Params params;
+
+    Pattern() {}
+
+    Pattern(const Term& subject, const Term& predicate, const Term& object) {
+        std::vector<Term> triple;
+        triple.push_back(subject);
+        triple.push_back(predicate);
+        triple.push_back(object);
+        _triples.push_back(triple);
+    }
+
+    template<typename V, typename P>
+    Pattern<typename Concat<Vars, V>::type, typename Concat<Params, P>::type>
+    operator&(const Pattern<V, P>& other) const {
+        Pattern<typename Concat<Vars, V>::type, typename Concat<Params, P>::type> result;
+        result._triples = _triples;
+        result._triples.insert(result._triples.end(), other._triples.begin(), other._triples.end());
+        return result;
+    }
+
+    /**
+     * Returns the triples as partial statements (\p sparql false), or as
+     * SPARQL triple patterns.
+     */
+    std::vector<std::string> statements(bool sparql) const {
+        std::vector<std::string> result;
+
+        for (size_t i = 0 ; i < _triples.size() ; ++i) {
+            std::string stmt;
+            _triples[i][0].write(stmt, sparql);
+            stmt += ' ';
+            _triples[i][1].write(stmt, sparql);
+            stmt += ' ';
+            _triples[i][2].write(stmt, sparql);
+            result.push_back(stmt);
+        }
+
+        return result;
+    }
+
+private:
+    template<typename V, typename P> friend class Pattern;
+
+    std::vector<std::vector<Term> > _triples;
+};
+
+/**
+ * A single triple pattern.
+ */
+template<typename S, typename P, typename O>
+Pattern<typename Concat<typename TermOf<typename TermType<S>::type>::vars,
+                        typename TermOf<typename TermType<P>::type>::vars,
+                        typename TermOf<typename TermType<O>::type>::vars>::type,
+        typename Concat<typename TermOf<typename TermType<S>::type>::params,
+                        typename TermOf<typename TermType<P>::type>::params,
+                        typename TermOf<typename TermType<O>::type>::params>::type>
+triple(const S& subject, const P& predicate, const O& object) {
+    typedef typename TermType<S>::type Subject;
+    typedef typename TermType<P>::type Predicate;
+    typedef typename TermType<O>::type Object;
+
+    static_assert(!std::is_same<Predicate, Class>::value, "a class can not be used as a predicate");
+    static_assert(!std::is_arithmetic<Predicate>::value && !std::is_same<Predicate, Literal>::value,
+                  "a value can not be used as a predicate");
+    static_assert(!std::is_arithmetic<Subject>::value && !std::is_same<Subject, Literal>::value,
+                  "a value can not be used as a subject");
+
+    typedef Pattern<typename Concat<typename TermOf<Subject>::vars,
+                                    typename TermOf<Predicate>::vars,
+                                    typename TermOf<Object>::vars>::type,
+                    typename Concat<typename TermOf<Subject>::params,
+                                    typename TermOf<Predicate>::params,
+                                    typename TermOf<Object>::params>::type> Result;
+
+    return Result(TermOf<Subject>::make(subject),
+                  TermOf<Predicate>::make(predicate),
+                  TermOf<Object>::make(object));
+}
+
+/**
+ * \p subject \p rdf:type \p type .
+ */
+template<typename S, typename C>
+auto isA(const S& subject, const C& type) -> decltype(triple(subject, std::string(), type)) {
+    return triple(subject, std::string("rdf:type"), type);
+}
+
+/**
+ * A \p find request: the resources that match \p Var in the pattern.
+ */
+template<typename Tag, typename Vars, typename Params>
+class Find {
+    static_assert(Contains<Tag, Vars>::value, "the selected variable does not appear in the pattern");
+
+public:
+    explicit Find(const Pattern<Vars, Params>& pattern) {
+        std::vector<std::string> stmts = pattern.statements(false);
+        _statements.insert(stmts.begin(), stmts.end());
+    }
+
+    std::string resource() const {return Tag::name();}
+
+    /**
+     * The partial statements, with a \p ${name} placeholder for each
+     * parameter.
+     */
+    const std::set<std::string>& statements() const {return _statements;}
+
+    PreparedFind prepare(Ontology& onto) const {return onto.prepareFind(resource(), _statements);}
+
+    /**
+     * Executes the request directly. Only for requests without parameters.
+     */
+    void execute(Ontology& onto, std::set<Concept>& result) const {
+        static_assert(std::is_same<Params, TagList<> >::value, "this request has parameters: prepare() it, then bind them");
+        onto.find(resource(), _statements, result);
+    }
+
+private:
+    std::set<std::string> _statements;
+};
+
+template<typename Tag, typename Vars, typename Params>
+Find<Tag, Vars, Params> find(const Var<Tag>&, const Pattern<Vars, Params>& pattern) {
+    return Find<Tag, Vars, Params>(pattern);
+}
+
+/**
+ * A SPARQL query selecting \p Var . Resources without namespace are in the
+ * \p oro: namespace; the ids bound to the parameters must carry their own.
+ */
+template<typename Tag, typename Vars, typename Params>
+class Sparql {
+    static_assert(Contains<Tag, Vars>::value, "the selected variable does not appear in the pattern");
+
+public:
+    explicit Sparql(const Pattern<Vars, Params>& pattern) {
+        std::vector<std::string> stmts = pattern.statements(true);
+
+        _text = "SELECT ?";
+        _text += Tag::name();
+        _text += " WHERE {";
+        for (size_t i = 0 ; i < stmts.size() ; ++i) {
+            if (i > 0) _text += " .";
+            _text += ' ';
+            _text += stmts[i];
+        }
+        _text += " }";
+    }
+
+    std::string variable() const {return Tag::name();}
+
+    const std::string& text() const {return _text;}
+
+    PreparedQuery prepare(Ontology& onto) const {return onto.prepareQuery(variable(), _text);}
+
+    /**
+     * Executes the query directly. Only for queries without parameters.
+     */
+    void execute(Ontology& onto, std::set<std::string>& result) const {
+        static_assert(std::is_same<Params, TagList<> >::value, "this query has parameters: prepare() it, then bind them");
+        onto.query(variable(), _text, result);
+    }
+
+private:
+    std::string _text;
+};
+
+template<typename Tag, typename Vars, typename Params>
+Sparql<Tag, Vars, Params> sparql(const Var<Tag>&, const Pattern<Vars, Params>& pattern) {
+    return Sparql<Tag, Vars, Params>(pattern);
+}
+
+}
+}
+
+/**
+ * Declares a variable \p var of the DSL, written \p ?var in the requests.
+ */
+#define ORO_DSL_VAR(var) \
+    struct var##_oro_dsl_var { static const char* name() {return #var;} }; \
+    const oro::dsl::Var<var##_oro_dsl_var> var = oro::dsl::Var<var##_oro_dsl_var>()
+
+/**
+ * Declares a parameter \p param of the DSL, of the given
+ * PreparedRequest::PlaceholderType (eg PreparedRequest::ID).
+ */
+#define ORO_DSL_PARAM(param, type) \
+    struct param##_oro_dsl_param { \
+        static std::string placeholder() { \
+            return std::string(#param) + ":" + oro::PreparedRequest::typeName(oro::type); \
+        } \
+    }; \
+    const oro::dsl::Param<param##_oro_dsl_param> param = oro::dsl::Param<param##_oro_dsl_param>()
+
+#endif /* QUERY_DSL_H_ */
@@ -0,0 +1,122 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <new>
+#include <algorithm>
+
+#include <boost/cstdint.hpp>
+
+#include "client_metrics.h"
+#include "leaked.h"
+#include "request_arena.h"
+
+using namespace std;
+
+namespace oro {
+
+RequestArena::RequestArena() :
+    _cursor(NULL),
+    _left(0),
+    _depth(0),
+    _allocations(0),
+    _bytes(0),
+    _chunkAllocations(0) {}
+
+RequestArena::~RequestArena() {
+    for (size_t i = 0 ; i < _chunks.size() ; ++i)
+        ::operator delete(_chunks[i].data);
+}
+
+void RequestArena::addChunk(size_t minSize) {
+    // Each chunk at least doubles the capacity of the arena.
+    size_t size = _chunks.empty() ? (size_t) INITIAL_CHUNK : _chunks.back().size * 2;
+    size = max(size, minSize);
+
+    Chunk chunk;
+    chunk.data = static_cast<char*>(::operator new(size));
+    chunk.size = size;
+    _chunks.push_back(chunk);
+
+    _cursor = chunk.data;
+    _left = size;
+    _chunkAllocations++;
+}
+
+void* RequestArena::do_allocate(size_t bytes, size_t alignment) {
+
+    size_t padding = (alignment - reinterpret_cast<boost::uintptr_t>(_cursor) % alignment) % alignment;
+
+    if (_cursor == NULL || padding + bytes > _left) {
+        addChunk(bytes + alignment);
+        padding = (alignment - reinterpret_cast<boost::uintptr_t>(_cursor) % alignment) % alignment;
+    }
+
+    void* p = _cursor + padding;
+    _cursor += padding + bytes;
+    _left -= padding + bytes;
+
+    _allocations++;
+    _bytes += bytes;
+
+    return p;
+}
+
+void RequestArena::release() {
+
+    if (ClientMetrics::enabled() && _allocations > 0)
+        ClientMetrics::recordArena(_allocations, _bytes, _chunkAllocations);
+
+    // Keeps a single chunk, as large as this request needed, so that the
+    // next requests of this size fit in it.
+    if (_chunks.size() > 1 || (!_chunks.empty() && _chunks[0].size > MAX_RETAINED)) {
+        size_t total = 0;
+        for (size_t i = 0 ; i < _chunks.size() ; ++i) {
+            total += _chunks[i].size;
+            ::operator delete(_chunks[i].data);
+        }
+        _chunks.clear();
+
+        Chunk chunk;
+        chunk.size = min(total, (size_t) MAX_RETAINED);
+        chunk.data = static_cast<char*>(::operator new(chunk.size));
+        _chunks.push_back(chunk);
+    }
+
+    if (!_chunks.empty()) {
+        _cursor = _chunks[0].data;
+        _left = _chunks[0].size;
+    }
+
+    _allocations = 0;
+    _bytes = 0;
+    _chunkAllocations = 0;
+}
+
+RequestArena& RequestArena::local() {
+    static leaked_tls<RequestArena> arenas;
+
+    RequestArena* arena = arenas.get();
+
+    if (arena == NULL) {
+        arena = new RequestArena();
+        arenas.reset(arena);
+    }
+
+    return *arena;
+}
+
+}
@@ -0,0 +1,121 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/** \file
+ * This header defines RequestArena, the memory resource from which the
+ * transient buffers of a request (its serialization) are allocated.
+ */
+
+#ifndef REQUEST_ARENA_H_
+#define REQUEST_ARENA_H_
+
+#include <string>
+#include <vector>
+
+#include <boost/container/pmr/memory_resource.hpp>
+#include <boost/container/pmr/polymorphic_allocator.hpp>
+
+namespace oro {
+
+/**
+ * A monotonic memory resource: allocations are carved out of large chunks,
+ * deallocations do nothing, and release() frees everything at once.
+ *
+ * An arena serves one request at a time. Once the request is over,
+ * release() makes the arena ready for the next one. It keeps one chunk as
+ * large as the request needed (up to MAX_RETAINED bytes): requests of a
+ * similar size are then served without calling malloc at all, which also
+ * spares the threads of the client from contending on the allocator.
+ *
+ * When the client metrics are enabled, release() records the allocations
+ * served by the arena, cf ClientStats.
+ *
+ * An arena must only be used by one thread at a time.
+ */
+class RequestArena : public boost::container::pmr::memory_resource {
+public:
+
+    enum {INITIAL_CHUNK = 4096,
+          MAX_RETAINED = 1 << 20};
+
+    RequestArena();
+    ~RequestArena();
+
+    /**
+     * Frees all the memory allocated since the last release.
+     */
+    void release();
+
+    /**
+     * Bytes allocated since the last release.
+     */
+    size_t bytesUsed() const {return _bytes;}
+
+    /**
+     * The arena of the calling thread, for the requests it sends.
+     */
+    static RequestArena& local();
+
+    /**
+     * Releases an arena when it goes out of scope. Scopes may be nested:
+     * only the outermost one releases the arena.
+     */
+    class Scope {
+    public:
+        explicit Scope(RequestArena& arena) : _arena(arena) {++_arena._depth;}
+        ~Scope() {if (--_arena._depth == 0) _arena.release();}
+    private:
+        RequestArena& _arena;
+    };
+
+protected:
+    void* do_allocate(std::size_t bytes, std::size_t alignment);
+    void do_deallocate(void* /*p*/, std::size_t /*bytes*/, std::size_t /*alignment*/) {}
+    bool do_is_equal(const boost::container::pmr::memory_resource& other) const BOOST_NOEXCEPT {return this == &other;}
+
+private:
+    RequestArena(const RequestArena&);
+    RequestArena& operator=(const RequestArena&);
+
+    void addChunk(size_t minSize);
+
+    struct Chunk {
+        char* data;
+        size_t size;
+    };
+
+    std::vector<Chunk> _chunks;
+    char* _cursor;
+    size_t _left;
+    int _depth;
+
+    // Since the last release
+    size_t _allocations;
+    size_t _bytes;
+    size_t _chunkAllocations;
+};
+
+/**
+ * A string whose characters are allocated from a RequestArena.
+ */
+typedef std::basic_string<char,
+                          std::char_traits<char>,
+                          boost::container::pmr::polymorphic_allocator<char> > arena_string;
+
+}
+
+#endif /* REQUEST_ARENA_H_ */
@@ -0,0 +1,137 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/** \file
+ * This header defines the ResponseSlot class, used by the connectors to hand
+ * a server response over from the thread that reads it to the thread that
+ * sent the request.
+ */
+
+#ifndef RESPONSE_SLOT_H_
+#define RESPONSE_SLOT_H_
+
+#include <utility>
+
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "oro_connector.h"
+
+// Number of polls of the slot before the waiting thread goes to sleep.
+#ifndef ORO_SLOT_SPIN
+#define ORO_SLOT_SPIN 2000
+#endif
+
+namespace oro {
+
+/**
+ * Tells the CPU that the calling thread is busy-waiting, between two polls:
+ * the other hyper-thread of the core gets its resources, and the end of the
+ * loop does not flush the pipeline. A no-op on other architectures.
+ */
+inline void spinPause() {
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/**
+ * A single-use completion slot for one server response.
+ *
+ * The thread that sends a request owns the slot and calls wait(); the thread
+ * that reads the response calls fulfill() exactly once. The response is moved
+ * in and out of the slot, never copied.
+ *
+ * The handoff itself is lock-free: the reader publishes the response with an
+ * atomic exchange, and the waiter first polls the slot for a short while.
+ * Only if the response is late does the waiter go to sleep, in which case
+ * the reader wakes up that waiter, and only that one.
+ */
+class ResponseSlot {
+
+public:
+
+    ResponseSlot() : decode(true), bytesReceived(0), parseTime(0), _state(EMPTY) {}
+
+    /**
+     * Stores the response and wakes up the waiting thread, if any.
+     * Must be called only once.
+     */
+    void fulfill(ServerResponse&& response) {
+        _response = std::move(response);
+
+        if (_state.exchange(READY, boost::memory_order_acq_rel) == SLEEPING) {
+            // The waiter only returns once it has re-acquired the lock, so
+            // the slot is not touched anymore after the unlock.
+            boost::lock_guard<boost::mutex> lock(_sleepLock);
+            _state.store(DONE, boost::memory_order_release);
+            _wakeUp.notify_one();
+        }
+    }
+
+    /**
+     * Blocks until the response is available, and returns it.
+     */
+    ServerResponse wait() {
+
+        for (int i = 0 ; i < ORO_SLOT_SPIN ; ++i) {
+            if (_state.load(boost::memory_order_acquire) == READY)
+                return std::move(_response);
+            spinPause();
+        }
+
+        int expected = EMPTY;
+        if (_state.compare_exchange_strong(expected, SLEEPING, boost::memory_order_acq_rel)) {
+            boost::unique_lock<boost::mutex> lock(_sleepLock);
+            while (_state.load(boost::memory_order_acquire) != DONE)
+                _wakeUp.wait(lock);
+        }
+
+        return std::move(_response);
+    }
+
+    /* Whether the reader must deserialize the result, or leave it in
+     * raw_result only. Set by the requester before the slot is queued.
+     */
+    bool decode;
+
+    /* Size of the response and time spent deserializing it, for the client
+     * metrics. Set by the reader before fulfill().
+     */
+    size_t bytesReceived;
+    boost::uint64_t parseTime;
+
+private:
+
+    ResponseSlot(const ResponseSlot&);
+    ResponseSlot& operator=(const ResponseSlot&);
+
+    enum {EMPTY, SLEEPING, READY, DONE};
+
+    boost::atomic<int> _state;
+    ServerResponse _response;
+
+    boost::mutex _sleepLock;
+    boost::condition_variable _wakeUp;
+};
+
+}
+
+#endif /* RESPONSE_SLOT_H_ */
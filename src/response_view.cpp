@@ -0,0 +1,192 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "oro_exceptions.h"
+#include "flat_result.h"
+#include "socket_connector.h"
+#include "response_view.h"
+
+using namespace std;
+using namespace boost;
+
+namespace oro {
+
+namespace {
+
+const char* kindNames[] = {"bool", "int", "double", "string", "list", "map"};
+
+}
+
+ResponseView::ResponseView(ServerResponse res) :
+    _res(std::move(res)),
+    _decoded(_res.raw_result.empty()) {}
+
+ResponseView::Kind ResponseView::classify(const string& raw) {
+
+    if (raw == "true" || raw == "false") return BOOL;
+
+    size_t last = raw.length() - 1;
+
+    if (raw.length() >= 2) {
+        if (raw[0] == '{' && raw[last] == '}') return MAP;
+
+        // cf makeCollec: a list of pairs is a map.
+        if (raw[0] == '[' && raw[last] == ']')
+            return (raw[1] == '[' && raw[last - 1] == ']') ? MAP : LIST;
+    }
+
+    int i;
+    double d;
+    if (SocketConnector::parseInt(raw, i)) return INT;
+    if (SocketConnector::parseDouble(raw, d)) return DOUBLE;
+
+    return STRING;
+}
+
+ResponseView::Kind ResponseView::kind() const {
+    if (!_decoded) return classify(_res.raw_result);
+
+    switch (_res.result.which()) {
+    case 0: return BOOL;
+    case 1: return INT;
+    case 2: return DOUBLE;
+    case 3: return STRING;
+    case 4: return LIST;
+    default: return MAP;
+    }
+}
+
+void ResponseView::check(const ServerResponse& res, const string& errorPrefix) {
+    if (res.status == ServerResponse::ok) return;
+
+    if (res.exception_msg.find(SERVER_NOTFOUND_EXCEPTION) != string::npos)
+        throw ResourceNotFoundOntologyException(errorPrefix + ": the resource does not exist in the current ontology (" + res.error_msg + ").");
+
+    if (res.exception_msg.find(SERVER_QUERYPARSE_EXCEPTION) != string::npos)
+        throw InvalidQueryException(errorPrefix + ": the SPARQL query is invalid (" + res.error_msg + ").");
+
+    throw OntologyServerException(errorPrefix + ": server threw a " + res.exception_msg + " (" + res.error_msg + ").");
+}
+
+void ResponseView::check() const {
+    check(_res, "The request was not successful");
+}
+
+void ResponseView::expect(Kind expected) const {
+    check();
+
+    Kind actual = kind();
+    if (actual != expected && !(expected == DOUBLE && actual == INT))
+        throw OntologyServerException(string("The server returned a ") + kindNames[actual] + ", not a " + kindNames[expected]);
+}
+
+bool ResponseView::asBool() const {
+    expect(BOOL);
+    if (_decoded) return get<bool>(_res.result);
+    return _res.raw_result == "true";
+}
+
+int ResponseView::asInt() const {
+    expect(INT);
+    if (_decoded) return get<int>(_res.result);
+
+    int value = 0;
+    SocketConnector::parseInt(_res.raw_result, value);
+    return value;
+}
+
+double ResponseView::asDouble() const {
+    expect(DOUBLE);
+    if (_decoded) {
+        if (const int* i = get<int>(&_res.result)) return *i;
+        return get<double>(_res.result);
+    }
+
+    double value = 0;
+    SocketConnector::parseDouble(_res.raw_result, value);
+    return value;
+}
+
+string ResponseView::asString() const {
+    expect(STRING);
+    if (_decoded) return get<string>(_res.result);
+    return _res.raw_result;
+}
+
+const set<string>& ResponseView::asSet() const {
+    expect(LIST);
+    return get<set<string> >(result());
+}
+
+const map<string, string>& ResponseView::asMap() const {
+    expect(MAP);
+    return get<map<string, string> >(result());
+}
+
+void ResponseView::asFlatSet(FlatStringSet& result) const {
+    check();
+
+    if (!_decoded) {
+        if (classify(_res.raw_result) == LIST) SocketConnector::makeFlatCollec(_res.raw_result, result);
+        else result.clear();
+    }
+    else if (const set<string>* result_p = get<set<string> >(&_res.result)) {
+        FlatStringSet tmp(*result_p);
+        result.swap(tmp);
+    }
+    else result.clear();
+}
+
+void ResponseView::asFlatMap(FlatStringMap& result) const {
+    check();
+
+    if (!_decoded) {
+        if (classify(_res.raw_result) == MAP) SocketConnector::makeFlatCollec(_res.raw_result, result);
+        else result.clear();
+    }
+    else if (const map<string, string>* result_p = get<map<string, string> >(&_res.result)) {
+        FlatStringMap tmp(*result_p);
+        result.swap(tmp);
+    }
+    else result.clear();
+}
+
+size_t ResponseView::visit(const ResultVisitor& visitor) const {
+    expect(LIST);
+
+    if (!_decoded) return SocketConnector::visitCollection(_res.raw_result, visitor);
+
+    size_t nbVisited = 0;
+    const set<string>& result = get<set<string> >(_res.result);
+
+    for (set<string>::const_iterator it = result.begin() ; it != result.end() ; ++it) {
+        ++nbVisited;
+        if (!visitor(*it)) break;
+    }
+
+    return nbVisited;
+}
+
+const server_return_types& ResponseView::result() const {
+    if (!_decoded) {
+        SocketConnector::deserialize(_res.raw_result, _res.result);
+        _decoded = true;
+    }
+    return _res.result;
+}
+
+}
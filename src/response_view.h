@@ -0,0 +1,154 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/** \file
+ * This header defines ResponseView, a server response that is decoded only
+ * when, and as far as, its value is accessed.
+ */
+
+#ifndef RESPONSE_VIEW_H_
+#define RESPONSE_VIEW_H_
+
+#include <set>
+#include <map>
+#include <string>
+
+#include "oro_connector.h"
+
+namespace oro {
+
+class FlatStringSet;
+class FlatStringMap;
+
+/**
+ * Wraps a response obtained with IConnector::executeUndecoded(): the result
+ * stays in its raw form until it is accessed, and is then decoded as the
+ * accessor requires. Checking the status, or reading a scalar, never builds
+ * a container; a list can be walked, or decoded into a FlatStringSet,
+ * without building a std::set.
+ *
+ * \code
+ * ResponseView res(connector.executeUndecoded("find", args));
+ *
+ * if (!res.ok()) ...
+ * if (res.kind() == ResponseView::LIST) res.visit(collect(inserter(result, result.begin())));
+ * \endcode
+ *
+ * Responses of connectors that always decode (ie without raw result) are
+ * read from their decoded result instead.
+ *
+ * A ResponseView is not thread-safe: the decoded result is cached on first
+ * access.
+ */
+class ResponseView {
+public:
+
+    /**
+     * The type of the result, as deserialize() would decode it. A list of
+     * pairs (like \p [[a,b],[c,d]] ) is a MAP.
+     */
+    enum Kind {BOOL, INT, DOUBLE, STRING, LIST, MAP};
+
+    explicit ResponseView(ServerResponse res);
+
+    /**
+     * Returns the type of a raw result, without decoding it.
+     */
+    static Kind classify(const std::string& raw);
+
+    /**
+     * Throws the exception matching a failed response: a
+     * ResourceNotFoundOntologyException or an InvalidQueryException if the
+     * server says so, an OntologyServerException otherwise. The message
+     * starts with \p errorPrefix . Does nothing if the request succeeded.
+     *
+     * The Ontology methods and the Batch check their responses with it.
+     */
+    static void check(const ServerResponse& res, const std::string& errorPrefix);
+    void check(const std::string& errorPrefix) const {check(_res, errorPrefix);}
+
+    ServerResponse::Status status() const {return _res.status;}
+    bool ok() const {return _res.status == ServerResponse::ok;}
+    const std::string& exceptionMsg() const {return _res.exception_msg;}
+    const std::string& errorMsg() const {return _res.error_msg;}
+
+    /**
+     * The result as sent by the server, or an empty string if the server
+     * sent none or if the connector decoded it.
+     */
+    const std::string& raw() const {return _res.raw_result;}
+
+    Kind kind() const;
+
+    /**
+     * Typed accessors. An INT may be read as a DOUBLE.
+     *
+     * \throw OntologyServerException if the request failed, or if the result
+     * is not of the requested type.
+     */
+    bool asBool() const;
+    int asInt() const;
+    double asDouble() const;
+    std::string asString() const;
+
+    /**
+     * Decodes the result, once, as a std::set (resp. a std::map).
+     *
+     * \throw OntologyServerException if the request failed, or if the result
+     * is not a LIST (resp. a MAP).
+     */
+    const std::set<std::string>& asSet() const;
+    const std::map<std::string, std::string>& asMap() const;
+
+    /**
+     * Decodes a LIST (resp. a MAP) into flat containers. Any other result
+     * gives an empty container.
+     *
+     * \throw OntologyServerException if the request failed.
+     */
+    void asFlatSet(FlatStringSet& result) const;
+    void asFlatMap(FlatStringMap& result) const;
+
+    /**
+     * Hands the elements of a LIST over to \p visitor , until it returns
+     * false.
+     *
+     * \return the number of elements visited.
+     * \throw OntologyServerException if the request failed, or if the
+     * result is not a LIST.
+     */
+    size_t visit(const ResultVisitor& visitor) const;
+
+    /**
+     * Returns the result decoded as by SocketConnector::deserialize(). It is
+     * decoded once, on first access.
+     */
+    const server_return_types& result() const;
+
+private:
+
+    void check() const;
+    void expect(Kind kind) const;
+
+    // Mutable: the result is decoded in place on first access.
+    mutable ServerResponse _res;
+    mutable bool _decoded;
+};
+
+}
+
+#endif /* RESPONSE_VIEW_H_ */
@@ -0,0 +1,471 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <algorithm>
+#include <fstream>
+
+#include <boost/cstdint.hpp>
+#include <boost/crc.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "oro.h"
+#include "oro_exceptions.h"
+#include "snapshot.h"
+
+using namespace std;
+
+namespace oro {
+
+namespace {
+
+const char MAGIC[] = "ORO-SNAP";
+const size_t MAGIC_SIZE = 8;
+const boost::uint32_t VERSION = 2;
+
+// magic, version, CRC
+const size_t HEADER_SIZE = MAGIC_SIZE + 4 + 4;
+
+// Each block: kind, number of items, payload size, payload CRC, payload.
+enum BlockKind {TERMS_BLOCK = 'T', STATEMENTS_BLOCK = 'S', END_BLOCK = 'E'};
+
+const size_t TERMS_PER_BLOCK = 1024;
+const size_t TRIPLES_PER_BLOCK = 4096;
+
+// Literal types take the 3 lowest bits of the encoded object.
+const int TYPE_BITS = 3;
+
+struct EncodedTriple {
+    boost::uint32_t subject;
+    boost::uint32_t predicate;
+    boost::uint64_t object; // (term index << TYPE_BITS) | literal type
+
+    bool operator<(const EncodedTriple& t) const {
+        if (subject != t.subject) return subject < t.subject;
+        if (predicate != t.predicate) return predicate < t.predicate;
+        return object < t.object;
+    }
+
+    bool operator==(const EncodedTriple& t) const {
+        return subject == t.subject && predicate == t.predicate && object == t.object;
+    }
+};
+
+bool lexicographic(const string* a, const string* b) {
+    return *a < *b;
+}
+
+bool sameTerm(const string* a, const string* b) {
+    return *a == *b;
+}
+
+const string& objectTerm(const Triple& t) {
+    return t.isObjectLiteral ? t.literal : t.object.str();
+}
+
+boost::uint32_t crc32(const string& data) {
+    boost::crc_32_type crc;
+    crc.process_bytes(data.data(), data.size());
+    return crc.checksum();
+}
+
+void putFixed(string& out, boost::uint64_t value, size_t bytes) {
+    for (size_t i = 0 ; i < bytes ; ++i) out += (char) ((value >> (8 * i)) & 0xFF);
+}
+
+void putVarint(string& out, boost::uint64_t value) {
+    while (value >= 0x80) {
+        out += (char) ((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += (char) value;
+}
+
+void writeBlock(ostream& out, BlockKind kind, size_t count, const string& payload) {
+    string header;
+    putFixed(header, kind, 1);
+    putFixed(header, count, 4);
+    putFixed(header, payload.size(), 4);
+    putFixed(header, crc32(payload), 4);
+
+    out.write(header.data(), header.size());
+    out.write(payload.data(), payload.size());
+}
+
+void corrupted(const char* reason) {
+    throw OntologyException(string("Invalid snapshot: ") + reason);
+}
+
+// Interns a term the first time it is used as a resource: literals stay out
+// of the symbol table.
+Symbol symbol(const vector<string>& terms, vector<Symbol>& symbols, vector<bool>& interned, size_t i) {
+    if (!interned[i]) {
+        symbols[i] = Symbol(terms[i]);
+        interned[i] = true;
+    }
+    return symbols[i];
+}
+
+/**
+ * Reads the snapshot, checking every bound.
+ */
+class Decoder {
+public:
+    Decoder(boost::string_view data) : _data(data), _pos(0) {}
+
+    boost::uint64_t fixed(size_t bytes) {
+        if (_data.size() - _pos < bytes) corrupted("truncated file");
+
+        boost::uint64_t value = 0;
+        for (size_t i = 0 ; i < bytes ; ++i)
+            value |= (boost::uint64_t) (unsigned char) _data[_pos + i] << (8 * i);
+        _pos += bytes;
+        return value;
+    }
+
+    boost::uint64_t varint() {
+        boost::uint64_t value = 0;
+        for (int shift = 0 ; shift < 64 ; shift += 7) {
+            if (_pos == _data.size()) corrupted("truncated block");
+
+            unsigned char byte = _data[_pos++];
+            value |= (boost::uint64_t) (byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        corrupted("invalid integer");
+        return 0;
+    }
+
+    boost::string_view bytes(size_t size) {
+        if (_data.size() - _pos < size) corrupted("truncated block");
+
+        boost::string_view result = _data.substr(_pos, size);
+        _pos += size;
+        return result;
+    }
+
+    // Reads a block header, checks the CRC of its payload, and returns a
+    // decoder for the payload.
+    Decoder block(int& kind, size_t& count) {
+        kind = fixed(1);
+        count = fixed(4);
+        size_t size = fixed(4);
+        boost::uint32_t crc = fixed(4);
+
+        boost::string_view payload = bytes(size);
+
+        boost::crc_32_type computed;
+        computed.process_bytes(payload.data(), payload.size());
+        if (computed.checksum() != crc) corrupted("checksum mismatch");
+
+        return Decoder(payload);
+    }
+
+    bool done() const {return _pos == _data.size();}
+
+private:
+    boost::string_view _data;
+    size_t _pos;
+};
+
+}
+
+SnapshotWriter::SnapshotWriter(const string& path) :
+    _file(path.c_str(), ios::out | ios::binary | ios::trunc),
+    _out(_file),
+    _path(path),
+    _nbAdded(0),
+    _nbWritten(0),
+    _closed(false)
+{
+    if (!_file) throw OntologyException("Can not open " + path + " for writing");
+    writeHeader();
+}
+
+SnapshotWriter::SnapshotWriter(ostream& out) :
+    _out(out),
+    _nbAdded(0),
+    _nbWritten(0),
+    _closed(false)
+{
+    writeHeader();
+}
+
+void SnapshotWriter::writeHeader() {
+    string header(MAGIC, MAGIC_SIZE);
+    putFixed(header, VERSION, 4);
+    putFixed(header, crc32(header), 4);
+    _out.write(header.data(), header.size());
+}
+
+void SnapshotWriter::check() {
+    if (!_out) throw OntologyException("Error while writing " + (_path.empty() ? string("the snapshot") : _path));
+}
+
+void SnapshotWriter::add(const Statement& stmt) {
+    if (_closed) throw OntologyException("The snapshot is already closed");
+
+    _pending.push_back(PendingStatement());
+    _pending.back().triple = stmt.triple();
+    _pending.back().type = stmt.isObjectLiteral ? stmt.literal_type : NOT_LITERAL;
+    _nbAdded++;
+
+    if (_pending.size() >= TRIPLES_PER_BLOCK) flush();
+}
+
+void SnapshotWriter::flush() {
+
+    if (_pending.empty()) return;
+
+    /**** New terms ****/
+    // The strings of the symbol table and of _pending do not move while the
+    // block is written.
+    vector<const string*> terms;
+
+    for (vector<PendingStatement>::const_iterator it = _pending.begin() ; it != _pending.end() ; ++it) {
+        const string* statementTerms[] = {&it->triple.subject.str(),
+                                          &it->triple.predicate.str(),
+                                          &objectTerm(it->triple)};
+        for (size_t i = 0 ; i < 3 ; ++i)
+            if (_indices.find(*statementTerms[i]) == _indices.end()) terms.push_back(statementTerms[i]);
+    }
+
+    sort(terms.begin(), terms.end(), lexicographic);
+    terms.erase(unique(terms.begin(), terms.end(), sameTerm), terms.end());
+
+    string payload;
+
+    for (size_t first = 0 ; first < terms.size() ; first += TERMS_PER_BLOCK) {
+        size_t last = min(first + TERMS_PER_BLOCK, terms.size());
+        payload.clear();
+
+        const string* previous = NULL;
+        for (size_t i = first ; i < last ; ++i) {
+            const string& term = *terms[i];
+
+            size_t shared = 0;
+            if (previous) {
+                size_t maxShared = min(previous->size(), term.size());
+                while (shared < maxShared && (*previous)[shared] == term[shared]) ++shared;
+            }
+
+            putVarint(payload, shared);
+            putVarint(payload, term.size() - shared);
+            payload.append(term, shared, string::npos);
+
+            previous = &term;
+
+            boost::uint32_t index = _indices.size();
+            _indices[term] = index;
+        }
+
+        writeBlock(_out, TERMS_BLOCK, last - first, payload);
+    }
+
+    /**** Statements ****/
+    vector<EncodedTriple> triples;
+    triples.reserve(_pending.size());
+
+    for (vector<PendingStatement>::const_iterator it = _pending.begin() ; it != _pending.end() ; ++it) {
+        EncodedTriple e;
+        e.subject = _indices[it->triple.subject.str()];
+        e.predicate = _indices[it->triple.predicate.str()];
+        e.object = ((boost::uint64_t) _indices[objectTerm(it->triple)] << TYPE_BITS) | it->type;
+        triples.push_back(e);
+    }
+
+    sort(triples.begin(), triples.end());
+    triples.erase(unique(triples.begin(), triples.end()), triples.end());
+
+    payload.clear();
+
+    EncodedTriple previous = {0, 0, 0};
+    for (size_t i = 0 ; i < triples.size() ; ++i) {
+        const EncodedTriple& t = triples[i];
+
+        // Each field is a delta from the previous triple when the fields
+        // before it are equal, an absolute value otherwise.
+        putVarint(payload, t.subject - previous.subject);
+        if (t.subject != previous.subject) {
+            putVarint(payload, t.predicate);
+            putVarint(payload, t.object);
+        }
+        else {
+            putVarint(payload, t.predicate - previous.predicate);
+            if (t.predicate != previous.predicate) putVarint(payload, t.object);
+            else putVarint(payload, t.object - previous.object);
+        }
+
+        previous = t;
+    }
+
+    writeBlock(_out, STATEMENTS_BLOCK, triples.size(), payload);
+
+    _nbWritten += triples.size();
+    _pending.clear();
+
+    check();
+}
+
+void SnapshotWriter::close() {
+    if (_closed) return;
+
+    flush();
+
+    string payload;
+    putFixed(payload, _indices.size(), 8);
+    putFixed(payload, _nbWritten, 8);
+    writeBlock(_out, END_BLOCK, 0, payload);
+
+    _closed = true;
+
+    if (_file.is_open()) _file.close();
+    else _out.flush();
+
+    check();
+}
+
+bool SnapshotReader::isSnapshot(boost::string_view data) {
+    return data.size() >= MAGIC_SIZE && data.substr(0, MAGIC_SIZE) == boost::string_view(MAGIC, MAGIC_SIZE);
+}
+
+size_t SnapshotReader::read(boost::string_view data,
+                            const boost::function<void(const Statement&)>& callback) {
+
+    if (!isSnapshot(data)) corrupted("not a liboro snapshot");
+
+    Decoder decoder(data);
+
+    /**** Header ****/
+    boost::string_view header = decoder.bytes(HEADER_SIZE - 4);
+    boost::uint32_t headerCrc = decoder.fixed(4);
+
+    boost::crc_32_type crc;
+    crc.process_bytes(header.data(), header.size());
+    if (crc.checksum() != headerCrc) corrupted("checksum mismatch in the header");
+
+    Decoder headerDecoder(header.substr(MAGIC_SIZE));
+    if (headerDecoder.fixed(4) != VERSION) corrupted("unsupported version");
+
+    vector<string> terms;
+    vector<Symbol> symbols;
+    vector<bool> interned;
+
+    Statement stmt(Concept::nothing, Property(Symbol()), Concept::nothing);
+    boost::uint64_t nbRead = 0;
+
+    while (true) {
+        int kind;
+        size_t count;
+        Decoder block = decoder.block(kind, count);
+
+        if (kind == END_BLOCK) {
+            if (block.fixed(8) != terms.size() || block.fixed(8) != nbRead) corrupted("inconsistent end block");
+            if (!block.done() || !decoder.done()) corrupted("unexpected data after the end block");
+            return nbRead;
+        }
+
+        /**** Terms ****/
+        else if (kind == TERMS_BLOCK) {
+            if (count == 0) corrupted("invalid dictionary block");
+
+            string term;
+            for (size_t i = 0 ; i < count ; ++i) {
+                boost::uint64_t shared = block.varint();
+                boost::uint64_t suffix = block.varint();
+                if (shared > term.size()) corrupted("invalid term");
+
+                term.resize(shared);
+                boost::string_view bytes = block.bytes(suffix);
+                term.append(bytes.data(), bytes.size());
+
+                terms.push_back(term);
+            }
+            symbols.resize(terms.size());
+            interned.resize(terms.size(), false);
+
+            if (!block.done()) corrupted("invalid dictionary block");
+        }
+
+        /**** Statements ****/
+        else if (kind == STATEMENTS_BLOCK) {
+            EncodedTriple t = {0, 0, 0};
+            for (size_t i = 0 ; i < count ; ++i) {
+                boost::uint64_t delta = block.varint();
+                if (delta) {
+                    t.subject += delta;
+                    t.predicate = block.varint();
+                    t.object = block.varint();
+                }
+                else {
+                    delta = block.varint();
+                    if (delta) {
+                        t.predicate += delta;
+                        t.object = block.varint();
+                    }
+                    else t.object += block.varint();
+                }
+
+                boost::uint64_t object = t.object >> TYPE_BITS;
+                LiteralType type = (LiteralType) (t.object & ((1 << TYPE_BITS) - 1));
+
+                if (t.subject >= terms.size() || t.predicate >= terms.size() ||
+                    object >= terms.size() || type > TYPED_LITERAL)
+                    corrupted("invalid statement");
+
+                stmt.subject = Concept(symbol(terms, symbols, interned, t.subject));
+                stmt.predicate = Property(symbol(terms, symbols, interned, t.predicate));
+                stmt.literal_type = type;
+
+                if (type == NOT_LITERAL) {
+                    stmt.object = Concept(symbol(terms, symbols, interned, object));
+                    stmt.literal_object.clear();
+                    stmt.isObjectLiteral = false;
+                }
+                else {
+                    stmt.object = Concept::nothing;
+                    stmt.literal_object = terms[object];
+                    stmt.isObjectLiteral = true;
+                }
+
+                callback(stmt);
+            }
+            if (!block.done()) corrupted("invalid statement block");
+
+            nbRead += count;
+        }
+
+        else corrupted("unknown block");
+    }
+}
+
+size_t SnapshotReader::read(const string& path,
+                            const boost::function<void(const Statement&)>& callback) {
+
+    ifstream in(path.c_str(), ios::in | ios::binary);
+    if (!in) throw OntologyException("Can not open " + path);
+
+    in.seekg(0, ios::end);
+    string data(in.tellg(), '\0');
+    in.seekg(0, ios::beg);
+    in.read(&data[0], data.size());
+
+    if (!in) throw OntologyException("Error while reading " + path);
+
+    return read(boost::string_view(data), callback);
+}
+
+}
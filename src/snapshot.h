@@ -0,0 +1,155 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/** \file
+ * This header defines the binary snapshot format of \p liboro , used to save
+ * and restore the content of a knowledge base on the client side.
+ */
+
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/utility/string_view.hpp>
+
+#include "statement_parser.h"
+#include "symbol_table.h"
+
+namespace oro {
+
+class Statement;
+
+/**
+ * Writes statements into a binary snapshot.
+ *
+ * A snapshot holds:
+ * <ul>
+ *  <li>a header: the magic string \p ORO-SNAP and the format version,</li>
+ *  <li>blocks of terms: the terms (subject, predicate, object or literal)
+ *  not written yet, each once, in lexicographic order within the block,
+ *  front-coded,</li>
+ *  <li>blocks of statements, as sorted triples of indices in the terms
+ *  written so far, delta-encoded,</li>
+ *  <li>an end block, with the total number of terms and of statements.</li>
+ * </ul>
+ * Each block is protected by a CRC-32 checksum. Integers are little-endian,
+ * or variable-length (7 bits per byte) within blocks.
+ *
+ * Statements are written by blocks of a few thousands, as they are added:
+ * the writer only keeps the index of the terms in memory. Duplicates within
+ * a block are written once.
+ */
+class SnapshotWriter {
+public:
+
+    /**
+     * Writes a snapshot file.
+     *
+     * \throw OntologyException if the file can not be opened.
+     */
+    explicit SnapshotWriter(const std::string& path);
+
+    /**
+     * Writes a snapshot into \p out, which must outlive the writer.
+     */
+    explicit SnapshotWriter(std::ostream& out);
+
+    /**
+     * Adds a statement. The statements are written once a block is full.
+     *
+     * \throw OntologyException if the snapshot can not be written.
+     */
+    void add(const Statement& stmt);
+
+    /**
+     * Returns the number of statements added so far.
+     */
+    size_t size() const {return _nbAdded;}
+
+    /**
+     * Writes the last block and the end of the snapshot. A snapshot that is
+     * not closed is read as truncated.
+     *
+     * \throw OntologyException if the snapshot can not be written.
+     */
+    void close();
+
+private:
+    SnapshotWriter(const SnapshotWriter&);
+    SnapshotWriter& operator=(const SnapshotWriter&);
+
+    void writeHeader();
+
+    // Writes the new terms and the pending statements.
+    void flush();
+
+    void check();
+
+    struct PendingStatement {
+        Triple triple;
+        LiteralType type;
+    };
+
+    std::ofstream _file;
+    std::ostream& _out;
+    std::string _path;
+
+    std::vector<PendingStatement> _pending;
+    boost::unordered_map<std::string, boost::uint32_t> _indices;
+
+    size_t _nbAdded;
+    boost::uint64_t _nbWritten;
+    bool _closed;
+};
+
+/**
+ * Reads binary snapshots written by SnapshotWriter.
+ */
+class SnapshotReader {
+public:
+
+    /**
+     * Returns whether \p data starts like a snapshot.
+     */
+    static bool isSnapshot(boost::string_view data);
+
+    /**
+     * Decodes a snapshot, calling \p callback for each statement, in order.
+     *
+     * \return the number of statements.
+     * \throw OntologyException if the snapshot is truncated or corrupted.
+     */
+    static size_t read(boost::string_view data,
+                       const boost::function<void(const Statement&)>& callback);
+
+    /**
+     * Same as above, for a snapshot file.
+     */
+    static size_t read(const std::string& path,
+                       const boost::function<void(const Statement&)>& callback);
+};
+
+}
+
+#endif /* SNAPSHOT_H_ */
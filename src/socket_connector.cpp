@@ -18,6 +18,7 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
+#include <netinet/tcp.h>
 
 #include <iostream>
 #include <fstream>
@@ -26,43 +27,24 @@
 #include <time.h>
 
 #include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <cctype>
+#include <limits>
+#include <cmath>
 
 #include <boost/lexical_cast.hpp>
 #include <boost/foreach.hpp>
 #include <boost/tokenizer.hpp>
+#include <boost/scoped_array.hpp>
 //#include <boost/thread/locks.hpp>
 
 #include "oro_exceptions.h"
+#include "client_metrics.h"
+#include "oro_log.h"
+#include "tracer.h"
 #include "socket_connector.h"
 
-#ifdef DEBUG
-
-char logtime[80];
-/** Compute and format a millisecond-accurate timestamp **/
-void timestamp(char* logtime)
-{
-    struct timeval  tv;
-    struct timezone tz;
-    struct tm      *tm;
-
-    gettimeofday(&tv, &tz);
-    tm = localtime(&tv.tv_sec);
-
-    sprintf(logtime, "%04d%02d%02d %d:%02d:%02d.%03d", 
-            tm->tm_year + 1900,
-            tm->tm_mon,
-            tm->tm_mday,
-            tm->tm_hour,
-            tm->tm_min, 
-            tm->tm_sec, 
-            ((int)tv.tv_usec)/1000);
-}
-
-#define TRACE(arg) {timestamp(logtime); std::cerr << "[LIBORO DEBUG] " << logtime << ": " << arg << std::endl;}
-#else
-#define TRACE(arg) sizeof(std::cerr << arg << std::endl)
-#endif
-
 using namespace std;
 using namespace boost;
 
@@ -73,17 +55,35 @@ const char* OK = "ok";
 const char* ERROR = "error";
 const char* EVENT = "event";
 
+/* Same as SocketConnector::cleanValue, on a view. */
+static string_view cleanView(string_view value) {
+
+    size_t startpos = value.find_first_not_of(" \t");
+    size_t endpos = value.find_last_not_of(" \t");
+
+    if (startpos == string_view::npos) return string_view();
 
-class ParametersSerializationHolder; //forward declaration. Defined in socket_connector.h
+    value = value.substr(startpos, endpos - startpos + 1);
+
+    if ((value[0] == '"' && value[value.length()-1] == '"') || (value[0] == '\'' && value[value.length()-1] == '\''))
+        value = value.substr(1, value.length() - 2);
+
+    return value;
+}
+
+static string_view view(const arena_string& str) {
+    return string_view(str.data(), str.length());
+}
 
 SocketConnector::SocketConnector(const string& hostname, const string& port) :
     host(hostname),
-    port(port) {
+    port(port),
+    _pendingRequests(128),
+    _readPos(0) {
 
     _isConnected = false;
-    responseToSkip = 0;
-
-    waitingAnAnswer = false;
+    _readBytes = 0;
+    _parseTime = 0;
 
     oro_connect(hostname, port);
 
@@ -91,20 +91,20 @@ SocketConnector::SocketConnector(const string& hostname, const string& port) :
 
     _goOn = true;
 
-    thread _eventListnerThrd(bind(&SocketConnector::run, this));
+    _eventListnerThrd = boost::thread(boost::bind(&SocketConnector::run, this));
 }
 
 SocketConnector::~SocketConnector(){
-    cerr << "Waiting for all pending request to finish...";
+    ORO_LOG_DEBUG("Waiting for all pending request to finish...");
     if (_isConnected) {
         execute("stats", true); //permit to wait for all previous call to be completed
     }
 
-    cerr << "done.\nStopping the event listener...";
+    ORO_LOG_DEBUG("Stopping the event listener...");
      _goOn = false;
     _eventListnerThrd.join();
 
-    cerr << "done.\nClosing socket connection...";
+    ORO_LOG_DEBUG("Closing socket connection...");
 
     if (_isConnected) {
         execute("close", false); //don't wait for ack, it won't come!
@@ -112,7 +112,7 @@ SocketConnector::~SocketConnector(){
         _isConnected = false;
     }
 
-    cerr << "done." << endl;
+    ORO_LOG_DEBUG("Socket connection closed.");
 }
 
 bool SocketConnector::isConnected() {return _isConnected;}
@@ -143,7 +143,7 @@ void SocketConnector::oro_connect(const string& hostname, const string& port){
     /* resolve host address */
     if ((err = getaddrinfo(hostname.c_str(), port.c_str(), NULL, &haddr)) != 0) {
         close(sockfd);
-        cerr << "Error: " << gai_strerror(err) << endl;
+        ORO_LOG_ERROR("Error: {}", gai_strerror(err));
         throw ConnectorException("Cannot get remote host addresses");
     }
 
@@ -165,6 +165,10 @@ void SocketConnector::oro_connect(const string& hostname, const string& port){
         throw ConnectorException("Error while connecting to \"" + hostname + "\". Wrong port ? Abandon.");
     }
 
+    // Drop whatever was left from a previous connection
+    _readBuffer.clear();
+    _readPos = 0;
+
     _isConnected = true;
 
 }
@@ -180,68 +184,282 @@ void SocketConnector::reconnect(const string& host, const string& port) {
 ServerResponse SocketConnector::execute(const string& query,
                                         const vector<server_param_types>& vect_args,
                                         bool waitForAck){
+    return request(query, vect_args, waitForAck, true);
+}
 
-        if (!_isConnected) {
-            throw ConnectorException("Not connected to oro-server!");
-        }
+ServerResponse SocketConnector::executeUndecoded(const string& query,
+                                                 const vector<server_param_types>& vect_args,
+                                                 bool waitForAck){
+    return request(query, vect_args, waitForAck, false);
+}
+
+ServerResponse SocketConnector::request(const string& query,
+                                        const vector<server_param_types>& vect_args,
+                                        bool waitForAck,
+                                        bool decode){
 
-        ParametersSerializationHolder paramsHolder;
+    RequestMetrics requestMetrics;
+    boost::uint64_t start = ClientMetrics::enabled() ? ClientMetrics::now() : 0;
 
-        if (!waitForAck) responseToSkip++;
+    TraceSpan requestSpan("connector", query);
+    TraceSpan serializeSpan("connector", "serialize");
 
-        string completeQuery = query + MSG_SEPARATOR ;
+    // The request is serialized in the arena of the calling thread, released
+    // once the request is over.
+    RequestArena& arena = RequestArena::local();
+    RequestArena::Scope arenaScope(arena);
 
-        if (!vect_args.empty()) {
-            //serialization of arguments
-            std::for_each(
-                        vect_args.begin(),
-                        vect_args.end(),
-                        boost::apply_visitor(paramsHolder)
-                        );
+    BasicParametersSerializationHolder<arena_string> paramsHolder(&arena);
 
-            completeQuery +=  paramsHolder.getArgs();
-            paramsHolder.reset();
-        }
+    arena_string completeQuery(&arena);
+    completeQuery.append(query.data(), query.length());
+    completeQuery += MSG_SEPARATOR;
 
-        TRACE("Sending " << completeQuery << " to oro-server");
+    if (!vect_args.empty()) {
+        //serialization of arguments
+        std::for_each(
+                    vect_args.begin(),
+                    vect_args.end(),
+                    boost::apply_visitor(paramsHolder)
+                    );
 
-        completeQuery += MSG_FINALIZER;
+        completeQuery += paramsHolder.getArgs();
+        paramsHolder.reset();
+    }
 
-        // Now send it on its way
-        write(sockfd,completeQuery.c_str(),completeQuery.length());
+    ORO_LOG_DEBUG("Sending {} to oro-server", view(completeQuery));
 
-        waitingAnAnswer = true;
+    completeQuery += MSG_FINALIZER;
 
+    serializeSpan.end();
 
+    return transmit(query, view(completeQuery), waitForAck, requestMetrics, start, decode);
+}
 
-        //inbound_requests.push(query_type(query, vect_args));
-    //}
+ServerResponse SocketConnector::executeSerialized(const string& query,
+                                                  const string& serialized_args,
+                                                  bool waitForAck){
 
-    ServerResponse res;
+    RequestMetrics requestMetrics;
+    boost::uint64_t start = ClientMetrics::enabled() ? ClientMetrics::now() : 0;
+
+    TraceSpan requestSpan("connector", query);
+    TraceSpan serializeSpan("connector", "serialize");
+
+    RequestArena& arena = RequestArena::local();
+    RequestArena::Scope arenaScope(arena);
+
+    arena_string completeQuery(&arena);
+    completeQuery.reserve(query.length() + serialized_args.length() + strlen(MSG_SEPARATOR) + strlen(MSG_FINALIZER));
+    completeQuery.append(query.data(), query.length());
+    completeQuery += MSG_SEPARATOR;
+    completeQuery.append(serialized_args.data(), serialized_args.length());
+
+    ORO_LOG_DEBUG("Sending {} to oro-server", view(completeQuery));
+
+    completeQuery += MSG_FINALIZER;
+
+    serializeSpan.end();
+
+    return transmit(query, view(completeQuery), waitForAck, requestMetrics, start);
+}
+
+void SocketConnector::executeBatch(const vector<query_type>& queries,
+                                   vector<ServerResponse>& responses){
+
+    responses.clear();
+    if (queries.empty()) return;
+
+    size_t nbQueries = queries.size();
+
+    bool metrics = ClientMetrics::enabled();
+    boost::uint64_t start = metrics ? ClientMetrics::now() : 0;
+    boost::uint64_t serialized = 0, queued = 0;
+
+    TraceSpan batchSpan("connector", "batch");
+    TraceSpan serializeSpan("connector", "serialize");
+
+    RequestArena& arena = RequestArena::local();
+    RequestArena::Scope arenaScope(arena);
+
+    // All the requests, back to back, and the size of each of them.
+    arena_string message(&arena);
+    vector<size_t> sizes;
+    BasicParametersSerializationHolder<arena_string> paramsHolder(&arena);
+
+    for (size_t i = 0 ; i < nbQueries ; ++i) {
+        size_t before = message.length();
+
+        message.append(queries[i].first.data(), queries[i].first.length());
+        message += MSG_SEPARATOR;
+
+        std::for_each(
+                    queries[i].second.begin(),
+                    queries[i].second.end(),
+                    boost::apply_visitor(paramsHolder)
+                    );
+
+        message += paramsHolder.getArgs();
+        paramsHolder.reset();
+
+        message += MSG_FINALIZER;
+        sizes.push_back(message.length() - before);
+    }
+
+    ORO_LOG_DEBUG("Sending a batch of {} requests to oro-server", nbQueries);
+
+    serializeSpan.end();
+
+    if (metrics) serialized = ClientMetrics::now();
+
+    scoped_array<ResponseSlot> slots(new ResponseSlot[nbQueries]);
+    bool sent = false;
 
     {
-        boost::unique_lock<boost::mutex> lock(outbound_lock);
+        TraceSpan queueSpan("connector", "queue");
+        boost::lock_guard<boost::mutex> lock(_writeLock);
+        queueSpan.end();
+
+        if (metrics) queued = ClientMetrics::now();
 
-        if(waitForAck) {
-            while (outbound_results.empty()) {
-                gotResult.wait(lock);
+        if (_isConnected) {
+            for (size_t i = 0 ; i < nbQueries ; ++i)
+                _pendingRequests.push(&slots[i]);
 
+            TraceSpan writeSpan("connector", "write");
+
+            if (!send_all(view(message))) {
+                _isConnected = false;
+                shutdown(sockfd, SHUT_RDWR); // wakes up the listener if it is reading
+                close(sockfd);
             }
 
-            res = outbound_results.front();
-            outbound_results.pop();
+            sent = true;
+        }
+    }
+
+    if (!sent) {
+        ServerResponse res;
+        res.status = ServerResponse::failed;
+        res.exception_msg = CONNECTOR_EXCEPTION;
+        res.error_msg = "Not connected to oro-server!";
+        responses.assign(nbQueries, res);
+        return;
+    }
 
-            TRACE("Popping a result for query " << query);
+    if (!_isConnected) {
+        failPendingRequests("Error while sending a request to the server! Connection closed by the server?");
+    }
 
-            if (res.status == ServerResponse::failed && res.exception_msg == CONNECTOR_EXCEPTION)
-            {
-                throw ConnectorException(res.error_msg);
-            }
+    TraceSpan waitSpan("connector", "wait");
+
+    responses.reserve(nbQueries);
+
+    for (size_t i = 0 ; i < nbQueries ; ++i) {
+        responses.push_back(slots[i].wait());
+
+        if (metrics) {
+            // The serialization and the wait for the connection are shared
+            // by the whole batch.
+            boost::uint64_t now = ClientMetrics::now();
+            RequestMetrics requestMetrics;
+            requestMetrics.serializeTime = (serialized - start) / nbQueries;
+            requestMetrics.queueTime = queued - serialized;
+            requestMetrics.waitTime = now - queued - slots[i].parseTime;
+            requestMetrics.parseTime = slots[i].parseTime;
+            requestMetrics.bytesSent = sizes[i];
+            requestMetrics.bytesReceived = slots[i].bytesReceived;
+            requestMetrics.failed = (responses[i].status == ServerResponse::failed);
+            ClientMetrics::recordRequest(queries[i].first, requestMetrics, now - start);
         }
-        else
+    }
+}
+
+ServerResponse SocketConnector::transmit(const string& query,
+                                         string_view completeQuery,
+                                         bool waitForAck,
+                                         RequestMetrics& requestMetrics,
+                                         boost::uint64_t start,
+                                         bool decode){
+
+    bool metrics = (start != 0);
+    boost::uint64_t step = start;
+
+    if (metrics) {
+        boost::uint64_t now = ClientMetrics::now();
+        requestMetrics.serializeTime = now - step;
+        requestMetrics.bytesSent = completeQuery.length();
+        step = now;
+    }
+
+    ResponseSlot slot;
+    slot.decode = decode;
+
+    {
+        TraceSpan queueSpan("connector", "queue");
+        boost::lock_guard<boost::mutex> lock(_writeLock);
+        queueSpan.end();
+
+        if (metrics) {
+            boost::uint64_t now = ClientMetrics::now();
+            requestMetrics.queueTime = now - step;
+            step = now;
+        }
+
+        if (!_isConnected) {
+            throw ConnectorException("Not connected to oro-server!");
+        }
+
+        // The slot must be queued before the request is sent: the response
+        // may well be read before 'write' returns.
+        _pendingRequests.push(waitForAck ? &slot : NULL);
+
+        TraceSpan writeSpan("connector", "write");
+
+        if (!send_all(completeQuery)) {
+            _isConnected = false;
+            shutdown(sockfd, SHUT_RDWR); // wakes up the listener if it is reading
+            close(sockfd);
+        }
+    }
+
+    if (!_isConnected) {
+        // The listener won't read anything anymore: fail our own request,
+        // and any other one still waiting.
+        failPendingRequests("Error while sending a request to the server! Connection closed by the server?");
+    }
+
+    ServerResponse res;
+
+    if(waitForAck) {
+        TraceSpan waitSpan("connector", "wait");
+        res = slot.wait();
+        waitSpan.end();
+
+        ORO_LOG_DEBUG("Got the result for query {}", query);
+
+        if (metrics) {
+            boost::uint64_t now = ClientMetrics::now();
+            requestMetrics.waitTime = now - step - slot.parseTime;
+            requestMetrics.parseTime = slot.parseTime;
+            requestMetrics.bytesReceived = slot.bytesReceived;
+            requestMetrics.failed = (res.status == ServerResponse::failed);
+            ClientMetrics::recordRequest(query, requestMetrics, now - start);
+        }
+
+        if (res.status == ServerResponse::failed && res.exception_msg == CONNECTOR_EXCEPTION)
         {
-            // we don't wait for acknowledgement!
-            res.status = ServerResponse::ok;
+            throw ConnectorException(res.error_msg);
+        }
+    }
+    else
+    {
+        // we don't wait for acknowledgement!
+        res.status = ServerResponse::ok;
+
+        if (metrics) {
+            requestMetrics.failed = !_isConnected;
+            ClientMetrics::recordRequest(query, requestMetrics, ClientMetrics::now() - start);
         }
     }
 
@@ -270,209 +488,221 @@ void SocketConnector::setEventCallback(
 }
 
 
-// based on libtclserv_client socket implementation
-ssize_t SocketConnector::readline(int fd, char *bufp, size_t maxlen)
+bool SocketConnector::send_all(string_view msg)
 {
-    int nb_to_read = 0;
-    char* p;
-    size_t size_request;
-    ssize_t err;
+    size_t sent = 0;
 
-    // get the len of the buffer
-    if (ioctl(fd, FIONREAD, &nb_to_read) == -1)
-    {
-        cerr << "failed to call ioctl FIONREAD" << endl;
-        return -1;
-    }
+    while (sent < msg.length()) {
+        // MSG_NOSIGNAL: a closed socket must not kill the process with SIGPIPE
+        ssize_t err = send(sockfd, msg.data() + sent, msg.length() - sent, MSG_NOSIGNAL);
 
-    if (nb_to_read >= maxlen) {
-        cerr << "Buffer too small!" << endl;
-        return -1;
-    }
+        if (err < 0) {
+            if (errno == EINTR) continue;
+            ORO_LOG_ERROR("Failed to send: {}", strerror(errno));
+            return false;
+        }
 
-    err = recv(fd, bufp, nb_to_read, MSG_PEEK);
-    if (err == -1) {
-        cerr << "Failed to recv" << endl;
-        return -1;
+        sent += err;
     }
 
-    if (err == 0) {
-        close(fd);
-        fd = -1;
-        cerr << "Peer deconnection" << endl;
-        return -1;
+    return true;
+}
+
+bool SocketConnector::hasBufferedLine() const
+{
+    return _readBuffer.find('\n', _readPos) != string::npos;
+}
+
+bool SocketConnector::readLine(string_view& line)
+{
+    char chunk[4096];
+
+    // Everything was read: the previous line is not needed anymore.
+    if (_readPos == _readBuffer.length()) {
+        _readBuffer.clear();
+        _readPos = 0;
     }
 
-    // look if we can find a rqst
-    p = strstr(bufp, "\n");
-    if (p == NULL) { assert(0); } // XXX WTF here
-    size_request = p - bufp + 1;
+    while (true) {
+        size_t eol = _readBuffer.find('\n', _readPos);
+
+        if (eol != string::npos) {
+            line = string_view(_readBuffer.data() + _readPos, eol - _readPos);
+            _readPos = eol + 1;
+            return true;
+        }
 
-    err = recv(fd, bufp, size_request, 0);
-    bufp[err] = 0;
-    return err;
+        // Incomplete line: keep what we have, and wait for more.
+        _readBuffer.erase(0, _readPos);
+        _readPos = 0;
 
+        ssize_t err = recv(sockfd, chunk, sizeof(chunk), 0);
+
+        if (err < 0) {
+            if (errno == EINTR) continue;
+            ORO_LOG_ERROR("Failed to recv: {}", strerror(errno));
+            return false;
+        }
+
+        if (err == 0) {
+            ORO_LOG_WARNING("Peer deconnection");
+            return false;
+        }
+
+        _readBuffer.append(chunk, err);
+
+#ifdef TCP_QUICKACK
+        // Acknowledge at once: a server that sends pipelined responses with
+        // Nagle's algorithm would otherwise hold the next ones until our
+        // delayed ACK (40ms). Linux resets this flag after each use.
+        int quickAck = 1;
+        setsockopt(sockfd, IPPROTO_TCP, TCP_QUICKACK, &quickAck, sizeof(quickAck));
+#endif
+    }
 }
 
-void SocketConnector::read(ServerResponse& res, bool only_events){
+bool SocketConnector::read(ServerResponse& res){
 
-    vector<string> rawResult;
+    // The fields are copied out of the read buffer straight into the
+    // strings that are handed over to the requester (or to the event
+    // callback): no intermediate copy.
+    string rawResult[3];
+    size_t nbFields = 0;
 
-    size_t MAX_LINE_LENGTH = 2048;
+    // The finalizer, without its trailing "\n"
+    const string_view finalizer(MSG_FINALIZER, strlen(MSG_FINALIZER) - 1);
 
+    string_view field;
 
-    char buffer[MAX_LINE_LENGTH];
+    _readBytes = 0;
+    _parseTime = 0;
 
-    while (true) {
+    TraceSpan readSpan("listener", "readLine");
 
-        ssize_t bytes_read = readline(sockfd, buffer, MAX_LINE_LENGTH);
+    while (true) {
 
-        if (bytes_read < 0) {
+        if (!readLine(field)) {
             res.status = ServerResponse::failed;
             res.exception_msg = CONNECTOR_EXCEPTION;
             res.error_msg = "Error reading from the server! Connection closed by the server?";
-            _isConnected = false;
-            close(sockfd);
-            return;
+            return true;
         }
 
-        if (bytes_read == 0) {
-            res.status = ServerResponse::failed;
-            res.exception_msg = CONNECTOR_EXCEPTION;
-            res.error_msg = "Error reading from the server! Empty string";
-            return;
-        }
+        _readBytes += field.length() + 1;
 
-        string field(buffer);
-
-        if (field == MSG_FINALIZER)
+        if (field == finalizer)
             break;
 
-        field = field.substr(0, field.length() - 1); //remove the trailing "\n"
-        rawResult.push_back(cleanValue(field));
-    }
-
-
-    /*
-        while (rawResult == NULL && delay < ORO_MAX_DELAY){
-            msleep(50);
-            delay += 50;
-            rawResult = in.read(false);
+        // Extra fields are only counted: the message is invalid anyway.
+        if (nbFields < 3) {
+            field = cleanView(field);
+            rawResult[nbFields].assign(field.data(), field.length());
         }
+        nbFields++;
+    }
 
-        //The server doesn't answer quickly enough.
-        if (rawResult == NULL){
-            res.status = ServerResponse::failed;
-            res.error_msg = "oro-server read timeout.";
-            return;
-        }
-*/
+    readSpan.end();
 
-    if (rawResult.size() < 1 || rawResult.size() > 3) {
+    if (nbFields < 1 || nbFields > 3) {
         res.status = ServerResponse::failed;
         res.exception_msg = "OntologyServerException";
         res.error_msg = "Internal server error! Wrong number of result element returned by the server.";
-        return;
+        return true;
     }
 
     if (rawResult[0] == EVENT){
 
-        if (_evtCallback != NULL) {
-            TRACE("Got an event! " << rawResult[1] << " (content: " << rawResult[2] << ")");
+        if (_evtCallback != NULL && nbFields == 3) {
+            ORO_LOG_DEBUG("Got an event! {} (content: {})", rawResult[1], rawResult[2]);
             server_return_types raw_event_content;
 
+            bool metrics = ClientMetrics::enabled();
+            boost::uint64_t start = metrics ? ClientMetrics::now() : 0;
+
             try {
+                TraceSpan span("listener", "deserialize event");
                 deserialize(rawResult[2], raw_event_content);
             } catch (OntologyServerException ose) {
-                res.status = ServerResponse::failed;
-                res.exception_msg = "OntologyServerException";
-                res.error_msg = ose.what();
-                return;
+                ORO_LOG_WARNING("Discarding an event with invalid content: {}", ose.what());
+                return false;
             }
 
-            _evtCallback(rawResult[1], raw_event_content);
-        }
-
+            if (metrics) ClientMetrics::recordEvent(_readBytes, ClientMetrics::now() - start);
 
-        if (!only_events) {
-            //We were waiting for a response, and we got an event interleaved. Fine.
-            //Fetch the next message, hoping it's the right one.
-            // -> it means we never go back to run() until we read an answer to our inital request.
-            read(res, only_events);
+            _evtCallback(rawResult[1], raw_event_content);
         }
 
-        return;
+        return false;
     }
 
     //  here => rawResult[0] == ERROR | OK
 
-    //we were waiting for events but got another message!!
-    //Maybe we are in waitForAck = false
-    if (only_events) {
-        if (responseToSkip == 0) {
-            cerr << "Got an OK or ERROR message from the server that was unexpected!" << endl;
-            cerr << "Content was: " << rawResult[1] << endl;
-            cerr << "Discarding it." << endl;
-        }
-        else {
-            responseToSkip--;
-        }
-
-        res.status = ServerResponse::discarded;
-        return;
-    }
-
-    // We are still waiting for response of previous request whose response were
-    // skipped (waitForAck = false)
-    if (responseToSkip != 0) {
-        responseToSkip--;
-        res.status = ServerResponse::discarded;
-        return;
-    }
-
-    if (rawResult[0] == ERROR){
+    if (rawResult[0] == ERROR && nbFields == 3){
         res.status = ServerResponse::failed;
-        res.exception_msg = rawResult[1];
-        res.error_msg = rawResult[2];
-        return;
+        res.exception_msg.swap(rawResult[1]);
+        res.error_msg.swap(rawResult[2]);
+        return true;
     }
 
     if (rawResult[0] == OK){
 
         res.status = ServerResponse::ok;
 
-        if (rawResult.size() == 1) {
+        if (nbFields == 1) {
             res.result = true;
-            return;
+            return true;
         }
 
-        res.raw_result = rawResult[1];
-        try {
-            deserialize(rawResult[1], res.result);
-        } catch (OntologyServerException ose) {
-            res.status = ServerResponse::failed;
-            res.exception_msg = "OntologyServerException";
-            res.error_msg = ose.what();
-            return;
-        }
+        // Deserialized by the listener once it knows whether the requester
+        // wants it.
+        res.raw_result.swap(rawResult[1]);
 
-        return;
+        return true;
     }
 
     // here => received malformed content from the server!
     res.status = ServerResponse::failed;
     res.exception_msg = "OntologyServerException";
     res.error_msg = "Internal server error! The server answer should start with \"ok\", \"event\" or \"error\"";
+    return true;
+}
+
+void SocketConnector::connectionLost(const string& reason) {
+    {
+        boost::lock_guard<boost::mutex> lock(_writeLock);
+
+        if (_isConnected) {
+            _isConnected = false;
+            close(sockfd);
+        }
+    }
+
+    // No request can be queued anymore: the pending ones will never get
+    // their response.
+    failPendingRequests(reason);
+}
+
+void SocketConnector::failPendingRequests(const string& reason) {
+    ResponseSlot* slot;
 
+    while (_pendingRequests.pop(slot)) {
+        if (slot == NULL) continue;
 
+        ServerResponse res;
+        res.status = ServerResponse::failed;
+        res.exception_msg = CONNECTOR_EXCEPTION;
+        res.error_msg = reason;
+
+        slot->fulfill(std::move(res));
+    }
 }
 
 void SocketConnector::run(){
 
-    ServerResponse res;
+    Tracer::nameThread("oro listener");
 
     if (!_isConnected) {
-        cerr << "Can not start liboro socket connector thread if not connected." << endl;
+        ORO_LOG_ERROR("Can not start liboro socket connector thread if not connected.");
     }
 
     while (_goOn) {
@@ -482,50 +712,73 @@ void SocketConnector::run(){
             continue;
         }
 
-        FD_ZERO(&sockets_to_read);
-        FD_SET(sockfd, &sockets_to_read);
+        // A complete message may already be waiting in the read buffer.
+        if (!hasBufferedLine()) {
+            FD_ZERO(&sockets_to_read);
+            FD_SET(sockfd, &sockets_to_read);
 
-        int retval = select(sockfd + 1, &sockets_to_read, NULL, NULL, NULL);
+            // Regularly wake up to check whether we must stop.
+            struct timeval timeout;
+            timeout.tv_sec = 0;
+            timeout.tv_usec = 100000;
 
-	if (retval == -1) {
-	    TRACE("During 'select': " << strerror(errno) << ". Continuing.");
-	    // The error is likely EINTR (signal caught). We can safely continue.
-	    continue;
-	}
-	else if (retval) { //got something to read from the server!
+            int retval = select(sockfd + 1, &sockets_to_read, NULL, NULL, &timeout);
 
-	    if (waitingAnAnswer) {
+            if (retval == -1) {
+                ORO_LOG_DEBUG("During 'select': {}. Continuing.", strerror(errno));
+                // The error is likely EINTR (signal caught). We can safely continue.
+                continue;
+            }
 
-		read(res, false); //will block until an answer is read.
+            if (retval == 0) continue; // timeout
+        }
 
-		if (res.status != ServerResponse::discarded)
-		{
-            boost::lock_guard<boost::mutex> lock(outbound_lock);
+        //got something to read from the server!
+        ServerResponse res;
 
-		    outbound_results.push(res);
-		    gotResult.notify_all();
+        if (!read(res)) continue; // it was an event.
 
-		    waitingAnAnswer = false;
-		}
+        if (res.status == ServerResponse::failed && res.exception_msg == CONNECTOR_EXCEPTION) {
+            connectionLost(res.error_msg);
+            continue;
+        }
 
-	    }
-	    else {
-		read(res, true); //Read AND process events
+        ResponseSlot* slot;
 
-		//If an error occurs while dealing with events (like server
-		//deconnection), export it in the server responses queue.
-		//At the next request, the client while be informed of the
-		//disconnection.
-		if(res.status == ServerResponse::failed)
-		{
-            boost::lock_guard<boost::mutex> lock(outbound_lock);
+        if (!_pendingRequests.pop(slot)) {
+            ORO_LOG_WARNING("Got an OK or ERROR message from the server that was unexpected! Content was: {}. Discarding it.",
+                            res.status == ServerResponse::ok ? res.raw_result : res.error_msg);
+            continue;
+        }
 
-		    outbound_results.push(res);
-		    gotResult.notify_all();
-		}
-	    }
-	}
+        // A NULL slot: the request was sent without waiting for ack. Nobody
+        // reads the response: it is not decoded.
+        if (slot != NULL) {
+            if (res.status == ServerResponse::ok && !res.raw_result.empty() && slot->decode)
+                decodeResult(res);
+
+            slot->bytesReceived = _readBytes;
+            slot->parseTime = _parseTime;
+            slot->fulfill(std::move(res));
+        }
+    }
+}
+
+void SocketConnector::decodeResult(ServerResponse& res) {
+
+    bool metrics = ClientMetrics::enabled();
+    boost::uint64_t start = metrics ? ClientMetrics::now() : 0;
+
+    try {
+        TraceSpan span("listener", "deserialize");
+        deserialize(res.raw_result, res.result);
+    } catch (OntologyServerException ose) {
+        res.status = ServerResponse::failed;
+        res.exception_msg = "OntologyServerException";
+        res.error_msg = ose.what();
     }
+
+    if (metrics) _parseTime = ClientMetrics::now() - start;
 }
 
 /** Remove leading and trailing quotes and whitespace if needed.
@@ -535,93 +788,101 @@ void SocketConnector::run(){
  */
 string& SocketConnector::cleanValue(string& value) {
 
-    //First, trim the string
+    //First, trim the string (in place: no reallocation)
     size_t startpos = value.find_first_not_of(" \t");
     size_t endpos = value.find_last_not_of(" \t");
 
     if(( string::npos == startpos ) || ( string::npos == endpos))
     {
-        value = "";
+        value.clear();
+    }
+    else {
+        value.erase(endpos + 1);
+        value.erase(0, startpos);
     }
-    else
-        value = value.substr( startpos, endpos-startpos+1 );
 
     //Then remove quotes
-    if ((value[0] == '"' && value[value.length()-1] == '"') || (value[0] == '\'' && value[value.length()-1] == '\''))
-        value = value.substr(1, value.length() - 2);
+    if ((value[0] == '"' && value[value.length()-1] == '"') || (value[0] == '\'' && value[value.length()-1] == '\'')) {
+        value.erase(value.length() - 1);
+        value.erase(0, 1);
+    }
 
     return value;
 }
 
-/** Protect a string by escaping the quotes and surrounding the string with quotes.
- *
- * @param value
- * @return
- */
-string SocketConnector::protectValue(const string& value) {
+/* Escapes the quotes of 'value' and appends it, quoted, to 'msg'. */
+template <typename String>
+static void appendProtected(const string& value, String& msg) {
 
-    //Escape double quotes
-    size_t start_pos = 0;
+    msg += '"';
 
-    string res(value);
+    size_t start_pos = 0;
 
     while(true) {
-        size_t pos = res.find("\"", start_pos);
-        if( string::npos != pos ) {
-            start_pos = pos + 2;
-            res.replace(pos, 1, "\\\"");
-        }
-        else break;
+        size_t pos = value.find('"', start_pos);
+        if( string::npos == pos ) break;
+
+        msg.append(value.data() + start_pos, pos - start_pos);
+        msg.append("\\\"", 2);
+        start_pos = pos + 1;
     }
 
-    //Quote the whole string
-    res = "\"" + res + "\"";
+    msg.append(value.data() + start_pos, value.length() - start_pos);
+    msg += '"';
+}
+
+/** Protect a string by escaping the quotes and surrounding the string with quotes.
+ *
+ * @param value
+ * @return
+ */
+string SocketConnector::protectValue(const string& value) {
+    string res;
+    res.reserve(value.length() + 2);
+    appendProtected(value, res);
     return res;
 }
 
-void SocketConnector::serializeVector(const vector<string>& data, string& msg)
+template <typename Collection, typename String>
+static void serializeList(const Collection& data, String& msg)
 {
     if (data.size() == 0) {msg += "[]"; return;}
 
-    vector<string>::const_iterator itData = data.begin();
-
-    msg += "[";
-
-    for( ; itData != data.end() ; ++itData)
-        msg += protectValue(*itData) + ",";
+    msg += '[';
 
-    msg = msg.substr(0, msg.length() - 1) + "]";
+    for(typename Collection::const_iterator itData = data.begin() ; itData != data.end() ; ++itData) {
+        appendProtected(*itData, msg);
+        msg += ',';
+    }
 
+    msg[msg.length() - 1] = ']';
 }
 
-void SocketConnector::serializeSet(const set<string>& data, string& msg)
+template <typename String>
+static void serializeMapTo(const map<string, string>& data, String& msg)
 {
-    if (data.size() == 0) {msg += "[]"; return;}
-
-    set<string>::const_iterator itData = data.begin();
-
-    msg += "[";
+    if (data.size() == 0) {msg += "{}"; return;}
 
-    for( ; itData != data.end() ; ++itData)
-        msg += protectValue(*itData) + ",";
+    msg += '{';
 
-    msg = msg.substr(0, msg.length() - 1) + "]";
+    for(map<string, string>::const_iterator itData = data.begin() ; itData != data.end() ; ++itData) {
+        appendProtected(itData->first, msg);
+        msg += ':';
+        appendProtected(itData->second, msg);
+        msg += ',';
+    }
 
+    msg[msg.length() - 1] = '}';
 }
 
-void SocketConnector::serializeMap(const map<string, string>& data, string& msg)
-{
-    if (data.size() == 0) {msg += "{}"; return;}
-
-    map<string, string>::const_iterator itData = data.begin();
+void SocketConnector::serializeVector(const vector<string>& data, string& msg) {serializeList(data, msg);}
+void SocketConnector::serializeVector(const vector<string>& data, arena_string& msg) {serializeList(data, msg);}
 
-    msg += "{";
+void SocketConnector::serializeSet(const set<string>& data, string& msg) {serializeList(data, msg);}
+void SocketConnector::serializeSet(const set<string>& data, arena_string& msg) {serializeList(data, msg);}
 
-    for( ; itData != data.end() ; ++itData)
-        msg += protectValue((*itData).first) + ":" + protectValue((*itData).second) + ",";
-
-    msg = msg.substr(0, msg.length() - 1) + "}";
-}
+void SocketConnector::serializeMap(const map<string, string>& data, string& msg) {serializeMapTo(data, msg);}
+void SocketConnector::serializeMap(const map<string, string>& data, arena_string& msg) {serializeMapTo(data, msg);}
 
 void SocketConnector::deserialize(const string& msg, server_return_types& result)
 {
@@ -638,21 +899,62 @@ void SocketConnector::deserialize(const string& msg, server_return_types& result
         result = makeCollec(msg);
     }
     else {
-        try {
-            result = lexical_cast<int>(msg);
-            return;
-        } catch (const bad_lexical_cast &e) {}
+        int i;
+        double d;
 
-        try {
-            result = lexical_cast<double>(msg);
-            return;
-        } catch (const bad_lexical_cast &e) {}
-
-        result = msg;
+        if (parseInt(msg, i)) result = i;
+        else if (parseDouble(msg, d)) result = d;
+        else result = msg;
     }
 
 }
 
+/* Only what lexical_cast accepts: no leading whitespace, no trailing
+ * characters, no overflow. strto* also accept leading spaces, and strtod
+ * hexadecimal numbers.
+ */
+bool SocketConnector::parseInt(const string& msg, int& value) {
+
+    const char* str = msg.c_str();
+    size_t first = (str[0] == '-' || str[0] == '+') ? 1 : 0;
+
+    if (!isdigit((unsigned char) str[first])) return false;
+
+    char* end;
+    errno = 0;
+    long l = strtol(str, &end, 10);
+
+    if (*end != '\0' || end != str + msg.length() || errno == ERANGE ||
+        l < numeric_limits<int>::min() || l > numeric_limits<int>::max())
+        return false;
+
+    value = l;
+    return true;
+}
+
+bool SocketConnector::parseDouble(const string& msg, double& value) {
+
+    const char* str = msg.c_str();
+    size_t first = (str[0] == '-' || str[0] == '+') ? 1 : 0;
+
+    if (!isdigit((unsigned char) str[first]) && str[first] != '.' &&
+        tolower(str[first]) != 'i' && tolower(str[first]) != 'n') return false; // inf, nan
+
+    if (msg.find_first_of("xX") != string::npos) return false;
+
+    char* end;
+    errno = 0;
+    double d = strtod(str, &end);
+
+    // Like lexical_cast, underflows are fine, overflows are not.
+    if (*end != '\0' || end != str + msg.length() ||
+        (errno == ERANGE && (d == HUGE_VAL || d == -HUGE_VAL)))
+        return false;
+
+    value = d;
+    return true;
+}
+
 server_return_types SocketConnector::makeCollec(const string& msg) {
 
     bool isValidMap = true;
@@ -748,6 +1050,162 @@ server_return_types SocketConnector::makeCollec(const string& msg) {
 
 }
 
+/* Splits the content of a collection, between 'begin' and 'end' (the
+ * brackets excluded), with the same rules as the escaped_list_separator
+ * used by makeCollec: ',' separates, '"' quotes, '\\' escapes. 'callback'
+ * gets each raw token, and returns false to stop. Returns the number of
+ * tokens passed to the callback.
+ */
+template<typename Callback>
+static size_t tokenize(const string& msg, size_t begin, size_t end, Callback callback) {
+
+    size_t nbTokens = 0;
+    bool inQuote = false;
+    string token;
+
+    if (begin == end) return 0; // "[]"
+
+    for (size_t i = begin ; i <= end ; ++i) {
+
+        if (i == end || (msg[i] == ',' && !inQuote)) {
+            ++nbTokens;
+            if (!callback(token)) break;
+            token.clear();
+            continue;
+        }
+
+        char c = msg[i];
+
+        if (c == '\\') {
+            if (++i == end) throw OntologyServerException("INTERNAL ERROR! The server answered an invalid collection (cannot end with an escape)!");
+
+            switch (msg[i]) {
+            case 'n': token += '\n'; break;
+            case '\\': case '"': case ',': token += msg[i]; break;
+            default: throw OntologyServerException("INTERNAL ERROR! The server answered an invalid collection (unknown escape sequence)!");
+            }
+        }
+        else if (c == '"') inQuote = !inQuote;
+        else token += c;
+    }
+
+    return nbTokens;
+}
+
+namespace {
+
+struct VisitToken {
+    const ResultVisitor& visitor;
+
+    VisitToken(const ResultVisitor& visitor) : visitor(visitor) {}
+
+    bool operator()(string& token) const {return visitor(SocketConnector::cleanValue(token));}
+};
+
+struct InsertToken {
+    FlatStringSet& result;
+
+    InsertToken(FlatStringSet& result) : result(result) {}
+
+    bool operator()(const string& token) const {
+        result.insert(cleanView(token));
+        return true;
+    }
+};
+
+/* '{a:b, c:d}' */
+struct InsertMapToken {
+    FlatStringMap& result;
+
+    InsertMapToken(FlatStringMap& result) : result(result) {}
+
+    bool operator()(const string& token) const {
+        size_t found = token.find(':');
+        if (found == string::npos) throw OntologyServerException("INTERNAL ERROR! The server answered an invalid map (missing semicolon)!");
+
+        string_view t(token);
+        result.insert(cleanView(t.substr(0, found)), cleanView(t.substr(found + 1)));
+        return true;
+    }
+};
+
+/* '[[a,b], [c,d]]' */
+struct InsertPairToken {
+    FlatStringMap& result;
+    bool& key;
+    string& lastKey;
+
+    InsertPairToken(FlatStringMap& result, bool& key, string& lastKey) : result(result), key(key), lastKey(lastKey) {}
+
+    bool operator()(const string& token) const {
+        string_view c = cleanView(token);
+
+        if (key) {
+            if (c.empty() || c[0] != '[') throw OntologyServerException("INTERNAL ERROR! The server answered an invalid collection!");
+            lastKey = cleanView(c.substr(1)).to_string();
+        }
+        else {
+            if (c.empty() || c[c.length()-1] != ']') throw OntologyServerException("INTERNAL ERROR! The server answered an invalid collection!");
+            result.insert(lastKey, cleanView(c.substr(0, c.length() - 1)));
+        }
+
+        key = !key;
+        return true;
+    }
+};
+
+}
+
+size_t SocketConnector::visitCollection(const string& msg, const ResultVisitor& visitor) {
+
+    if (msg.length() < 2 || msg[0] != '[' || msg[msg.length() - 1] != ']')
+        throw OntologyServerException("INTERNAL ERROR! The server answered an invalid collection!");
+
+    return tokenize(msg, 1, msg.length() - 1, VisitToken(visitor));
+}
+
+void SocketConnector::makeFlatCollec(const string& msg, FlatStringSet& result) {
+
+    if (msg.length() < 2 || msg[0] != '[' || msg[msg.length() - 1] != ']')
+        throw OntologyServerException("INTERNAL ERROR! The server answered an invalid collection!");
+
+    result.clear();
+    // The elements take at most the size of the message.
+    result.reserve(count(msg.begin(), msg.end(), ',') + 1, msg.length());
+
+    tokenize(msg, 1, msg.length() - 1, InsertToken(result));
+
+    result.sort();
+}
+
+void SocketConnector::makeFlatCollec(const string& msg, FlatStringMap& result) {
+
+    result.clear();
+
+    if (msg.length() >= 2 && msg[0] == '{' && msg[msg.length() - 1] == '}') {
+        result.reserve(count(msg.begin(), msg.end(), ',') + 1, msg.length());
+        tokenize(msg, 1, msg.length() - 1, InsertMapToken(result));
+    }
+    else if (msg.length() >= 2 && msg[0] == '[' && msg[msg.length() - 1] == ']') {
+        // Like makeCollec, a list is a map only if it is a list of pairs.
+        // An empty list is an empty map.
+        if (msg.length() > 2) {
+            if (!(msg[1] == '[' && msg[msg.length() - 2] == ']'))
+                throw OntologyServerException("INTERNAL ERROR! The server answered a list where a map was expected!");
+
+            bool key = true;
+            string lastKey;
+            result.reserve(count(msg.begin(), msg.end(), ',') / 2 + 1, msg.length());
+            tokenize(msg, 1, msg.length() - 1, InsertPairToken(result, key, lastKey));
+
+            if (!key) result.insert(lastKey, string_view()); // a key without value
+        }
+    }
+    else throw OntologyServerException("INTERNAL ERROR! The server answered an invalid collection!");
+
+    result.sort();
+}
+
 int SocketConnector::msleep(unsigned long milisec)
 {
     struct timespec req={0};
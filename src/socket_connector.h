@@ -34,14 +34,18 @@
 #include <netinet/in.h>
 #include <netdb.h>
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 
-#include <queue>
-
 #include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/lockfree/queue.hpp>
 
 #include "oro_connector.h"
+#include "flat_result.h"
+#include "request_arena.h"
+#include "response_slot.h"
 #include "oro.h"
 
 
@@ -107,6 +111,17 @@ public:
                 bool waitForAck);
     ServerResponse execute(const std::string& query,
                 bool waitForAck);
+    ServerResponse executeUndecoded(const std::string& query,
+                const std::vector<server_param_types>& args,
+                bool waitForAck = true);
+    ServerResponse executeSerialized(const std::string& query,
+                const std::string& serialized_args,
+                bool waitForAck);
+
+    /* Pipelines the queries: they are sent in one write, then the responses
+     * are awaited in order. */
+    void executeBatch(const std::vector<query_type>& queries,
+                std::vector<ServerResponse>& responses);
 
     void setEventCallback(
                 void (*evtCallback)(const std::string& event_id,
@@ -117,19 +132,86 @@ public:
     static void serializeVector(const std::vector<std::string>& data, std::string& msg);
     static void serializeMap(const std::map<std::string, std::string>& data, std::string& msg);
 
+    /* Same, into a string allocated from a RequestArena. */
+    static void serializeSet(const std::set<std::string>& data, arena_string& msg);
+    static void serializeVector(const std::vector<std::string>& data, arena_string& msg);
+    static void serializeMap(const std::map<std::string, std::string>& data, arena_string& msg);
+
+    /* Codec of the protocol. Public and stateless, so that they can be
+     * tested and benchmarked without server (cf oro-microbench). */
+    static std::string protectValue(const std::string& value);
+    static std::string& cleanValue(std::string& value);
+
+    static void deserialize(const std::string& msg, server_return_types& result);
+
+    /* Number parsing of deserialize(): same results as lexical_cast, but
+     * returns false instead of throwing when msg is not a number. */
+    static bool parseInt(const std::string& msg, int& value);
+    static bool parseDouble(const std::string& msg, double& value);
+    static server_return_types makeCollec(const std::string& msg);
+
+    /**
+     * Decodes a list (like \p ["a","b"] ) incrementally: \p visitor is
+     * called with each element, in order, as it is decoded, until it
+     * returns false. Returns the number of elements visited.
+     *
+     * The elements are the ones makeCollec() would return, without building
+     * the set (duplicates, if any, are visited).
+     *
+     * \throw OntologyServerException if \p msg is not a list.
+     */
+    static size_t visitCollection(const std::string& msg, const ResultVisitor& visitor);
+
+    /**
+     * Like makeCollec(), but decodes a list (resp. a map, or a list of
+     * pairs) into a FlatStringSet (resp. a FlatStringMap): one allocation
+     * for all the characters, instead of one node per element.
+     *
+     * \throw OntologyServerException if \p msg is not a collection of the
+     * expected kind.
+     */
+    static void makeFlatCollec(const std::string& msg, FlatStringSet& result);
+    static void makeFlatCollec(const std::string& msg, FlatStringMap& result);
+
 private:
 
     void oro_connect(const std::string& hostname, const std::string& port);
 
-    static std::string protectValue(const std::string& value);
-    static std::string& cleanValue(std::string& value);
+    /* Serializes and sends a request. If 'decode' is false, the result is
+     * left in raw_result.
+     */
+    ServerResponse request(const std::string& query,
+                           const std::vector<server_param_types>& args,
+                           bool waitForAck,
+                           bool decode);
+
+    /* Sends a complete, serialized request and waits for its response if
+     * 'waitForAck' is true. 'metrics' holds the serialization time and size,
+     * and 'start' the start time of the request, if metrics are enabled.
+     */
+    ServerResponse transmit(const std::string& query,
+                            boost::string_view completeQuery,
+                            bool waitForAck,
+                            RequestMetrics& metrics,
+                            boost::uint64_t start,
+                            bool decode = true);
+
+    /* Deserializes raw_result into result. */
+    void decodeResult(ServerResponse& res);
+
+    /* Reads one complete message from the server. Events are handed over to
+     * the event callback and false is returned. Otherwise, the response
+     * is stored in 'response' and true is returned.
+     */
+    bool read(ServerResponse& response);
 
-    void deserialize(const std::string& msg, server_return_types& result);
-    server_return_types makeCollec(const std::string& msg);
-    void read(ServerResponse& response, bool only_events);
+    // Size and deserialization time of the last message read, for the
+    // client metrics.
+    size_t _readBytes;
+    boost::uint64_t _parseTime;
     int msleep(unsigned long milisec);
 
-    bool _isConnected;
+    boost::atomic<bool> _isConnected;
 
     // Socket related fields
     std::string host;
@@ -141,56 +223,77 @@ private:
 
     // main() of the 'select' thread.
     void run();
-    volatile bool _goOn;
+    boost::atomic<bool> _goOn;
     boost::thread _eventListnerThrd;
 
-    boost::condition_variable gotResult;
-    std::queue<ServerResponse> outbound_results;
-    boost::mutex    outbound_lock;
+    /* Sends the whole buffer on the socket. Returns false if the socket
+     * is not writable anymore.
+     */
+    bool send_all(boost::string_view msg);
 
-    ssize_t readline(int fd, char *bufp, size_t maxlen);
+    /* Marks the connector as disconnected and fails every pending request
+     * with a ConnectorException carrying 'reason'.
+     */
+    void connectionLost(const std::string& reason);
+    void failPendingRequests(const std::string& reason);
+
+    /* Completion slots of the requests sent to the server, in the order
+     * they were sent (the server answers in the same order). A NULL slot
+     * stands for a request whose response must be discarded (waitForAck =
+     * false). Slots are pushed under _writeLock, together with the write of
+     * the request itself, and popped by the listener thread.
+     */
+    boost::lockfree::queue<ResponseSlot*> _pendingRequests;
+    boost::mutex _writeLock;
+
+    /* Buffered reading of the socket, line by line. Only used by the
+     * listener thread. 'line' points into the read buffer: it is valid
+     * until the next call.
+     */
+    bool readLine(boost::string_view& line);
+    bool hasBufferedLine() const;
+    std::string _readBuffer;
+    size_t _readPos;
 
     // The event callback
     void (*_evtCallback)(const std::string& event_id,
                         const server_return_types& raw_event_content);
-
-    /* When not waiting for acknoledgements (waitForAck = false), we need to
-     * track how many responses must be skipped to avoid returning a answer to
-     * discard (for instance, a 'ok' after a 'add') as the response to keep
-     * (for instance, a 'ok' after a 'checkConsistency').
-     */
-    int responseToSkip;
-
-    bool waitingAnAnswer;
 };
 
 /**
  * Visitor for serialization of the method parameters before querying
- * the ontology server.
+ * the ontology server. \p String is either std::string or arena_string.
  */
-class ParametersSerializationHolder : public boost::static_visitor<>
+template <typename String>
+class BasicParametersSerializationHolder : public boost::static_visitor<>
 {
-    std::string args;
+    String args;
 
 public:
 
-    ParametersSerializationHolder() : args("") {}
+    explicit BasicParametersSerializationHolder(const typename String::allocator_type& alloc = typename String::allocator_type()) :
+        args(alloc) {}
 
     void operator()(const int i)
     {
-        args += i;
+        char number[16];
+        args.append(number, snprintf(number, sizeof(number), "%d", i));
         args += MSG_SEPARATOR;
     }
 
     void operator()(const double i)
     {
-        args += i;
+        char number[32];
+        args.append(number, snprintf(number, sizeof(number), "%.17g", i));
         args += MSG_SEPARATOR;
     }
 
     void operator()(const std::string & str)
     {
-        args += "\"" + str + "\"" + MSG_SEPARATOR;
+        args += '"';
+        args.append(str.data(), str.length());
+        args += '"';
+        args += MSG_SEPARATOR;
     }
 
     void operator()(const bool b)
@@ -217,13 +320,15 @@ public:
         args += MSG_SEPARATOR;
     }
 
-    std::string& getArgs() {return args;}
+    String& getArgs() {return args;}
 
-    void reset() {args = "";}
+    void reset() {args.clear();}
 
 
 };
 
+typedef BasicParametersSerializationHolder<std::string> ParametersSerializationHolder;
+
 }
 
 #endif /* SOCKET_CONNECTOR_H_ */
@@ -18,83 +18,57 @@
 #include <string>
 #include <sstream>
 
+#include <boost/thread/tss.hpp>
+
 #include "oro.h"
+#include "oro_exceptions.h"
+#include "statement_parser.h"
 
 using namespace std;
 
 namespace oro {
-	Statement::Statement(const Concept& _subject, const Property& _predicate, const Concept& _object):subject(_subject), predicate(_predicate), object(_object), literal_object(""), isObjectLiteral(false){
-		_originalStmt = subject.to_string() + " " + predicate.to_string() + " " + (isObjectLiteral?literal_object:object.to_string());
+
+	// Parsers keep a scratch buffer between two statements: one per thread.
+	static StatementParser& parser() {
+		static boost::thread_specific_ptr<StatementParser> local;
+		if (!local.get()) local.reset(new StatementParser());
+		return *local;
 	}
+
+	Statement::Statement(const Concept& _subject, const Property& _predicate, const Concept& _object):subject(_subject), predicate(_predicate), object(_object), isObjectLiteral(false), literal_type(NOT_LITERAL){}
 	
-	Statement::Statement(const Concept& _subject, const Property& _predicate, const std::string& _object):subject(_subject), predicate(_predicate), object(Concept::nothing), literal_object(_object), isObjectLiteral(true){
-		_originalStmt = subject.to_string() + " " + predicate.to_string() + " " + (isObjectLiteral?literal_object:object.to_string());
+	Statement::Statement(const Concept& _subject, const Property& _predicate, const std::string& _object):subject(_subject), predicate(_predicate), object(Concept::nothing), isObjectLiteral(true), literal_type(STRING_LITERAL){
+		
+		LiteralType type;
+
+		if (!parser().parseObject(_object, literal_object, type)) {
+			literal_object = _object;
+			return;
+		}
+
+		literal_type = type;
+		if (type == NOT_LITERAL) {
+			object = Concept(Symbol(literal_object));
+			literal_object.clear();
+			isObjectLiteral = false;
+		}
 	}
+
+	Statement::Statement(const Concept& _subject, const Property& _predicate, const std::string& literal, LiteralType type):subject(_subject), predicate(_predicate), object(Concept::nothing), literal_object(literal), isObjectLiteral(true), literal_type(type){}
 		
 	/**
 	 * Creates a new statement from its literal string representation.
 	*/
-	Statement::Statement(const string& stmt) : subject(""), predicate(""), object(""), literal_object(""), isObjectLiteral(false){
-		
-		_originalStmt = stmt;
-				
-		string buf = stmt; // Have a buffer string
-		//stringstream ss(stmt); // Insert the string into a stream
-
-		vector<string> tokens; // Create vector to hold the parts of the statement
-
-		//while (ss >> buf) //nice and efficient to tokenize a string on the spaces
-		//	tokens.push_back(buf);
-		
-		//pas super élégant...
-		int cutAt;
+	Statement::Statement(const string& stmt) : subject(Symbol()), predicate(Symbol()), object(Symbol()), isObjectLiteral(false), literal_type(NOT_LITERAL){
 		
-		//First token (subject)
-		cutAt = buf.find(" ");
-		tokens.push_back(buf.substr(0,cutAt));
-		
-		//if(tokens[0].find(":") != string::npos){
-		//	tokens[0] = tokens[0].substr(tokens[0].find(":"));
-		//}
-		
-		subject = Concept(tokens[0]);
-		
-		//Second token (predicate)
-		buf = buf.substr(cutAt+1);
-		cutAt = buf.find(" ");
-		tokens.push_back(buf.substr(0,cutAt));
-		
-		predicate = Property(tokens[1]);
-				
-		//Third token (object)
-		buf = buf.substr(cutAt+1);
-		tokens.push_back(buf);
-		
-		//Problem: the third argument may contain spaces
-		
-		//if (tokens.size() != 3)
-		//	throw InvalidStatementException();
-		
-		//TODO Ugly... if the last token contains a semicolon or the predicate is subClassOf, we assume it's a concept. Need to be improved!
-		if(tokens[2].find(":") != string::npos){
-			tokens[2] = tokens[2].substr(tokens[2].find(":"));
-			object = Concept(tokens[2]);
-			isObjectLiteral = false;
-		}
-		else if (tokens[1] == "rdfs:subClassOf") {
-			object = Concept(tokens[2]);
-			isObjectLiteral = false;
-		}
-		else {
-			object = tokens[2];
-			isObjectLiteral = true;
-		}
+		if (!parser().parse(stmt, *this))
+			throw InvalidStatementException("Invalid statement <" + stmt + ">: " + parser().lastError());
 	}
+
 	/**
 	 * Returns a computer-friendly string describing the statement.
 	 */
 	std::string Statement::to_string() const {
-		//return subject.to_string() + " " + predicate.to_string() + " " + (isObjectLiteral?literal_object:object.to_string());
-		return _originalStmt;
+		return triple().to_string();
 	}
 }
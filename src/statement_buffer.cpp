@@ -0,0 +1,153 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <utility>
+
+#include "statement_buffer.h"
+
+using namespace std;
+
+namespace oro {
+
+void StatementBuffer::insert(Action action, const Triple& stmt) {
+    boost::unordered_map<Triple, size_t>::const_iterator it = _ids.find(stmt);
+
+    if (it != _ids.end()) apply(action, it->second);
+    else apply(action, newId(stmt));
+}
+
+size_t StatementBuffer::newId(const Triple& stmt) {
+    size_t id;
+
+    if (!_freeIds.empty()) {
+        id = _freeIds.back();
+        _freeIds.pop_back();
+    }
+    else {
+        id = _entries.size();
+        _entries.push_back(Entry());
+    }
+
+    Entry& entry = _entries[id];
+    entry.stmt = stmt;
+    entry.pos[ADD] = entry.pos[REMOVE] = entry.pos[UPDATE] = npos;
+
+    _ids.insert(make_pair(stmt, id));
+
+    return id;
+}
+
+void StatementBuffer::apply(Action action, size_t id) {
+
+    Entry& entry = _entries[id];
+
+    //An "add" cancels a pending "remove" of this very statement, and conversely.
+    if (action != UPDATE) {
+        Action opposite = (action == ADD) ? REMOVE : ADD;
+
+        if (entry.pos[opposite] != npos) {
+            erase(opposite, id);
+            return;
+        }
+    }
+
+    if (entry.pos[action] == npos) {
+        entry.pos[action] = _lists[action].size();
+        _lists[action].push_back(id);
+    }
+}
+
+void StatementBuffer::erase(Action action, size_t id) {
+
+    Entry& entry = _entries[id];
+    vector<size_t>& list = _lists[action];
+
+    //Swap with the last statement of the list, then pop.
+    size_t last = list.back();
+    list[entry.pos[action]] = last;
+    _entries[last].pos[action] = entry.pos[action];
+    list.pop_back();
+
+    entry.pos[action] = npos;
+
+    //Statement not used anymore? release its id.
+    if (entry.pos[ADD] == npos && entry.pos[REMOVE] == npos && entry.pos[UPDATE] == npos) {
+        _ids.erase(entry.stmt);
+        _freeIds.push_back(id);
+    }
+}
+
+void StatementBuffer::merge(StatementBuffer& other) {
+
+    if (empty()) {
+        swap(other);
+        return;
+    }
+
+    static const Action actions[] = {ADD, REMOVE, UPDATE};
+
+    //Add and remove lists of a buffer never share a statement, hence
+    //merging action by action is the same as replaying the insertions.
+    for (int a = 0 ; a < 3 ; ++a) {
+        const vector<size_t>& list = other._lists[actions[a]];
+
+        for (size_t i = 0 ; i < list.size() ; ++i)
+            insert(actions[a], other._entries[list[i]].stmt);
+    }
+
+    other.clear();
+}
+
+void StatementBuffer::drain(vector<string>& toAdd,
+                            vector<string>& toRemove,
+                            vector<string>& toUpdate) {
+
+    vector<string>* outputs[] = {&toAdd, &toRemove, &toUpdate};
+
+    for (int a = ADD ; a <= UPDATE ; ++a) {
+        const vector<size_t>& list = _lists[a];
+        vector<string>& output = *outputs[a];
+
+        output.reserve(output.size() + list.size());
+
+        for (size_t i = 0 ; i < list.size() ; ++i) {
+            output.push_back(string());
+            _entries[list[i]].stmt.appendTo(output.back());
+        }
+    }
+
+    clear();
+}
+
+void StatementBuffer::clear() {
+    _ids.clear();
+    _entries.clear();
+    _freeIds.clear();
+    _lists[ADD].clear();
+    _lists[REMOVE].clear();
+    _lists[UPDATE].clear();
+}
+
+void StatementBuffer::swap(StatementBuffer& other) {
+    _entries.swap(other._entries);
+    _freeIds.swap(other._freeIds);
+    _ids.swap(other._ids);
+    for (int a = ADD ; a <= UPDATE ; ++a)
+        _lists[a].swap(other._lists[a]);
+}
+
+}
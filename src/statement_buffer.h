@@ -0,0 +1,114 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/** \file
+ * This header defines the StatementBuffer class, which holds the statements
+ * added, removed or updated while the ontology is bufferizing.
+ */
+
+#ifndef STATEMENT_BUFFER_H_
+#define STATEMENT_BUFFER_H_
+
+#include <string>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+#include "symbol_table.h"
+
+namespace oro {
+
+/**
+ * The pending actions on statements, until they are sent to the server.
+ *
+ * Each statement is stored once, as a Triple of symbols, whatever the
+ * number of actions it is involved in, and is looked up by hash. The strings
+ * sent to the server are only built by drain(). Like the former buffer of
+ * Ontology::flush(), an ADD cancels a pending REMOVE of the same statement
+ * (and conversely), in constant time. UPDATEs never cancel anything.
+ *
+ * The buffer is not thread-safe.
+ */
+class StatementBuffer {
+
+public:
+
+    enum Action {ADD = 0, REMOVE, UPDATE};
+
+    StatementBuffer() {}
+
+    /**
+     * Records an action on a statement.
+     */
+    void insert(Action action, const Triple& stmt);
+
+    /**
+     * Moves all the pending actions of \p other into this buffer, as if they
+     * had been inserted one after the other. \p other is left empty.
+     */
+    void merge(StatementBuffer& other);
+
+    /**
+     * Serializes the pending statements, one vector per action, and clears
+     * the buffer.
+     */
+    void drain(std::vector<std::string>& toAdd,
+               std::vector<std::string>& toRemove,
+               std::vector<std::string>& toUpdate);
+
+    /** Number of statements pending for \p action. */
+    size_t size(Action action) const {return _lists[action].size();}
+
+    /** Total number of pending actions. */
+    size_t size() const {return _lists[ADD].size() + _lists[REMOVE].size() + _lists[UPDATE].size();}
+
+    bool empty() const {return _lists[ADD].empty() && _lists[REMOVE].empty() && _lists[UPDATE].empty();}
+
+    void clear();
+
+    void swap(StatementBuffer& other);
+
+private:
+
+    StatementBuffer(const StatementBuffer&);
+    StatementBuffer& operator=(const StatementBuffer&);
+
+    static const size_t npos = static_cast<size_t>(-1);
+
+    struct Entry {
+        Triple stmt;
+
+        // Position of the statement in each of the action lists, or npos.
+        size_t pos[3];
+    };
+
+    size_t newId(const Triple& stmt);
+    void apply(Action action, size_t id);
+    void erase(Action action, size_t id);
+
+    std::vector<Entry> _entries;
+    std::vector<size_t> _freeIds;
+
+    boost::unordered_map<Triple, size_t> _ids;
+
+    // Ids of the statements pending for each action.
+    std::vector<size_t> _lists[3];
+};
+
+}
+
+#endif /* STATEMENT_BUFFER_H_ */
@@ -0,0 +1,457 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstring>
+
+#include <boost/bind.hpp>
+
+#include "oro.h"
+#include "oro_exceptions.h"
+#include "statement_parser.h"
+
+using namespace std;
+
+namespace oro {
+
+namespace {
+
+struct Namespace {
+    const char* prefix;
+    const char* uri;
+};
+
+// Well-known namespaces, whose full URIs are turned into prefixed names.
+const Namespace NAMESPACES[] = {
+    {"rdf", "http://www.w3.org/1999/02/22-rdf-syntax-ns#"},
+    {"rdfs", "http://www.w3.org/2000/01/rdf-schema#"},
+    {"owl", "http://www.w3.org/2002/07/owl#"},
+    {"xsd", "http://www.w3.org/2001/XMLSchema#"},
+    {"oro", "http://kb.openrobots.org#"}
+};
+
+const size_t NB_NAMESPACES = sizeof(NAMESPACES) / sizeof(Namespace);
+
+inline bool isSpace(char c) {return c == ' ' || c == '\t' || c == '\r' || c == '\n';}
+inline bool isDigit(char c) {return c >= '0' && c <= '9';}
+
+void skipSpaces(boost::string_view text, size_t& pos) {
+    while (pos < text.size() && isSpace(text[pos])) ++pos;
+}
+
+// Recognizes the short forms of numbers and booleans.
+LiteralType shortFormType(boost::string_view token) {
+
+    if (token == "true" || token == "false") return BOOLEAN_LITERAL;
+
+    size_t i = 0;
+    if (i < token.size() && (token[i] == '+' || token[i] == '-')) ++i;
+
+    size_t intDigits = 0, fracDigits = 0;
+    while (i < token.size() && isDigit(token[i])) {++i; ++intDigits;}
+
+    bool dot = false;
+    if (i < token.size() && token[i] == '.') {
+        dot = true;
+        ++i;
+        while (i < token.size() && isDigit(token[i])) {++i; ++fracDigits;}
+    }
+
+    if (intDigits + fracDigits == 0) return NOT_LITERAL;
+
+    if (i == token.size()) {
+        if (!dot) return INTEGER_LITERAL;
+        return fracDigits > 0 ? DECIMAL_LITERAL : NOT_LITERAL;
+    }
+
+    if (token[i] != 'e' && token[i] != 'E') return NOT_LITERAL;
+    ++i;
+    if (i < token.size() && (token[i] == '+' || token[i] == '-')) ++i;
+
+    size_t expDigits = 0;
+    while (i < token.size() && isDigit(token[i])) {++i; ++expDigits;}
+
+    return (expDigits > 0 && i == token.size()) ? DOUBLE_LITERAL : NOT_LITERAL;
+}
+
+}
+
+StatementParser::StatementParser(const string& defaultNamespace) {
+    if (!defaultNamespace.empty()) _defaultPrefix = defaultNamespace + ":";
+}
+
+bool StatementParser::fail(const char* reason) {
+    _error = reason;
+    return false;
+}
+
+Statement StatementParser::parse(boost::string_view text) {
+    Statement stmt(Concept::nothing, Property(Symbol()), Concept::nothing);
+
+    if (!parse(text, stmt))
+        throw InvalidStatementException("Invalid statement <" + string(text.data(), text.size()) + ">: " + _error);
+
+    return stmt;
+}
+
+bool StatementParser::parse(boost::string_view text, Statement& stmt) {
+
+    size_t pos = 0;
+    Symbol subject, predicate;
+    LiteralType type;
+
+    if (!nextResource(text, pos, subject)) return false;
+
+    if (!nextResource(text, pos, predicate)) return false;
+    if (predicate.str() == "a") predicate = Symbol("rdf:type");
+
+    skipSpaces(text, pos);
+    size_t objectStart = pos;
+
+    if (!nextObject(text, pos, type)) return false;
+
+    skipSpaces(text, pos);
+    if (pos != text.size()) {
+        //Legacy form: an unquoted object made of several words, like in
+        //'john says hello world', is the string of all these words.
+        char c = text[objectStart];
+        if (c == '"' || c == '\'' || c == '<')
+            return fail("unexpected token after the object");
+
+        size_t end = text.size();
+        while (isSpace(text[end - 1])) --end;
+
+        _scratch.clear();
+        appendQuoted(text.substr(objectStart, end - objectStart));
+        type = STRING_LITERAL;
+    }
+
+    stmt.subject = Concept(subject);
+    stmt.predicate = Property(predicate);
+
+    if (type == NOT_LITERAL) {
+        stmt.object = Concept(Symbol(boost::string_view(_scratch)));
+        stmt.literal_object.clear();
+        stmt.isObjectLiteral = false;
+    }
+    else {
+        stmt.object = Concept::nothing;
+        stmt.literal_object.assign(_scratch);
+        stmt.isObjectLiteral = true;
+    }
+    stmt.literal_type = type;
+
+    return true;
+}
+
+bool StatementParser::parseObject(boost::string_view text, string& object, LiteralType& type) {
+    size_t pos = 0;
+
+    if (!nextObject(text, pos, type)) return false;
+
+    skipSpaces(text, pos);
+    if (pos != text.size()) return false;
+
+    object.assign(_scratch);
+    return true;
+}
+
+size_t StatementParser::parseBuffer(boost::string_view buffer,
+                                    const boost::function<void(const Statement&)>& callback,
+                                    vector<Error>* errors) {
+
+    Statement stmt(Concept::nothing, Property(Symbol()), Concept::nothing);
+    size_t nbStatements = 0;
+    size_t lineNumber = 0;
+
+    while (!buffer.empty()) {
+        size_t eol = buffer.find('\n');
+        boost::string_view line = buffer.substr(0, eol);
+        buffer = (eol == boost::string_view::npos) ? boost::string_view() : buffer.substr(eol + 1);
+        ++lineNumber;
+
+        size_t start = 0;
+        skipSpaces(line, start);
+        if (start == line.size() || line[start] == '#') continue;
+
+        if (parse(line, stmt)) {
+            callback(stmt);
+            ++nbStatements;
+        }
+        else if (errors) {
+            errors->push_back(Error());
+            errors->back().line = lineNumber;
+            errors->back().message = _error;
+        }
+    }
+
+    return nbStatements;
+}
+
+namespace {
+void appendStatement(vector<Statement>* statements, const Statement& stmt) {
+    statements->push_back(stmt);
+}
+}
+
+size_t StatementParser::parseBuffer(boost::string_view buffer,
+                                    vector<Statement>& statements,
+                                    vector<Error>* errors) {
+    return parseBuffer(buffer, boost::bind(&appendStatement, &statements, _1), errors);
+}
+
+bool StatementParser::nextResource(boost::string_view text, size_t& pos, Symbol& result) {
+
+    skipSpaces(text, pos);
+    if (pos == text.size()) return fail("missing token (a statement has a subject, a predicate and an object)");
+
+    _scratch.clear();
+
+    if (text[pos] == '<') {
+        boost::string_view iri;
+        if (!readIri(text, pos, iri)) return false;
+        appendIri(iri);
+    }
+    else if (text[pos] == '"' || text[pos] == '\'') {
+        return fail("a literal can only be the object of a statement");
+    }
+    else appendName(readBare(text, pos));
+
+    result = Symbol(boost::string_view(_scratch));
+    return true;
+}
+
+bool StatementParser::nextObject(boost::string_view text, size_t& pos, LiteralType& type) {
+
+    skipSpaces(text, pos);
+    if (pos == text.size()) return fail("missing object");
+
+    _scratch.clear();
+
+    char c = text[pos];
+
+    /**** Resources given by IRI ****/
+    if (c == '<') {
+        boost::string_view iri;
+        if (!readIri(text, pos, iri)) return false;
+        appendIri(iri);
+        type = NOT_LITERAL;
+    }
+
+    /**** Quoted literals ****/
+    else if (c == '"' || c == '\'') {
+        boost::string_view content;
+        char quote;
+        if (!readQuoted(text, pos, content, quote)) return false;
+
+        if (pos + 1 < text.size() && text[pos] == '^' && text[pos + 1] == '^') {
+            pos += 2;
+
+            boost::string_view datatype;
+            if (pos < text.size() && text[pos] == '<') {
+                if (!readIri(text, pos, datatype)) return false;
+            }
+            else datatype = readBare(text, pos);
+
+            if (datatype.empty()) return fail("missing datatype after '^^'");
+
+            appendTypedLiteral(content, datatype, type);
+        }
+        else {
+            type = STRING_LITERAL;
+
+            appendQuoted(content);
+
+            if (pos < text.size() && text[pos] == '@') {
+                _scratch += '@';
+                ++pos;
+                while (pos < text.size() && !isSpace(text[pos])) {
+                    char l = text[pos++];
+                    _scratch += (l >= 'A' && l <= 'Z') ? (char)(l - 'A' + 'a') : l;
+                }
+            }
+        }
+    }
+
+    /**** Names, numbers, booleans and unquoted typed literals ****/
+    else {
+        boost::string_view token = readBare(text, pos);
+
+        size_t carets = token.find("^^");
+        if (carets != boost::string_view::npos) {
+            boost::string_view lexical = token.substr(0, carets);
+            boost::string_view datatype = token.substr(carets + 2);
+
+            if (datatype.size() > 2 && datatype[0] == '<' && datatype[datatype.size() - 1] == '>')
+                datatype = datatype.substr(1, datatype.size() - 2);
+
+            if (lexical.empty() || datatype.empty()) return fail("malformed typed literal");
+
+            appendTypedLiteral(lexical, datatype, type);
+        }
+        else {
+            type = shortFormType(token);
+
+            if (type == NOT_LITERAL) appendName(token);
+            else _scratch.append(token.data(), token.size());
+        }
+    }
+
+    return true;
+}
+
+bool StatementParser::readIri(boost::string_view text, size_t& pos, boost::string_view& iri) {
+    size_t end = text.find('>', pos);
+    if (end == boost::string_view::npos) return fail("unterminated IRI");
+
+    iri = text.substr(pos + 1, end - pos - 1);
+    pos = end + 1;
+    return true;
+}
+
+bool StatementParser::readQuoted(boost::string_view text, size_t& pos, boost::string_view& content, char& quote) {
+
+    quote = text[pos];
+
+    //Long strings ("""...""" or '''...''')
+    if (pos + 2 < text.size() && text[pos + 1] == quote && text[pos + 2] == quote) {
+        const char delimiter[] = {quote, quote, quote, '\0'};
+        size_t end = text.find(delimiter, pos + 3);
+        if (end == boost::string_view::npos) return fail("unterminated long string");
+
+        content = text.substr(pos + 3, end - pos - 3);
+        pos = end + 3;
+        return true;
+    }
+
+    size_t i = pos + 1;
+    while (i < text.size() && text[i] != quote) {
+        if (text[i] == '\\') ++i; //skip the escaped character
+        ++i;
+    }
+
+    if (i >= text.size()) return fail("unterminated string");
+
+    content = text.substr(pos + 1, i - pos - 1);
+    pos = i + 1;
+    return true;
+}
+
+boost::string_view StatementParser::readBare(boost::string_view text, size_t& pos) {
+    size_t start = pos;
+    while (pos < text.size() && !isSpace(text[pos])) ++pos;
+    return text.substr(start, pos - start);
+}
+
+void StatementParser::appendName(boost::string_view name) {
+
+    if (!_defaultPrefix.empty() &&
+        name.size() > _defaultPrefix.size() &&
+        name.substr(0, _defaultPrefix.size()) == _defaultPrefix) {
+        name.remove_prefix(_defaultPrefix.size());
+    }
+    //':Table' is 'Table' in the default namespace as well.
+    else if (name.size() > 1 && name[0] == ':') {
+        name.remove_prefix(1);
+    }
+
+    _scratch.append(name.data(), name.size());
+}
+
+void StatementParser::appendIri(boost::string_view iri) {
+
+    for (size_t i = 0 ; i < NB_NAMESPACES ; ++i) {
+        boost::string_view ns(NAMESPACES[i].uri);
+
+        if (iri.size() > ns.size() && iri.substr(0, ns.size()) == ns) {
+            boost::string_view local = iri.substr(ns.size());
+
+            if (_defaultPrefix.size() != strlen(NAMESPACES[i].prefix) + 1 ||
+                _defaultPrefix.compare(0, _defaultPrefix.size() - 1, NAMESPACES[i].prefix) != 0) {
+                _scratch += NAMESPACES[i].prefix;
+                _scratch += ':';
+            }
+            _scratch.append(local.data(), local.size());
+            return;
+        }
+    }
+
+    _scratch += '<';
+    _scratch.append(iri.data(), iri.size());
+    _scratch += '>';
+}
+
+void StatementParser::appendQuoted(boost::string_view content) {
+
+    _scratch += '"';
+
+    //Double quotes inside single-quoted or long strings must be escaped.
+    for (size_t i = 0 ; i < content.size() ; ++i) {
+        if (content[i] == '\\' && i + 1 < content.size()) {
+            _scratch += content[i];
+            _scratch += content[++i];
+            continue;
+        }
+        if (content[i] == '"') _scratch += '\\';
+        _scratch += content[i];
+    }
+
+    _scratch += '"';
+}
+
+void StatementParser::appendTypedLiteral(boost::string_view lexical, boost::string_view datatype, LiteralType& type) {
+
+    //The datatype is written first, since it decides of the form of the
+    //lexical part, which is then inserted in front of it.
+    _scratch += "^^";
+
+    if (datatype.find("//") != boost::string_view::npos)
+        appendIri(datatype); // full IRI, brackets already removed
+    else
+        _scratch.append(datatype.data(), datatype.size());
+
+    boost::string_view dt(_scratch);
+    dt.remove_prefix(2);
+
+    if (dt == "xsd:integer") type = INTEGER_LITERAL;
+    else if (dt == "xsd:decimal") type = DECIMAL_LITERAL;
+    else if (dt == "xsd:double") type = DOUBLE_LITERAL;
+    else if (dt == "xsd:boolean") type = BOOLEAN_LITERAL;
+    else type = TYPED_LITERAL;
+
+    LiteralType lexicalType = shortFormType(lexical);
+
+    //"12"^^xsd:integer is 12.
+    if (type != TYPED_LITERAL && lexicalType == type) {
+        _scratch.assign(lexical.data(), lexical.size());
+        return;
+    }
+
+    type = TYPED_LITERAL;
+
+    //Numbers and booleans are left unquoted (12^^xsd:int), other lexical
+    //forms are quoted ("xyz"^^app:dt).
+    if (lexicalType != NOT_LITERAL)
+        _scratch.insert(0, lexical.data(), lexical.size());
+    else {
+        string::size_type end = _scratch.size();
+        appendQuoted(lexical);
+        std::rotate(_scratch.begin(), _scratch.begin() + end, _scratch.end());
+    }
+}
+
+}
@@ -0,0 +1,181 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/** \file
+ * This header defines the StatementParser class, which turns the textual
+ * form of statements into their canonical, interned form.
+ */
+
+#ifndef STATEMENT_PARSER_H_
+#define STATEMENT_PARSER_H_
+
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/utility/string_view.hpp>
+
+#include "symbol_table.h"
+
+namespace oro {
+
+class Statement;
+
+/** Constants that define the kind of the object of a statement.
+ *
+ * <ul>
+ *  <li>\p NOT_LITERAL : the object is a resource (a concept).</li>
+ *  <li>\p STRING_LITERAL : a quoted string, possibly with a language tag,
+ *  like <tt>"chat"\@fr</tt>.</li>
+ *  <li>\p INTEGER_LITERAL, \p DECIMAL_LITERAL, \p DOUBLE_LITERAL,
+ *  \p BOOLEAN_LITERAL : a literal of type xsd:integer, xsd:decimal,
+ *  xsd:double or xsd:boolean, like <tt>12</tt>, <tt>1.3</tt>,
+ *  <tt>1.0e6</tt> or <tt>true</tt>.</li>
+ *  <li>\p TYPED_LITERAL : a literal of another datatype, like
+ *  <tt>12^^xsd:int</tt>.</li>
+ * </ul>
+ */
+enum LiteralType {NOT_LITERAL,
+                  STRING_LITERAL,
+                  INTEGER_LITERAL,
+                  DECIMAL_LITERAL,
+                  DOUBLE_LITERAL,
+                  BOOLEAN_LITERAL,
+                  TYPED_LITERAL};
+
+/**
+ * Parses statements, and puts them in a canonical form, so that equivalent
+ * statements end up with the same symbols (and thus compare equal).
+ *
+ * The syntax is the one of the partial statements of \p oro-server : three
+ * whitespace-separated tokens, the subject, the predicate and the object.
+ * For compatibility with the former parser, an unquoted object followed by
+ * other words is a string made of the rest of the statement:
+ * <tt>john says hello world</tt> is <tt>john says "hello world"</tt>.
+ * Canonicalization:
+ * <ul>
+ *  <li>runs of whitespace are collapsed,</li>
+ *  <li>the prefix of the default namespace (\p oro by default) is removed:
+ *  <tt>oro:Table</tt> becomes <tt>Table</tt>,</li>
+ *  <li>full URIs of the well-known namespaces (rdf, rdfs, owl, xsd, oro)
+ *  are replaced by prefixed names,</li>
+ *  <li>\p a as predicate becomes \p rdf:type ,</li>
+ *  <li>strings are double-quoted (<tt>'chat'</tt> and
+ *  <tt>"""chat"""</tt> become <tt>"chat"</tt>) and language tags are
+ *  lower-cased,</li>
+ *  <li>xsd:integer, xsd:decimal, xsd:double and xsd:boolean literals use
+ *  their short form (<tt>"12"^^xsd:integer</tt> becomes <tt>12</tt>), and
+ *  other typed literals are written <tt>lexical^^prefix:type</tt>, the
+ *  lexical form being quoted only when needed.</li>
+ * </ul>
+ *
+ * A parser reuses its internal buffers from one statement to the next: once
+ * warmed up, parsing only allocates memory for symbols never seen before,
+ * and for the literal objects. A
+ * parser is not thread-safe; use one per thread.
+ */
+class StatementParser {
+
+public:
+
+    /**
+     * Describes a statement that could not be parsed.
+     */
+    struct Error {
+        /** Line of the statement in the buffer (starting at 1). */
+        size_t line;
+        std::string message;
+    };
+
+    /**
+     * \param defaultNamespace the prefix of the default namespace of the
+     * server, which is removed from the names. Empty to keep every prefix.
+     */
+    StatementParser(const std::string& defaultNamespace = "oro");
+
+    /**
+     * Parses one statement.
+     *
+     * \throw InvalidStatementException if \p text is not a valid statement.
+     */
+    Statement parse(boost::string_view text);
+
+    /**
+     * Parses one statement.
+     *
+     * \return false if \p text is not a valid statement (cf lastError()).
+     */
+    bool parse(boost::string_view text, Statement& stmt);
+
+    /**
+     * Parses the object of a statement alone, and returns its canonical form.
+     *
+     * \return false if \p text is not a single valid object.
+     */
+    bool parseObject(boost::string_view text, std::string& object, LiteralType& type);
+
+    /**
+     * Parses a buffer holding one statement per line. Blank lines and lines
+     * starting with '#' are skipped.
+     *
+     * \param callback called for each statement, in order.
+     * \param errors if not NULL, receives the invalid lines, which are
+     * otherwise silently skipped.
+     * \return the number of statements parsed.
+     */
+    size_t parseBuffer(boost::string_view buffer,
+                       const boost::function<void(const Statement&)>& callback,
+                       std::vector<Error>* errors = NULL);
+
+    /**
+     * Same as above, appending the statements to \p statements.
+     */
+    size_t parseBuffer(boost::string_view buffer,
+                       std::vector<Statement>& statements,
+                       std::vector<Error>* errors = NULL);
+
+    /**
+     * Returns the reason why the last call to parse() failed.
+     */
+    const std::string& lastError() const {return _error;}
+
+private:
+
+    bool fail(const char* reason);
+
+    // Read the next token of \p text (from \p pos), and build its canonical
+    // form in _scratch. Resources are then interned; literals are not.
+    bool nextResource(boost::string_view text, size_t& pos, Symbol& result);
+    bool nextObject(boost::string_view text, size_t& pos, LiteralType& type);
+
+    bool readIri(boost::string_view text, size_t& pos, boost::string_view& iri);
+    bool readQuoted(boost::string_view text, size_t& pos, boost::string_view& content, char& quote);
+    boost::string_view readBare(boost::string_view text, size_t& pos);
+
+    void appendName(boost::string_view name);
+    void appendIri(boost::string_view iri);
+    void appendQuoted(boost::string_view content);
+    void appendTypedLiteral(boost::string_view lexical, boost::string_view datatype, LiteralType& type);
+
+    std::string _defaultPrefix; // with the trailing ':'
+    std::string _scratch;
+    std::string _error;
+};
+
+}
+
+#endif /* STATEMENT_PARSER_H_ */
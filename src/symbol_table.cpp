@@ -0,0 +1,119 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <boost/functional/hash.hpp>
+#include <boost/thread/locks.hpp>
+
+#include "oro_exceptions.h"
+#include "symbol_table.h"
+
+using namespace std;
+
+namespace oro {
+
+SymbolTable::SymbolTable() : _size(0) {
+    for (size_t i = 0 ; i < MAX_CHUNKS ; ++i)
+        _chunks[i].store(NULL, boost::memory_order_relaxed);
+
+    add(boost::string_view()); // symbol 0 is the empty string
+}
+
+SymbolTable& SymbolTable::instance() {
+    // Constructed on first use, since symbols are created during the static
+    // initialization of other translation units (cf oro_library.cpp). Never
+    // destroyed, since symbols may still be read by other threads while the
+    // program exits.
+    static SymbolTable* table = new SymbolTable();
+    return *table;
+}
+
+size_t SymbolTable::ViewHash::operator()(const boost::string_view& str) const {
+    return boost::hash_range(str.begin(), str.end());
+}
+
+symbol_id SymbolTable::intern(boost::string_view str) {
+
+    if (str.empty()) return 0;
+
+    SymbolTable& table = instance();
+
+    Shard& shard = table._shards[ViewHash()(str) % SHARDS];
+
+    boost::lock_guard<boost::mutex> lock(shard.lock);
+
+    boost::unordered_map<boost::string_view, symbol_id, ViewHash>::const_iterator it = shard.ids.find(str);
+    if (it != shard.ids.end()) return it->second;
+
+    symbol_id id = table.add(str);
+    shard.ids.insert(make_pair(boost::string_view(name(id)), id));
+
+    return id;
+}
+
+symbol_id SymbolTable::add(boost::string_view str) {
+
+    boost::lock_guard<boost::mutex> lock(_addLock);
+
+    size_t id = _size.load(boost::memory_order_relaxed);
+
+    if (id >= (size_t) MAX_CHUNKS * CHUNK_SIZE)
+        throw OntologyException("Too many symbols: the symbol table is full.");
+
+    std::string* chunk = _chunks[id >> CHUNK_BITS].load(boost::memory_order_relaxed);
+
+    if (chunk == NULL) {
+        chunk = new std::string[CHUNK_SIZE];
+        _chunks[id >> CHUNK_BITS].store(chunk, boost::memory_order_release);
+    }
+
+    chunk[id & (CHUNK_SIZE - 1)].assign(str.data(), str.size());
+
+    _size.store(id + 1, boost::memory_order_release);
+
+    return id;
+}
+
+size_t hash_value(const Triple& t) {
+    size_t seed = 0;
+    boost::hash_combine(seed, t.subject.id());
+    boost::hash_combine(seed, t.predicate.id());
+    boost::hash_combine(seed, t.object.id());
+    boost::hash_combine(seed, t.isObjectLiteral);
+    if (t.isObjectLiteral) boost::hash_combine(seed, t.literal);
+    return seed;
+}
+
+void Triple::appendTo(string& out) const {
+    const string& s = subject.str();
+    const string& p = predicate.str();
+    const string& o = isObjectLiteral ? literal : object.str();
+
+    out.reserve(out.size() + s.size() + p.size() + o.size() + 2);
+    out += s;
+    out += ' ';
+    out += p;
+    out += ' ';
+    out += o;
+}
+
+string Triple::to_string() const {
+    string res;
+    appendTo(res);
+    return res;
+}
+
+}
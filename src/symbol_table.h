@@ -0,0 +1,202 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/** \file
+ * This header defines the symbol table of \p liboro : every identifier
+ * (of a concept, a class or a property) manipulated through Concept, Class,
+ * Property or Statement is stored once in this table, and referred to by a
+ * small integer. Labels and literals are plain strings: they are as many as
+ * the values the application ever asserted, and would fill the table.
+ */
+
+#ifndef SYMBOL_TABLE_H_
+#define SYMBOL_TABLE_H_
+
+#include <string>
+#include <iostream>
+
+#include <boost/cstdint.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/utility/string_view.hpp>
+
+namespace oro {
+
+typedef boost::uint32_t symbol_id;
+
+/**
+ * The process-wide table of interned strings.
+ *
+ * Symbols are never removed: a symbol id, and the reference returned by
+ * SymbolTable::name(), remain valid until the program exits. The table thus
+ * grows with every distinct identifier the application handles, up to
+ * 2^26 symbols: results of requests that generate new identifiers should be
+ * read as strings (cf FlatStringSet), not as Concept. Reading a
+ * symbol never takes a lock. Interning a string locks one of several
+ * shards of the index, chosen by hash.
+ *
+ * The empty string is always the symbol 0.
+ */
+class SymbolTable {
+
+public:
+
+    /**
+     * Returns the id of a string, adding it to the table if needed.
+     *
+     * \throw OntologyException if the table is full.
+     */
+    static symbol_id intern(boost::string_view str);
+
+    /**
+     * Returns the string of a symbol.
+     */
+    static const std::string& name(symbol_id id) {
+        const SymbolTable& table = instance();
+        return table._chunks[id >> CHUNK_BITS].load(boost::memory_order_acquire)[id & (CHUNK_SIZE - 1)];
+    }
+
+    /**
+     * Returns the number of symbols in the table.
+     */
+    static size_t size() {return instance()._size.load(boost::memory_order_acquire);}
+
+private:
+
+    SymbolTable();
+    SymbolTable(const SymbolTable&);
+    SymbolTable& operator=(const SymbolTable&);
+
+    static SymbolTable& instance();
+
+    symbol_id add(boost::string_view str);
+
+    enum {CHUNK_BITS = 12,
+          CHUNK_SIZE = 1 << CHUNK_BITS,
+          MAX_CHUNKS = 1 << 14,
+          SHARDS = 16};
+
+    struct ViewHash {
+        size_t operator()(const boost::string_view& str) const;
+    };
+
+    struct Shard {
+        boost::mutex lock;
+        boost::unordered_map<boost::string_view, symbol_id, ViewHash> ids;
+    };
+
+    // Strings are stored in fixed-size chunks that are never reallocated,
+    // so that readers can access them while new symbols are added.
+    boost::atomic<std::string*> _chunks[MAX_CHUNKS];
+    boost::atomic<size_t> _size;
+    boost::mutex _addLock;
+
+    Shard _shards[SHARDS];
+};
+
+/**
+ * A handle to an interned string. Copying, comparing and hashing a symbol
+ * are constant-time operations.
+ *
+ * Symbols are ordered by id (ie, by order of creation), not alphabetically.
+ */
+class Symbol {
+public:
+    /** The empty symbol. */
+    Symbol() : _id(0) {}
+
+    explicit Symbol(const std::string& str) : _id(SymbolTable::intern(str)) {}
+    explicit Symbol(boost::string_view str) : _id(SymbolTable::intern(str)) {}
+    explicit Symbol(const char* str) : _id(SymbolTable::intern(str)) {}
+
+    const std::string& str() const {return SymbolTable::name(_id);}
+
+    symbol_id id() const {return _id;}
+
+    bool empty() const {return _id == 0;}
+
+    bool operator==(const Symbol& other) const {return _id == other._id;}
+    bool operator!=(const Symbol& other) const {return _id != other._id;}
+    bool operator<(const Symbol& other) const {return _id < other._id;}
+
+    friend std::size_t hash_value(const Symbol& s) {return s._id;}
+
+    friend std::ostream& operator<<(std::ostream& stream, const Symbol& s) {
+        stream << s.str();
+        return stream;
+    }
+
+private:
+    symbol_id _id;
+};
+
+/**
+ * The compact identity of a statement: its subject and predicate symbols,
+ * and either its object symbol or its literal object. Cf Statement::triple().
+ */
+struct Triple {
+    Symbol subject;
+    Symbol predicate;
+    Symbol object; // empty if isObjectLiteral
+    std::string literal;
+    bool isObjectLiteral;
+
+    Triple() : isObjectLiteral(false) {}
+
+    Triple(Symbol subject, Symbol predicate, Symbol object) :
+        subject(subject),
+        predicate(predicate),
+        object(object),
+        isObjectLiteral(false) {}
+
+    Triple(Symbol subject, Symbol predicate, const std::string& literal) :
+        subject(subject),
+        predicate(predicate),
+        literal(literal),
+        isObjectLiteral(true) {}
+
+    bool operator==(const Triple& t) const {
+        return subject == t.subject && predicate == t.predicate &&
+               object == t.object && isObjectLiteral == t.isObjectLiteral &&
+               literal == t.literal;
+    }
+
+    bool operator<(const Triple& t) const {
+        if (subject != t.subject) return subject < t.subject;
+        if (predicate != t.predicate) return predicate < t.predicate;
+        if (isObjectLiteral != t.isObjectLiteral) return isObjectLiteral < t.isObjectLiteral;
+        if (object != t.object) return object < t.object;
+        return literal < t.literal;
+    }
+
+    friend std::size_t hash_value(const Triple& t);
+
+    /**
+     * Returns the statement as expected by \p oro-server .
+     */
+    std::string to_string() const;
+
+    /**
+     * Appends the statement, as expected by \p oro-server , to \p out.
+     */
+    void appendTo(std::string& out) const;
+};
+
+}
+
+#endif /* SYMBOL_TABLE_H_ */
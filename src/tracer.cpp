@@ -0,0 +1,240 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <unistd.h>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#include "oro_exceptions.h"
+#include "leaked.h"
+#include "tracer.h"
+
+using namespace std;
+
+namespace oro {
+
+namespace {
+
+struct Span {
+    const char* category;
+    boost::uint64_t start;
+    boost::uint64_t end;
+    char name[48];
+};
+
+/* The spans of one thread. Only the owner thread writes; readers copy the
+ * spans, then check with 'head' that they were not overwritten meanwhile.
+ */
+struct Ring {
+    Ring(unsigned int tid) : head(0), cleared(0), tid(tid) {}
+
+    // Allocated on the first span: naming a thread costs nothing while
+    // tracing is disabled.
+    vector<Span> spans;
+
+    // Number of spans ever written, and number of them discarded by clear().
+    boost::atomic<boost::uint64_t> head;
+    boost::atomic<boost::uint64_t> cleared;
+
+    unsigned int tid;
+    string name;
+};
+
+struct Registry {
+    boost::mutex lock;
+
+    // Rings are never released: the spans of the threads that have exited
+    // are part of the trace as well.
+    vector<Ring*> rings;
+};
+
+Registry& registry() {
+    return leaked<Registry>();
+}
+
+// Rings are owned by the registry: nothing to do when a thread exits.
+void noCleanup(Ring*) {}
+
+Ring& localRing() {
+    static leaked_tls<Ring> rings(noCleanup);
+
+    Ring* ring = rings.get();
+
+    if (ring == NULL) {
+        Registry& reg = registry();
+        boost::lock_guard<boost::mutex> lock(reg.lock);
+
+        ring = new Ring(reg.rings.size() + 1);
+        reg.rings.push_back(ring);
+        rings.reset(ring);
+    }
+
+    return *ring;
+}
+
+void writeJsonString(ostream& out, const string& value) {
+    out << '"';
+    for (size_t i = 0 ; i < value.length() ; ++i) {
+        char c = value[i];
+        if (c == '"' || c == '\\') out << '\\' << c;
+        else if ((unsigned char) c < 0x20) out << ' ';
+        else out << c;
+    }
+    out << '"';
+}
+
+// Chrome traces are in microseconds.
+void writeMicroseconds(ostream& out, boost::uint64_t ns) {
+    out << ns / 1000 << '.' << (char) ('0' + ns / 100 % 10) << (char) ('0' + ns / 10 % 10) << (char) ('0' + ns % 10);
+}
+
+/* Dumps the trace at exit, if ORO_TRACE is set. */
+struct TraceAtExit {
+    TraceAtExit() {
+        const char* path = getenv("ORO_TRACE");
+        if (path != NULL && *path != '\0') this->path = path;
+    }
+
+    ~TraceAtExit() {
+        if (path.empty()) return;
+
+        //The logger may already be stopped: write to stderr directly.
+        try {
+            Tracer::dump(path);
+            cerr << "[II] Trace written to " << path << endl;
+        } catch (OntologyException& e) {
+            cerr << "[EE] " << e.what() << endl;
+        }
+    }
+
+    string path;
+};
+
+TraceAtExit traceAtExit;
+
+}
+
+boost::atomic<bool> Tracer::_enabled(getenv("ORO_TRACE") != NULL && *getenv("ORO_TRACE") != '\0');
+
+void Tracer::enable(bool state) {
+    _enabled.store(state, boost::memory_order_relaxed);
+}
+
+void Tracer::nameThread(const string& name) {
+    Ring& ring = localRing();
+
+    boost::lock_guard<boost::mutex> lock(registry().lock);
+    ring.name = name;
+}
+
+void Tracer::record(const char* category, const char* name, boost::uint64_t start, boost::uint64_t end) {
+    Ring& ring = localRing();
+
+    if (ring.spans.empty()) ring.spans.resize(ORO_TRACE_RING_SIZE);
+
+    boost::uint64_t index = ring.head.load(boost::memory_order_relaxed);
+    Span& span = ring.spans[index % ORO_TRACE_RING_SIZE];
+
+    span.category = category;
+    span.start = start;
+    span.end = end;
+    strncpy(span.name, name, sizeof(span.name) - 1);
+    span.name[sizeof(span.name) - 1] = '\0';
+
+    ring.head.store(index + 1, boost::memory_order_release);
+}
+
+void Tracer::clear() {
+    Registry& reg = registry();
+    boost::lock_guard<boost::mutex> lock(reg.lock);
+
+    for (size_t i = 0 ; i < reg.rings.size() ; ++i)
+        reg.rings[i]->cleared.store(reg.rings[i]->head.load());
+}
+
+void Tracer::dump(ostream& out) {
+    Registry& reg = registry();
+    boost::lock_guard<boost::mutex> lock(reg.lock);
+
+    int pid = getpid();
+    bool first = true;
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    vector<Span> spans;
+
+    for (size_t r = 0 ; r < reg.rings.size() ; ++r) {
+        Ring& ring = *reg.rings[r];
+
+        if (!ring.name.empty()) {
+            out << (first ? "\n" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid
+                << ",\"tid\":" << ring.tid << ",\"args\":{\"name\":";
+            writeJsonString(out, ring.name);
+            out << "}}";
+            first = false;
+        }
+
+        boost::uint64_t head = ring.head.load(boost::memory_order_acquire);
+        boost::uint64_t from = std::max(ring.cleared.load(), head > ORO_TRACE_RING_SIZE ? head - ORO_TRACE_RING_SIZE : 0);
+
+        spans.clear();
+        for (boost::uint64_t i = from ; i < head ; ++i)
+            spans.push_back(ring.spans[i % ORO_TRACE_RING_SIZE]);
+
+        // The owner thread may have overwritten the oldest spans while we
+        // were copying them (plus the one it may be writing right now).
+        boost::atomic_thread_fence(boost::memory_order_acquire);
+        boost::uint64_t newHead = ring.head.load(boost::memory_order_relaxed);
+        size_t skip = 0;
+        if (newHead + 1 > from + ORO_TRACE_RING_SIZE)
+            skip = std::min<boost::uint64_t>(spans.size(), newHead + 1 - ORO_TRACE_RING_SIZE - from);
+
+        for (size_t i = skip ; i < spans.size() ; ++i) {
+            const Span& span = spans[i];
+
+            out << (first ? "\n" : ",\n") << "{\"ph\":\"X\",\"cat\":\"" << span.category << "\",\"name\":";
+            writeJsonString(out, span.name);
+            out << ",\"pid\":" << pid << ",\"tid\":" << ring.tid << ",\"ts\":";
+            writeMicroseconds(out, span.start);
+            out << ",\"dur\":";
+            writeMicroseconds(out, span.end - span.start);
+            out << "}";
+            first = false;
+        }
+    }
+
+    out << "\n]}\n";
+}
+
+void Tracer::dump(const string& path) {
+    ofstream out(path.c_str());
+    if (!out) throw OntologyException("Can not open " + path + " for writing");
+
+    dump(out);
+
+    out.close();
+    if (!out) throw OntologyException("Error while writing " + path);
+}
+
+}
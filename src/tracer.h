@@ -0,0 +1,129 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/** \file
+ * This header defines the Tracer, which records the timeline of the calls
+ * to liboro (spans), and exports it in the Chrome trace format.
+ */
+
+#ifndef TRACER_H_
+#define TRACER_H_
+
+#include <string>
+#include <ostream>
+#include <chrono>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+
+// Number of spans kept per thread. Older spans are overwritten.
+#define ORO_TRACE_RING_SIZE 16384
+
+namespace oro {
+
+/**
+ * Records spans (a name, a start and an end) into per-thread ring buffers,
+ * and dumps them as Chrome trace JSON, to be opened in chrome://tracing or
+ * https://ui.perfetto.dev.
+ *
+ * liboro records a span for each Ontology call, and for the stages of the
+ * requests: serialization, wait for the connection (queue), write, wait for
+ * the server, and on the listener thread, the reading and the
+ * deserialization of the responses, and the dispatch of the events.
+ *
+ * Tracing is disabled by default. Setting the ORO_TRACE environment
+ * variable to a file name enables it, and the trace is written to that file
+ * when the process exits. It can also be enabled with enable(), and written
+ * at any time with dump().
+ *
+ * Recording a span does not lock nor allocate: each thread writes into its
+ * own ring, that dump() reads concurrently. While disabled, a span only
+ * costs a relaxed atomic load.
+ */
+class Tracer {
+public:
+    static bool enabled() {return _enabled.load(boost::memory_order_relaxed);}
+
+    static void enable(bool state = true);
+
+    /**
+     * Writes the spans recorded so far by all the threads, as Chrome trace
+     * JSON. Throws an OntologyException if the file can not be written.
+     */
+    static void dump(const std::string& path);
+    static void dump(std::ostream& out);
+
+    /**
+     * Discards the spans recorded so far.
+     */
+    static void clear();
+
+    /**
+     * Names the calling thread in the trace.
+     */
+    static void nameThread(const std::string& name);
+
+    /**
+     * A monotonic timestamp, in nanoseconds.
+     */
+    static boost::uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * Records a span of the calling thread. Names longer than 47 characters
+     * are truncated.
+     */
+    static void record(const char* category, const char* name, boost::uint64_t start, boost::uint64_t end);
+
+private:
+    static boost::atomic<bool> _enabled;
+};
+
+/**
+ * Records a span from its construction to its destruction (or to end()),
+ * if the tracer is enabled. \p category and \p name must outlive the span.
+ */
+class TraceSpan {
+public:
+    TraceSpan(const char* category, const char* name) :
+        _category(category), _name(name), _start(Tracer::enabled() ? Tracer::now() : 0) {}
+
+    TraceSpan(const char* category, const std::string& name) :
+        _category(category), _name(name.c_str()), _start(Tracer::enabled() ? Tracer::now() : 0) {}
+
+    ~TraceSpan() {end();}
+
+    void end() {
+        if (_start == 0) return;
+        Tracer::record(_category, _name, _start, Tracer::now());
+        _start = 0;
+    }
+
+private:
+    TraceSpan(const TraceSpan&);
+    TraceSpan& operator=(const TraceSpan&);
+
+    const char* _category;
+    const char* _name;
+    boost::uint64_t _start;
+};
+
+}
+
+#endif /* TRACER_H_ */
@@ -67,7 +67,9 @@ int main(int argc, char* argv[]) {
         cout << desc;
         cout << endl;
 
-        cout << "Adds symbolic statements to a KB-API compatible knowledge base.\n\n";
+        cout << "Adds symbolic statements to a KB-API compatible knowledge base.\n";
+        cout << "Literals containing spaces should be quoted (\"john says 'hello world'\");\n";
+        cout << "otherwise, the words after the predicate are taken as one string.\n\n";
         cout << "Séverin Lemaignan, Plymouth University 2016, " << endl;
         cout << "Report bugs to: " << endl;
         cout << "https://www.github.com/severin-lemaignan/liboro/issues" << endl;
@@ -20,356 +20,460 @@
 
 #include <string>
 #include <iostream>
-#include <iterator>
+#include <fstream>
+#include <iomanip>
 #include <signal.h>
-#include <map>
 #include <set>
 #include <vector>
-#include <ctime>
+#include <chrono>
 
-#include <boost/thread/thread.hpp>
+#include <boost/function.hpp>
+#include <boost/program_options.hpp>
 #include <boost/thread/mutex.hpp>
-#include <boost/thread/condition.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 
 #include "oro.h"
 #include "oro_library.h"
 #include "oro_connector.h"
 #include "socket_connector.h"
+#include "latency_histogram.h"
 
 using namespace std;
 
-
 using namespace oro;
-using namespace boost;
-
-struct ltstr
-{
-  bool operator()(const string& s1, const string& s2) const
-  {
-    return s1.compare(s2) < 0;
-  }
-};
-
-//Forward declarations
-class eventHandler;
-void sigproc(int);
-void displayCollec(const set<string>& result);
-void displayTime(void);
-
-//boost::condition cond;
-//boost::mutex mut;
-
-bool waitingForEvent = true;
-const string hostname = "localhost";
-const string port = "6969";
+namespace po = boost::program_options;
 
-//map<string, gettimeofday_t, ltstr> timetable;
-map<string, timeval, ltstr> timetable;
+typedef std::chrono::steady_clock Clock;
 
-int main(void) {
-
-        timeval time;
-    string name;
-
-    cout << "********* ORO Benchmark *********" << endl;
-    cout << "Press ctrl+c to exit." << endl;
+/**
+ * Passed to the benchmark cases: gives access to the ontology, and times the
+ * operations.
+ */
+class Bench {
+public:
+    Bench(Ontology* onto, size_t size) : onto(onto), size(size), errors(0), _histogram(NULL) {}
+
+    /**
+     * Runs and times one operation.
+     */
+    template<typename Operation>
+    void op(Operation operation) {
+        Clock::time_point start = Clock::now();
+        operation();
+        boost::uint64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+
+        if (_histogram) _histogram->record(duration);
+    }
 
-    //We catch ctrl+c to cleanly close the application
-    signal( SIGINT,sigproc);
+    /**
+     * Records the operations into \p histogram, or discards them (warm-up)
+     * if NULL.
+     */
+    void recordInto(LatencyHistogram* histogram) {_histogram = histogram;}
 
-    {
-    SocketConnector connector(hostname, port);
     Ontology* onto;
-    //Instanciate the ontology with the YARP connector.
-    onto = Ontology::createWithConnector(connector);
-
-    Concept myself = Concept("myself"); //create a new instance in the ontology which represents "myself" ie the robot/process where this code executes.
-
-    cout << " * Connected to ontology server on " << hostname << ":" << port << endl;
-    cout << " * Now starting benchmarking." << endl;
+    size_t size;
+    size_t errors;
 
+private:
+    LatencyHistogram* _histogram;
+};
 
-    /////////////////////////////
-    //  START OF BENCHMARKING  //
-    /////////////////////////////
+struct BenchCase {
+    string name;
+    string description;
+    // Number of statements (or results) handled by one operation, or 0 if
+    // it is the size of the benchmark.
+    size_t itemsPerOp;
+    boost::function<void(Bench&)> run;
+};
 
+struct BenchResult {
+    string name;
+    string description;
+    size_t itemsPerOp;
+    size_t errors;
+    LatencyHistogram latencies;
+};
 
-        gettimeofday(&time, NULL);
-        timetable["0- start"] = time;
+vector<BenchResult> results;
 
-    //  TEST 1 //
-    cout << " * <BENCH01> Assertion of some initial facts" << endl;
+size_t benchSize = 100;
+size_t iterations = 10;
+size_t warmup = 2;
+string format = "text";
+ostream* output = &cout;
 
-    onto->add(Statement("gorilla rdf:type Monkey"));
-    onto->add(Statement("gorilla age 12^^xsd:int"));
-    onto->add(Statement("gorilla weight 75.2"));
+void sigproc(int);
+void report();
 
-        gettimeofday(&time, NULL);
-        timetable["<BENCH01> simple assertions"] = time;
+/*******************************************************************************
+*                              Benchmark cases                                 *
+*******************************************************************************/
 
+void createConcepts(Bench& b) {
+    for (size_t i = 0 ; i < b.size ; i++)
+        b.op([&]() {Concept::create(Class("test"));});
+}
 
-    //  TEST 2 //
-    int nb_stmt = 100;
+void createConceptsBuffered(Bench& b) {
+    b.op([&]() {
+        b.onto->bufferize();
+        for (size_t i = 0 ; i < b.size ; i++)
+            Concept::create(Class("test"));
+        b.onto->flush();
+    });
+}
 
-    cout << " * <BENCH02> Insertion of " << nb_stmt << " statements" << endl;
+class EventWaiter : public OroEventObserver {
+public:
+    EventWaiter() : _fired(false) {}
 
-    for (int i = 0 ; i < nb_stmt ; i++)
-    {
-        Class testClass = Class("test");
-        Concept test = Concept::create(testClass);
+    void operator()(const OroEvent& evt) {
+        boost::lock_guard<boost::mutex> lock(_lock);
+        _fired = true;
+        _cond.notify_all();
     }
 
-        gettimeofday(&time, NULL);
-        timetable["<BENCH02> insertion statements"] = time;
-
-
-
-    //  TEST 3 //
-
-    cout << " * <BENCH03> Insertion of "<< nb_stmt << " statements with buffering" << endl;
-
-    onto->bufferize();
-    for (int i = 0 ; i < nb_stmt ; i++)
-    {
-        Class testClass = Class("test");
-        Concept test = Concept::create(testClass);
+    bool wait(int timeout_ms) {
+        boost::unique_lock<boost::mutex> lock(_lock);
+        bool fired = _cond.timed_wait(lock, boost::posix_time::milliseconds(timeout_ms), [&]() {return _fired;});
+        _fired = false;
+        return fired;
     }
-    onto->flush();
-
-        gettimeofday(&time, NULL);
-        timetable["<BENCH03> insertion buffered statements"] = time;
-
-
-    //  TEST 4 //
-    set<string> result;
-
-    name = "<BENCH04> Simple getInfos query";
 
-    cout << " * " << name << endl;
-
-    cout << "\t* Looking for infos on Gorillas:" << endl;
+private:
+    bool _fired;
+    boost::mutex _lock;
+    boost::condition_variable _cond;
+};
 
-    onto->getInfos("gorilla", result);
+vector<BenchCase> benchCases() {
+    vector<BenchCase> cases;
+
+    cases.push_back({"BENCH01", "Assertion of some initial facts", 1, [](Bench& b) {
+        b.op([&]() {b.onto->add(Statement("gorilla rdf:type Monkey"));});
+        b.op([&]() {b.onto->add(Statement("gorilla age 12^^xsd:int"));});
+        b.op([&]() {b.onto->add(Statement("gorilla weight 75.2"));});
+    }});
+
+    cases.push_back({"BENCH02", "Insertion of statements", 1, createConcepts});
+
+    cases.push_back({"BENCH03", "Insertion of statements with buffering", 0, createConceptsBuffered});
+
+    cases.push_back({"BENCH04a", "Simple getInfos query (existing resource)", 1, [](Bench& b) {
+        set<string> result;
+        b.op([&]() {b.onto->getInfos("gorilla", result);});
+    }});
+
+    cases.push_back({"BENCH04b", "Simple getInfos query (inexistant resource)", 1, [](Bench& b) {
+        set<string> result;
+        b.op([&]() {
+            try {
+                b.onto->getInfos("schtroumph", result);
+            } catch (ResourceNotFoundOntologyException e) {}
+        });
+    }});
+
+    cases.push_back({"BENCH05", "Event registration and notification", 1, [](Bench& b) {
+        // The dispatcher keeps a pointer to the observer until the event
+        // fires: an event that arrives after its timeout, or after
+        // clearEvents(), is still delivered. The waiter thus lives as long
+        // as the ontology.
+        static EventWaiter* waiter = new EventWaiter();
+        set<string> pattern;
+        pattern.insert("?object rdf:type Donkey");
+
+        b.op([&]() {
+            b.onto->registerEvent(*waiter, NEW_INSTANCE, ON_TRUE_ONE_SHOT, pattern, "?object");
+            Concept::create(Class("Donkey"));
+            if (!waiter->wait(1000)) b.errors++;
+        });
+
+        b.onto->clearEvents();
+    }});
+
+    cases.push_back({"BENCH06", "SPARQL test", 1, [](Bench& b) {
+        set<string> result;
+        b.op([&]() {b.onto->query("object", "SELECT ?object WHERE { ?object rdf:type oro:Monkey }", result);});
+    }});
+
+    cases.push_back({"BENCH07", "Find test", 1, [](Bench& b) {
+        set<Concept> result;
+        b.op([&]() {b.onto->find("object", "?object rdf:type Monkey", result);});
+    }});
+
+    cases.push_back({"BENCH08", "Filtred find test", 1, [](Bench& b) {
+        set<Concept> result;
+        set<string> partial_stmts;
+        set<string> filters;
+
+        partial_stmts.insert("?mysterious rdf:type oro:Monkey");
+        partial_stmts.insert("?mysterious oro:weight ?value");
+        filters.insert("?value >= 50");
+
+        b.op([&]() {b.onto->find("mysterious", partial_stmts, filters, result);});
+    }});
+
+    cases.push_back({"BENCH09", "Consistency check test", 1, [](Bench& b) {
+        b.op([&]() {if (!b.onto->checkConsistency()) b.errors++;});
+    }});
+
+    cases.push_back({"BENCH10", "Insertion of statements with 'waitForAck=false'", 1, [](Bench& b) {
+        b.onto->alwaysWaitForAcknowledgment(false);
+        createConcepts(b);
+        b.onto->alwaysWaitForAcknowledgment(true);
+    }});
+
+    cases.push_back({"BENCH11", "Insertion of statements with buffering and without waiting for ack", 0, [](Bench& b) {
+        b.onto->alwaysWaitForAcknowledgment(false);
+        createConceptsBuffered(b);
+        b.onto->alwaysWaitForAcknowledgment(true);
+    }});
+
+    cases.push_back({"BENCH12", "Creation of labelled concepts, one request per concept", 3, [](Bench& b) {
+        for (size_t i = 0 ; i < b.size ; i++)
+            b.op([&]() {
+                Concept::build()
+                    .label("test concept")
+                    .type(Class("test"))
+                    .assertThat(Property("isAt"), "gorilla")
+                    .commit();
+            });
+    }});
+
+    cases.push_back({"BENCH13", "Creation of labelled concepts in a single request", 0, [](Bench& b) {
+        vector<ConceptBuilder> builders;
+        for (size_t i = 0 ; i < b.size ; i++)
+            builders.push_back(Concept::build()
+                                   .label("test concept")
+                                   .type(Class("test"))
+                                   .assertThat(Property("isAt"), "gorilla"));
+
+        // Only the request is timed: creating the builders is local.
+        b.op([&]() {ConceptBuilder::commit(builders);});
+    }});
+
+    return cases;
+}
 
-    displayCollec(result);
+/*******************************************************************************
+*                                  Reports                                     *
+*******************************************************************************/
 
-        gettimeofday(&time, NULL);
-        timetable["<BENCH04> Simple getInfos query (existing resource)"] = time;
+// Operations per second, from the mean latency (operations are sequential).
+double throughput(const BenchResult& r) {
+    return r.latencies.mean() > 0 ? 1e9 / r.latencies.mean() : 0;
+}
 
-    cout << "\t* Looking for infos on Schtroumphs" << endl;
+double itemThroughput(const BenchResult& r) {
+    return throughput(r) * (r.itemsPerOp ? r.itemsPerOp : benchSize);
+}
 
-    try {
-        onto->getInfos("schtroumph", result);
-    } catch (ResourceNotFoundOntologyException e)
-    {
-        cout << "\t Good: nothing found, as expected."<<endl;
+string jsonEscape(const string& str) {
+    string res;
+    for (size_t i = 0 ; i < str.size() ; ++i) {
+        if (str[i] == '"' || str[i] == '\\') res += '\\';
+        res += str[i];
     }
+    return res;
+}
 
-        gettimeofday(&time, NULL);
-        timetable["<BENCH04> Simple getInfos query (inexistant resource)"] = time;
-
-    /*
-    //  TEST 5 //
-    string event_port = local_port + "_events";
-
-    name = "<BENCH5> Event registration";
-
-    cout << " * " << name << endl;
-
-    boost::thread eventHandleThread(eventHandler(event_port));
-
-    onto->subscribe("?object rdf:type Donkey", Ontology::ON_TRUE_ONE_SHOT, event_port);
-
-    Concept dudule = Concept::create(Class("Donkey"));
-
-        timetable[name] = gettimeofday();
-
-    //~ boost::mutex::scoped_lock lock(mut);
-    //~ while(waitingForEvent)
-    //~ {
-        //~ cond.wait(lock);
-    //~ }
-    */
-
-    //  TEST 6 //
-
-    name = "<BENCH06> SPARQL test";
-
-    cout << " * " << name << endl;
-    result.clear();
-
-    string query = "SELECT ?object WHERE { ?object rdf:type oro:Monkey }";
-
-    onto->query("object", query, result);
-
-    displayCollec(result);
-
-        gettimeofday(&time, NULL);
-        timetable[name] = time;
-
-    //  TEST 7 //
-
-    name = "<BENCH07> Find test";
-
-    cout << " * " << name << endl;
-
-    set<Concept> resultConcepts;
-
-    onto->find("object", "?object rdf:type Monkey", resultConcepts);
-
-    copy(resultConcepts.begin(), resultConcepts.end(), ostream_iterator<Concept>(cout, "\n"));
-
-
-        gettimeofday(&time, NULL);
-        timetable[name] = time;
-
-
-    //  TEST 8 //
-
-    name = "<BENCH08> Filtred find test";
-
-    cout << " * " << name << endl;
-
-    resultConcepts.clear();
-
-    set<string> partial_stmts;
-    set<string> filters;
-
-    partial_stmts.insert("?mysterious rdf:type oro:Monkey");
-    partial_stmts.insert("?mysterious oro:weight ?value");
-
-    filters.insert("?value >= 50");
-
-    onto->find("mysterious", partial_stmts, filters, resultConcepts);
-
-
-    copy(resultConcepts.begin(), resultConcepts.end(), ostream_iterator<Concept>(cout, "\n"));
-
-        gettimeofday(&time, NULL);
-        timetable[name] = time;
-
-    //  TEST 9 //
-
-    name = "<BENCH09> Consistency check test";
-
-    cout << " * " << name << endl;
-
-    resultConcepts.clear();
-
-    if (!onto->checkConsistency()) {cout<<"Error: the ontology should be found to be consistent."<<endl;}
-
-        gettimeofday(&time, NULL);
-        timetable[name] = time;
-
-    ///////////////////////////
-    ///////////////////////////
-
-    //  TEST 10 //
-    onto->alwaysWaitForAcknowledgment(false);
+void report() {
+    ostream& out = *output;
+
+    if (format == "json") {
+        out << "{\"iterations\":" << iterations << ",\"warmup\":" << warmup << ",\"size\":" << benchSize << ",\"cases\":[";
+        for (size_t i = 0 ; i < results.size() ; ++i) {
+            const BenchResult& r = results[i];
+            const LatencyHistogram& h = r.latencies;
+            out << (i ? "," : "") << endl
+                << "{\"name\":\"" << r.name << "\",\"description\":\"" << jsonEscape(r.description) << "\""
+                << ",\"operations\":" << h.count() << ",\"errors\":" << r.errors
+                << ",\"mean_ns\":" << (boost::uint64_t) h.mean()
+                << ",\"min_ns\":" << h.min()
+                << ",\"p50_ns\":" << h.percentile(50)
+                << ",\"p90_ns\":" << h.percentile(90)
+                << ",\"p99_ns\":" << h.percentile(99)
+                << ",\"p999_ns\":" << h.percentile(99.9)
+                << ",\"max_ns\":" << h.max()
+                << ",\"ops_per_sec\":" << throughput(r)
+                << ",\"items_per_sec\":" << itemThroughput(r) << "}";
+        }
+        out << "]}" << endl;
+    }
+    else if (format == "csv") {
+        out << "name,operations,errors,mean_ns,min_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns,ops_per_sec,items_per_sec" << endl;
+        for (size_t i = 0 ; i < results.size() ; ++i) {
+            const BenchResult& r = results[i];
+            const LatencyHistogram& h = r.latencies;
+            out << r.name << "," << h.count() << "," << r.errors << ","
+                << (boost::uint64_t) h.mean() << "," << h.min() << ","
+                << h.percentile(50) << "," << h.percentile(90) << ","
+                << h.percentile(99) << "," << h.percentile(99.9) << ","
+                << h.max() << "," << throughput(r) << "," << itemThroughput(r) << endl;
+        }
+    }
+    else {
+        out << endl << "Latencies in microseconds, over " << iterations << " runs of each case (after " << warmup << " warm-up runs)" << endl;
+        out << left << setw(10) << "case" << right
+            << setw(8) << "ops" << setw(10) << "mean" << setw(10) << "p50" << setw(10) << "p90"
+            << setw(10) << "p99" << setw(10) << "p99.9" << setw(10) << "max"
+            << setw(12) << "ops/s" << setw(12) << "items/s" << endl;
+
+        out << fixed << setprecision(1);
+        for (size_t i = 0 ; i < results.size() ; ++i) {
+            const BenchResult& r = results[i];
+            const LatencyHistogram& h = r.latencies;
+            out << left << setw(10) << r.name << right
+                << setw(8) << h.count()
+                << setw(10) << h.mean() / 1000
+                << setw(10) << h.percentile(50) / 1000.0
+                << setw(10) << h.percentile(90) / 1000.0
+                << setw(10) << h.percentile(99) / 1000.0
+                << setw(10) << h.percentile(99.9) / 1000.0
+                << setw(10) << h.max() / 1000.0
+                << setw(12) << throughput(r)
+                << setw(12) << itemThroughput(r);
+            if (r.errors) out << "  (" << r.errors << " errors)";
+            out << endl;
+        }
+    }
 
-    cout << " * <BENCH10> Insertion of " << nb_stmt << " statements with 'waitForAck=false'" << endl;
+    out.flush();
+}
 
-    for (int i = 0 ; i < nb_stmt ; i++)
-    {
-        Class testClass = Class("test");
-        Concept test = Concept::create(testClass);
+int main(int argc, char* argv[]) {
+
+    //////////////////////////////////////////////////////////////////////
+    ////////// Command-line parsing
+    //////////////////////////////////////////////////////////////////////
+
+    po::options_description desc("Allowed options");
+    desc.add_options()
+            ("help,h", "produce help message")
+            ("host", po::value<string>()->default_value("localhost"), "knowledge base host")
+            ("port", po::value<string>()->default_value("6969"), "knowledge base port")
+            ("iterations,n", po::value<size_t>(&iterations)->default_value(10), "number of measured runs of each case")
+            ("warmup,w", po::value<size_t>(&warmup)->default_value(2), "number of unmeasured runs of each case, before the measured ones")
+            ("size,s", po::value<size_t>(&benchSize)->default_value(100), "number of statements of the insertion cases")
+            ("case,c", po::value<vector<string>>(), "run only these cases (eg, -c BENCH02 -c BENCH03)")
+            ("format,f", po::value<string>(&format)->default_value("text"), "output format: text, json or csv")
+            ("output,o", po::value<string>(), "write the results to this file instead of the standard output")
+            ("list,l", "list the benchmark cases");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    vector<BenchCase> cases = benchCases();
+
+    if (vm.count("help")) {
+        cout << "Usage: oro-benchmark [options]" << endl << endl;
+        cout << desc << endl;
+        cout << "Runs a set of benchmark cases against a KB-API compatible knowledge base, and\n"
+                "reports the latency distribution and the throughput of each case.\n";
+        return 1;
     }
 
-        gettimeofday(&time, NULL);
-        timetable["<BENCH10> insertion statements without waiting for ack"] = time;
+    if (vm.count("list")) {
+        for (size_t i = 0 ; i < cases.size() ; ++i)
+            cout << cases[i].name << "\t" << cases[i].description << endl;
+        return 0;
+    }
 
+    if (format != "text" && format != "json" && format != "csv") {
+        cerr << "Unknown output format: " << format << endl;
+        return 1;
+    }
 
+    set<string> selected;
+    if (vm.count("case")) {
+        vector<string> names = vm["case"].as<vector<string>>();
+        selected.insert(names.begin(), names.end());
+    }
 
-    //  TEST 11 //
+    ofstream file;
+    if (vm.count("output")) {
+        file.open(vm["output"].as<string>().c_str());
+        if (!file) {
+            cerr << "Can not open " << vm["output"].as<string>() << endl;
+            return 1;
+        }
+        output = &file;
+    }
 
-    cout << " * <BENCH11> Insertion of "<< nb_stmt << " statements with buffering and without waiting for ack" << endl;
+    //We catch ctrl+c to report the cases run so far
+    signal( SIGINT,sigproc);
 
-    onto->bufferize();
-    for (int i = 0 ; i < nb_stmt ; i++)
     {
-        Class testClass = Class("test");
-        Concept test = Concept::create(testClass);
-    }
-    onto->flush();
-
-        gettimeofday(&time, NULL);
-        timetable["<BENCH11> insertion buffered statements without waiting for ack"] = time;
+    SocketConnector connector(vm["host"].as<string>(), vm["port"].as<string>());
+    Ontology* onto;
 
+    try {
+        onto = Ontology::createWithConnector(connector);
+    } catch (OntologyServerException ose) {
+        cerr << "Server error: " << ose.what() << endl;
+        return 1;
     }
 
-    gettimeofday(&time, NULL);
-    timetable["Time to flush"] = time;
-
+    cerr << " * Connected to ontology server on " << vm["host"].as<string>() << ":" << vm["port"].as<string>() << endl;
 
-    displayTime();
+    Bench bench(onto, benchSize);
 
+    //The initial facts the query cases rely on.
+    onto->add(Statement("gorilla rdf:type Monkey"));
+    onto->add(Statement("gorilla age 12^^xsd:int"));
+    onto->add(Statement("gorilla weight 75.2"));
 
-}
-/*
-class eventHandler
-{
-  string portName;
-public:
-  eventHandler(string portName) : portName(portName) { }
-
-  void operator()()
-  {
-    BufferedPort<Bottle> eventPort;
-    eventPort.open(("/" + portName).c_str());
+    for (size_t i = 0 ; i < cases.size() ; ++i) {
+        const BenchCase& c = cases[i];
+        if (!selected.empty() && !selected.count(c.name)) continue;
 
-    Bottle *incomingEventBottle = eventPort.read();
+        cerr << " * <" << c.name << "> " << c.description << endl;
 
-    if (incomingEventBottle != NULL) {
-    cout << "BREAKING NEWS: A donkey appeared in the ontology!" << endl;
-    } else {
-    cout << "bouhouh...no events at all!" << endl;
-    }
+        BenchResult result;
+        result.name = c.name;
+        result.description = c.description;
+        result.itemsPerOp = c.itemsPerOp;
 
-    {
-        boost::mutex::scoped_lock lock(mut);
-        waitingForEvent = false;
-        cond.notify_all();
+        bench.errors = 0;
 
-    }
+        try {
+            bench.recordInto(NULL);
+            for (size_t n = 0 ; n < warmup ; ++n) c.run(bench);
 
-  }
+            bench.errors = 0;
+            bench.recordInto(&result.latencies);
+            for (size_t n = 0 ; n < iterations ; ++n) c.run(bench);
+        } catch (OntologyServerException e) {
+            cerr << "   Server error: " << e.what() << endl;
+            bench.errors++;
+        } catch (OntologyException e) {
+            cerr << "   Error: " << e.what() << endl;
+            bench.errors++;
+        }
 
-};
-*/
+        onto->alwaysWaitForAcknowledgment(true);
 
-void displayTime()
-{
-    double tick_ms = ((double) CLOCKS_PER_SEC) / 1000;
-
-    cout << endl << "*************** Timetable *****************" << endl;
-        map<string, timeval>::iterator bench = timetable.begin();
-        timeval tmp = (*bench).second;
-    ++bench;
-
-    for( ; bench != timetable.end() ; ++bench) {
-                int ms_duration = ((*bench).second.tv_sec * 1000 + (*bench).second.tv_usec / 1000) -
-                                  (tmp.tv_sec * 1000 + tmp.tv_usec / 1000);
-                cout << (*bench).first << " -> " << ms_duration << "ms" << endl;
-        tmp = (*bench).second;
+        result.errors = bench.errors;
+        results.push_back(result);
+    }
     }
 
-    cout << "*******************************************" << endl;
+    report();
 
+    return 0;
 }
 
-void displayCollec(const set<string>& result)
-{
-    copy(result.begin(), result.end(), ostream_iterator<string>(cout, "\n")); //ce n'est pas moi qui ait écrit ça
-}
-
-
 void sigproc(int sig)
 {
     signal(SIGINT, sigproc); /*  */
      /* NOTE some versions of UNIX will reset signal to default
      after each call. So for portability reset signal each time */
 
-    displayTime();
+    report();
 
     exit(0);
 }
@@ -16,6 +16,9 @@
 
 
 #include <string>
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <signal.h>
 
@@ -24,7 +27,10 @@
 #endif
 
 #include "oro.h"
+#include "batch.h"
 #include "socket_connector.h"
+#include "snapshot.h"
+#include "statement_parser.h"
 
 using namespace std;
 
@@ -37,6 +43,60 @@ void sigproc(int);
 string hostname;
 string port;
 
+// Streams the whole knowledge base, page by page of subjects, into a binary
+// snapshot.
+int exportSnapshot(Ontology* onto, const string& path, size_t pageSize) {
+
+	SnapshotWriter writer(path);
+	StatementParser parser;
+	set<string> subjects;
+	size_t offset = 0;
+	size_t invalid = 0;
+
+	do {
+		ostringstream query;
+		query << "SELECT DISTINCT ?s WHERE { ?s ?p ?o } ORDER BY ?s LIMIT " << pageSize << " OFFSET " << offset;
+
+		subjects.clear();
+		onto->query("s", query.str(), subjects);
+
+		// The getInfos of the whole page in one round-trip.
+		Batch batch = onto->batch();
+		vector<BatchResult<set<string> > > pageInfos;
+		for (set<string>::const_iterator subject = subjects.begin() ; subject != subjects.end() ; ++subject)
+			pageInfos.push_back(batch.getInfos(*subject));
+		batch.execute();
+
+		for (size_t i = 0 ; i < pageInfos.size() ; ++i) {
+			const set<string>* infos;
+			try {
+				infos = &pageInfos[i].get();
+			} catch (ResourceNotFoundOntologyException &e) {
+				continue;
+			}
+
+			Statement stmt(Concept::nothing, Property(Symbol()), Concept::nothing);
+			for (set<string>::const_iterator info = infos->begin() ; info != infos->end() ; ++info) {
+				if (parser.parse(*info, stmt)) writer.add(stmt);
+				else {
+					cerr << endl << "[WW] Skipping <" << *info << ">: " << parser.lastError() << endl;
+					invalid++;
+				}
+			}
+		}
+
+		offset += subjects.size();
+		cout << "\r" << offset << " resources, " << writer.size() << " statements" << flush;
+
+	} while (subjects.size() == pageSize);
+
+	writer.close();
+
+	cout << endl << "done." << endl;
+
+	return invalid ? 1 : 0;
+}
+
 int main(int argc, char* argv[]) {
 
 	string path;
@@ -44,8 +104,9 @@ int main(int argc, char* argv[]) {
 	Ontology* onto;
 	
 	cout << "********* oro-export - Export the current ontology to a file *********" << endl;
-	if (argc != 3 && argc != 4){
-		cout << "Syntax:\n> oro-server host port [path]" << endl << "If no path is provided, the default one ('$(server_working_directory)/openrobots.owl') is used." << endl;
+	if (argc < 3 || argc > 6){
+		cout << "Syntax:\n> oro-export host port [path]" << endl << "If no path is provided, the default one ('$(server_working_directory)/openrobots.owl') is used." << endl;
+		cout << "> oro-export host port --snapshot file [page size]" << endl << "Streams the ontology into a local binary snapshot, that oro-import can load. Subjects are retrieved by pages of 'page size' (default: 500)." << endl;
 		return(0);
 	}
 
@@ -55,7 +116,14 @@ int main(int argc, char* argv[]) {
 	hostname = argv[1];
 	port = argv[2];
 	
-	if (argc == 3){
+	bool snapshot = argc >= 5 && string(argv[3]) == "--snapshot";
+	size_t pageSize = 500;
+
+	if (snapshot) {
+		path = argv[4];
+		if (argc == 6) pageSize = max(1, atoi(argv[5]));
+	}
+	else if (argc == 3){
 		cout << "Default path used. If you wish, you can provide a path + file name."<<endl;
 		path = "openrobots.owl";
 	}
@@ -68,6 +136,18 @@ int main(int argc, char* argv[]) {
 
 	cout << "Exporting the current ontology to " << path << "... ";
 
+	if (snapshot) {
+		cout << endl;
+		try {
+			return exportSnapshot(onto, path, pageSize);
+		} catch (OntologyServerException &e) {
+			cerr << endl << "Server error: " << e.what() << endl;
+		} catch (OntologyException &e) {
+			cerr << endl << "Error! " << e.what() << endl;
+		}
+		exit(1);
+	}
+
 	try {
 		onto->save(path);
 	} catch (OntologyServerException &e)
@@ -0,0 +1,220 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+// Measures the wake-up latency of the handoff of a response from the
+// listener thread to the thread waiting for it, with the former
+// queue + mutex + notify_all scheme, and with ResponseSlot.
+// It does not need any oro-server.
+
+#include <boost/program_options.hpp>
+
+#include <string>
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <chrono>
+
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+
+#include "oro_connector.h"
+#include "response_slot.h"
+
+using namespace std;
+using namespace oro;
+namespace po = boost::program_options;
+
+typedef std::chrono::steady_clock Clock;
+
+// Nanoseconds since the start of the program.
+static long long now_ns() {
+    static const Clock::time_point origin = Clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - origin).count();
+}
+
+static ServerResponse makeResponse() {
+    ServerResponse res;
+    res.status = ServerResponse::ok;
+    res.raw_result = "[\"gorilla rdf:type Monkey\",\"gorilla age 12\"]";
+    set<string> result;
+    result.insert("gorilla rdf:type Monkey");
+    result.insert("gorilla age 12");
+    res.result = result;
+    return res;
+}
+
+static void report(const string& name, vector<long long>& latencies) {
+    sort(latencies.begin(), latencies.end());
+
+    long long sum = 0;
+    for (size_t i = 0 ; i < latencies.size() ; ++i) sum += latencies[i];
+
+    cout << name << endl;
+    cout << "\tmean: " << sum / (long long) latencies.size() / 1000.0 << "us"
+         << "\tp50: " << latencies[latencies.size() * 50 / 100] / 1000.0 << "us"
+         << "\tp99: " << latencies[latencies.size() * 99 / 100] / 1000.0 << "us"
+         << "\tmax: " << latencies.back() / 1000.0 << "us" << endl;
+}
+
+/**
+ * Former scheme: the listener pushes a copy of the response in a shared queue
+ * and wakes up every thread waiting on the condition variable.
+ *
+ * Like ResponseSlot::wait(), the caller first polls for its response
+ * ORO_SLOT_SPIN times, with the same pause, before going to sleep: only the
+ * handoff differs between the two benchmarks.
+ */
+static vector<long long> benchQueue(int iterations, int idle_waiters) {
+
+    boost::mutex outbound_lock;
+    boost::condition_variable gotResult;
+    queue<ServerResponse> outbound_results;
+    bool stop = false;
+
+    boost::atomic<long long> sent_at(0);
+    boost::atomic<int> requested(0);
+    boost::atomic<int> pushed(0);
+    vector<long long> latencies;
+
+    // Other callers, waiting for their own response.
+    boost::thread_group idle;
+    for (int i = 0 ; i < idle_waiters ; ++i) {
+        idle.create_thread([&]() {
+            boost::unique_lock<boost::mutex> lock(outbound_lock);
+            while (!stop) gotResult.wait(lock);
+        });
+    }
+
+    boost::thread listener([&]() {
+        ServerResponse res = makeResponse();
+        for (int i = 0 ; i < iterations ; ++i) {
+            while (requested.load() <= i) boost::this_thread::yield();
+            boost::lock_guard<boost::mutex> lock(outbound_lock);
+            sent_at = now_ns();
+            outbound_results.push(res);
+            pushed.store(i + 1, boost::memory_order_release);
+            gotResult.notify_all();
+        }
+    });
+
+    for (int i = 0 ; i < iterations ; ++i) {
+        requested++;
+
+        for (int spin = 0 ; spin < ORO_SLOT_SPIN ; ++spin) {
+            if (pushed.load(boost::memory_order_acquire) > i) break;
+            spinPause();
+        }
+
+        boost::unique_lock<boost::mutex> lock(outbound_lock);
+        while (outbound_results.empty()) gotResult.wait(lock);
+        ServerResponse res = outbound_results.front();
+        outbound_results.pop();
+        latencies.push_back(now_ns() - sent_at);
+    }
+
+    listener.join();
+    {
+        boost::lock_guard<boost::mutex> lock(outbound_lock);
+        stop = true;
+        gotResult.notify_all();
+    }
+    idle.join_all();
+
+    return latencies;
+}
+
+/**
+ * ResponseSlot: the response is moved in a slot owned by the caller, and only
+ * the caller is woken up.
+ */
+static vector<long long> benchSlot(int iterations, int idle_waiters) {
+
+    boost::atomic<ResponseSlot*> current(NULL);
+    boost::atomic<long long> sent_at(0);
+    vector<long long> latencies;
+
+    // Other callers, waiting for their own response.
+    vector<ResponseSlot*> idle_slots;
+    boost::thread_group idle;
+    for (int i = 0 ; i < idle_waiters ; ++i) {
+        ResponseSlot* slot = new ResponseSlot();
+        idle_slots.push_back(slot);
+        idle.create_thread([slot]() { slot->wait(); });
+    }
+
+    boost::thread listener([&]() {
+        for (int i = 0 ; i < iterations ; ++i) {
+            ResponseSlot* slot;
+            while ((slot = current.exchange(NULL)) == NULL) boost::this_thread::yield();
+            ServerResponse res = makeResponse();
+            sent_at = now_ns();
+            slot->fulfill(std::move(res));
+        }
+    });
+
+    for (int i = 0 ; i < iterations ; ++i) {
+        ResponseSlot slot;
+        current = &slot;
+        ServerResponse res = slot.wait();
+        latencies.push_back(now_ns() - sent_at);
+    }
+
+    listener.join();
+    for (size_t i = 0 ; i < idle_slots.size() ; ++i)
+        idle_slots[i]->fulfill(ServerResponse());
+    idle.join_all();
+    for (size_t i = 0 ; i < idle_slots.size() ; ++i)
+        delete idle_slots[i];
+
+    return latencies;
+}
+
+int main(int argc, char* argv[]) {
+
+    po::options_description desc("Allowed options");
+    desc.add_options()
+            ("help,h", "produce help message")
+            ("iterations,n", po::value<int>()->default_value(20000), "number of responses handed over")
+            ("waiters,w", po::value<int>()->default_value(4), "number of other callers waiting for a response");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        cout << "Usage: oro-handoff-bench [options]" << endl << endl;
+        cout << desc << endl;
+        cout << "Measures the latency between the moment the listener thread hands a response\n"
+                "over and the moment the waiting caller gets it. No server is needed.\n";
+        return 1;
+    }
+
+    int iterations = vm["iterations"].as<int>();
+    int waiters = vm["waiters"].as<int>();
+
+    cout << "********* ORO response handoff benchmark *********" << endl;
+    cout << iterations << " responses, " << waiters << " other waiting callers" << endl << endl;
+
+    vector<long long> queue_latencies = benchQueue(iterations, waiters);
+    report("queue + mutex + notify_all", queue_latencies);
+
+    vector<long long> slot_latencies = benchSlot(iterations, waiters);
+    report("ResponseSlot", slot_latencies);
+
+    return 0;
+}
@@ -0,0 +1,434 @@
+/*
+ * Copyright (c) 2016 Plymouth University Séverin Lemaignan severin.lemaignan@plymouth.ac.uk
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <boost/program_options.hpp>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <string>
+#include <deque>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "oro.h"
+#include "socket_connector.h"
+#include "statement_parser.h"
+#include "snapshot.h"
+
+using namespace std;
+
+using namespace oro;
+namespace po = boost::program_options;
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * Batches of statements waiting to be sent. The queue is bounded: the parser
+ * blocks when as many batches as senders are already waiting.
+ */
+class BatchQueue {
+public:
+    BatchQueue(size_t capacity) : _capacity(capacity), _closed(false), _aborted(false) {}
+
+    /**
+     * Queues a batch. If the queue was aborted, the batch is dropped and
+     * false is returned.
+     */
+    bool push(set<Statement>& batch) {
+        boost::unique_lock<boost::mutex> lock(_lock);
+        while (_batches.size() >= _capacity && !_aborted) _notFull.wait(lock);
+
+        if (_aborted) {
+            batch.clear();
+            return false;
+        }
+
+        _batches.push_back(set<Statement>());
+        _batches.back().swap(batch);
+        _notEmpty.notify_one();
+        return true;
+    }
+
+    bool pop(set<Statement>& batch) {
+        boost::unique_lock<boost::mutex> lock(_lock);
+        while (_batches.empty() && !_closed) _notEmpty.wait(lock);
+
+        if (_batches.empty()) return false;
+
+        batch.swap(_batches.front());
+        _batches.pop_front();
+        _notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        boost::lock_guard<boost::mutex> lock(_lock);
+        _closed = true;
+        _notEmpty.notify_all();
+    }
+
+    /**
+     * Drops the waiting batches, and unblocks the parser and the senders.
+     */
+    void abort() {
+        boost::lock_guard<boost::mutex> lock(_lock);
+        _closed = true;
+        _aborted = true;
+        _batches.clear();
+        _notEmpty.notify_all();
+        _notFull.notify_all();
+    }
+
+private:
+    size_t _capacity;
+    bool _closed;
+    bool _aborted;
+    deque<set<Statement> > _batches;
+    boost::mutex _lock;
+    boost::condition_variable _notEmpty;
+    boost::condition_variable _notFull;
+};
+
+class Importer {
+public:
+    Importer(Ontology* onto, const string& agent, size_t batchSize, size_t inFlight) :
+        _onto(onto),
+        _agent(agent),
+        _batchSize(batchSize),
+        _queue(inFlight),
+        _parsed(0),
+        _lineOffset(0),
+        _invalid(0),
+        _sent(0),
+        _failed(0),
+        _aborted(false),
+        _start(Clock::now()),
+        _lastReport(_start)
+    {
+        for (size_t i = 0 ; i < inFlight ; ++i)
+            _senders.create_thread(boost::bind(&Importer::send, this));
+    }
+
+    /**
+     * Starts a new file: the lines are numbered from 1 again.
+     */
+    void startFile(const string& path) {
+        _path = path;
+        _lineOffset = 0;
+    }
+
+    /**
+     * Parses a buffer of complete lines, and queues the statements.
+     */
+    void parse(boost::string_view buffer) {
+        vector<StatementParser::Error> errors;
+
+        _parsed += _parser.parseBuffer(buffer, boost::bind(&Importer::append, this, _1), &errors);
+
+        for (size_t i = 0 ; i < errors.size() ; ++i)
+            cerr << "[WW] " << _path << ", line " << _lineOffset + errors[i].line << ": " << errors[i].message << endl;
+        _invalid += errors.size();
+
+        _lineOffset += count(buffer.begin(), buffer.end(), '\n');
+    }
+
+    /**
+     * Decodes a binary snapshot (cf oro-export), and queues the statements.
+     */
+    bool load(boost::string_view snapshot) {
+        try {
+            _parsed += SnapshotReader::read(snapshot, boost::bind(&Importer::append, this, _1));
+        } catch (OntologyException& e) {
+            cerr << "[EE] " << e.what() << endl;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Sends the last batch, and waits for every batch to be acknowledged.
+     */
+    void finish() {
+        if (!_batch.empty() && !_aborted) _queue.push(_batch);
+        _queue.close();
+        _senders.join_all();
+
+        double elapsed = std::chrono::duration<double>(Clock::now() - _start).count();
+
+        cerr << endl;
+        cerr << "Parsed " << _parsed << " statements (" << _invalid << " invalid lines)" << endl;
+        cerr << "Sent " << _sent << " statements in " << elapsed << "s: "
+             << (size_t) (_sent / elapsed) << " statements/sec" << endl;
+        if (_failed) cerr << "[EE] " << _failed << " statements could not be added" << endl;
+        if (_aborted) cerr << "[EE] Import aborted: the remaining statements were not sent" << endl;
+    }
+
+    /**
+     * Whether the import was stopped because the connection to the server
+     * failed.
+     */
+    bool aborted() const {return _aborted;}
+
+    bool failed() const {return _failed > 0 || _invalid > 0 || _aborted;}
+
+private:
+    void append(const Statement& stmt) {
+        if (_aborted) return;
+
+        _batch.insert(stmt);
+
+        if (_batch.size() >= _batchSize) {
+            _queue.push(_batch);
+            report();
+        }
+    }
+
+    void report() {
+        Clock::time_point now = Clock::now();
+        if (now - _lastReport < std::chrono::seconds(1)) return;
+
+        double elapsed = std::chrono::duration<double>(now - _start).count();
+        cerr << "\r" << _sent << " statements sent (" << (size_t) (_sent / elapsed) << " statements/sec)" << flush;
+        _lastReport = now;
+    }
+
+    void send() {
+        set<Statement> batch;
+
+        while (_queue.pop(batch)) {
+            try {
+                if (_agent.empty()) _onto->add(batch);
+                else _onto->addForAgent(_agent, batch);
+                _sent += batch.size();
+            } catch (OntologyServerException& ose) {
+                // Only this batch was rejected: the next ones may be fine.
+                cerr << "[EE] Server error: " << ose.what() << endl;
+                _failed += batch.size();
+            } catch (ConnectorException& ce) {
+                cerr << "[EE] Connection error: " << ce.what() << endl;
+                _failed += batch.size();
+                abort();
+            } catch (std::exception& e) {
+                cerr << "[EE] " << e.what() << endl;
+                _failed += batch.size();
+                abort();
+            }
+            batch.clear();
+        }
+    }
+
+    // Stops the import: the other senders and the parser stop at their next
+    // batch.
+    void abort() {
+        _aborted = true;
+        _queue.abort();
+    }
+
+    Ontology* _onto;
+    string _agent;
+    size_t _batchSize;
+
+    StatementParser _parser;
+    set<Statement> _batch;
+    BatchQueue _queue;
+    boost::thread_group _senders;
+
+    size_t _parsed;
+    string _path;
+    size_t _lineOffset;
+    size_t _invalid;
+    boost::atomic<size_t> _sent;
+    boost::atomic<size_t> _failed;
+    boost::atomic<bool> _aborted;
+
+    Clock::time_point _start;
+    Clock::time_point _lastReport;
+};
+
+// Maps the whole file in memory: the statements are parsed in place.
+bool importFile(Importer& importer, const string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cerr << "[EE] Can not open " << path << ": " << strerror(errno) << endl;
+        return false;
+    }
+
+    struct stat st;
+    fstat(fd, &st);
+
+    if (st.st_size == 0) {
+        close(fd);
+        return true;
+    }
+
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        cerr << "[EE] Can not map " << path << ": " << strerror(errno) << endl;
+        return false;
+    }
+
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    boost::string_view content((const char*) data, st.st_size);
+    bool ok = true;
+
+    if (SnapshotReader::isSnapshot(content)) ok = importer.load(content);
+    else importer.parse(content);
+
+    munmap(data, st.st_size);
+    return ok;
+}
+
+// Reads stdin by chunks. The last, incomplete line of a chunk is kept for the
+// next one.
+bool importStream(Importer& importer, FILE* stream) {
+    const size_t CHUNK_SIZE = 1 << 20;
+
+    vector<char> buffer(CHUNK_SIZE);
+    size_t pending = 0;
+
+    while (!importer.aborted()) {
+        if (pending == buffer.size()) buffer.resize(buffer.size() * 2); // very long line
+
+        size_t read = fread(&buffer[pending], 1, buffer.size() - pending, stream);
+        size_t available = pending + read;
+
+        if (read == 0) {
+            if (available) importer.parse(boost::string_view(&buffer[0], available));
+            return !ferror(stream);
+        }
+
+        boost::string_view chunk(&buffer[0], available);
+        size_t eol = chunk.rfind('\n');
+
+        if (eol == boost::string_view::npos) {
+            pending = available;
+            continue;
+        }
+
+        importer.parse(chunk.substr(0, eol + 1));
+
+        pending = available - eol - 1;
+        memmove(&buffer[0], &buffer[eol + 1], pending);
+    }
+
+    return false;
+}
+
+int main(int argc, char* argv[]) {
+
+    //////////////////////////////////////////////////////////////////////
+    ////////// Command-line parsing
+    //////////////////////////////////////////////////////////////////////
+
+    po::positional_options_description p;
+    p.add("file", -1);
+
+    po::options_description desc("Allowed options");
+    desc.add_options()
+            ("help,h", "produce help message")
+            ("host", po::value<string>()->default_value("localhost"), "knowledge base host")
+            ("port", po::value<string>()->default_value("6969"), "knowledge base port")
+            ("agent,a", po::value<string>()->default_value(""), "add the statements to the model of this agent")
+            ("batch-size,b", po::value<size_t>()->default_value(1000), "number of statements per request")
+            ("in-flight,j", po::value<size_t>()->default_value(4), "number of requests sent concurrently");
+
+    po::options_description hidden("Hidden options");
+    hidden.add_options()
+            ("file", po::value<vector<string>>(), "statement file(s) to import")
+            ;
+
+    po::options_description cmd_line("Allowed options");
+    cmd_line.add(desc).add(hidden);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv)
+                        .options(cmd_line)
+                        .positional(p)
+                        .run(), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        cout << "Usage: oro-import [options] [file...]" << endl;
+        cout << endl;
+
+        cout << desc;
+        cout << endl;
+
+        cout << "Imports statements, one per line, from files (or from the standard\n"
+                "input if no file or '-' is given) into a KB-API compatible knowledge base.\n"
+                "Blank lines and lines starting with '#' are ignored.\n"
+                "Files can also be binary snapshots, as written by 'oro-export --snapshot'.\n\n";
+        cout << "Report bugs to: " << endl;
+        cout << "https://www.github.com/severin-lemaignan/liboro/issues" << endl;
+
+        return 1;
+    }
+
+    vector<string> files;
+    if (vm.count("file")) files = vm["file"].as<vector<string>>();
+    else files.push_back("-");
+
+    size_t batchSize = max<size_t>(1, vm["batch-size"].as<size_t>());
+    size_t inFlight = max<size_t>(1, vm["in-flight"].as<size_t>());
+
+    //////////////////////////////////////////////////////////////////////
+    ////////////////////////////////////////////////////////////////////////
+
+    bool ok = true;
+
+    {
+    Ontology* onto;
+    SocketConnector connector(vm["host"].as<string>(), vm["port"].as<string>());
+
+    try {
+        onto = Ontology::createWithConnector(connector);
+    } catch (OntologyServerException& ose) {
+        cerr << "Server error: " << ose.what() << endl;
+        return 1;
+    }
+
+    Importer importer(onto, vm["agent"].as<string>(), batchSize, inFlight);
+
+    for (const auto& file : files) {
+        if (importer.aborted()) break;
+
+        importer.startFile(file == "-" ? "<stdin>" : file);
+
+        if (file == "-") ok = importStream(importer, stdin) && ok;
+        else ok = importFile(importer, file) && ok;
+    }
+
+    importer.finish();
+    ok = ok && !importer.failed();
+    }
+
+    return ok ? 0 : 1;
+
+}
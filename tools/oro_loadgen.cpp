@@ -0,0 +1,474 @@
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+// Drives a knowledge base with a mix of operations from several client
+// threads, either as fast as possible (closed loop) or at a fixed arrival
+// rate (open loop), and reports the throughput and the latency percentiles
+// of each type of operation over time.
+
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <signal.h>
+#include <set>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <thread>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#include "oro.h"
+#include "oro_connector.h"
+#include "socket_connector.h"
+#include "latency_histogram.h"
+
+using namespace std;
+
+using namespace oro;
+namespace po = boost::program_options;
+
+typedef std::chrono::steady_clock Clock;
+
+enum OpType {ADD, FIND, QUERY, GET_INFOS, EVENT, NB_OP_TYPES};
+
+const char* opNames[NB_OP_TYPES] = {"add", "find", "query", "getInfos", "event"};
+
+// Set on ctrl+c, or at the end of the run.
+boost::atomic<bool> stopped(false);
+
+// Set when an operation failed on the client side (eg, the connection was
+// lost): the run is stopped, since every following operation would fail.
+boost::atomic<bool> aborted(false);
+
+void sigproc(int sig) {
+    stopped = true;
+}
+
+void abortRun(const char* reason) {
+    if (!aborted.exchange(true))
+        cerr << "[EE] Stopping the run: " << reason << endl;
+    stopped = true;
+}
+
+/**
+ * Counts the events fired by the 'event' operations.
+ */
+class EventCounter : public OroEventObserver {
+public:
+    EventCounter() : nbEvents(0) {}
+
+    void operator()(const OroEvent& evt) {
+        nbEvents++;
+    }
+
+    boost::atomic<size_t> nbEvents;
+};
+
+/**
+ * Latencies of the operations since the last report.
+ */
+struct IntervalStats {
+    IntervalStats() : histograms(NB_OP_TYPES), errors(NB_OP_TYPES, 0) {}
+
+    void reset() {
+        for (size_t i = 0 ; i < NB_OP_TYPES ; ++i) {
+            histograms[i].reset();
+            errors[i] = 0;
+        }
+    }
+
+    void merge(const IntervalStats& other) {
+        for (size_t i = 0 ; i < NB_OP_TYPES ; ++i) {
+            histograms[i].merge(other.histograms[i]);
+            errors[i] += other.errors[i];
+        }
+    }
+
+    vector<LatencyHistogram> histograms;
+    vector<size_t> errors;
+};
+
+struct LoadConfig {
+    size_t threads;
+    double rate;            // total arrival rate, in ops/s. 0 for closed loop
+    Clock::time_point start;
+    Clock::time_point end;
+    vector<double> mix;     // weight of each type of operation
+    size_t seeds;           // number of individuals the read operations hit
+};
+
+/**
+ * A client thread. Its stats are only shared with the reporting thread,
+ * which collects them at each interval.
+ */
+class Worker {
+public:
+    Worker(Ontology* onto, const LoadConfig& config, EventCounter& counter, size_t id) :
+        _onto(onto), _config(config), _counter(counter), _id(id), _nbOps(0),
+        _random(id + 1), _mix(config.mix.begin(), config.mix.end()), _seed(0, config.seeds - 1) {}
+
+    void run() {
+        // In open loop, each thread gets rate/threads ops/s, the threads
+        // being out of phase.
+        std::chrono::nanoseconds period(0);
+        Clock::time_point next = _config.start;
+
+        if (_config.rate > 0) {
+            period = std::chrono::nanoseconds((long long) (1e9 * _config.threads / _config.rate));
+            next += period * _id / _config.threads;
+        }
+
+        while (!stopped) {
+            Clock::time_point intended;
+
+            if (_config.rate > 0) {
+                intended = next;
+                next += period;
+                if (intended >= _config.end) break;
+                if (intended > Clock::now()) std::this_thread::sleep_until(intended);
+            }
+            else {
+                intended = Clock::now();
+                if (intended >= _config.end) break;
+            }
+
+            OpType op = (OpType) _mix(_random);
+            bool failed = false;
+
+            try {
+                execute(op);
+            } catch (OntologyServerException& ose) {
+                failed = true;
+            } catch (ConnectorException& ce) {
+                failed = true;
+                abortRun(ce.what());
+            } catch (std::exception& e) {
+                failed = true;
+                abortRun(e.what());
+            }
+
+            // In open loop, the latency is measured from the time the
+            // operation *should* have started: when the server falls
+            // behind, the queueing delay is accounted for (no coordinated
+            // omission).
+            boost::uint64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - intended).count();
+
+            boost::lock_guard<boost::mutex> lock(_mutex);
+            _stats.histograms[op].record(latency);
+            if (failed) _stats.errors[op]++;
+        }
+    }
+
+    /**
+     * Adds the stats since the last call to \p stats.
+     */
+    void collect(IntervalStats& stats) {
+        boost::lock_guard<boost::mutex> lock(_mutex);
+        stats.merge(_stats);
+        _stats.reset();
+    }
+
+private:
+    string name(const string& prefix) {
+        ostringstream res;
+        res << prefix << _id << "_" << _nbOps++;
+        return res.str();
+    }
+
+    void execute(OpType op) {
+        switch (op) {
+        case ADD:
+            _onto->add(Statement(name("loadgen_object_") + " rdf:type LoadgenObject"));
+            break;
+
+        case FIND: {
+            set<Concept> result;
+            _onto->find("object", "?object rdf:type LoadgenSeed", result);
+            break;
+        }
+
+        case QUERY: {
+            set<string> result;
+            _onto->query("object", "SELECT ?object WHERE { ?object rdf:type oro:LoadgenSeed } LIMIT 10", result);
+            break;
+        }
+
+        case GET_INFOS: {
+            set<string> result;
+            ostringstream seed;
+            seed << "loadgen_seed_" << _seed(_random);
+            _onto->getInfos(seed.str(), result);
+            break;
+        }
+
+        case EVENT: {
+            // A one-shot event, immediately triggered: the server creates
+            // and discards a subscription.
+            string fact = name("loadgen_trigger_") + " rdf:type LoadgenTrigger";
+            set<string> pattern;
+            pattern.insert(fact);
+
+            _onto->registerEvent(_counter, FACT_CHECKING, ON_TRUE_ONE_SHOT, pattern, "");
+            _onto->add(Statement(fact));
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+
+    Ontology* _onto;
+    const LoadConfig& _config;
+    EventCounter& _counter;
+    size_t _id;
+    size_t _nbOps;
+
+    std::mt19937 _random;
+    std::discrete_distribution<int> _mix;
+    std::uniform_int_distribution<size_t> _seed;
+
+    boost::mutex _mutex;
+    IntervalStats _stats;
+};
+
+/**
+ * Parses an operation mix like "add=40,find=30,query=10,getInfos=15,event=5".
+ */
+vector<double> parseMix(const string& spec) {
+    vector<double> mix(NB_OP_TYPES, 0.0);
+
+    vector<string> entries;
+    boost::split(entries, spec, boost::is_any_of(","));
+
+    for (size_t i = 0 ; i < entries.size() ; ++i) {
+        size_t eq = entries[i].find('=');
+        string op = boost::trim_copy(entries[i].substr(0, eq));
+
+        size_t type = 0;
+        while (type < NB_OP_TYPES && op != opNames[type]) type++;
+
+        if (type == NB_OP_TYPES || eq == string::npos)
+            throw po::error("invalid operation mix entry '" + entries[i] + "'");
+
+        mix[type] = atof(entries[i].substr(eq + 1).c_str());
+    }
+
+    double total = 0.0;
+    for (size_t i = 0 ; i < NB_OP_TYPES ; ++i) total += mix[i];
+    if (total <= 0.0) throw po::error("the operation mix is empty");
+
+    return mix;
+}
+
+void printHeader(const string& format) {
+    if (format == "csv")
+        cout << "time,op,count,ops_per_s,errors,p50_us,p90_us,p99_us,p999_us,max_us" << endl;
+    else
+        cout << setw(8) << "time" << "  " << left << setw(10) << "op" << right
+             << setw(10) << "ops/s" << setw(8) << "errors"
+             << setw(10) << "p50(us)" << setw(10) << "p90(us)" << setw(10) << "p99(us)"
+             << setw(11) << "p99.9(us)" << setw(10) << "max(us)" << endl;
+}
+
+void printLine(const string& format, const string& time, const string& op,
+               const LatencyHistogram& histogram, size_t errors, double elapsed) {
+
+    double opsPerSecond = elapsed > 0 ? histogram.count() / elapsed : 0.0;
+
+    if (format == "csv") {
+        cout << time << "," << op << "," << histogram.count() << "," << opsPerSecond << "," << errors;
+        double percents[] = {50, 90, 99, 99.9};
+        for (size_t i = 0 ; i < 4 ; ++i) cout << "," << histogram.percentile(percents[i]) / 1e3;
+        cout << "," << histogram.max() / 1e3 << endl;
+    }
+    else {
+        cout << setw(8) << time << "  " << left << setw(10) << op << right << fixed << setprecision(1)
+             << setw(10) << opsPerSecond << setw(8) << errors
+             << setw(10) << histogram.percentile(50) / 1e3
+             << setw(10) << histogram.percentile(90) / 1e3
+             << setw(10) << histogram.percentile(99) / 1e3
+             << setw(11) << histogram.percentile(99.9) / 1e3
+             << setw(10) << histogram.max() / 1e3 << endl;
+    }
+}
+
+/**
+ * Prints one line per type of operation, and one for all of them.
+ */
+void printStats(const string& format, const string& time, const IntervalStats& stats, double elapsed) {
+    LatencyHistogram all;
+    size_t allErrors = 0;
+
+    for (size_t i = 0 ; i < NB_OP_TYPES ; ++i) {
+        if (stats.histograms[i].count() == 0) continue;
+
+        printLine(format, time, opNames[i], stats.histograms[i], stats.errors[i], elapsed);
+        all.merge(stats.histograms[i]);
+        allErrors += stats.errors[i];
+    }
+
+    printLine(format, time, "all", all, allErrors, elapsed);
+}
+
+int main(int argc, char* argv[]) {
+
+    //////////////////////////////////////////////////////////////////////
+    ////////// Command-line parsing
+    //////////////////////////////////////////////////////////////////////
+
+    LoadConfig config;
+    double duration;
+    double interval;
+    string mix;
+    string format;
+
+    po::options_description desc("Allowed options");
+    desc.add_options()
+            ("help,h", "produce help message")
+            ("host", po::value<string>()->default_value("localhost"), "knowledge base host")
+            ("port", po::value<string>()->default_value("6969"), "knowledge base port")
+            ("threads,t", po::value<size_t>(&config.threads)->default_value(4), "number of client threads")
+            ("rate,r", po::value<double>(&config.rate)->default_value(0), "open loop: total arrival rate, in operations per second. 0 (default) runs a closed loop, as fast as possible")
+            ("duration,d", po::value<double>(&duration)->default_value(10), "duration of the run, in seconds")
+            ("interval,i", po::value<double>(&interval)->default_value(1), "time between two reports, in seconds")
+            ("mix,m", po::value<string>(&mix)->default_value("add=40,find=20,query=10,getInfos=25,event=5"), "relative weights of the operations (add, find, query, getInfos, event)")
+            ("seeds,s", po::value<size_t>(&config.seeds)->default_value(100), "number of individuals created before the run, and hit by the read operations")
+            ("format,f", po::value<string>(&format)->default_value("text"), "output format: text or csv");
+
+    po::variables_map vm;
+
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+
+        if (vm.count("help")) {
+            cout << "Usage: oro-loadgen [options]" << endl << endl;
+            cout << desc << endl;
+            cout << "Drives a KB-API compatible knowledge base with a mix of operations from\n"
+                    "several client threads, and reports the throughput and the latency\n"
+                    "percentiles of each type of operation over time.\n\n"
+                    "In open loop (--rate), the latencies are measured from the scheduled start\n"
+                    "of the operations: when the server cannot keep up, the queueing delay is\n"
+                    "part of the reported latencies.\n\n"
+                    "To spread the load over several processes, run several instances with\n"
+                    "'--format csv'.\n";
+            return 1;
+        }
+
+        config.mix = parseMix(mix);
+        if (config.threads == 0 || config.seeds == 0 || interval <= 0)
+            throw po::error("--threads, --seeds and --interval must be strictly positive");
+    }
+    catch (po::error& e) {
+        cerr << "[EE] " << e.what() << endl;
+        return 1;
+    }
+
+    SocketConnector connector(vm["host"].as<string>(), vm["port"].as<string>());
+    Ontology* onto;
+
+    try {
+        onto = Ontology::createWithConnector(connector);
+    } catch (OntologyServerException ose) {
+        cerr << "[EE] Could not connect to the ontology server: " << ose.what() << endl;
+        return 1;
+    }
+
+    // The individuals hit by the read operations
+    set<Statement> seeds;
+    for (size_t i = 0 ; i < config.seeds ; ++i) {
+        ostringstream seed;
+        seed << "loadgen_seed_" << i;
+        seeds.insert(Statement(seed.str() + " rdf:type LoadgenSeed"));
+        seeds.insert(Statement(seed.str() + " rdfs:label \"seed " + boost::lexical_cast<string>(i) + "\""));
+    }
+    onto->add(seeds);
+
+    //We catch ctrl+c to report the run so far
+    signal(SIGINT, sigproc);
+
+    EventCounter counter;
+
+    config.start = Clock::now();
+    config.end = config.start + std::chrono::nanoseconds((long long) (duration * 1e9));
+
+    vector<Worker*> workers;
+    boost::thread_group threads;
+    for (size_t i = 0 ; i < config.threads ; ++i) {
+        workers.push_back(new Worker(onto, config, counter, i));
+        threads.create_thread(boost::bind(&Worker::run, workers.back()));
+    }
+
+    if (config.rate > 0)
+        cerr << "[II] Open loop, " << config.rate << " ops/s";
+    else
+        cerr << "[II] Closed loop";
+    cerr << ", " << config.threads << " threads, " << duration << "s" << endl;
+
+    printHeader(format);
+
+    IntervalStats total;
+    Clock::time_point last = config.start;
+
+    while (!stopped) {
+        Clock::time_point next = last + std::chrono::nanoseconds((long long) (interval * 1e9));
+        if (next > config.end) next = config.end;
+
+        while (!stopped && Clock::now() < next)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        if (Clock::now() >= config.end) stopped = true;
+        if (stopped) break; // the last interval goes with the final collection
+
+        IntervalStats stats;
+        for (size_t i = 0 ; i < workers.size() ; ++i) workers[i]->collect(stats);
+        total.merge(stats);
+
+        Clock::time_point now = Clock::now();
+        ostringstream time;
+        time << fixed << setprecision(1) << std::chrono::duration<double>(now - config.start).count();
+
+        printStats(format, time.str(), stats, std::chrono::duration<double>(now - last).count());
+        last = now;
+    }
+
+    threads.join_all();
+
+    for (size_t i = 0 ; i < workers.size() ; ++i) {
+        workers[i]->collect(total);
+        delete workers[i];
+    }
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - config.start).count();
+
+    if (format != "csv") cout << endl;
+    printStats(format, "total", total, elapsed);
+
+    if (total.histograms[EVENT].count() > 0)
+        cerr << "[II] " << counter.nbEvents << " events received for " << total.histograms[EVENT].count() << " registered." << endl;
+
+    return aborted ? 1 : 0;
+}
@@ -0,0 +1,506 @@
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+// Benchmarks the client-side hot paths of liboro (serialization of the
+// requests, parsing of the responses, statements, buffers, events), without
+// any ontology server.
+
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <set>
+#include <map>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/program_options.hpp>
+
+#include "oro.h"
+#include "oro_connector.h"
+#include "socket_connector.h"
+#include "statement_parser.h"
+
+using namespace std;
+
+using namespace oro;
+namespace po = boost::program_options;
+
+typedef std::chrono::steady_clock Clock;
+
+/*******************************************************************************
+*                            Allocation counting                               *
+*******************************************************************************/
+
+// Every allocation of the process goes through these operators.
+static boost::atomic<size_t> nbAllocations(0);
+static boost::atomic<size_t> nbAllocatedBytes(0);
+
+void* operator new(size_t size) {
+    nbAllocations.fetch_add(1, boost::memory_order_relaxed);
+    nbAllocatedBytes.fetch_add(size, boost::memory_order_relaxed);
+
+    void* p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+/*******************************************************************************
+*                            Loopback connector                                *
+*******************************************************************************/
+
+/**
+ * Answers every request locally, so that an Ontology can be benchmarked
+ * without server.
+ */
+class LoopbackConnector : public IConnector {
+public:
+    LoopbackConnector() : evtCallback(NULL) {}
+
+    ServerResponse execute(const string& query, const vector<server_param_types>& args, bool waitForAck) {
+        ServerResponse res = ok();
+
+        if (query == "registerEvent" || query == "registerEventForAgent")
+            res.result = string("evt1");
+        return res;
+    }
+
+    ServerResponse execute(const string& query, const server_param_types& arg, bool waitForAck) {
+        return ok();
+    }
+
+    ServerResponse execute(const string& query, bool waitForAck) {
+        ServerResponse res = ok();
+
+        if (query == "stats") {
+            map<string, string> stats;
+            stats["version"] = "loopback";
+            res.result = stats;
+        }
+        return res;
+    }
+
+    void setEventCallback(void (*callback)(const string& event_id, const server_return_types& raw_event_content)) {
+        evtCallback = callback;
+    }
+
+    bool isConnected() {return true;}
+
+    void (*evtCallback)(const string& event_id, const server_return_types& raw_event_content);
+
+private:
+    ServerResponse ok() {
+        ServerResponse res;
+        res.status = ServerResponse::ok;
+        return res;
+    }
+};
+
+class CountingObserver : public OroEventObserver {
+public:
+    CountingObserver() : nbEvents(0) {}
+
+    void operator()(const OroEvent& evt) {
+        nbEvents++;
+    }
+
+    boost::atomic<size_t> nbEvents;
+};
+
+/*******************************************************************************
+*                                 Payloads                                     *
+*******************************************************************************/
+
+set<string> statements(size_t nb) {
+    set<string> res;
+    for (size_t i = 0 ; i < nb ; ++i) {
+        ostringstream stmt;
+        stmt << "object" << i << " rdf:type Cup";
+        res.insert(stmt.str());
+    }
+    return res;
+}
+
+set<string> quotedLiterals(size_t nb) {
+    set<string> res;
+    for (size_t i = 0 ; i < nb ; ++i) {
+        ostringstream stmt;
+        stmt << "human" << i << " says \"I said \\\"hello\\\", then \\\"bye\\\" (" << i << ")\"";
+        res.insert(stmt.str());
+    }
+    return res;
+}
+
+map<string, string> pairs(size_t nb) {
+    map<string, string> res;
+    for (size_t i = 0 ; i < nb ; ++i) {
+        ostringstream key;
+        key << "object" << i;
+        res[key.str()] = "instance";
+    }
+    return res;
+}
+
+// A list of pairs, as answered by 'lookup'.
+string pairsList(size_t nb) {
+    ostringstream res;
+    res << "[";
+    for (size_t i = 0 ; i < nb ; ++i)
+        res << (i ? "," : "") << "[\"object" << i << "\",\"instance\"]";
+    res << "]";
+    return res.str();
+}
+
+string serialized(const set<string>& data) {
+    string res;
+    SocketConnector::serializeSet(data, res);
+    return res;
+}
+
+string serialized(const map<string, string>& data) {
+    string res;
+    SocketConnector::serializeMap(data, res);
+    return res;
+}
+
+string statementLines(size_t nb) {
+    ostringstream res;
+    for (size_t i = 0 ; i < nb ; ++i)
+        res << "object" << i << " rdf:type oro:Cup\n"
+            << "object" << i << " rdfs:label \"cup number " << i << "\"@en\n";
+    return res.str();
+}
+
+/*******************************************************************************
+*                                  Runner                                      *
+*******************************************************************************/
+
+struct MicroBench {
+    string name;
+    boost::function<void()> run;
+};
+
+struct MicroResult {
+    string name;
+    size_t iterations;
+    double nsPerOp;
+    double allocationsPerOp;
+    double bytesPerOp;
+};
+
+// Keeps the results of the benchmarked functions alive.
+size_t sink = 0;
+
+MicroResult measure(const MicroBench& bench, double minTime) {
+    bench.run(); // warm-up
+
+    size_t iterations = 1;
+
+    while (true) {
+        size_t allocations = nbAllocations.load();
+        size_t bytes = nbAllocatedBytes.load();
+        Clock::time_point start = Clock::now();
+
+        for (size_t i = 0 ; i < iterations ; ++i) bench.run();
+
+        double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+        if (elapsed >= minTime || iterations >= 1000000000) {
+            MicroResult res;
+            res.name = bench.name;
+            res.iterations = iterations;
+            res.nsPerOp = elapsed * 1e9 / iterations;
+            res.allocationsPerOp = (double) (nbAllocations.load() - allocations) / iterations;
+            res.bytesPerOp = (double) (nbAllocatedBytes.load() - bytes) / iterations;
+            return res;
+        }
+
+        // Aim at 1.2 x the minimum time, growing at most 100 times per step.
+        double target = elapsed > 0 ? iterations * minTime * 1.2 / elapsed : iterations * 100;
+        iterations = max(iterations + 1, min(iterations * 100, (size_t) target));
+    }
+}
+
+vector<MicroBench> microBenches(LoopbackConnector& loopback, CountingObserver& observer) {
+    vector<MicroBench> benches;
+
+    // Payloads are built once, and captured by value.
+    set<string> smallSet = statements(5);
+    set<string> largeSet = statements(1000);
+    set<string> quotes = quotedLiterals(100);
+    map<string, string> smallMap = pairs(5);
+    map<string, string> largeMap = pairs(1000);
+
+    /**** Serialization of the requests ****/
+
+    benches.push_back({"ParametersSerializationHolder/small", [smallSet]() {
+        vector<server_param_types> args;
+        args.push_back(string("myself"));
+        args.push_back(smallSet);
+
+        ParametersSerializationHolder holder;
+        for (size_t i = 0 ; i < args.size() ; ++i) boost::apply_visitor(holder, args[i]);
+        sink += holder.getArgs().size();
+    }});
+
+    benches.push_back({"ParametersSerializationHolder/large", [largeSet]() {
+        vector<server_param_types> args;
+        args.push_back(string("myself"));
+        args.push_back(largeSet);
+
+        ParametersSerializationHolder holder;
+        for (size_t i = 0 ; i < args.size() ; ++i) boost::apply_visitor(holder, args[i]);
+        sink += holder.getArgs().size();
+    }});
+
+    // A complete request (as SocketConnector::request builds it), into a
+    // std::string, then into the arena of the thread.
+    vector<server_param_types> requestArgs;
+    requestArgs.push_back(string("myself"));
+    requestArgs.push_back(largeSet);
+
+    benches.push_back({"serializeRequest/string", [requestArgs]() {
+        ParametersSerializationHolder holder;
+        for (size_t i = 0 ; i < requestArgs.size() ; ++i) boost::apply_visitor(holder, requestArgs[i]);
+
+        string completeQuery = string("find") + MSG_SEPARATOR;
+        completeQuery += holder.getArgs();
+        completeQuery += MSG_FINALIZER;
+        sink += completeQuery.size();
+    }});
+
+    benches.push_back({"serializeRequest/arena", [requestArgs]() {
+        RequestArena& arena = RequestArena::local();
+        RequestArena::Scope scope(arena);
+
+        BasicParametersSerializationHolder<arena_string> holder(&arena);
+        for (size_t i = 0 ; i < requestArgs.size() ; ++i) boost::apply_visitor(holder, requestArgs[i]);
+
+        arena_string completeQuery(&arena);
+        completeQuery += "find";
+        completeQuery += MSG_SEPARATOR;
+        completeQuery += holder.getArgs();
+        completeQuery += MSG_FINALIZER;
+        sink += completeQuery.size();
+    }});
+
+    benches.push_back({"serializeSet/small", [smallSet]() {sink += serialized(smallSet).size();}});
+    benches.push_back({"serializeSet/large", [largeSet]() {sink += serialized(largeSet).size();}});
+    benches.push_back({"serializeSet/quotes", [quotes]() {sink += serialized(quotes).size();}});
+    benches.push_back({"serializeMap/small", [smallMap]() {sink += serialized(smallMap).size();}});
+    benches.push_back({"serializeMap/large", [largeMap]() {sink += serialized(largeMap).size();}});
+
+    string plain = "object12 rdf:type Cup";
+    string quoted = *quotes.begin();
+
+    benches.push_back({"protectValue/plain", [plain]() {sink += SocketConnector::protectValue(plain).size();}});
+    benches.push_back({"protectValue/quotes", [quoted]() {sink += SocketConnector::protectValue(quoted).size();}});
+
+    benches.push_back({"cleanValue", []() {
+        string value = "  \"object12 rdf:type Cup\" ";
+        sink += SocketConnector::cleanValue(value).size();
+    }});
+
+    /**** Parsing of the responses ****/
+
+    const char* scalars[][2] = {{"deserialize/bool", "true"},
+                                {"deserialize/int", "42"},
+                                {"deserialize/double", "3.14"},
+                                {"deserialize/string", "a label with spaces"}};
+
+    for (size_t i = 0 ; i < 4 ; ++i) {
+        string msg = scalars[i][1];
+        benches.push_back({scalars[i][0], [msg]() {
+            server_return_types result;
+            SocketConnector::deserialize(msg, result);
+            sink += result.which();
+        }});
+    }
+
+    string smallSetMsg = serialized(smallSet);
+    string largeSetMsg = serialized(largeSet);
+    string quotesMsg = serialized(quotes);
+    string largeMapMsg = serialized(largeMap);
+    string pairsMsg = pairsList(1000);
+
+    const pair<string, string> collections[] = {make_pair("deserialize/set-small", smallSetMsg),
+                                                make_pair("deserialize/set-large", largeSetMsg),
+                                                make_pair("deserialize/set-quotes", quotesMsg),
+                                                make_pair("deserialize/map-large", largeMapMsg),
+                                                make_pair("makeCollec/pairs-large", pairsMsg)};
+
+    for (size_t i = 0 ; i < 5 ; ++i) {
+        string msg = collections[i].second;
+        benches.push_back({collections[i].first, [msg]() {
+            server_return_types result;
+            SocketConnector::deserialize(msg, result);
+            sink += result.which();
+        }});
+    }
+
+    const pair<string, string> flatSets[] = {make_pair("makeFlatCollec/set-small", smallSetMsg),
+                                             make_pair("makeFlatCollec/set-large", largeSetMsg),
+                                             make_pair("makeFlatCollec/set-quotes", quotesMsg)};
+
+    for (size_t i = 0 ; i < 3 ; ++i) {
+        string msg = flatSets[i].second;
+        benches.push_back({flatSets[i].first, [msg]() {
+            FlatStringSet result;
+            SocketConnector::makeFlatCollec(msg, result);
+            sink += result.size();
+        }});
+    }
+
+    const pair<string, string> flatMaps[] = {make_pair("makeFlatCollec/map-large", largeMapMsg),
+                                             make_pair("makeFlatCollec/pairs-large", pairsMsg)};
+
+    for (size_t i = 0 ; i < 2 ; ++i) {
+        string msg = flatMaps[i].second;
+        benches.push_back({flatMaps[i].first, [msg]() {
+            FlatStringMap result;
+            SocketConnector::makeFlatCollec(msg, result);
+            sink += result.size();
+        }});
+    }
+
+    /**** Statements ****/
+
+    benches.push_back({"Statement/simple", []() {
+        Statement stmt("object12 rdf:type oro:Cup");
+        sink += stmt.object.symbol().id();
+    }});
+
+    benches.push_back({"Statement/typed", []() {
+        Statement stmt("gorilla age \"12\"^^xsd:integer");
+        sink += stmt.literal_object.size();
+    }});
+
+    benches.push_back({"Statement/quoted", []() {
+        Statement stmt("human says \"I said \\\"hello\\\", then \\\"bye\\\"\"@EN");
+        sink += stmt.literal_object.size();
+    }});
+
+    string lines = statementLines(500);
+    benches.push_back({"StatementParser/buffer-1000", [lines]() {
+        static StatementParser parser;
+        sink += parser.parseBuffer(lines, [](const Statement& stmt) {sink += stmt.subject.symbol().id();});
+    }});
+
+    /**** Ontology ****/
+
+    set<Statement> toAdd;
+    for (set<string>::const_iterator it = largeSet.begin() ; it != largeSet.end() ; ++it)
+        toAdd.insert(Statement(*it));
+
+    benches.push_back({"addToBuffer/1000", [toAdd]() {
+        Ontology* onto = Ontology::getInstance();
+        onto->bufferize();
+        onto->add(toAdd);
+        onto->flush();
+    }});
+
+    // Measures the conversion and the posting of the event to the dispatcher
+    // (the observer itself is called from the dispatcher thread).
+    set<string> pattern;
+    pattern.insert("?obj rdf:type Cup");
+    string eventId = Ontology::getInstance()->registerEvent(observer, NEW_INSTANCE, ON_TRUE, pattern, "?obj");
+
+    void (*evtCallback)(const string&, const server_return_types&) = loopback.evtCallback;
+    server_return_types event = largeSet;
+    benches.push_back({"evtCallback/large", [evtCallback, eventId, event]() {
+        evtCallback(eventId, event);
+    }});
+
+    return benches;
+}
+
+int main(int argc, char* argv[]) {
+
+    //////////////////////////////////////////////////////////////////////
+    ////////// Command-line parsing
+    //////////////////////////////////////////////////////////////////////
+
+    double minTime;
+    string filter;
+    string format;
+
+    po::options_description desc("Allowed options");
+    desc.add_options()
+            ("help,h", "produce help message")
+            ("filter", po::value<string>(&filter)->default_value(""), "only run the benchmarks whose name contains this string")
+            ("min-time,t", po::value<double>(&minTime)->default_value(0.2), "minimum duration of each benchmark, in seconds")
+            ("format,f", po::value<string>(&format)->default_value("text"), "output format: text or csv");
+
+    po::positional_options_description p;
+    p.add("filter", 1);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(desc).positional(p).run(), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        cout << "Usage: oro-microbench [options] [filter]" << endl << endl;
+        cout << desc << endl;
+        cout << "Benchmarks the client-side hot paths of liboro, without ontology server.\n"
+                "Reports the time, and the number and size of the memory allocations, per\n"
+                "operation.\n";
+        return 1;
+    }
+
+    LoopbackConnector loopback;
+    Ontology::createWithConnector(loopback);
+
+    CountingObserver observer;
+    vector<MicroBench> benches = microBenches(loopback, observer);
+
+    if (format == "csv")
+        cout << "name,iterations,ns_per_op,allocations_per_op,bytes_per_op" << endl;
+    else
+        cout << left << setw(40) << "benchmark" << right << setw(12) << "iterations"
+             << setw(14) << "ns/op" << setw(12) << "allocs/op" << setw(12) << "bytes/op" << endl;
+
+    for (size_t i = 0 ; i < benches.size() ; ++i) {
+        if (benches[i].name.find(filter) == string::npos) continue;
+
+        MicroResult res = measure(benches[i], minTime);
+
+        if (format == "csv")
+            cout << res.name << "," << res.iterations << "," << res.nsPerOp << ","
+                 << res.allocationsPerOp << "," << res.bytesPerOp << endl;
+        else
+            cout << left << setw(40) << res.name << right << setw(12) << res.iterations
+                 << fixed << setprecision(1) << setw(14) << res.nsPerOp
+                 << setw(12) << res.allocationsPerOp << setw(12) << setprecision(0) << res.bytesPerOp << endl;
+    }
+
+    return sink == 0; // never true: keeps the results alive
+}
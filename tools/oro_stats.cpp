@@ -17,10 +17,19 @@
 
 #include <string>
 #include <cstring>
+#include <cstdlib>
 #include <iostream>
+#include <fstream>
+#include <iomanip>
 #include <iterator>
 #include <signal.h>
 #include <map>
+#include <vector>
+#include <chrono>
+#include <thread>
+
+#include <boost/atomic.hpp>
+#include <boost/program_options.hpp>
 
 #include "oro.h"
 #include "socket_connector.h"
@@ -29,55 +38,242 @@ using namespace std;
 
 
 using namespace oro;
+namespace po = boost::program_options;
 
-struct ltstr
-{
-  bool operator()(const string s1, const string s2) const
-  {
-    return s1.compare(s2) < 0;
-  }
-};
+typedef std::chrono::steady_clock Clock;
 
 //Forward declarations
 void sigproc(int);
 
-string hostname;
-string port;
+// Set on ctrl+c: stops the watch mode.
+boost::atomic<bool> watching(false);
+boost::atomic<bool> stopped(false);
+
+/**
+ * Returns true if \p value is entirely a number, stored in \p number.
+ */
+bool toNumber(const string& value, double& number) {
+	if (value.empty()) return false;
+
+	char* end;
+	number = strtod(value.c_str(), &end);
+	return *end == '\0';
+}
+
+/**
+ * Totals of the client-side metrics over all the requests.
+ */
+struct ClientTotals {
+	ClientTotals() : calls(0), errors(0), bytesSent(0), bytesReceived(0), events(0) {}
+
+	explicit ClientTotals(const ClientStats& stats) : calls(0), errors(0), bytesSent(0), bytesReceived(0), events(stats.events) {
+		for (map<string, MethodStats>::const_iterator it = stats.methods.begin() ; it != stats.methods.end() ; ++it) {
+			calls += it->second.calls;
+			errors += it->second.errors;
+			bytesSent += it->second.bytesSent;
+			bytesReceived += it->second.bytesReceived;
+		}
+	}
+
+	boost::uint64_t calls;
+	boost::uint64_t errors;
+	boost::uint64_t bytesSent;
+	boost::uint64_t bytesReceived;
+	boost::uint64_t events;
+};
+
+/**
+ * Samples the server stats at a fixed interval, and reports the numeric
+ * fields with their delta and rate since the previous sample, followed by
+ * the change of the client-side metrics.
+ */
+int watch(Ontology* onto, double interval, size_t count, ostream* csv) {
+
+	map<string, double> previous;
+	vector<string> columns; // numeric fields, as found in the first sample
+	ClientTotals previousClient;
+	int status = 0;
+
+	double minRtt = 0.0, maxRtt = 0.0, totalRtt = 0.0;
+	size_t nbSamples = 0;
+
+	Clock::time_point start = Clock::now();
+	Clock::time_point next = start;
+	Clock::time_point last = start;
+
+	while (!stopped && (count == 0 || nbSamples < count)) {
+
+		Clock::time_point probe = Clock::now();
+		map<string, string> result;
+
+		// On error, the loop ends and the samples so far are summarized.
+		try {
+			result = onto->stats();
+		} catch (OntologyServerException& ose) {
+			cerr << "[EE] Server error: " << ose.what() << endl;
+			status = 1;
+			break;
+		} catch (ConnectorException& ce) {
+			cerr << "[EE] Connection error: " << ce.what() << endl;
+			status = 1;
+			break;
+		}
+
+		Clock::time_point now = Clock::now();
+		double rtt = std::chrono::duration<double, std::milli>(now - probe).count();
+
+		minRtt = nbSamples == 0 ? rtt : min(minRtt, rtt);
+		maxRtt = max(maxRtt, rtt);
+		totalRtt += rtt;
+
+		double time = std::chrono::duration<double>(probe - start).count();
+		double elapsed = std::chrono::duration<double>(probe - last).count();
+		last = probe;
+
+		map<string, double> current;
+		for (map<string, string>::const_iterator it = result.begin() ; it != result.end() ; ++it) {
+			double number;
+			if (toNumber(it->second, number)) current[it->first] = number;
+		}
+
+		if (nbSamples == 0) {
+			for (map<string, string>::const_iterator it = result.begin() ; it != result.end() ; ++it)
+				if (current.find(it->first) == current.end())
+					cout << "* " << it->first << "->" << it->second << endl;
+
+			for (map<string, double>::const_iterator it = current.begin() ; it != current.end() ; ++it)
+				columns.push_back(it->first);
+
+			if (csv) {
+				*csv << "time_s,rtt_ms";
+				for (size_t i = 0 ; i < columns.size() ; ++i)
+					*csv << "," << columns[i] << "," << columns[i] << "_delta," << columns[i] << "_per_s";
+				*csv << ",client_requests_delta,client_errors_delta,client_bytes_sent_delta,client_bytes_received_delta,client_events_delta";
+				*csv << endl;
+			}
+		}
+
+		cout << "[" << fixed << setprecision(1) << setw(8) << time << "s] rtt "
+		     << setprecision(2) << rtt << "ms";
+		if (csv) *csv << fixed << setprecision(3) << time << "," << rtt;
+
+		for (size_t i = 0 ; i < columns.size() ; ++i) {
+			const string& key = columns[i];
+			bool known = current.find(key) != current.end();
+
+			double value = known ? current[key] : 0.0;
+			double delta = (nbSamples > 0 && known) ? value - previous[key] : 0.0;
+			double rate = elapsed > 0 ? delta / elapsed : 0.0;
+
+			cout << " | " << key << " " << setprecision(0) << value;
+			if (nbSamples > 0)
+				cout << " (" << showpos << delta << noshowpos << ", " << setprecision(1) << rate << "/s)";
 
-map<string, clock_t, ltstr> timetable;
+			if (csv) *csv << "," << setprecision(0) << value << "," << delta << "," << setprecision(3) << rate;
+		}
+
+		// Client-side metrics, including the stats requests themselves.
+		ClientTotals client(onto->clientStats());
+
+		cout << " | client " << client.calls - previousClient.calls << " req, "
+		     << client.errors - previousClient.errors << " err, "
+		     << client.bytesSent - previousClient.bytesSent << "B sent, "
+		     << client.bytesReceived - previousClient.bytesReceived << "B recv, "
+		     << client.events - previousClient.events << " events";
+		if (csv) *csv << "," << client.calls - previousClient.calls
+		              << "," << client.errors - previousClient.errors
+		              << "," << client.bytesSent - previousClient.bytesSent
+		              << "," << client.bytesReceived - previousClient.bytesReceived
+		              << "," << client.events - previousClient.events;
+
+		cout << endl;
+		if (csv) *csv << endl;
+
+		previous = current;
+		previousClient = client;
+		nbSamples++;
+
+		// Fixed schedule: the duration of the probe does not shift the
+		// samples.
+		next += std::chrono::nanoseconds((long long) (interval * 1e9));
+		while (!stopped && Clock::now() < next && (count == 0 || nbSamples < count))
+			std::this_thread::sleep_for(std::min<Clock::duration>(next - Clock::now(), std::chrono::milliseconds(100)));
+	}
+
+	if (nbSamples > 0) {
+		cout << endl << "stats probe round-trip time: min " << setprecision(2) << minRtt
+		     << "ms, avg " << totalRtt / nbSamples << "ms, max " << maxRtt << "ms ("
+		     << nbSamples << " samples)" << endl << endl;
+		cout << "Client-side metrics:" << endl << onto->clientStats();
+	}
+
+	return status;
+}
 
 int main(int argc, char* argv[]) {
 
-	string query;
-	map<string, string> result;
-	Ontology* onto;
+	double interval;
+	size_t count;
+
+	po::positional_options_description p;
+	p.add("host", 1).add("port", 1);
+
+	po::options_description desc("Allowed options");
+	desc.add_options()
+			("help,h", "produce help message")
+			("host", po::value<string>()->default_value("localhost"), "knowledge base host")
+			("port", po::value<string>()->default_value("6969"), "knowledge base port")
+			("watch,w", po::value<double>(&interval)->default_value(0), "sample the stats every given number of seconds, until ctrl+c")
+			("count,n", po::value<size_t>(&count)->default_value(0), "in watch mode, stop after this number of samples")
+			("csv,o", po::value<string>(), "in watch mode, also write the samples to this CSV file");
+
+	po::variables_map vm;
+	po::store(po::command_line_parser(argc, argv).options(desc).positional(p).run(), vm);
+	po::notify(vm);
 
-	//We catch ctrl+c to cleanly close the application
-	signal( SIGINT,sigproc);
-	
 	cout << "********* ORO - Statistics *********" << endl;
-	//if (argc > 1 && strcmp(argv[2], "-h") == 0){
-	if (argc != 3){
+	if (vm.count("help")) {
 		cout << "Returns some statistics on a oro-server" << endl << endl;
-		cout << "Syntax:\n> oro-stats hostname port" <<endl;
-		return(0);
+		cout << "Syntax:\n> oro-stats [options] [hostname] [port]" << endl << endl;
+		cout << desc << endl;
+		cout << "In watch mode, the numeric statistics are reported with their change and\n"
+		        "their rate since the previous sample, together with the round-trip time of\n"
+		        "the stats request itself and the change of the client-side metrics.\n";
+		return 1;
 	}
+
+	//We catch ctrl+c to cleanly close the application
+	signal( SIGINT,sigproc);
+
 	cout << "Press ctrl+c to exit." << endl;
-	
-	hostname = argv[1];
-	port = argv[2];
-	
-	
-	//Instanciate the ontology with the YARP connector.
-	SocketConnector connector(hostname, port);
-	onto = Ontology::createWithConnector(connector);
-	
-	result = onto->stats();
-	
+
+	ofstream csv;
+	if (vm.count("csv")) {
+		csv.open(vm["csv"].as<string>().c_str());
+		if (!csv) {
+			cerr << "[EE] Can not open " << vm["csv"].as<string>() << " for writing" << endl;
+			return 1;
+		}
+	}
+
+	//Instanciate the ontology with the socket connector.
+	SocketConnector connector(vm["host"].as<string>(), vm["port"].as<string>());
+	Ontology* onto = Ontology::createWithConnector(connector);
+
+	if (interval > 0) {
+		onto->enableClientStats();
+		watching = true;
+		return watch(onto, interval, count, csv.is_open() ? &csv : NULL);
+	}
+
+	map<string, string> result = onto->stats();
+
 	map<string, string>::const_iterator itData = result.begin();
 	for( ; itData != result.end() ; ++itData) {
 		cout << "* " << (*itData).first << "->" << (*itData).second << endl;
 	}
+
+	return 0;
 }
 
 void sigproc(int sig)
@@ -86,5 +282,11 @@ void sigproc(int sig)
 	 /* NOTE some versions of UNIX will reset signal to default
 	 after each call. So for portability reset signal each time */
 
+	// In watch mode, let the loop end and report.
+	if (watching && !stopped) {
+		stopped = true;
+		return;
+	}
+
 	exit(0);
 }
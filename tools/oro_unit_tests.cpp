@@ -0,0 +1,1333 @@
+
+/*
+ * Copyright (c) 2008-2010 LAAS-CNRS Séverin Lemaignan slemaign@laas.fr
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+// Unit tests of the parts of liboro that do not need a server. Run by ctest
+// (cf tools/CMakeLists.txt), or directly: oro-unit-tests
+
+#define BOOST_TEST_MODULE LiboroUnitTests
+#include <boost/test/included/unit_test.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <string>
+#include <sstream>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/tokenizer.hpp>
+#include <boost/thread.hpp>
+
+#include "oro.h"
+#include "oro_exceptions.h"
+#include "oro_log.h"
+#include "event_dispatcher.h"
+#include "flat_result.h"
+#include "prepared_query.h"
+#include "query_dsl.h"
+#include "response_view.h"
+#include "socket_connector.h"
+#include "snapshot.h"
+#include "statement_buffer.h"
+#include "statement_parser.h"
+#include "symbol_table.h"
+
+using namespace std;
+using namespace oro;
+
+/*******************************************************************************
+*                            Symbol table                                      *
+*******************************************************************************/
+
+BOOST_AUTO_TEST_SUITE(symbol_table)
+
+BOOST_AUTO_TEST_CASE(literals_and_labels_are_not_interned)
+{
+    Concept robot(Symbol("myself"));
+    Property age(Symbol("hasAge"));
+    ConceptBuilder(robot).label("interns rdfs:label");
+
+    size_t symbols = SymbolTable::size();
+
+    // As many distinct literals as a long-running application would assert.
+    for (int i = 0 ; i < 200000 ; i++) {
+        ostringstream value;
+        value << i;
+
+        Statement number(robot, age, value.str());
+        BOOST_REQUIRE(number.isObjectLiteral);
+        BOOST_CHECK_EQUAL(number.literal_object, value.str());
+
+        Statement text("myself hasAge \"robot " + value.str() + "\"");
+        BOOST_REQUIRE(text.isObjectLiteral);
+
+        Statement typed(robot, age, "\"" + value.str() + "\"^^xsd:integer");
+        BOOST_CHECK_EQUAL(typed.literal_type, INTEGER_LITERAL);
+        BOOST_CHECK(typed == number);
+
+        ConceptBuilder builder(robot);
+        builder.label("robot " + value.str());
+    }
+
+    BOOST_CHECK_EQUAL(SymbolTable::size(), symbols);
+}
+
+BOOST_AUTO_TEST_CASE(resources_are_interned_once)
+{
+    size_t symbols = SymbolTable::size();
+
+    Statement a("oro:internedCup isOnTable <http://kb.openrobots.org#internedTable>");
+    Statement b("internedCup   oro:isOnTable    internedTable");
+
+    BOOST_CHECK(a == b);
+    BOOST_CHECK(a.object.symbol() == Symbol("internedTable"));
+    BOOST_CHECK_EQUAL(SymbolTable::size(), symbols + 3);
+}
+
+BOOST_AUTO_TEST_CASE(literals_compare_by_value)
+{
+    Statement a("myself hasAge 12");
+    Statement b("myself hasAge 13");
+    Statement c("myself hasAge \"12\"^^xsd:integer");
+
+    BOOST_CHECK(a == c);
+    BOOST_CHECK(!(a == b));
+    BOOST_CHECK(a < b);
+    BOOST_CHECK(!(b < a));
+    BOOST_CHECK_EQUAL(hash_value(a), hash_value(c));
+    BOOST_CHECK(a.triple() == c.triple());
+    BOOST_CHECK_EQUAL(a.to_string(), "myself hasAge 12");
+}
+
+BOOST_AUTO_TEST_CASE(concepts_are_ordered_alphabetically)
+{
+    // Interned in the reverse order.
+    Concept last(Symbol("zz_ordered"));
+    Concept first(Symbol("aa_ordered"));
+
+    set<Concept> concepts;
+    concepts.insert(last);
+    concepts.insert(first);
+    concepts.insert(Concept(Symbol("zz_ordered")));
+
+    BOOST_REQUIRE_EQUAL(concepts.size(), 2u);
+    BOOST_CHECK_EQUAL(concepts.begin()->id(), "aa_ordered");
+    BOOST_CHECK(!(first < first));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/*******************************************************************************
+*                            Statement parser                                  *
+*******************************************************************************/
+
+BOOST_AUTO_TEST_SUITE(statement_parser)
+
+// Canonical form of a statement, as sent to the server.
+string canonical(const string& text) {
+    return Statement(text).to_string();
+}
+
+BOOST_AUTO_TEST_CASE(whitespace_is_collapsed)
+{
+    BOOST_CHECK_EQUAL(canonical("  cup1 \t isOn\r\n table "), "cup1 isOn table");
+}
+
+BOOST_AUTO_TEST_CASE(default_namespace_is_removed)
+{
+    BOOST_CHECK_EQUAL(canonical("oro:cup1 oro:isOn :table"), "cup1 isOn table");
+    BOOST_CHECK_EQUAL(canonical("cup1 rdf:type owl:Thing"), "cup1 rdf:type owl:Thing");
+
+    StatementParser noDefault("");
+    BOOST_CHECK_EQUAL(noDefault.parse("oro:cup1 isOn table").to_string(), "oro:cup1 isOn table");
+}
+
+BOOST_AUTO_TEST_CASE(well_known_iris_are_prefixed)
+{
+    BOOST_CHECK_EQUAL(canonical("<http://kb.openrobots.org#cup1> "
+                                "<http://www.w3.org/1999/02/22-rdf-syntax-ns#type> "
+                                "<http://www.w3.org/2002/07/owl#Thing>"),
+                      "cup1 rdf:type owl:Thing");
+    BOOST_CHECK_EQUAL(canonical("cup1 rdfs:seeAlso <http://example.org/cup>"),
+                      "cup1 rdfs:seeAlso <http://example.org/cup>");
+}
+
+BOOST_AUTO_TEST_CASE(a_is_rdf_type)
+{
+    BOOST_CHECK(Statement("cup1 a Cup") == Statement("cup1 rdf:type Cup"));
+}
+
+BOOST_AUTO_TEST_CASE(strings_are_double_quoted)
+{
+    BOOST_CHECK_EQUAL(canonical("cat name 'chat'"), "cat name \"chat\"");
+    BOOST_CHECK_EQUAL(canonical("cat name \"\"\"chat\"\"\""), "cat name \"chat\"");
+    BOOST_CHECK_EQUAL(canonical("cat name 'le \"chat\"'"), "cat name \"le \\\"chat\\\"\"");
+    BOOST_CHECK_EQUAL(canonical("cat name \"chat\"@FR"), "cat name \"chat\"@fr");
+    BOOST_CHECK_EQUAL(Statement("cat name 'chat'@fr").literal_type, STRING_LITERAL);
+}
+
+BOOST_AUTO_TEST_CASE(numbers_and_booleans_use_the_short_form)
+{
+    BOOST_CHECK_EQUAL(canonical("x p \"12\"^^xsd:integer"), "x p 12");
+    BOOST_CHECK_EQUAL(canonical("x p \"1.3\"^^<http://www.w3.org/2001/XMLSchema#decimal>"), "x p 1.3");
+    BOOST_CHECK_EQUAL(canonical("x p 1.0e6^^xsd:double"), "x p 1.0e6");
+    BOOST_CHECK_EQUAL(canonical("x p \"true\"^^xsd:boolean"), "x p true");
+
+    BOOST_CHECK_EQUAL(Statement("x p 12").literal_type, INTEGER_LITERAL);
+    BOOST_CHECK_EQUAL(Statement("x p -1.3").literal_type, DECIMAL_LITERAL);
+    BOOST_CHECK_EQUAL(Statement("x p 1.0E-6").literal_type, DOUBLE_LITERAL);
+    BOOST_CHECK_EQUAL(Statement("x p false").literal_type, BOOLEAN_LITERAL);
+
+    // Not numbers: resources.
+    BOOST_CHECK(!Statement("x p 12a").isObjectLiteral);
+    BOOST_CHECK(!Statement("x p 1.").isObjectLiteral);
+    BOOST_CHECK(!Statement("x p 1e").isObjectLiteral);
+}
+
+BOOST_AUTO_TEST_CASE(other_typed_literals)
+{
+    BOOST_CHECK_EQUAL(canonical("x p \"12\"^^xsd:int"), "x p 12^^xsd:int");
+    BOOST_CHECK_EQUAL(canonical("x p \"xyz\"^^<http://www.w3.org/2001/XMLSchema#token>"), "x p \"xyz\"^^xsd:token");
+    BOOST_CHECK_EQUAL(canonical("x p \"abc\"^^xsd:integer"), "x p \"abc\"^^xsd:integer");
+    BOOST_CHECK_EQUAL(Statement("x p 12^^xsd:int").literal_type, TYPED_LITERAL);
+}
+
+BOOST_AUTO_TEST_CASE(equivalent_forms_compare_equal)
+{
+    Statement a("oro:cup1 a oro:Cup");
+    Statement b("<http://kb.openrobots.org#cup1>   rdf:type   Cup");
+    BOOST_CHECK(a == b);
+    BOOST_CHECK_EQUAL(hash_value(a), hash_value(b));
+
+    Concept cup(Symbol("cup1"));
+    Property weight(Symbol("weight"));
+    BOOST_CHECK(Statement(cup, weight, "\"0.5\"^^xsd:decimal") == Statement("cup1 weight 0.5"));
+    BOOST_CHECK_EQUAL(Statement(cup, weight, "unparsable value").literal_object, "unparsable value");
+}
+
+BOOST_AUTO_TEST_CASE(invalid_statements)
+{
+    BOOST_CHECK_THROW(Statement("cup1 isOn"), InvalidStatementException);
+    BOOST_CHECK_THROW(Statement("cup1 isOn \"table\" chair"), InvalidStatementException);
+    BOOST_CHECK_THROW(Statement("cup1 isOn <http://kb.openrobots.org#table> chair"), InvalidStatementException);
+    BOOST_CHECK_THROW(Statement("\"cup\" isOn table"), InvalidStatementException);
+    BOOST_CHECK_THROW(Statement("cup1 name \"unterminated"), InvalidStatementException);
+    BOOST_CHECK_THROW(Statement("<http://kb.openrobots.org#cup1 isOn table"), InvalidStatementException);
+    BOOST_CHECK_THROW(Statement("x p \"12\"^^"), InvalidStatementException);
+}
+
+BOOST_AUTO_TEST_CASE(unquoted_strings)
+{
+    Statement stmt("john says hello   world ");
+    BOOST_CHECK(stmt.isObjectLiteral);
+    BOOST_CHECK_EQUAL(stmt.literal_type, STRING_LITERAL);
+    BOOST_CHECK_EQUAL(stmt.to_string(), "john says \"hello   world\"");
+    BOOST_CHECK(stmt == Statement("john says 'hello   world'"));
+
+    BOOST_CHECK_EQUAL(canonical("cup1 label 12 \"apples\""), "cup1 label \"12 \\\"apples\\\"\"");
+}
+
+BOOST_AUTO_TEST_CASE(buffers)
+{
+    StatementParser parser;
+    vector<Statement> statements;
+    vector<StatementParser::Error> errors;
+
+    size_t nb = parser.parseBuffer("# comment\n"
+                                   "cup1 a Cup\n"
+                                   "\n"
+                                   "cup1 isOn\n"
+                                   "  cup1 weight 0.5", statements, &errors);
+
+    BOOST_CHECK_EQUAL(nb, 2u);
+    BOOST_REQUIRE_EQUAL(statements.size(), 2u);
+    BOOST_CHECK_EQUAL(statements[1].to_string(), "cup1 weight 0.5");
+    BOOST_REQUIRE_EQUAL(errors.size(), 1u);
+    BOOST_CHECK_EQUAL(errors[0].line, 4u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/*******************************************************************************
+*                            Statement buffer                                  *
+*******************************************************************************/
+
+BOOST_AUTO_TEST_SUITE(statement_buffer)
+
+Triple triple(const string& text) {
+    return Statement(text).triple();
+}
+
+struct Drained {
+    vector<string> toAdd, toRemove, toUpdate;
+
+    Drained(StatementBuffer& buffer) {
+        buffer.drain(toAdd, toRemove, toUpdate);
+    }
+};
+
+BOOST_AUTO_TEST_CASE(add_cancels_remove)
+{
+    StatementBuffer buffer;
+
+    buffer.insert(StatementBuffer::REMOVE, triple("cup1 isOn table"));
+    buffer.insert(StatementBuffer::ADD, triple("cup1 isOn table"));
+    BOOST_CHECK(buffer.empty());
+
+    // Cancelled: a new add is pending again.
+    buffer.insert(StatementBuffer::ADD, triple("cup1 isOn table"));
+    BOOST_CHECK_EQUAL(buffer.size(StatementBuffer::ADD), 1u);
+    BOOST_CHECK_EQUAL(buffer.size(StatementBuffer::REMOVE), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(remove_cancels_add)
+{
+    StatementBuffer buffer;
+
+    buffer.insert(StatementBuffer::ADD, triple("cup1 weight 0.5"));
+    buffer.insert(StatementBuffer::UPDATE, triple("cup1 weight 0.5"));
+    buffer.insert(StatementBuffer::REMOVE, triple("cup1 weight \"0.5\"^^xsd:decimal"));
+
+    // Updates never cancel, nor are cancelled.
+    BOOST_CHECK_EQUAL(buffer.size(StatementBuffer::ADD), 0u);
+    BOOST_CHECK_EQUAL(buffer.size(StatementBuffer::REMOVE), 0u);
+    BOOST_CHECK_EQUAL(buffer.size(StatementBuffer::UPDATE), 1u);
+
+    Drained drained(buffer);
+    BOOST_REQUIRE_EQUAL(drained.toUpdate.size(), 1u);
+    BOOST_CHECK_EQUAL(drained.toUpdate[0], "cup1 weight 0.5");
+}
+
+BOOST_AUTO_TEST_CASE(duplicates_are_dropped)
+{
+    StatementBuffer buffer;
+
+    buffer.insert(StatementBuffer::ADD, triple("cup1 a Cup"));
+    buffer.insert(StatementBuffer::ADD, triple("oro:cup1 rdf:type oro:Cup"));
+    buffer.insert(StatementBuffer::UPDATE, triple("cup1 isOn table"));
+    buffer.insert(StatementBuffer::UPDATE, triple("cup1 isOn table"));
+
+    BOOST_CHECK_EQUAL(buffer.size(), 2u);
+
+    Drained drained(buffer);
+    BOOST_REQUIRE_EQUAL(drained.toAdd.size(), 1u);
+    BOOST_CHECK_EQUAL(drained.toAdd[0], "cup1 rdf:type Cup");
+    BOOST_CHECK_EQUAL(drained.toUpdate.size(), 1u);
+    BOOST_CHECK(buffer.empty());
+}
+
+BOOST_AUTO_TEST_CASE(cancelled_statements_are_swapped_with_the_last)
+{
+    StatementBuffer buffer;
+
+    buffer.insert(StatementBuffer::ADD, triple("a p x"));
+    buffer.insert(StatementBuffer::ADD, triple("b p x"));
+    buffer.insert(StatementBuffer::ADD, triple("c p x"));
+    buffer.insert(StatementBuffer::ADD, triple("d p x"));
+    buffer.insert(StatementBuffer::REMOVE, triple("b p x"));
+
+    // The id of b is reused by e.
+    buffer.insert(StatementBuffer::ADD, triple("e p x"));
+
+    Drained drained(buffer);
+    BOOST_REQUIRE_EQUAL(drained.toAdd.size(), 4u);
+    BOOST_CHECK_EQUAL(drained.toAdd[0], "a p x");
+    BOOST_CHECK_EQUAL(drained.toAdd[1], "d p x");
+    BOOST_CHECK_EQUAL(drained.toAdd[2], "c p x");
+    BOOST_CHECK_EQUAL(drained.toAdd[3], "e p x");
+    BOOST_CHECK(drained.toRemove.empty());
+}
+
+BOOST_AUTO_TEST_CASE(merge_replays_the_insertions)
+{
+    StatementBuffer buffer, other;
+
+    // Into an empty buffer.
+    other.insert(StatementBuffer::ADD, triple("a p x"));
+    buffer.merge(other);
+    BOOST_CHECK(other.empty());
+    BOOST_CHECK_EQUAL(buffer.size(StatementBuffer::ADD), 1u);
+
+    other.insert(StatementBuffer::REMOVE, triple("a p x"));
+    other.insert(StatementBuffer::ADD, triple("b p x"));
+    other.insert(StatementBuffer::REMOVE, triple("c p \"literal\""));
+    buffer.merge(other);
+    BOOST_CHECK(other.empty());
+
+    Drained drained(buffer);
+    BOOST_REQUIRE_EQUAL(drained.toAdd.size(), 1u);
+    BOOST_CHECK_EQUAL(drained.toAdd[0], "b p x");
+    BOOST_REQUIRE_EQUAL(drained.toRemove.size(), 1u);
+    BOOST_CHECK_EQUAL(drained.toRemove[0], "c p \"literal\"");
+}
+
+BOOST_AUTO_TEST_CASE(drain_appends_and_clears)
+{
+    StatementBuffer buffer;
+    vector<string> toAdd(1, "z p x"), toRemove, toUpdate;
+
+    buffer.insert(StatementBuffer::ADD, triple("a p 12"));
+    buffer.insert(StatementBuffer::REMOVE, triple("b p true"));
+    buffer.drain(toAdd, toRemove, toUpdate);
+
+    BOOST_REQUIRE_EQUAL(toAdd.size(), 2u);
+    BOOST_CHECK_EQUAL(toAdd[0], "z p x");
+    BOOST_CHECK_EQUAL(toAdd[1], "a p 12");
+    BOOST_REQUIRE_EQUAL(toRemove.size(), 1u);
+    BOOST_CHECK_EQUAL(toRemove[0], "b p true");
+    BOOST_CHECK(toUpdate.empty());
+    BOOST_CHECK(buffer.empty());
+
+    // Nothing left to drain, and the buffer is still usable.
+    Drained empty(buffer);
+    BOOST_CHECK(empty.toAdd.empty() && empty.toRemove.empty() && empty.toUpdate.empty());
+
+    buffer.insert(StatementBuffer::REMOVE, triple("a p 12"));
+    BOOST_CHECK_EQUAL(buffer.size(StatementBuffer::REMOVE), 1u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/*******************************************************************************
+*                               Snapshots                                      *
+*******************************************************************************/
+
+BOOST_AUTO_TEST_SUITE(snapshot)
+
+void collect(vector<Statement>* statements, const Statement& stmt) {
+    statements->push_back(stmt);
+}
+
+size_t readSnapshot(const string& data, vector<Statement>& statements) {
+    return SnapshotReader::read(boost::string_view(data), boost::bind(&collect, &statements, _1));
+}
+
+// A snapshot of 'nb' statements, of every kind of object.
+string writeSnapshot(size_t nb, set<Statement>& statements) {
+    ostringstream out;
+    SnapshotWriter writer(out);
+
+    for (size_t i = 0 ; i < nb ; i++) {
+        ostringstream subject;
+        subject << "snapshot_object_" << i / 3;
+
+        switch (i % 3) {
+        case 0: statements.insert(Statement(subject.str() + " rdf:type SnapshotObject")); break;
+        case 1: statements.insert(Statement(subject.str() + " rdfs:label \"object " + subject.str() + "\"@en")); break;
+        case 2: statements.insert(Statement(subject.str() + " weight 0." + subject.str().substr(16))); break;
+        }
+    }
+
+    for (set<Statement>::const_iterator it = statements.begin() ; it != statements.end() ; ++it) {
+        writer.add(*it);
+        writer.add(*it); // duplicates are written once
+    }
+    writer.close();
+
+    return out.str();
+}
+
+BOOST_AUTO_TEST_CASE(round_trip)
+{
+    set<Statement> written;
+    string data = writeSnapshot(10000, written); // several blocks
+
+    BOOST_CHECK(SnapshotReader::isSnapshot(data));
+
+    vector<Statement> read;
+    BOOST_CHECK_EQUAL(readSnapshot(data, read), written.size());
+    BOOST_CHECK_EQUAL(read.size(), written.size());
+
+    set<Statement> readSet(read.begin(), read.end());
+    BOOST_CHECK(readSet == written);
+
+    for (size_t i = 0 ; i < read.size() ; i++) {
+        if (read[i].predicate.symbol() == Symbol("weight"))
+            BOOST_CHECK_EQUAL(read[i].literal_type, DECIMAL_LITERAL);
+        if (read[i].predicate.symbol() == Symbol("rdfs:label"))
+            BOOST_CHECK_EQUAL(read[i].literal_type, STRING_LITERAL);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(empty_snapshot)
+{
+    ostringstream out;
+    SnapshotWriter writer(out);
+    writer.close();
+
+    vector<Statement> read;
+    BOOST_CHECK_EQUAL(readSnapshot(out.str(), read), 0u);
+}
+
+bool isChecksumError(const OntologyException& e) {
+    return string(e.what()).find("checksum mismatch") != string::npos;
+}
+
+BOOST_AUTO_TEST_CASE(checksum_mismatch)
+{
+    set<Statement> written;
+    string data = writeSnapshot(100, written);
+
+    // The last byte of the payload of the statement block, before the end
+    // block (13 bytes of header, 16 bytes of payload).
+    data[data.size() - 30] ^= 0x01;
+
+    vector<Statement> read;
+    BOOST_CHECK_EXCEPTION(readSnapshot(data, read), OntologyException, isChecksumError);
+}
+
+BOOST_AUTO_TEST_CASE(truncated_snapshot)
+{
+    set<Statement> written;
+    string data = writeSnapshot(100, written);
+
+    vector<Statement> read;
+    BOOST_CHECK_THROW(readSnapshot(data.substr(0, data.size() - 1), read), OntologyException);
+    BOOST_CHECK_THROW(readSnapshot(data.substr(0, data.size() / 2), read), OntologyException);
+
+    // Not closed: no end block.
+    ostringstream out;
+    SnapshotWriter writer(out);
+    writer.add(*written.begin());
+    BOOST_CHECK_THROW(readSnapshot(out.str(), read), OntologyException);
+}
+
+BOOST_AUTO_TEST_CASE(not_a_snapshot)
+{
+    vector<Statement> read;
+    BOOST_CHECK(!SnapshotReader::isSnapshot("cup1 rdf:type Cup"));
+    BOOST_CHECK_THROW(readSnapshot("cup1 rdf:type Cup", read), OntologyException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/*******************************************************************************
+*                             Flat results                                     *
+*******************************************************************************/
+
+BOOST_AUTO_TEST_SUITE(flat_result)
+
+BOOST_AUTO_TEST_CASE(set_is_sorted_and_deduplicated)
+{
+    FlatStringSet flat;
+    flat.insert("cup");
+    flat.insert("bottle");
+    flat.insert("");
+    flat.insert("cup");
+    flat.insert("apple");
+
+    // Insertion order until sorted.
+    BOOST_CHECK(!flat.sorted());
+    BOOST_CHECK_EQUAL(flat.size(), 5u);
+    BOOST_CHECK_EQUAL(flat[0], "cup");
+    BOOST_CHECK_EQUAL(flat[1], "bottle");
+
+    flat.sort();
+
+    BOOST_CHECK(flat.sorted());
+    BOOST_REQUIRE_EQUAL(flat.size(), 4u);
+    BOOST_CHECK_EQUAL(flat[0], "");
+    BOOST_CHECK_EQUAL(flat[1], "apple");
+    BOOST_CHECK_EQUAL(flat[2], "bottle");
+    BOOST_CHECK_EQUAL(flat[3], "cup");
+    BOOST_CHECK_EQUAL(flat.bytes(), 17u); // the duplicate stays in the buffer
+
+    set<string> expected;
+    expected.insert("");
+    expected.insert("apple");
+    expected.insert("bottle");
+    expected.insert("cup");
+    BOOST_CHECK(flat.toSet() == expected);
+    BOOST_CHECK(FlatStringSet(expected).toSet() == expected);
+}
+
+BOOST_AUTO_TEST_CASE(set_find)
+{
+    set<string> elements;
+    for (int i = 0 ; i < 1000 ; i += 2) {
+        ostringstream element;
+        element << "object_" << i;
+        elements.insert(element.str());
+    }
+
+    FlatStringSet flat(elements);
+
+    for (int i = 0 ; i < 1000 ; i++) {
+        ostringstream element;
+        element << "object_" << i;
+
+        FlatStringSet::const_iterator it = flat.find(element.str());
+        if (i % 2 == 0) {
+            BOOST_REQUIRE(it != flat.end());
+            BOOST_CHECK_EQUAL(*it, element.str());
+        }
+        else BOOST_CHECK(it == flat.end());
+
+        BOOST_CHECK_EQUAL(flat.count(element.str()), i % 2 == 0 ? 1u : 0u);
+    }
+
+    BOOST_CHECK(!flat.contains(""));
+    BOOST_CHECK(!flat.contains("object_"));
+    BOOST_CHECK(!FlatStringSet().contains("object_0"));
+
+    FlatStringSet other;
+    flat.swap(other);
+    BOOST_CHECK(flat.empty());
+    BOOST_CHECK_EQUAL(other.size(), 500u);
+
+    other.clear();
+    BOOST_CHECK(other.empty());
+    BOOST_CHECK(other.find("object_0") == other.end());
+}
+
+BOOST_AUTO_TEST_CASE(map_keeps_the_last_value)
+{
+    FlatStringMap flat;
+    flat.insert("b", "1");
+    flat.insert("a", "2");
+    flat.insert("b", "3");
+    flat.insert("c", "");
+    flat.sort();
+
+    BOOST_REQUIRE_EQUAL(flat.size(), 3u);
+    BOOST_CHECK_EQUAL(flat[0].first, "a");
+    BOOST_CHECK_EQUAL(flat.at("b"), "3");
+    BOOST_CHECK_EQUAL(flat.at("c"), "");
+    BOOST_CHECK_EQUAL(flat.count("c"), 1u);
+    BOOST_CHECK(flat.find("d") == flat.end());
+    BOOST_CHECK_THROW(flat.at("d"), std::out_of_range);
+
+    map<string, string> expected;
+    expected["a"] = "2";
+    expected["b"] = "3";
+    expected["c"] = "";
+    BOOST_CHECK(flat.toMap() == expected);
+    BOOST_CHECK(FlatStringMap(expected).toMap() == expected);
+}
+
+/* The tokenizer of the flat and visited decoding (cf tokenize() in
+ * socket_connector.cpp) must split exactly like the escaped_list_separator of
+ * makeCollec().
+ */
+
+// A list of random elements, with separators, quotes and escapes.
+string randomList(unsigned int& seed) {
+    static const char* pieces[] = {"a", "b", " ", "\t", ",", "\"", "'", ":",
+                                   "\\n", "\\\\", "\\\"", "\\,"};
+
+    seed = seed * 1103515245 + 12345;
+    size_t length = (seed >> 16) % 24;
+
+    string list = "[";
+    for (size_t i = 0 ; i < length ; i++) {
+        seed = seed * 1103515245 + 12345;
+        list += pieces[(seed >> 16) % (sizeof(pieces) / sizeof(pieces[0]))];
+    }
+    return list + "]";
+}
+
+bool append(vector<string>* elements, const string& element) {
+    elements->push_back(element);
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE(lists_decode_like_make_collec)
+{
+    unsigned int seed = 42;
+
+    for (int i = 0 ; i < 20000 ; i++) {
+        string list = randomList(seed);
+        BOOST_TEST_CONTEXT("list: " << list) {
+
+            // The elements, in order, as escaped_list_separator splits them.
+            vector<string> expected;
+            string content = list.substr(1, list.length() - 2);
+            boost::tokenizer<boost::escaped_list_separator<char> > tokens(content);
+            for (boost::tokenizer<boost::escaped_list_separator<char> >::iterator it = tokens.begin() ; it != tokens.end() ; ++it) {
+                string token = *it;
+                expected.push_back(SocketConnector::cleanValue(token));
+            }
+
+            vector<string> visited;
+            BOOST_CHECK_EQUAL(SocketConnector::visitCollection(list, boost::bind(&append, &visited, _1)), expected.size());
+            BOOST_CHECK(visited == expected);
+
+            FlatStringSet flat;
+            SocketConnector::makeFlatCollec(list, flat);
+            BOOST_CHECK(flat.toSet() == set<string>(expected.begin(), expected.end()));
+            BOOST_CHECK(flat.toSet() == boost::get<set<string> >(SocketConnector::makeCollec(list)));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(maps_decode_like_make_collec)
+{
+    const char* maps[] = {"{}",
+                          "{a:b}",
+                          "{a:1, b : \"x, y\", c:}",
+                          "{\"k\\\"ey\":\"v\\nal\", a:b, a:c}",
+                          "[[a,b]]",
+                          "[[a,b], [ c , \"d,e\" ], [a, f]]",
+                          "[[\"x\\\\y\",\\,]]"};
+
+    for (size_t i = 0 ; i < sizeof(maps) / sizeof(maps[0]) ; i++) {
+        BOOST_TEST_CONTEXT("map: " << maps[i]) {
+            FlatStringMap flat;
+            SocketConnector::makeFlatCollec(maps[i], flat);
+
+            if (string(maps[i]) == "{}") BOOST_CHECK(flat.empty());
+            else BOOST_CHECK(flat.toMap() == (boost::get<map<string, string> >(SocketConnector::makeCollec(maps[i]))));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(invalid_escapes)
+{
+    const char* lists[] = {"[a\\]", "[a\\x]", "[\"a\\t\"]"};
+
+    for (size_t i = 0 ; i < sizeof(lists) / sizeof(lists[0]) ; i++) {
+        BOOST_TEST_CONTEXT("list: " << lists[i]) {
+            FlatStringSet flat;
+            BOOST_CHECK_THROW(SocketConnector::makeFlatCollec(lists[i], flat), std::runtime_error);
+            BOOST_CHECK_THROW(SocketConnector::makeCollec(lists[i]), std::runtime_error);
+        }
+    }
+}
+
+ServerResponse response(const string& raw, const server_return_types& result = string()) {
+    ServerResponse res;
+    res.status = ServerResponse::ok;
+    res.raw_result = raw;
+    res.result = result;
+    return res;
+}
+
+BOOST_AUTO_TEST_CASE(only_lists_are_visited)
+{
+    vector<string> visited;
+    BOOST_CHECK_EQUAL(ResponseView(response("[a, b]")).visit(boost::bind(&append, &visited, _1)), 2u);
+
+    set<string> decoded;
+    decoded.insert("c");
+    BOOST_CHECK_EQUAL(ResponseView(response("", decoded)).visit(boost::bind(&append, &visited, _1)), 1u);
+    BOOST_CHECK_EQUAL(visited.size(), 3u);
+
+    BOOST_CHECK_THROW(ResponseView(response("42")).visit(boost::bind(&append, &visited, _1)), OntologyServerException);
+    BOOST_CHECK_THROW(ResponseView(response("{a:b}")).visit(boost::bind(&append, &visited, _1)), OntologyServerException);
+    BOOST_CHECK_THROW(ResponseView(response("", string("x"))).visit(boost::bind(&append, &visited, _1)), OntologyServerException);
+    BOOST_CHECK_EQUAL(visited.size(), 3u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/*******************************************************************************
+*                            Number parsing                                    *
+*******************************************************************************/
+
+BOOST_AUTO_TEST_SUITE(number_parsing)
+
+/* SocketConnector::parseInt and parseDouble must accept exactly what
+ * lexical_cast accepts, with the same value: deserialize() used lexical_cast
+ * before.
+ */
+void checkLikeLexicalCast(const string& str) {
+    BOOST_TEST_CONTEXT("string: \"" << str << "\"") {
+        int i = 0;
+        bool castInt = true;
+        try {
+            i = boost::lexical_cast<int>(str);
+        } catch (boost::bad_lexical_cast&) {
+            castInt = false;
+        }
+
+        int parsedInt = 0;
+        BOOST_REQUIRE_EQUAL(SocketConnector::parseInt(str, parsedInt), castInt);
+        if (castInt) BOOST_REQUIRE_EQUAL(parsedInt, i);
+
+        double d = 0;
+        bool castDouble = true;
+        try {
+            d = boost::lexical_cast<double>(str);
+        } catch (boost::bad_lexical_cast&) {
+            castDouble = false;
+        }
+
+        double parsedDouble = 0;
+        BOOST_REQUIRE_EQUAL(SocketConnector::parseDouble(str, parsedDouble), castDouble);
+        if (castDouble) {
+            if (std::isnan(d)) BOOST_REQUIRE(std::isnan(parsedDouble));
+            else BOOST_REQUIRE_EQUAL(parsedDouble, d);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(known_cases)
+{
+    const char* strings[] = {"0", "-0", "+1", "42", "007",
+                             "2147483647", "2147483648", "-2147483648", "-2147483649",
+                             "99999999999999999999",
+                             "1.5", "-.5", ".5", "5.", "1e3", "1E-3", "-2.5e+10", "1e400", "1e-400",
+                             "inf", "-INF", "infinity", "nan", "NaN", "-nan",
+                             "0x10", "0X1p3", "1,5", "1.2.3", "e3", ".", "+", "-", "--1", "+-1",
+                             " 1", "1 ", "\t1", "", "true", "abc", "1a"};
+
+    for (size_t i = 0 ; i < sizeof(strings) / sizeof(strings[0]) ; i++)
+        checkLikeLexicalCast(strings[i]);
+}
+
+BOOST_AUTO_TEST_CASE(random_strings)
+{
+    static const char alphabet[] = "0123456789+-.eExXinfaINFA ";
+
+    unsigned int seed = 7;
+
+    for (int n = 0 ; n < 300000 ; n++) {
+        seed = seed * 1103515245 + 12345;
+        size_t length = (seed >> 16) % 12;
+
+        string str;
+        for (size_t i = 0 ; i < length ; i++) {
+            seed = seed * 1103515245 + 12345;
+            // Half digits, so that many strings are numbers.
+            size_t c = (seed >> 16) % 32;
+            str += c < 16 ? alphabet[c % 10] : alphabet[10 + c - 16];
+        }
+
+        checkLikeLexicalCast(str);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/*******************************************************************************
+*                           Event dispatcher                                   *
+*******************************************************************************/
+
+BOOST_AUTO_TEST_SUITE(event_dispatcher)
+
+// Records the events it gets, optionally taking some time for each.
+class Recorder : public OroEventObserver {
+public:
+    Recorder(unsigned int delay_ms = 0) : _delay_ms(delay_ms), _calls(0), _done(0) {}
+
+    void operator()(const OroEvent& evt) {
+        {
+            boost::lock_guard<boost::mutex> lock(_lock);
+            _calls++;
+            const set<Concept>& content = boost::get<set<Concept> >(evt.content);
+            vector<string> elements;
+            for (set<Concept>::const_iterator it = content.begin() ; it != content.end() ; ++it)
+                elements.push_back(it->id());
+            _events.push_back(elements);
+        }
+        _changed.notify_all();
+
+        if (_delay_ms > 0) boost::this_thread::sleep(boost::posix_time::milliseconds(_delay_ms));
+
+        {
+            boost::lock_guard<boost::mutex> lock(_lock);
+            _done++;
+        }
+        _changed.notify_all();
+    }
+
+    // Waits until the observer has been called 'calls' times (false after
+    // two seconds).
+    bool waitForCalls(size_t calls) {
+        boost::unique_lock<boost::mutex> lock(_lock);
+        boost::posix_time::ptime deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(2);
+        while (_calls < calls)
+            if (!_changed.timed_wait(lock, deadline)) return false;
+        return true;
+    }
+
+    size_t calls() {boost::lock_guard<boost::mutex> lock(_lock); return _calls;}
+    size_t done() {boost::lock_guard<boost::mutex> lock(_lock); return _done;}
+    vector<vector<string> > events() {boost::lock_guard<boost::mutex> lock(_lock); return _events;}
+
+private:
+    unsigned int _delay_ms;
+    boost::mutex _lock;
+    boost::condition_variable _changed;
+    size_t _calls;
+    size_t _done;
+    vector<vector<string> > _events;
+};
+
+server_return_types content(const string& element) {
+    set<string> content;
+    content.insert(element);
+    return content;
+}
+
+// Holds the worker it runs on until released.
+class Gate : public OroEventObserver {
+public:
+    Gate() : _entered(false), _open(false) {}
+
+    void operator()(const OroEvent&) {
+        boost::unique_lock<boost::mutex> lock(_lock);
+        _entered = true;
+        _changed.notify_all();
+        while (!_open) _changed.wait(lock);
+    }
+
+    void waitUntilEntered() {
+        boost::unique_lock<boost::mutex> lock(_lock);
+        while (!_entered) _changed.wait(lock);
+    }
+
+    void open() {
+        boost::lock_guard<boost::mutex> lock(_lock);
+        _open = true;
+        _changed.notify_all();
+    }
+
+private:
+    boost::mutex _lock;
+    boost::condition_variable _changed;
+    bool _entered;
+    bool _open;
+};
+
+BOOST_AUTO_TEST_CASE(events_of_an_id_are_delivered_in_order)
+{
+    Recorder first, second;
+    EventDispatcher dispatcher(4, 64, BLOCK);
+    dispatcher.subscribe("first", &first, false);
+    dispatcher.subscribe("second", &second, false);
+
+    for (int i = 0 ; i < 500 ; i++) {
+        ostringstream element;
+        element << "e" << i;
+        dispatcher.post("first", content(element.str()));
+        dispatcher.post("second", content(element.str()));
+    }
+
+    BOOST_REQUIRE(first.waitForCalls(500));
+    BOOST_REQUIRE(second.waitForCalls(500));
+
+    vector<vector<string> > events = first.events();
+    for (int i = 0 ; i < 500 ; i++) {
+        ostringstream element;
+        element << "e" << i;
+        BOOST_REQUIRE_EQUAL(events[i].size(), 1u);
+        BOOST_CHECK_EQUAL(events[i][0], element.str());
+    }
+    BOOST_CHECK(second.events() == events);
+    BOOST_CHECK_EQUAL(dispatcher.droppedEvents(), 0u);
+}
+
+// Fills the only queue of a dispatcher of capacity 2 with a, b and c, while
+// its worker is held by a gate, and returns what is delivered.
+vector<vector<string> > overflow(OverflowPolicy policy, vector<bool>& posted, unsigned long& dropped) {
+    // Declared first: the dispatcher joins its worker before they go.
+    Gate gate;
+    Recorder recorder;
+    EventDispatcher dispatcher(1, 2, policy);
+    dispatcher.subscribe("gate", &gate, true);
+    dispatcher.subscribe("evt", &recorder, false);
+
+    dispatcher.post("gate", content("g"));
+    gate.waitUntilEntered();
+
+    posted.push_back(dispatcher.post("evt", content("a")));
+    posted.push_back(dispatcher.post("evt", content("b")));
+    posted.push_back(dispatcher.post("evt", content("c")));
+    dropped = dispatcher.droppedEvents();
+
+    gate.open();
+    recorder.waitForCalls(2);
+    return recorder.events();
+}
+
+BOOST_AUTO_TEST_CASE(drop_newest)
+{
+    vector<bool> posted;
+    unsigned long dropped;
+    vector<vector<string> > events = overflow(DROP_NEWEST, posted, dropped);
+
+    BOOST_CHECK(posted[0] && posted[1] && !posted[2]);
+    BOOST_CHECK_EQUAL(dropped, 1u);
+    BOOST_REQUIRE_EQUAL(events.size(), 2u);
+    BOOST_CHECK_EQUAL(events[0][0], "a");
+    BOOST_CHECK_EQUAL(events[1][0], "b");
+}
+
+BOOST_AUTO_TEST_CASE(drop_oldest)
+{
+    vector<bool> posted;
+    unsigned long dropped;
+    vector<vector<string> > events = overflow(DROP_OLDEST, posted, dropped);
+
+    BOOST_CHECK(posted[0] && posted[1] && posted[2]);
+    BOOST_CHECK_EQUAL(dropped, 1u);
+    BOOST_REQUIRE_EQUAL(events.size(), 2u);
+    BOOST_CHECK_EQUAL(events[0][0], "b");
+    BOOST_CHECK_EQUAL(events[1][0], "c");
+}
+
+// The concepts of a call, in alphabetical order.
+string sorted(vector<string> elements) {
+    sort(elements.begin(), elements.end());
+    string result;
+    for (size_t i = 0 ; i < elements.size() ; i++) result += elements[i];
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(bursts_are_delivered_when_the_window_closes)
+{
+    Recorder recorder;
+    EventDispatcher dispatcher;
+    dispatcher.subscribe("evt", &recorder, false, EventCoalescing(100));
+
+    dispatcher.post("evt", content("a"));
+    dispatcher.post("evt", content("b"));
+    dispatcher.post("evt", content("a"));
+    dispatcher.post("evt", string());
+
+    boost::this_thread::sleep(boost::posix_time::milliseconds(30));
+    BOOST_CHECK_EQUAL(recorder.calls(), 0u);
+
+    BOOST_REQUIRE(recorder.waitForCalls(1));
+    BOOST_CHECK_EQUAL(sorted(recorder.events()[0]), "ab");
+
+    // A new window opens with the next event.
+    dispatcher.post("evt", content("c"));
+    BOOST_REQUIRE(recorder.waitForCalls(2));
+    BOOST_CHECK_EQUAL(sorted(recorder.events()[1]), "c");
+    BOOST_CHECK_EQUAL(recorder.calls(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(max_events_flushes_a_burst_early)
+{
+    Recorder recorder;
+    EventDispatcher dispatcher;
+    dispatcher.subscribe("evt", &recorder, false, EventCoalescing(1000, 2));
+
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+    dispatcher.post("evt", content("a"));
+    dispatcher.post("evt", content("b"));
+    dispatcher.post("evt", content("c"));
+
+    BOOST_REQUIRE(recorder.waitForCalls(1));
+    BOOST_CHECK((boost::posix_time::microsec_clock::universal_time() - start).total_milliseconds() < 500);
+    BOOST_CHECK_EQUAL(sorted(recorder.events()[0]), "ab");
+
+    // The rest waits for its own window.
+    boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+    BOOST_CHECK_EQUAL(recorder.calls(), 1u);
+    BOOST_REQUIRE(recorder.waitForCalls(2));
+    BOOST_CHECK_EQUAL(sorted(recorder.events()[1]), "c");
+}
+
+BOOST_AUTO_TEST_CASE(unsubscribe_waits_for_the_observer)
+{
+    EventDispatcher dispatcher;
+    Recorder slow(200);
+
+    dispatcher.subscribe("evt", &slow, false);
+    dispatcher.post("evt", content("a"));
+    BOOST_REQUIRE(slow.waitForCalls(1));
+
+    // The observer is still running: unsubscribe returns once it is done.
+    BOOST_CHECK(dispatcher.unsubscribe("evt"));
+    BOOST_CHECK_EQUAL(slow.done(), 1u);
+
+    BOOST_CHECK(!dispatcher.unsubscribe("evt"));
+}
+
+BOOST_AUTO_TEST_CASE(unsubscribe_discards_coalesced_events)
+{
+    Recorder recorder;
+    {
+        EventDispatcher dispatcher;
+        dispatcher.subscribe("evt", &recorder, false, EventCoalescing(100));
+
+        dispatcher.post("evt", content("a"));
+        boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+        dispatcher.unsubscribe("evt");
+
+        // The burst would be delivered when its window closes.
+        boost::this_thread::sleep(boost::posix_time::milliseconds(200));
+    }
+    BOOST_CHECK_EQUAL(recorder.calls(), 0u);
+}
+
+// Reconfigures the dispatcher it observes.
+class Reconfigurer : public OroEventObserver {
+public:
+    Reconfigurer(EventDispatcher& dispatcher) : dispatcher(dispatcher), rejected(false) {}
+
+    void operator()(const OroEvent&) {
+        try {
+            dispatcher.configure(2, 16, DROP_NEWEST);
+        } catch (OntologyException&) {
+            rejected = true;
+        }
+    }
+
+    EventDispatcher& dispatcher;
+    boost::atomic<bool> rejected;
+};
+
+BOOST_AUTO_TEST_CASE(configure_is_rejected_from_an_observer)
+{
+    Recorder recorder;
+    EventDispatcher dispatcher;
+    Reconfigurer reconfigurer(dispatcher);
+
+    dispatcher.subscribe("evt", &reconfigurer, true);
+    dispatcher.subscribe("next", &recorder, false);
+    dispatcher.post("evt", content("a"));
+    dispatcher.post("next", content("b"));
+
+    BOOST_REQUIRE(recorder.waitForCalls(1));
+    BOOST_CHECK(reconfigurer.rejected);
+
+    // Still possible from any other thread.
+    dispatcher.configure(2, 16, DROP_NEWEST);
+    dispatcher.post("next", content("c"));
+    BOOST_CHECK(recorder.waitForCalls(2));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/*******************************************************************************
+*                           Prepared requests                                  *
+*******************************************************************************/
+
+BOOST_AUTO_TEST_SUITE(prepared_query)
+
+// Records the serialized requests, and answers them with one result.
+class RecordingConnector : public IConnector {
+public:
+    RecordingConnector() : calls(0) {}
+
+    ServerResponse execute(const string&, const vector<server_param_types>&, bool) {return answer();}
+    ServerResponse execute(const string&, const server_param_types&, bool) {return answer();}
+    ServerResponse execute(const string&, bool) {return answer();}
+
+    ServerResponse executeSerialized(const string& query, const string& serialized_args, bool) {
+        calls++;
+        method = query;
+        args = serialized_args;
+        return answer();
+    }
+
+    bool isConnected() {return true;}
+
+    ServerResponse answer() {
+        ServerResponse res;
+        res.status = ServerResponse::ok;
+        set<string> result;
+        result.insert("table1");
+        res.result = result;
+        return res;
+    }
+
+    size_t calls;
+    string method;
+    string args;
+};
+
+BOOST_AUTO_TEST_CASE(query_fragments)
+{
+    RecordingConnector connector;
+    PreparedQuery query(connector, "x", "SELECT ?x WHERE {${agent} sees ?x . ?x label ${name:literal} . ${agent} likes ?x}");
+
+    vector<string> placeholders = query.placeholders();
+    BOOST_REQUIRE_EQUAL(placeholders.size(), 2u);
+    BOOST_CHECK_EQUAL(placeholders[0], "agent");
+    BOOST_CHECK_EQUAL(placeholders[1], "name");
+
+    set<string> result;
+    query.bind("agent", "myself").bind("name", "say \"hi\" \\o/").execute(result);
+
+    BOOST_CHECK_EQUAL(connector.method, "query");
+    BOOST_CHECK_EQUAL(connector.args, "\"x\"\n\"SELECT ?x WHERE {myself sees ?x . ?x label \"say \\\"hi\\\" \\\\o/\" . myself likes ?x}\"\n");
+    BOOST_CHECK_EQUAL(result.size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(find_fragments_are_escaped)
+{
+    RecordingConnector connector;
+
+    set<string> partial_statements;
+    partial_statements.insert("?x seenBy ${agent}");
+    partial_statements.insert("?x label ${name:literal}");
+    set<string> restrictions;
+    restrictions.insert("?x weight < ${max:double}");
+
+    PreparedFind find(connector, "x", partial_statements, restrictions);
+
+    set<Concept> result;
+    find.bind("agent", "myself").bind("name", "big \"red\" table").bind("max", 2.5).execute(result);
+
+    // Serialized as Ontology::find() would serialize the same request (the
+    // partial statements keep their order once bound).
+    set<string> bound_statements;
+    bound_statements.insert("?x seenBy myself");
+    bound_statements.insert("?x label \"big \\\"red\\\" table\"");
+    set<string> bound_restrictions;
+    bound_restrictions.insert("?x weight < 2.5");
+
+    ParametersSerializationHolder expected;
+    expected(string("x"));
+    expected(bound_statements);
+    expected(bound_restrictions);
+
+    BOOST_CHECK_EQUAL(connector.method, "find");
+    BOOST_CHECK_EQUAL(connector.args, expected.getArgs());
+    BOOST_CHECK_EQUAL(connector.args, "\"x\"\n"
+                                      "[\"?x label \\\"big \\\\\"red\\\\\" table\\\"\",\"?x seenBy myself\"]\n"
+                                      "[\"?x weight < 2.5\"]\n");
+    BOOST_CHECK_EQUAL(result.size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(bindings_are_validated)
+{
+    RecordingConnector connector;
+    PreparedQuery query(connector, "x", "SELECT ?x WHERE {${a} p ${n:int} . ?x q ${d:double} . ?x r ${b:bool}}");
+
+    BOOST_CHECK_THROW(query.bind("unknown", "x"), OntologyException);
+
+    BOOST_CHECK_THROW(query.bind("a", "two words"), OntologyException);
+    BOOST_CHECK_THROW(query.bind("a", "\"quoted\""), OntologyException);
+    BOOST_CHECK_THROW(query.bind("a", ""), OntologyException);
+    BOOST_CHECK_THROW(query.bind("a", 1), OntologyException);
+
+    BOOST_CHECK_THROW(query.bind("n", "1.5"), OntologyException);
+    BOOST_CHECK_THROW(query.bind("n", "ten"), OntologyException);
+    BOOST_CHECK_THROW(query.bind("n", 1.5), OntologyException);
+    BOOST_CHECK_THROW(query.bind("n", true), OntologyException);
+    BOOST_CHECK_NO_THROW(query.bind("n", 10));
+
+    BOOST_CHECK_THROW(query.bind("d", "1e"), OntologyException);
+    BOOST_CHECK_NO_THROW(query.bind("d", 3)); // an int is a valid double
+
+    BOOST_CHECK_THROW(query.bind("b", "yes"), OntologyException);
+    BOOST_CHECK_NO_THROW(query.bind("b", false));
+
+    // Every placeholder must be bound.
+    set<string> result;
+    BOOST_CHECK_THROW(query.execute(result), OntologyException);
+    BOOST_CHECK_EQUAL(connector.calls, 0u);
+
+    query.bind("a", "myself");
+    query.execute(result);
+    BOOST_CHECK_EQUAL(connector.args, "\"x\"\n\"SELECT ?x WHERE {myself p 10 . ?x q 3 . ?x r false}\"\n");
+
+    query.clearBindings();
+    BOOST_CHECK_THROW(query.execute(result), OntologyException);
+}
+
+BOOST_AUTO_TEST_CASE(invalid_templates)
+{
+    RecordingConnector connector;
+    BOOST_CHECK_THROW(PreparedQuery(connector, "x", "SELECT ?x WHERE {?x p ${a"), OntologyException);
+    BOOST_CHECK_THROW(PreparedQuery(connector, "x", "SELECT ?x WHERE {${} p ?x}"), OntologyException);
+    BOOST_CHECK_THROW(PreparedQuery(connector, "x", "SELECT ?x WHERE {${a:float} p ?x}"), OntologyException);
+    BOOST_CHECK_THROW(PreparedQuery(connector, "x", "SELECT ?x WHERE {${a:int} p ${a:bool}}"), OntologyException);
+}
+
+BOOST_AUTO_TEST_CASE(results_are_cached_per_binding)
+{
+    RecordingConnector connector;
+    PreparedQuery query(connector, "x", "SELECT ?x WHERE {${a} sees ?x}");
+    query.enableCache(1);
+
+    set<string> result;
+    query.bind("a", "myself").execute(result);
+    query.bind("a", "myself").execute(result);
+    BOOST_CHECK_EQUAL(connector.calls, 1u);
+    BOOST_CHECK_EQUAL(query.cacheHits(), 1u);
+
+    query.bind("a", "you").execute(result);
+    query.bind("a", "myself").execute(result); // evicted
+    BOOST_CHECK_EQUAL(connector.calls, 3u);
+    BOOST_CHECK_EQUAL(result.size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(dsl_find)
+{
+    ORO_DSL_VAR(x);
+    ORO_DSL_PARAM(agent, PreparedRequest::ID);
+
+    Property sees(Symbol("sees"));
+    Class robot(Symbol("Robot"));
+
+    set<string> statements = dsl::find(x, dsl::triple(agent, sees, x) & dsl::isA(x, robot)).statements();
+
+    BOOST_CHECK_EQUAL(dsl::find(x, dsl::isA(x, robot)).resource(), "x");
+    BOOST_REQUIRE_EQUAL(statements.size(), 2u);
+    BOOST_CHECK(statements.count("${agent:id} sees ?x"));
+    BOOST_CHECK(statements.count("?x rdf:type Robot"));
+}
+
+BOOST_AUTO_TEST_CASE(dsl_sparql)
+{
+    ORO_DSL_VAR(x);
+    ORO_DSL_PARAM(name, PreparedRequest::LITERAL);
+
+    Concept myself(Symbol("myself"));
+    Property label(Symbol("rdfs:label"));
+
+    string text = dsl::sparql(x, dsl::triple(myself, "sees", x)
+                                    & dsl::triple(x, label, name)
+                                    & dsl::triple(x, "weight", 0.5)
+                                    & dsl::triple(x, "says", dsl::literal("\"hi\""))).text();
+
+    BOOST_CHECK_EQUAL(text, "SELECT ?x WHERE { oro:myself oro:sees ?x . ?x rdfs:label ${name:literal} ."
+                            " ?x oro:weight 0.5 . ?x oro:says \"\\\"hi\\\"\" }");
+
+    // The text is a valid template.
+    RecordingConnector connector;
+    PreparedQuery query(connector, "x", text);
+    set<string> result;
+    query.bind("name", "Bob").execute(result);
+    BOOST_CHECK_EQUAL(connector.args, "\"x\"\n\"SELECT ?x WHERE { oro:myself oro:sees ?x . ?x rdfs:label \"Bob\" ."
+                                      " ?x oro:weight 0.5 . ?x oro:says \"\\\"hi\\\"\" }\"\n");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/*******************************************************************************
+*                                Logging                                       *
+*******************************************************************************/
+
+BOOST_AUTO_TEST_SUITE(logging)
+
+BOOST_AUTO_TEST_CASE(long_strings_are_visibly_truncated)
+{
+    LogRecord record;
+    record.formatString = "{}|{}|{}";
+    record.nbArgs = 0;
+    record.payloadSize = 0;
+
+    record.add(string(150, 'a'));
+    record.add(string(100, 'b'));
+    record.add("c");
+
+    string out;
+    record.format(out);
+
+    BOOST_CHECK_EQUAL(out, string(150, 'a') + "|" + string(ORO_LOG_PAYLOAD - 153, 'b') + "...|");
+}
+
+BOOST_AUTO_TEST_SUITE_END()